@@ -0,0 +1,355 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: allocator.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static MemoryBlock *GetMemoryBlock(void *memory)
+static void ReleaseMemoryBlocks(MemoryBlock *block)
+static MemoryBlock *EvictMemoryPool(size_t bytes)
+void *AllocateMemory(MemoryUse use, size_t size)
+void FreeMemory(void *memory)
+void SetMemoryPoolBytes(size_t bytes)
+void TrimMemoryPool()
+void PrintMemoryReport(FILE *fp)
+   $
+   $Description: Every block has a header in front of it with its size
+   and what it is for. A freed block goes on the front of the pool and is
+   only handed out again for an allocation of exactly the same size, so
+   nothing is ever bigger than it was asked to be. The images of a batch
+   are usually the same size, so their pixels and buffers keep coming back
+   out of the pool. When the pool is holding more than its limit the
+   blocks that were freed the longest time ago are given back to the
+   system. One lock covers the pool and the counts, it is only taken a
+   few times for each buffer of an encode or decode. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "allocator.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// The header in front of every block. It takes MEMORY_ALIGNMENT bytes so
+// the block after it stays aligned.
+struct MemoryBlock
+{
+    size_t Size;
+    MemoryUse Use;
+
+    // The next block in the pool, when the block has been freed.
+    MemoryBlock *Next;
+};
+
+static_assert(sizeof(MemoryBlock) <= MEMORY_ALIGNMENT, "The memory block header has to fit in the alignment.");
+
+// The counts of one use of memory.
+struct MemoryTotal
+{
+    size_t Current;
+    size_t Peak;
+    uint64_t Allocations;
+    uint64_t Reused;
+};
+
+static const char *memory_use_names[MEMORY_USE_COUNT] =
+{
+    "image", "payload", "stream", "chunk", "compression", "archive",
+};
+
+static pthread_mutex_t memory_lock = PTHREAD_MUTEX_INITIALIZER;
+static MemoryTotal memory_totals[MEMORY_USE_COUNT];
+static size_t memory_current = 0;
+static size_t memory_peak = 0;
+
+// The freed blocks, the most recently freed first.
+static MemoryBlock *memory_pool = 0;
+static size_t memory_pool_bytes = 0;
+static size_t memory_pool_limit = MEMORY_POOL_BYTES;
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetMemoryBlock
+   $Prototype: static MemoryBlock *GetMemoryBlock(void *memory)
+   $Params:
+       memory: A block from AllocateMemory
+   $
+   $Description: Returns the header in front of the block. $
+   ======================================================================== */
+static MemoryBlock *GetMemoryBlock(void *memory)
+{
+    return (MemoryBlock*)((uint8_t*)memory - MEMORY_ALIGNMENT);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReleaseMemoryBlocks
+   $Prototype: static void ReleaseMemoryBlocks(MemoryBlock *block)
+   $Params:
+       block: The first of a list of blocks
+   $
+   $Description: Gives every block in the list back to the system. This
+   is done without the lock held. $
+   ======================================================================== */
+static void ReleaseMemoryBlocks(MemoryBlock *block)
+{
+    while (block)
+    {
+        MemoryBlock *next = block->Next;
+
+        free(block);
+        block = next;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EvictMemoryPool
+   $Prototype: static MemoryBlock *EvictMemoryPool(size_t bytes)
+   $Params:
+       bytes: How many bytes the pool can hold at most afterwards
+   $
+   $Description: Takes the oldest blocks out of the pool until it holds
+   no more than bytes. The lock has to be held. Returns the list of blocks
+   that were taken out, for ReleaseMemoryBlocks. $
+   ======================================================================== */
+static MemoryBlock *EvictMemoryPool(size_t bytes)
+{
+    MemoryBlock *evicted = 0;
+
+    while (memory_pool_bytes > bytes)
+    {
+        MemoryBlock **last = &memory_pool;
+
+        while ((*last)->Next)
+        {
+            last = &(*last)->Next;
+        }
+
+        MemoryBlock *block = *last;
+
+        *last = 0;
+        memory_pool_bytes -= block->Size;
+
+        block->Next = evicted;
+        evicted = block;
+    }
+
+    return evicted;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: AllocateMemory
+   $Prototype: void *AllocateMemory(MemoryUse use, size_t size)
+   $Params:
+       use: What the memory is for
+       size: How many bytes are needed
+   $
+   $Description: Returns a block of exactly size bytes that is
+   MEMORY_ALIGNMENT aligned. A freed block of the same size is reused if
+   the pool has one. Returns 0 if the memory can't be allocated. $
+   ======================================================================== */
+void *AllocateMemory(MemoryUse use, size_t size)
+{
+    MemoryBlock *block = 0;
+    MemoryTotal *total = memory_totals + use;
+
+    pthread_mutex_lock(&memory_lock);
+
+    for(MemoryBlock **next = &memory_pool; *next; next = &(*next)->Next)
+    {
+        if ((*next)->Size == size)
+        {
+            block = *next;
+            *next = block->Next;
+            memory_pool_bytes -= size;
+            total->Reused++;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&memory_lock);
+
+    if (block == 0)
+    {
+        void *memory;
+
+        if (posix_memalign(&memory, MEMORY_ALIGNMENT, MEMORY_ALIGNMENT + size) != 0)
+        {
+            return 0;
+        }
+
+        block = (MemoryBlock*)memory;
+        block->Size = size;
+    }
+
+    block->Use = use;
+    block->Next = 0;
+
+    pthread_mutex_lock(&memory_lock);
+
+    total->Allocations++;
+    total->Current += size;
+    if (total->Current > total->Peak)
+    {
+        total->Peak = total->Current;
+    }
+
+    memory_current += size;
+    if (memory_current > memory_peak)
+    {
+        memory_peak = memory_current;
+    }
+
+    pthread_mutex_unlock(&memory_lock);
+
+    return (uint8_t*)block + MEMORY_ALIGNMENT;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FreeMemory
+   $Prototype: void FreeMemory(void *memory)
+   $Params:
+       memory: A block from AllocateMemory, or 0.
+   $
+   $Description: Puts the block in the pool to be reused. If that takes
+   the pool over its limit the oldest blocks are given back to the
+   system, and a block bigger than the limit never goes in the pool. $
+   ======================================================================== */
+void FreeMemory(void *memory)
+{
+    MemoryBlock *block;
+    MemoryBlock *evicted = 0;
+
+    if (memory == 0)
+    {
+        return;
+    }
+
+    block = GetMemoryBlock(memory);
+
+    pthread_mutex_lock(&memory_lock);
+
+    memory_totals[block->Use].Current -= block->Size;
+    memory_current -= block->Size;
+
+    if (block->Size <= memory_pool_limit)
+    {
+        evicted = EvictMemoryPool(memory_pool_limit - block->Size);
+
+        block->Next = memory_pool;
+        memory_pool = block;
+        memory_pool_bytes += block->Size;
+    }
+    else
+    {
+        block->Next = 0;
+        evicted = block;
+    }
+
+    pthread_mutex_unlock(&memory_lock);
+
+    ReleaseMemoryBlocks(evicted);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetMemoryPoolBytes
+   $Prototype: void SetMemoryPoolBytes(size_t bytes)
+   $Params:
+       bytes: How many bytes of freed blocks the pool can keep. 0 turns
+              the pool off.
+   $
+   $Description: Sets the limit of the pool, giving back the oldest
+   blocks if it is holding more than that. $
+   ======================================================================== */
+void SetMemoryPoolBytes(size_t bytes)
+{
+    MemoryBlock *evicted;
+
+    pthread_mutex_lock(&memory_lock);
+
+    memory_pool_limit = bytes;
+    evicted = EvictMemoryPool(bytes);
+
+    pthread_mutex_unlock(&memory_lock);
+
+    ReleaseMemoryBlocks(evicted);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: TrimMemoryPool
+   $Prototype: void TrimMemoryPool()
+   $Params: $
+   $Description: Gives every block in the pool back to the system. The
+   limit stays the same. $
+   ======================================================================== */
+void TrimMemoryPool()
+{
+    MemoryBlock *evicted;
+
+    pthread_mutex_lock(&memory_lock);
+
+    evicted = memory_pool;
+    memory_pool = 0;
+    memory_pool_bytes = 0;
+
+    pthread_mutex_unlock(&memory_lock);
+
+    ReleaseMemoryBlocks(evicted);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: PrintMemoryReport
+   $Prototype: void PrintMemoryReport(FILE *fp)
+   $Params:
+       fp: Where to print the report
+   $
+   $Description: Prints how many bytes each use of memory has now and had
+   at most, how many blocks it allocated and how many of those came out of
+   the pool, then what the pool is holding. $
+   ======================================================================== */
+void PrintMemoryReport(FILE *fp)
+{
+    MemoryTotal totals[MEMORY_USE_COUNT];
+    size_t current;
+    size_t peak;
+    size_t pool_bytes;
+    int pool_count = 0;
+
+    pthread_mutex_lock(&memory_lock);
+
+    for(int i = 0; i < MEMORY_USE_COUNT; i++)
+    {
+        totals[i] = memory_totals[i];
+    }
+
+    current = memory_current;
+    peak = memory_peak;
+    pool_bytes = memory_pool_bytes;
+
+    for(MemoryBlock *block = memory_pool; block; block = block->Next)
+    {
+        pool_count++;
+    }
+
+    pthread_mutex_unlock(&memory_lock);
+
+    fprintf(fp, "%-16s %14s %14s %10s %10s\n", "memory", "current_kb", "peak_kb", "allocs", "reused");
+
+    for(int i = 0; i < MEMORY_USE_COUNT; i++)
+    {
+        fprintf(fp, "%-16s %14.1f %14.1f %10llu %10llu\n",
+                memory_use_names[i], totals[i].Current / 1024.0, totals[i].Peak / 1024.0,
+                (unsigned long long)totals[i].Allocations, (unsigned long long)totals[i].Reused);
+    }
+
+    fprintf(fp, "%-16s %14.1f %14.1f\n", "total", current / 1024.0, peak / 1024.0);
+    fprintf(fp, "The pool is keeping %.1f KB in %d blocks.\n", pool_bytes / 1024.0, pool_count);
+}
@@ -0,0 +1,63 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: allocator.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: Pixel buffers and scratch buffers for reading and writing
+                 come from a pool, so a batch of jobs reuses the same
+                 memory instead of growing. How much each part of the
+                 program has allocated is counted for a report. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(ALLOCATOR_H)
+#define ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// What the memory is for. Each one gets its own line in the report.
+enum MemoryUse
+{
+    // The pixels of images and rows of them.
+    MEMORY_IMAGE,
+
+    // Files and text that are being encoded or have been decoded.
+    MEMORY_PAYLOAD,
+
+    // The strips and buffers of the streaming encoder and decoder.
+    MEMORY_STREAM,
+
+    // Chunks of the payload that are being packed or unpacked.
+    MEMORY_CHUNK,
+
+    // The blocks and hash tables of the compressor.
+    MEMORY_COMPRESSION,
+
+    // The files of an archive.
+    MEMORY_ARCHIVE,
+
+    MEMORY_USE_COUNT
+};
+
+// Blocks are this aligned, which is enough for any of the kernels.
+#define MEMORY_ALIGNMENT 64
+
+// How many bytes of freed blocks the pool keeps by default. Bigger
+// blocks than this are never kept.
+#define MEMORY_POOL_BYTES (256 * 1024 * 1024)
+
+// Returns exactly size bytes, reusing a freed block of the same size if
+// the pool has one. Returns 0 if the memory can't be allocated.
+void *AllocateMemory(MemoryUse use, size_t size);
+
+// Gives the block back to the pool. memory can be 0.
+void FreeMemory(void *memory);
+
+void SetMemoryPoolBytes(size_t bytes);
+void TrimMemoryPool();
+
+void PrintMemoryReport(FILE *fp);
+
+#endif
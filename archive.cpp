@@ -0,0 +1,792 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: archive.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static void SetArchiveWord(char *bytes, uint32_t value)
+static uint32_t GetArchiveWord(const char *bytes)
+static void ReadArchiveJob(void *data, int index)
+static const char *GetArchiveName(const char *filename)
+static int IsArchiveNameSafe(const char *name)
+static char *ReadStegoArchive(char **filenames, int file_count, int *buffer_length)
+Image *EncodeStegoArchive(Image *image, char **filenames, int file_count)
+Image *EncodeStegoArchiveEnc(Image *image, char **filenames, int file_count, AESType aes, const char *password)
+static int ReadArchiveTable(StegoArchive *archive)
+static StegoArchive *StartStegoArchive(StegoReader *reader)
+StegoArchive *OpenStegoArchive(Image *image, const char *password)
+StegoArchive *OpenStegoArchive(const ImageView *view, const char *password)
+static int WriteArchiveFile(StegoArchive *archive, const StegoArchiveFile *file, const char *filename)
+int ExtractStegoArchiveFile(StegoArchive *archive, const char *name, const char *filename)
+static void ExtractArchiveJob(void *data, int index)
+int ExtractStegoArchive(StegoArchive *archive, const char *directory)
+void CloseStegoArchive(StegoArchive *archive)
+   $
+   $Description: An archive is stored as the data of an ordinary payload,
+   so it is chunked, compressed and encrypted like any other. The data
+   starts with a table:
+
+       0 "ARC" <file count> <table length>
+       <offset> <length> <CRC32C> <NUL terminated name>   for each file
+
+   followed by the contents of the files, one after the other. The words
+   are 4 bytes, most significant byte first, and the offsets are from the
+   start of the data. The leading 0 is an empty filename, so decoding an
+   archive as a single file is turned away.
+
+   Only the chunks that hold the table are decoded to list an archive,
+   and only the chunks of a file to extract it (see DecodeStegoReaderRange).
+   The files are read in parallel when they are encoded and extracted in
+   parallel when all of them are. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "checksum.h"
+#include "threads.h"
+#include "profiler.h"
+
+// The start of the table is the magic, the file count and the length of
+// the whole table. Each file has an entry of the offset, length and
+// checksum of its contents and then its name.
+#define ARCHIVE_MAGIC "\0ARC"
+#define ARCHIVE_MAGIC_BYTES 4
+#define ARCHIVE_HEADER_BYTES 12
+#define ARCHIVE_ENTRY_BYTES 12
+
+// The data of a payload has to fit in an int.
+#define ARCHIVE_MAX_LENGTH 0x7FFFFFFF
+
+// The files being read into the data of an archive.
+struct ArchiveRead
+{
+    char **Filenames;
+    char *Buffer;
+    StegoArchiveFile *Files;
+
+    // 0 if the file was read, otherwise -1.
+    int *Results;
+};
+
+// The files of an archive being extracted at once.
+struct ArchiveExtract
+{
+    StegoArchive *Archive;
+    const char *Directory;
+    int *Results;
+
+    // How many threads each file is extracted with.
+    int Threads;
+};
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetArchiveWord
+   $Prototype: static void SetArchiveWord(char *bytes, uint32_t value)
+   $Params:
+       bytes: Where to write the 4 bytes
+       value: The value to write
+   $
+   $Description: Writes a word of the table, most significant byte first. $
+   ======================================================================== */
+static void SetArchiveWord(char *bytes, uint32_t value)
+{
+    bytes[0] = (char)(value >> 24);
+    bytes[1] = (char)(value >> 16);
+    bytes[2] = (char)(value >> 8);
+    bytes[3] = (char)value;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetArchiveWord
+   $Prototype: static uint32_t GetArchiveWord(const char *bytes)
+   $Params:
+       bytes: The 4 bytes to read
+   $
+   $Description: Reads a word of the table. $
+   ======================================================================== */
+static uint32_t GetArchiveWord(const char *bytes)
+{
+    const uint8_t *in = (const uint8_t*)bytes;
+
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadArchiveJob
+   $Prototype: static void ReadArchiveJob(void *data, int index)
+   $Params:
+       data: The ArchiveRead
+       index: The file to read
+   $
+   $Description: Reads a file into its place in the data and works out
+   its checksum while it is in the cache. $
+   ======================================================================== */
+static void ReadArchiveJob(void *data, int index)
+{
+    ArchiveRead *read = (ArchiveRead*)data;
+    StegoArchiveFile *file = &read->Files[index];
+    char *buffer = read->Buffer + file->Offset;
+    uint32_t bytes_read = 0;
+    FILE *fp;
+
+    read->Results[index] = -1;
+
+    if ((fp = fopen(read->Filenames[index], "r")) == 0)
+    {
+        printf("Unable to open file: %s\n", read->Filenames[index]);
+        return;
+    }
+
+    while (bytes_read < file->Length)
+    {
+        uint32_t n = fread(buffer + bytes_read, 1, file->Length - bytes_read, fp);
+
+        if (n == 0)
+        {
+            printf("Error reading file: %s\n", read->Filenames[index]);
+            fclose(fp);
+            return;
+        }
+
+        bytes_read += n;
+    }
+
+    fclose(fp);
+
+    file->Checksum = FinishChecksum(UpdateChecksum(CHECKSUM_START, (const uint8_t*)buffer, file->Length));
+    read->Results[index] = 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetArchiveName
+   $Prototype: static const char *GetArchiveName(const char *filename)
+   $Params:
+       filename: The path of a file being put in an archive
+   $
+   $Description: Returns the name the file is stored under, which is the
+   last part of its path. The directories in front of it are dropped so
+   extracting the archive only ever writes into the one directory. $
+   ======================================================================== */
+static const char *GetArchiveName(const char *filename)
+{
+    const char *name = strrchr(filename, '/');
+
+    return name ? name + 1 : filename;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: IsArchiveNameSafe
+   $Prototype: static int IsArchiveNameSafe(const char *name)
+   $Params:
+       name: The name of a file in an archive
+   $
+   $Description: Returns 1 if the file can be extracted under the name
+   without writing outside of the directory it is extracted into. The
+   name can't be empty, start with a /, or have a part that is empty, .
+   or .. in it. Returns 0 otherwise. $
+   ======================================================================== */
+static int IsArchiveNameSafe(const char *name)
+{
+    const char *part = name;
+
+    if (name[0] == 0 || name[0] == '/')
+    {
+        return 0;
+    }
+
+    for(;;)
+    {
+        const char *part_end = strchr(part, '/');
+        size_t part_length = part_end ? (size_t)(part_end - part) : strlen(part);
+
+        if (part_length == 0 ||
+            (part_length == 1 && part[0] == '.') ||
+            (part_length == 2 && part[0] == '.' && part[1] == '.'))
+        {
+            return 0;
+        }
+
+        if (part_end == 0)
+        {
+            return 1;
+        }
+
+        part = part_end + 1;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoArchive
+   $Prototype: static char *ReadStegoArchive(char **filenames, int file_count, int *buffer_length)
+   $Params:
+       filenames: The files to put in the archive
+       file_count: How many files there are
+       buffer_length: Gets set to the length of the returned buffer.
+   $
+   $Description: Works out where every file goes from their sizes, reads
+   them in on the stego threads and then writes the table in front of
+   them. Each file is stored under its name without the directories in
+   front of it (see GetArchiveName). The buffer needs to be freed. Returns 0 if a file can't be read
+   or they don't fit in a payload. $
+   ======================================================================== */
+static char *ReadStegoArchive(char **filenames, int file_count, int *buffer_length)
+{
+    TIMED_BLOCK();
+
+    ArchiveRead read;
+    StegoArchiveFile *files = (StegoArchiveFile*)calloc(file_count, sizeof(StegoArchiveFile));
+    int *results = (int*)malloc(sizeof(int) * file_count);
+    uint64_t length = ARCHIVE_HEADER_BYTES;
+    uint32_t table_length;
+    char *entry;
+    char *buffer = 0;
+
+    for(int i = 0; i < file_count; i++)
+    {
+        const char *name = GetArchiveName(filenames[i]);
+
+        if (!IsArchiveNameSafe(name))
+        {
+            printf("Error: %s can't be stored in an archive.\n", filenames[i]);
+            free(files);
+            free(results);
+            return 0;
+        }
+
+        length += ARCHIVE_ENTRY_BYTES + strlen(name) + 1;
+    }
+
+    table_length = (uint32_t)length;
+
+    // Get the file sizes, the contents go after the table.
+    for(int i = 0; i < file_count; i++)
+    {
+        FILE *fp;
+
+        if ((fp = fopen(filenames[i], "r")) == 0)
+        {
+            printf("Unable to open file: %s\n", filenames[i]);
+            free(files);
+            free(results);
+            return 0;
+        }
+
+        fseek(fp, 0, SEEK_END);
+        files[i].Name = GetArchiveName(filenames[i]);
+        files[i].Offset = (uint32_t)length;
+        files[i].Length = ftell(fp);
+        length += files[i].Length;
+        fclose(fp);
+
+        if (length > ARCHIVE_MAX_LENGTH)
+        {
+            printf("Error: the files are too long to store.\n");
+            free(files);
+            free(results);
+            return 0;
+        }
+    }
+
+    buffer = (char*)AllocateMemory(MEMORY_ARCHIVE, length);
+
+    read.Filenames = filenames;
+    read.Buffer = buffer;
+    read.Files = files;
+    read.Results = results;
+
+    ParallelFor(GetStegoThreads(), file_count, ReadArchiveJob, &read);
+
+    // Write the table.
+    memcpy(buffer, ARCHIVE_MAGIC, ARCHIVE_MAGIC_BYTES);
+    SetArchiveWord(buffer + 4, file_count);
+    SetArchiveWord(buffer + 8, table_length);
+    entry = buffer + ARCHIVE_HEADER_BYTES;
+
+    for(int i = 0; i < file_count; i++)
+    {
+        int name_length = strlen(files[i].Name) + 1;
+
+        if (results[i] != 0)
+        {
+            FreeMemory(buffer);
+            buffer = 0;
+            break;
+        }
+
+        SetArchiveWord(entry, files[i].Offset);
+        SetArchiveWord(entry + 4, files[i].Length);
+        SetArchiveWord(entry + 8, files[i].Checksum);
+        memcpy(entry + ARCHIVE_ENTRY_BYTES, files[i].Name, name_length);
+        entry += ARCHIVE_ENTRY_BYTES + name_length;
+    }
+
+    free(files);
+    free(results);
+
+    *buffer_length = (int)length;
+
+    return buffer;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoArchive
+   $Prototype: Image *EncodeStegoArchive(Image *image, char **filenames, int file_count)
+   $Params:
+       image: The image to encode into
+       filenames: The files to put in the archive. They are stored with
+                  the last part of these names.
+       file_count: How many files there are
+   $
+   $Description: Encodes an archive of the files into a copy of the image. $
+   ======================================================================== */
+Image *EncodeStegoArchive(Image *image, char **filenames, int file_count)
+{
+    TIMED_BLOCK();
+
+    Image *encoded_image;
+    int buffer_length;
+    char *buffer;
+
+    if ((buffer = ReadStegoArchive(filenames, file_count, &buffer_length)) == 0)
+    {
+        return 0;
+    }
+
+    encoded_image = EncodeStegoBuffer(image, buffer, buffer_length);
+    FreeMemory(buffer);
+
+    return encoded_image;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoArchiveEnc
+   $Prototype: Image *EncodeStegoArchiveEnc(Image *image, char **filenames, int file_count, AESType aes, const char *password)
+   $Params:
+       image: The image to encode into
+       filenames: The files to put in the archive
+       file_count: How many files there are
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: Encodes an encrypted archive of the files into a copy of
+   the image. The table is encrypted along with the files. $
+   ======================================================================== */
+Image *EncodeStegoArchiveEnc(Image *image, char **filenames, int file_count, AESType aes, const char *password)
+{
+    TIMED_BLOCK();
+
+    Image *encoded_image;
+    int buffer_length;
+    char *buffer;
+
+    if ((buffer = ReadStegoArchive(filenames, file_count, &buffer_length)) == 0)
+    {
+        return 0;
+    }
+
+    encoded_image = EncodeStegoBufferEnc(image, buffer, buffer_length, aes, password);
+    FreeMemory(buffer);
+
+    return encoded_image;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadArchiveTable
+   $Prototype: static int ReadArchiveTable(StegoArchive *archive)
+   $Params:
+       archive: The archive with its reader open.
+   $
+   $Description: Decodes the table and fills out the files from it. Every
+   entry is checked to be inside the data, and its name to be safe to
+   extract (see IsArchiveNameSafe), before any of them are used. Returns 0
+   on success and -1 if it isn't an archive or the table is bad. $
+   ======================================================================== */
+static int ReadArchiveTable(StegoArchive *archive)
+{
+    uint32_t data_length = StegoReaderBytes(archive->Reader);
+    char header[ARCHIVE_HEADER_BYTES];
+    uint32_t file_count;
+    uint32_t table_length;
+    uint32_t position = ARCHIVE_HEADER_BYTES;
+
+    if (data_length < ARCHIVE_HEADER_BYTES)
+    {
+        printf("Cannot decode image. The data isn't an archive.\n");
+        return -1;
+    }
+
+    if (DecodeStegoReaderRange(archive->Reader, header, 0, ARCHIVE_HEADER_BYTES) < 0)
+    {
+        return -1;
+    }
+
+    if (memcmp(header, ARCHIVE_MAGIC, ARCHIVE_MAGIC_BYTES) != 0)
+    {
+        printf("Cannot decode image. The data isn't an archive.\n");
+        return -1;
+    }
+
+    file_count = GetArchiveWord(header + 4);
+    table_length = GetArchiveWord(header + 8);
+
+    // Every entry has at least a one character name and its NUL.
+    if (table_length > data_length ||
+        (uint64_t)file_count * (ARCHIVE_ENTRY_BYTES + 2) > table_length - ARCHIVE_HEADER_BYTES)
+    {
+        printf("Cannot decode image. The archive table is bad.\n");
+        return -1;
+    }
+
+    archive->Table = (char*)malloc(table_length);
+    archive->Files = (StegoArchiveFile*)calloc(file_count + 1, sizeof(StegoArchiveFile));
+
+    if (DecodeStegoReaderRange(archive->Reader, archive->Table, 0, table_length) < 0)
+    {
+        return -1;
+    }
+
+    for(uint32_t i = 0; i < file_count; i++)
+    {
+        StegoArchiveFile *file = &archive->Files[i];
+        const char *entry = archive->Table + position;
+        const char *name_end;
+
+        if (table_length - position < ARCHIVE_ENTRY_BYTES + 2 ||
+            (name_end = (const char*)memchr(entry + ARCHIVE_ENTRY_BYTES, 0, table_length - position - ARCHIVE_ENTRY_BYTES)) == 0)
+        {
+            printf("Cannot decode image. The archive table is bad.\n");
+            return -1;
+        }
+
+        file->Offset = GetArchiveWord(entry);
+        file->Length = GetArchiveWord(entry + 4);
+        file->Checksum = GetArchiveWord(entry + 8);
+        file->Name = entry + ARCHIVE_ENTRY_BYTES;
+
+        if (file->Offset < table_length || file->Offset > data_length ||
+            file->Length > data_length - file->Offset)
+        {
+            printf("Cannot decode image. The archive table is bad.\n");
+            return -1;
+        }
+
+        if (!IsArchiveNameSafe(file->Name))
+        {
+            printf("Cannot decode image. The archive has a file called %s, which isn't safe to extract.\n", file->Name);
+            return -1;
+        }
+
+        position = (name_end + 1) - archive->Table;
+    }
+
+    archive->FileCount = file_count;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartStegoArchive
+   $Prototype: static StegoArchive *StartStegoArchive(StegoReader *reader)
+   $Params:
+       reader: The reader of the payload, or 0 if it couldn't be opened.
+   $
+   $Description: Makes an archive of the payload the reader has opened
+   and reads its table. The archive closes the reader. Returns 0 if there
+   isn't a reader or the payload isn't an archive. $
+   ======================================================================== */
+static StegoArchive *StartStegoArchive(StegoReader *reader)
+{
+    StegoArchive *archive;
+
+    if (reader == 0)
+    {
+        return 0;
+    }
+
+    archive = (StegoArchive*)calloc(1, sizeof(StegoArchive));
+    archive->Reader = reader;
+
+    if (ReadArchiveTable(archive) != 0)
+    {
+        CloseStegoArchive(archive);
+        return 0;
+    }
+
+    return archive;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: OpenStegoArchive
+   $Prototype: StegoArchive *OpenStegoArchive(Image *image, const char *password)
+   $Params:
+       image: The image with the archive. It has to stay loaded until the
+              archive is closed.
+       password: The password it was encrypted with, 0 if it isn't
+                 encrypted.
+   $
+   $Description: Opens the archive in an image and reads its table, which
+   only decodes the chunks the table is in, so listing the files of an
+   archive takes as long however big they are. Returns 0 if the image
+   doesn't have an archive. $
+   ======================================================================== */
+StegoArchive *OpenStegoArchive(Image *image, const char *password)
+{
+    TIMED_BLOCK();
+
+    return StartStegoArchive(OpenStegoReader(image, password));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: OpenStegoArchive
+   $Prototype: StegoArchive *OpenStegoArchive(const ImageView *view, const char *password)
+   $Params:
+       view: The view of the image with the archive. Its pixels have to
+             stay where they are until the archive is closed.
+       password: The password it was encrypted with, 0 if it isn't
+                 encrypted.
+   $
+   $Description: Opens the archive in the pixels of a view without copying
+   them. Returns 0 if the view can't be used or doesn't have an archive. $
+   ======================================================================== */
+StegoArchive *OpenStegoArchive(const ImageView *view, const char *password)
+{
+    TIMED_BLOCK();
+
+    return StartStegoArchive(OpenStegoReader(view, password));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteArchiveFile
+   $Prototype: static int WriteArchiveFile(StegoArchive *archive, const StegoArchiveFile *file, const char *filename)
+   $Params:
+       archive: The archive the file is in
+       file: The file to extract
+       filename: The file to write it to
+   $
+   $Description: Decodes the file about STEGO_STREAM_BUFFER_SIZE at a time,
+   split on whole chunks so no chunk is decoded twice, and writes each
+   part out before the next one is decoded. The file is removed if its
+   checksum doesn't match. Returns how many bytes the file has, or -1. $
+   ======================================================================== */
+static int WriteArchiveFile(StegoArchive *archive, const StegoArchiveFile *file, const char *filename)
+{
+    uint32_t chunk_bytes = StegoReaderChunkBytes(archive->Reader);
+    uint32_t part_bytes = (STEGO_STREAM_BUFFER_SIZE / chunk_bytes) * chunk_bytes;
+    uint32_t end = file->Offset + file->Length;
+    uint32_t checksum = CHECKSUM_START;
+    char *buffer;
+    FILE *fp;
+    int result = 0;
+
+    if (part_bytes < chunk_bytes)
+    {
+        part_bytes = chunk_bytes;
+    }
+
+    if ((fp = fopen(filename, "w")) == 0)
+    {
+        printf("Error writing file: %s\n", filename);
+        return -1;
+    }
+
+    buffer = (char*)AllocateMemory(MEMORY_ARCHIVE, (file->Length < part_bytes) ? file->Length : part_bytes);
+
+    for(uint32_t offset = file->Offset; offset < end && result == 0; )
+    {
+        uint32_t next = (offset / part_bytes + 1) * part_bytes;
+        uint32_t count = ((next < end) ? next : end) - offset;
+        uint32_t bytes_written = 0;
+
+        if (DecodeStegoReaderRange(archive->Reader, buffer, offset, count) != (int)count)
+        {
+            printf("Unable to extract %s.\n", file->Name);
+            result = -1;
+            break;
+        }
+
+        checksum = UpdateChecksum(checksum, (const uint8_t*)buffer, count);
+
+        while (bytes_written < count)
+        {
+            uint32_t n = fwrite(buffer + bytes_written, 1, count - bytes_written, fp);
+
+            if (n == 0)
+            {
+                printf("Error writing file: %s\n", filename);
+                result = -1;
+                break;
+            }
+
+            bytes_written += n;
+        }
+
+        offset += count;
+    }
+
+    FreeMemory(buffer);
+    fclose(fp);
+
+    if (result == 0 && FinishChecksum(checksum) != file->Checksum)
+    {
+        printf("Cannot decode image. The checksum of %s doesn't match, the image is damaged.\n", file->Name);
+        result = -1;
+    }
+
+    if (result != 0)
+    {
+        remove(filename);
+        return -1;
+    }
+
+    return file->Length;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ExtractStegoArchiveFile
+   $Prototype: int ExtractStegoArchiveFile(StegoArchive *archive, const char *name, const char *filename)
+   $Params:
+       archive: The archive to extract from
+       name: The name of the file in the archive
+       filename: The file to write it to, 0 to use its name.
+   $
+   $Description: Extracts one file, which only decodes the pixels of the
+   chunks that hold it. Returns how many bytes the file has, or -1. $
+   ======================================================================== */
+int ExtractStegoArchiveFile(StegoArchive *archive, const char *name, const char *filename)
+{
+    TIMED_BLOCK();
+
+    for(int i = 0; i < archive->FileCount; i++)
+    {
+        if (strcmp(archive->Files[i].Name, name) == 0)
+        {
+            return WriteArchiveFile(archive, &archive->Files[i], filename ? filename : name);
+        }
+    }
+
+    printf("The archive doesn't have a file called %s.\n", name);
+
+    return -1;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ExtractArchiveJob
+   $Prototype: static void ExtractArchiveJob(void *data, int index)
+   $Params:
+       data: The ArchiveExtract
+       index: The file to extract
+   $
+   $Description: Extracts one of the files on a worker thread, with
+   Threads threads. $
+   ======================================================================== */
+static void ExtractArchiveJob(void *data, int index)
+{
+    ArchiveExtract *extract = (ArchiveExtract*)data;
+    const StegoArchiveFile *file = &extract->Archive->Files[index];
+    char *filename = (char*)file->Name;
+    int stego_threads = SetStegoJobThreads(extract->Threads);
+
+    if (extract->Directory)
+    {
+        filename = (char*)malloc(strlen(extract->Directory) + strlen(file->Name) + 2);
+        sprintf(filename, "%s/%s", extract->Directory, file->Name);
+    }
+
+    extract->Results[index] = (WriteArchiveFile(extract->Archive, file, filename) < 0) ? -1 : 0;
+
+    if (extract->Directory)
+    {
+        free(filename);
+    }
+
+    SetStegoJobThreads(stego_threads);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ExtractStegoArchive
+   $Prototype: int ExtractStegoArchive(StegoArchive *archive, const char *directory)
+   $Params:
+       archive: The archive to extract
+       directory: The directory to extract into, 0 for the current one.
+   $
+   $Description: Extracts every file in the archive under its name. The
+   files are extracted on the stego threads at once, each of them single
+   threaded like the jobs of a batch. A single file is extracted on all
+   of them instead. Returns how many files couldn't be extracted. $
+   ======================================================================== */
+int ExtractStegoArchive(StegoArchive *archive, const char *directory)
+{
+    TIMED_BLOCK();
+
+    ArchiveExtract extract;
+    int failed = 0;
+
+    extract.Archive = archive;
+    extract.Directory = directory;
+    extract.Results = (int*)malloc(sizeof(int) * (archive->FileCount + 1));
+    extract.Threads = GetStegoThreads();
+
+    if (archive->FileCount > 1)
+    {
+        int thread_count = extract.Threads;
+
+        extract.Threads = 1;
+        ParallelFor(thread_count, archive->FileCount, ExtractArchiveJob, &extract);
+    }
+    else if (archive->FileCount == 1)
+    {
+        ExtractArchiveJob(&extract, 0);
+    }
+
+    for(int i = 0; i < archive->FileCount; i++)
+    {
+        if (extract.Results[i] != 0)
+        {
+            failed++;
+        }
+    }
+
+    free(extract.Results);
+
+    return failed;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CloseStegoArchive
+   $Prototype: void CloseStegoArchive(StegoArchive *archive)
+   $Params:
+       archive: The archive to close
+   $
+   $Description: Closes the reader and frees the table. $
+   ======================================================================== */
+void CloseStegoArchive(StegoArchive *archive)
+{
+    CloseStegoReader(archive->Reader);
+    free(archive->Files);
+    free(archive->Table);
+    free(archive);
+}
@@ -0,0 +1,50 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: archive.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: Many files in one image, behind a table of where each
+                 one is. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(ARCHIVE_H)
+#define ARCHIVE_H
+
+#include <stdint.h>
+
+#include "encryption.h"
+#include "image.h"
+#include "steganography.h"
+
+// A file in an archive. Offset is where its contents start in the data
+// and Checksum is the CRC32C of them. Name points into the table.
+struct StegoArchiveFile
+{
+    const char *Name;
+    uint32_t Offset;
+    uint32_t Length;
+    uint32_t Checksum;
+};
+
+// An archive that has been opened. Only the table has been decoded.
+struct StegoArchive
+{
+    StegoReader *Reader;
+    int FileCount;
+    StegoArchiveFile *Files;
+    char *Table;
+};
+
+Image *EncodeStegoArchive(Image *image, char **filenames, int file_count);
+Image *EncodeStegoArchiveEnc(Image *image, char **filenames, int file_count, AESType aes, const char *password);
+
+// The password is 0 if the archive isn't encrypted.
+StegoArchive *OpenStegoArchive(Image *image, const char *password);
+StegoArchive *OpenStegoArchive(const ImageView *view, const char *password);
+int ExtractStegoArchiveFile(StegoArchive *archive, const char *name, const char *filename);
+int ExtractStegoArchive(StegoArchive *archive, const char *directory);
+void CloseStegoArchive(StegoArchive *archive);
+
+#endif
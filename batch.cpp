@@ -0,0 +1,324 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: batch.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static int ParseBatchLine(char *line, BatchJob *job)
+static int ReadBatchManifest(const char *manifest, BatchJob **jobs_out, int *job_count)
+static int RunBatchEncode(BatchJob *job)
+static int RunBatchDecode(BatchJob *job)
+static void RunBatchJob(void *data, int index)
+int RunStegoBatch(const char *manifest, int thread_count)
+   $
+   $Description: The manifest has one job per line:
+
+       <mode> <carrier> <payload> <output>
+
+   encode puts the payload file into the carrier bitmap and saves it as
+   output. decode takes the file out of the carrier and writes it to
+   output, the payload is ignored and an output of - uses the filename
+   stored in the image. Blank lines and lines starting with # are skipped,
+   and a line that isn't a job is reported as a job that failed. The jobs
+   are run on a thread per processor in one process, in no particular
+   order, so a job can't use the output of another one. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "image.h"
+#include "steganography.h"
+#include "threads.h"
+
+enum BatchMode
+{
+    BATCH_ENCODE,
+    BATCH_DECODE,
+
+    // The line couldn't be read, so there is nothing to run.
+    BATCH_BAD,
+};
+
+// One line of the manifest.
+struct BatchJob
+{
+    int Line;
+    BatchMode Mode;
+
+    // These all point into Text.
+    char *Text;
+    char *Carrier;
+    char *Payload;
+    char *Output;
+
+    // 0 if the job worked, otherwise -1.
+    int Result;
+};
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ParseBatchLine
+   $Prototype: static int ParseBatchLine(char *line, BatchJob *job)
+   $Params:
+       line: The line from the manifest. It gets split up.
+       job: The job to fill out.
+   $
+   $Description: Splits a manifest line into a job. Returns 1 if the line
+   is a job, 0 if it should be skipped and -1 if it is bad. $
+   ======================================================================== */
+static int ParseBatchLine(char *line, BatchJob *job)
+{
+    char *save = 0;
+    char *mode = strtok_r(line, " \t\r\n", &save);
+
+    if (mode == 0 || mode[0] == '#')
+    {
+        return 0;
+    }
+
+    job->Carrier = strtok_r(0, " \t\r\n", &save);
+    job->Payload = strtok_r(0, " \t\r\n", &save);
+    job->Output = strtok_r(0, " \t\r\n", &save);
+
+    if (job->Output == 0 || strtok_r(0, " \t\r\n", &save) != 0)
+    {
+        return -1;
+    }
+
+    if (strcmp(mode, "encode") == 0)
+    {
+        job->Mode = BATCH_ENCODE;
+    }
+    else if (strcmp(mode, "decode") == 0)
+    {
+        job->Mode = BATCH_DECODE;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 1;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadBatchManifest
+   $Prototype: static int ReadBatchManifest(const char *manifest, BatchJob **jobs_out, int *job_count)
+   $Params:
+       manifest: The manifest file to read
+       jobs_out: Gets set to the array of jobs, which needs to be freed.
+       job_count: Gets set to how many jobs were read.
+   $
+   $Description: Reads all of the jobs in the manifest. A bad line is kept
+   as a BATCH_BAD job so it is counted with the ones that fail. Returns 0
+   on success and -1 if the file can't be read. $
+   ======================================================================== */
+static int ReadBatchManifest(const char *manifest, BatchJob **jobs_out, int *job_count)
+{
+    FILE *fp;
+    BatchJob *jobs = 0;
+    int job_size = 0;
+    int line_number = 0;
+    char *line = 0;
+    size_t line_size = 0;
+
+    if ((fp = fopen(manifest, "r")) == 0)
+    {
+        printf("Unable to open file: %s\n", manifest);
+        return -1;
+    }
+
+    *job_count = 0;
+
+    while (getline(&line, &line_size, fp) > 0)
+    {
+        BatchJob job;
+        int parsed;
+
+        line_number++;
+        job.Line = line_number;
+        job.Text = strdup(line);
+        job.Result = -1;
+
+        if ((parsed = ParseBatchLine(job.Text, &job)) == 0)
+        {
+            free(job.Text);
+            continue;
+        }
+
+        if (parsed < 0)
+        {
+            printf("%s:%d: Expected <encode|decode> <carrier> <payload> <output>\n", manifest, line_number);
+            job.Mode = BATCH_BAD;
+        }
+
+        if (*job_count == job_size)
+        {
+            job_size = (job_size > 0) ? (job_size * 2) : 64;
+            jobs = (BatchJob*)realloc(jobs, sizeof(BatchJob) * job_size);
+        }
+
+        jobs[(*job_count)++] = job;
+    }
+
+    free(line);
+    fclose(fp);
+
+    *jobs_out = jobs;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunBatchEncode
+   $Prototype: static int RunBatchEncode(BatchJob *job)
+   $Params:
+       job: The job to run
+   $
+   $Description: Encodes the payload into the carrier. The carrier is
+   mapped copy on write and encoded in place, so only the pixels that hold
+   the payload are copied before it is saved. $
+   ======================================================================== */
+static int RunBatchEncode(BatchJob *job)
+{
+    Image *image;
+    int result;
+
+    if ((image = LoadImageMapped(job->Carrier, IMAGE_MAP_PRIVATE)) == 0)
+    {
+        return -1;
+    }
+
+    result = EncodeStegoFileInPlace(image, job->Payload);
+    if (result == 0 && SaveBitmap(job->Output, image) != 0)
+    {
+        result = -1;
+    }
+
+    FreeImage(image);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunBatchDecode
+   $Prototype: static int RunBatchDecode(BatchJob *job)
+   $Params:
+       job: The job to run
+   $
+   $Description: Decodes the file in the carrier. $
+   ======================================================================== */
+static int RunBatchDecode(BatchJob *job)
+{
+    Image *image;
+    int result;
+
+    if ((image = LoadImageMapped(job->Carrier, IMAGE_MAP_READ)) == 0)
+    {
+        return -1;
+    }
+
+    result = DecodeStegoFile(image, (strcmp(job->Output, "-") == 0) ? 0 : job->Output);
+
+    FreeImage(image);
+
+    return (result < 0) ? -1 : 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunBatchJob
+   $Prototype: static void RunBatchJob(void *data, int index)
+   $Params:
+       data: The array of jobs
+       index: The job to run
+   $
+   $Description: Runs one job on a worker thread. The job runs single
+   threaded since there are already enough of them to keep every
+   processor busy, which only changes the thread it runs on. $
+   ======================================================================== */
+static void RunBatchJob(void *data, int index)
+{
+    BatchJob *job = (BatchJob*)data + index;
+    int stego_threads = SetStegoJobThreads(1);
+    int image_threads = SetImageJobThreads(1);
+
+    if (job->Mode == BATCH_ENCODE)
+    {
+        job->Result = RunBatchEncode(job);
+    }
+    else if (job->Mode == BATCH_DECODE)
+    {
+        job->Result = RunBatchDecode(job);
+    }
+
+    SetStegoJobThreads(stego_threads);
+    SetImageJobThreads(image_threads);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunStegoBatch
+   $Prototype: int RunStegoBatch(const char *manifest, int thread_count)
+   $Params:
+       manifest: The manifest file with the jobs
+       thread_count: How many jobs to run at once, 0 uses one per processor.
+   $
+   $Description: Runs every job in the manifest and prints whether each one
+   worked, in manifest order. A bad line counts as a job that failed and
+   the rest still run. Returns how many jobs failed, or -1 if the manifest
+   can't be read. $
+   ======================================================================== */
+int RunStegoBatch(const char *manifest, int thread_count)
+{
+    BatchJob *jobs;
+    int job_count;
+    int failed = 0;
+
+    if (ReadBatchManifest(manifest, &jobs, &job_count) != 0)
+    {
+        return -1;
+    }
+
+    ParallelFor(thread_count, job_count, RunBatchJob, jobs);
+
+    for(int i = 0; i < job_count; i++)
+    {
+        if (jobs[i].Mode == BATCH_BAD)
+        {
+            printf("%s:%d: bad line failed\n", manifest, jobs[i].Line);
+        }
+        else
+        {
+            printf("%s:%d: %s %s %s\n", manifest, jobs[i].Line,
+                   (jobs[i].Mode == BATCH_ENCODE) ? "encode" : "decode",
+                   jobs[i].Carrier, (jobs[i].Result == 0) ? "ok" : "failed");
+        }
+
+        if (jobs[i].Result != 0)
+        {
+            failed++;
+        }
+
+        free(jobs[i].Text);
+    }
+
+    printf("%d of %d jobs failed.\n", failed, job_count);
+
+    free(jobs);
+
+    // The jobs reused each other's buffers, they aren't needed now.
+    TrimMemoryPool();
+
+    return failed;
+}
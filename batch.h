@@ -0,0 +1,16 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: batch.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: Runs many encode/decode jobs from a manifest file. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(BATCH_H)
+#define BATCH_H
+
+int RunStegoBatch(const char *manifest, int thread_count);
+
+#endif
@@ -0,0 +1,463 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: bench.cpp $
+   $Program: steganography_bench $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static uint64_t GetBenchTime()
+static Image *CreateBenchImage(uint32_t width, uint32_t height, int rgba)
+static void RunBench(const char *name, const char *kernel, BenchFunction function, BenchState *state, uint64_t pixels, int repetitions)
+static void BenchEncode(BenchState *state)
+static void BenchDecode(BenchState *state)
+static void BenchEncodeDepth(BenchState *state)
+static void BenchDecodeDepth(BenchState *state)
+static void BenchEncodeScattered(BenchState *state)
+static void BenchDecodeScattered(BenchState *state)
+static void BenchNegate(BenchState *state)
+static void BenchScale(BenchState *state)
+static void BenchBasicGrayscale(BenchState *state)
+static void BenchLuminanceGrayscale(BenchState *state)
+static void BenchFlipVertical(BenchState *state)
+static void BenchSave(BenchState *state)
+static void BenchLoad(BenchState *state)
+static void RunBenchSize(const BenchSize *size, int repetitions)
+int main(int argc, char **argv)
+   $
+   $Description: Times the steganography kernels, the image functions and
+   loading/saving bitmaps on random images from 0.1 to 100 megapixels.
+
+       steganography_bench [max megapixels] [repetitions]
+
+   Every benchmark is run once to warm up and then timed repetitions
+   times. The results are printed as CSV, one line per benchmark:
+
+       benchmark,kernel,width,height,pixels,repetitions,mean_ns,min_ns,stddev_ns,mb_per_s,ns_per_pixel
+
+   mb_per_s is how many megabytes (10^6) of pixel data were processed per
+   second using the mean time, so the encode/decode numbers count the two
+   pixels each payload byte is stored in (fewer at the deeper depths,
+   which use the same payload). The kernel column is the stego
+   kernel that was forced for encode/decode, auto for the 24 bit carrier
+   and - for everything else. $
+   $Revisions: $
+   ======================================================================== */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "image_functions.h"
+#include "steganography.h"
+#include "stego_kernels.h"
+
+#define BENCH_DEFAULT_REPETITIONS 5
+#define BENCH_DEFAULT_MEGAPIXELS 100
+
+// Where the load/save benchmarks write their bitmap.
+#define BENCH_FILENAME "steganography_bench.bmp"
+
+// The state that is passed to every benchmark.
+struct BenchState
+{
+    Image *Carrier;
+
+    // The payload for the encode/decode benchmarks.
+    char *Buffer;
+    int Count;
+    int Depth;
+
+    // The scatter for the scattered encode/decode benchmarks.
+    StegoScatter Scatter;
+
+    // The bitmap the load benchmark reads.
+    const char *Filename;
+};
+
+typedef void (*BenchFunction)(BenchState *state);
+
+// The image sizes that are benchmarked.
+struct BenchSize
+{
+    uint32_t Width;
+    uint32_t Height;
+};
+
+static const BenchSize bench_sizes[] = {
+    { 400, 250 },
+    { 1000, 1000 },
+    { 4000, 2500 },
+    { 10000, 10000 },
+};
+
+static const struct
+{
+    StegoKernel Kernel;
+    const char *Name;
+} bench_kernels[] = {
+    { STEGO_KERNEL_SCALAR, "scalar" },
+    { STEGO_KERNEL_SSE, "sse" },
+    { STEGO_KERNEL_BMI2, "bmi2" },
+    { STEGO_KERNEL_AVX2, "avx2" },
+};
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetBenchTime
+   $Prototype: static uint64_t GetBenchTime()
+   $Params: $
+   $Description: Returns the wall clock time in nanoseconds. $
+   ======================================================================== */
+static uint64_t GetBenchTime()
+{
+    timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return ((uint64_t)time.tv_sec * 1000000000) + time.tv_nsec;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CreateBenchImage
+   $Prototype: static Image *CreateBenchImage(uint32_t width, uint32_t height, int rgba)
+   $Params:
+       width: The width of the image
+       height: The height of the image
+       rgba: 1 to use RGBA masks instead of ARGB, so loading it has to
+             convert the pixels.
+   $
+   $Description: Creates a random image with its masks set. $
+   ======================================================================== */
+static Image *CreateBenchImage(uint32_t width, uint32_t height, int rgba)
+{
+    Image *image = CreateRandomImage(width, height, 32);
+
+    if (image && rgba)
+    {
+        image->MaskRed = 0xFF000000;
+        image->MaskGreen = 0x00FF0000;
+        image->MaskBlue = 0x0000FF00;
+        image->MaskAlpha = 0x000000FF;
+
+        image->ShiftRed = 24;
+        image->ShiftGreen = 16;
+        image->ShiftBlue = 8;
+        image->ShiftAlpha = 0;
+    }
+
+    return image;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunBench
+   $Prototype: static void RunBench(const char *name, const char *kernel, BenchFunction function, BenchState *state, uint64_t pixels, int repetitions)
+   $Params:
+       name: The name of the benchmark
+       kernel: The kernel that is being used, or -
+       function: The function to time
+       state: Passed to the function
+       pixels: How many pixels the function processes
+       repetitions: How many times to time the function
+   $
+   $Description: Warms up, times and prints one line of results. $
+   ======================================================================== */
+static void RunBench(const char *name, const char *kernel, BenchFunction function, BenchState *state, uint64_t pixels, int repetitions)
+{
+    double total = 0;
+    double total_squared = 0;
+    uint64_t min = UINT64_MAX;
+
+    // Warm up the caches, page tables and branch predictors.
+    function(state);
+
+    for(int i = 0; i < repetitions; i++)
+    {
+        uint64_t start = GetBenchTime();
+
+        function(state);
+
+        uint64_t time = GetBenchTime() - start;
+
+        total += time;
+        total_squared += (double)time * time;
+
+        if (time < min)
+        {
+            min = time;
+        }
+    }
+
+    double mean = total / repetitions;
+    double variance = (total_squared / repetitions) - (mean * mean);
+    double stddev = (variance > 0) ? sqrt(variance) : 0;
+
+    // ns -> s is 10^9 and bytes -> MB is 10^6.
+    double mb_per_s = (mean > 0) ? ((double)pixels * 4 * 1000) / mean : 0;
+    double ns_per_pixel = (pixels > 0) ? mean / pixels : 0;
+
+    printf("%s,%s,%u,%u,%lu,%d,%.0f,%lu,%.0f,%.2f,%.4f\n",
+           name, kernel, state->Carrier->Width, state->Carrier->Height, (unsigned long)pixels, repetitions,
+           mean, (unsigned long)min, stddev, mb_per_s, ns_per_pixel);
+    fflush(stdout);
+}
+
+static void BenchEncode(BenchState *state)
+{
+    EncodeStegoBytes(state->Carrier, state->Buffer, state->Count, 0);
+}
+
+static void BenchDecode(BenchState *state)
+{
+    DecodeStegoBytes(state->Carrier, 0, state->Buffer, state->Count);
+}
+
+static void BenchEncodeDepth(BenchState *state)
+{
+    EncodeStegoBytesDepth(state->Carrier, state->Buffer, state->Count, 0, state->Depth);
+}
+
+static void BenchDecodeDepth(BenchState *state)
+{
+    DecodeStegoBytesDepth(state->Carrier, 0, state->Buffer, state->Count, state->Depth);
+}
+
+static void BenchEncodeScattered(BenchState *state)
+{
+    EncodeStegoBytesScattered(state->Carrier, state->Buffer, state->Count, 0, state->Depth, &state->Scatter);
+}
+
+static void BenchDecodeScattered(BenchState *state)
+{
+    DecodeStegoBytesScattered(state->Carrier, 0, state->Buffer, state->Count, state->Depth, &state->Scatter);
+}
+
+static void BenchNegate(BenchState *state)
+{
+    NegateImage(state->Carrier);
+}
+
+static void BenchScale(BenchState *state)
+{
+    FreeImage(Scale(state->Carrier, 1.0f, 1.0f));
+}
+
+static void BenchBasicGrayscale(BenchState *state)
+{
+    BasicGrayscale(state->Carrier);
+}
+
+static void BenchLuminanceGrayscale(BenchState *state)
+{
+    LuminanceGrayscale(state->Carrier);
+}
+
+static void BenchFlipVertical(BenchState *state)
+{
+    FlipVertical(state->Carrier);
+}
+
+static void BenchSave(BenchState *state)
+{
+    SaveBitmap(state->Filename, state->Carrier);
+}
+
+// Loading a bitmap that doesn't need converting only maps it, so the
+// pixels are read once to make the numbers comparable.
+static void BenchLoad(BenchState *state)
+{
+    Image *image = LoadImage(state->Filename);
+    volatile uint32_t sum = 0;
+
+    if (image)
+    {
+        for(uint32_t i = 0; i < GetImageSize(image) / sizeof(uint32_t); i++)
+        {
+            sum += image->Pixels[i];
+        }
+    }
+
+    FreeImage(image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunBenchSize
+   $Prototype: static void RunBenchSize(const BenchSize *size, int repetitions)
+   $Params:
+       size: The size of the images to use.
+       repetitions: How many times to time each benchmark.
+   $
+   $Description: Runs every benchmark on one image size. $
+   ======================================================================== */
+static void RunBenchSize(const BenchSize *size, int repetitions)
+{
+    BenchState state;
+    uint64_t pixels = (uint64_t)size->Width * size->Height;
+
+    if ((state.Carrier = CreateBenchImage(size->Width, size->Height, 0)) == 0)
+    {
+        fprintf(stderr, "Unable to create a %ux%u image.\n", size->Width, size->Height);
+        return;
+    }
+
+    // Fill the whole image, leaving room for the length like the real
+    // encoder does.
+    state.Count = StegoMaxBytes(state.Carrier);
+    state.Buffer = (char*)malloc(state.Count);
+    state.Filename = BENCH_FILENAME;
+
+    for(int i = 0; i < state.Count; i++)
+    {
+        state.Buffer[i] = (char)rand();
+    }
+
+    // Every kernel the CPU supports, so new ones can be compared to the
+    // scalar one.
+    for(uint32_t i = 0; i < sizeof(bench_kernels) / sizeof(bench_kernels[0]); i++)
+    {
+        SetStegoKernel(bench_kernels[i].Kernel);
+
+        if (GetStegoKernel() != bench_kernels[i].Kernel)
+        {
+            continue;
+        }
+
+        RunBench("encode", bench_kernels[i].Name, BenchEncode, &state, (uint64_t)state.Count * 2, repetitions);
+        RunBench("decode", bench_kernels[i].Name, BenchDecode, &state, (uint64_t)state.Count * 2, repetitions);
+    }
+
+    SetStegoKernel(STEGO_KERNEL_AUTO);
+
+    // The deeper depths have one kernel each. The same payload takes up
+    // fewer pixels.
+    for(state.Depth = 2; state.Depth <= STEGO_MAX_DEPTH; state.Depth++)
+    {
+        char name[32];
+        uint64_t depth_pixels = GetStegoPixelCount(state.Count, state.Depth);
+
+        snprintf(name, sizeof(name), "encode_depth%d", state.Depth);
+        RunBench(name, "scalar", BenchEncodeDepth, &state, depth_pixels, repetitions);
+
+        snprintf(name, sizeof(name), "decode_depth%d", state.Depth);
+        RunBench(name, "scalar", BenchDecodeDepth, &state, depth_pixels, repetitions);
+    }
+
+    // Scattering the same payload should cost no more than twice as much
+    // as the depth's own numbers above.
+    uint8_t scatter_key[STEGO_SCATTER_KEY_BYTES];
+
+    for(int i = 0; i < STEGO_SCATTER_KEY_BYTES; i++)
+    {
+        scatter_key[i] = (uint8_t)rand();
+    }
+
+    StartStegoScatter(&state.Scatter, scatter_key, 0, GetStegoImagePixels(state.Carrier));
+
+    for(state.Depth = STEGO_MIN_DEPTH; state.Depth <= STEGO_MAX_DEPTH; state.Depth++)
+    {
+        char name[32];
+        uint64_t depth_pixels = GetStegoPixelCount(state.Count, state.Depth);
+
+        snprintf(name, sizeof(name), "encode_scattered%d", state.Depth);
+        RunBench(name, "auto", BenchEncodeScattered, &state, depth_pixels, repetitions);
+
+        snprintf(name, sizeof(name), "decode_scattered%d", state.Depth);
+        RunBench(name, "auto", BenchDecodeScattered, &state, depth_pixels, repetitions);
+    }
+
+    RunBench("negate", "-", BenchNegate, &state, pixels, repetitions);
+    RunBench("scale", "-", BenchScale, &state, pixels, repetitions);
+    RunBench("basic_grayscale", "-", BenchBasicGrayscale, &state, pixels, repetitions);
+    RunBench("luminance_grayscale", "-", BenchLuminanceGrayscale, &state, pixels, repetitions);
+    RunBench("flip_vertical", "-", BenchFlipVertical, &state, pixels, repetitions);
+    RunBench("save", "-", BenchSave, &state, pixels, repetitions);
+    RunBench("load", "-", BenchLoad, &state, pixels, repetitions);
+
+    FreeImage(state.Carrier);
+
+    // Load a bitmap with RGBA masks so every pixel has to be converted.
+    if ((state.Carrier = CreateBenchImage(size->Width, size->Height, 1)) != 0)
+    {
+        SaveBitmap(state.Filename, state.Carrier);
+        RunBench("load_convert", "-", BenchLoad, &state, pixels, repetitions);
+        FreeImage(state.Carrier);
+    }
+
+    // A 24 bit carrier is encoded straight into its packed rows. It holds
+    // less than a 32 bit one so the buffer is already big enough.
+    if ((state.Carrier = CreateRandomImage(size->Width, size->Height, 24)) != 0)
+    {
+        state.Count = StegoMaxBytes(state.Carrier);
+
+        for(state.Depth = 1; state.Depth <= STEGO_MAX_DEPTH; state.Depth++)
+        {
+            char name[32];
+            uint64_t depth_pixels = GetStegoPixelCount(state.Count, state.Depth);
+
+            snprintf(name, sizeof(name), "encode_24bit_depth%d", state.Depth);
+            RunBench(name, "auto", BenchEncodeDepth, &state, depth_pixels, repetitions);
+
+            snprintf(name, sizeof(name), "decode_24bit_depth%d", state.Depth);
+            RunBench(name, "auto", BenchDecodeDepth, &state, depth_pixels, repetitions);
+        }
+
+        SaveBitmap(state.Filename, state.Carrier);
+        RunBench("load_24bit", "-", BenchLoad, &state, pixels, repetitions);
+        FreeImage(state.Carrier);
+    }
+
+    unlink(state.Filename);
+    free(state.Buffer);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: main
+   $Prototype: int main(int argc, char **argv)
+   $Params:
+       argv[1]: The largest image to benchmark in megapixels. Defaults to 100.
+       argv[2]: How many times to time each benchmark. Defaults to 5.
+   $
+   $Description: Runs all of the benchmarks. $
+   ======================================================================== */
+int main(int argc, char **argv)
+{
+    double max_megapixels = BENCH_DEFAULT_MEGAPIXELS;
+    int repetitions = BENCH_DEFAULT_REPETITIONS;
+
+    if (argc > 1)
+    {
+        max_megapixels = atof(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        repetitions = atoi(argv[2]);
+    }
+
+    if (repetitions < 1)
+    {
+        fprintf(stderr, "usage: %s [max megapixels] [repetitions]\n", argv[0]);
+        return -1;
+    }
+
+    printf("benchmark,kernel,width,height,pixels,repetitions,mean_ns,min_ns,stddev_ns,mb_per_s,ns_per_pixel\n");
+
+    for(uint32_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+    {
+        double megapixels = ((double)bench_sizes[i].Width * bench_sizes[i].Height) / 1000000;
+
+        if (megapixels <= max_megapixels)
+        {
+            RunBenchSize(&bench_sizes[i], repetitions);
+        }
+    }
+
+    return 0;
+}
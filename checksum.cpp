@@ -0,0 +1,236 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: checksum.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static uint32_t MultiplyChecksum(uint32_t a, uint32_t b)
+static uint32_t UpdateChecksumScalar(uint32_t checksum, const uint8_t *data, uint32_t count)
+static uint32_t ShiftChecksumSSE(uint32_t checksum, uint32_t power)
+static uint32_t UpdateChecksumSSE(uint32_t checksum, const uint8_t *data, uint32_t count)
+uint32_t UpdateChecksum(uint32_t checksum, const uint8_t *data, uint32_t count)
+uint32_t ShiftChecksum(uint32_t checksum, uint64_t count)
+   $
+   $Description: The checksums are kept bit reversed, the same as the
+   CRC32 instruction, so bit 31 is x^0. UpdateChecksum doesn't invert the
+   checksum on the way in or out, which is what makes the checksum of a
+   part that starts from 0 something that can be added on later: adding
+   count zero bytes to a checksum is multiplying it by x^(8 * count)
+   modulo the polynomial, and the rest of the data only adds its own
+   checksum from 0 on top.
+
+   The CRC32 instruction takes 3 cycles but a new one can start every
+   cycle, so long data is split into 3 streams that are checksummed at the
+   same time and then shifted into place with a carry-less multiply. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "checksum.h"
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// The Castagnoli polynomial, bit reversed.
+#define CHECKSUM_POLYNOMIAL 0x82F63B78
+
+// How many bytes each of the 3 streams does at a time.
+#define CHECKSUM_STREAM_BYTES 2048
+
+// x^(8 * CHECKSUM_STREAM_BYTES - 33) and x^(8 * 2 * CHECKSUM_STREAM_BYTES - 33)
+// modulo the polynomial. The 33 makes up for the multiply leaving its
+// result 1 bit up and the CRC32 instruction multiplying by x^32 as it
+// reduces it.
+#define CHECKSUM_SHIFT_ONE 0xA51B6135
+#define CHECKSUM_SHIFT_TWO 0x82F89C77
+
+/* ========================================================================
+   $FUNCTION
+   $Name: MultiplyChecksum
+   $Prototype: static uint32_t MultiplyChecksum(uint32_t a, uint32_t b)
+   $Params:
+       a: A bit reversed polynomial
+       b: Another one
+   $
+   $Description: Returns a * b modulo the polynomial. $
+   ======================================================================== */
+static uint32_t MultiplyChecksum(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+
+    for(uint32_t bit = 1u << 31; bit != 0; bit >>= 1)
+    {
+        if (a & bit)
+        {
+            product ^= b;
+        }
+
+        // b * x
+        b = (b & 1) ? ((b >> 1) ^ CHECKSUM_POLYNOMIAL) : (b >> 1);
+    }
+
+    return product;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: UpdateChecksumScalar
+   $Prototype: static uint32_t UpdateChecksumScalar(uint32_t checksum, const uint8_t *data, uint32_t count)
+   $Params:
+       checksum: The checksum so far
+       data: The bytes to add
+       count: How many bytes there are
+   $
+   $Description: Adds the bytes a bit at a time, for processors without
+   SSE4.2. $
+   ======================================================================== */
+static uint32_t UpdateChecksumScalar(uint32_t checksum, const uint8_t *data, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        checksum ^= data[i];
+
+        for(int bit = 0; bit < 8; bit++)
+        {
+            checksum = (checksum & 1) ? ((checksum >> 1) ^ CHECKSUM_POLYNOMIAL) : (checksum >> 1);
+        }
+    }
+
+    return checksum;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ShiftChecksumSSE
+   $Prototype: static uint32_t ShiftChecksumSSE(uint32_t checksum, uint32_t power)
+   $Params:
+       checksum: The checksum to shift
+       power: CHECKSUM_SHIFT_ONE or CHECKSUM_SHIFT_TWO.
+   $
+   $Description: Shifts the checksum past the data of 1 or 2 streams. $
+   ======================================================================== */
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t ShiftChecksumSSE(uint32_t checksum, uint32_t power)
+{
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(checksum), _mm_cvtsi32_si128(power), 0x00);
+
+    return (uint32_t)_mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(product));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: UpdateChecksumSSE
+   $Prototype: static uint32_t UpdateChecksumSSE(uint32_t checksum, const uint8_t *data, uint32_t count)
+   $Params:
+       checksum: The checksum so far
+       data: The bytes to add
+       count: How many bytes there are
+   $
+   $Description: Adds 3 streams of CHECKSUM_STREAM_BYTES at a time, then
+   the rest 8 bytes at a time. $
+   ======================================================================== */
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t UpdateChecksumSSE(uint32_t checksum, const uint8_t *data, uint32_t count)
+{
+    uint64_t value = checksum;
+
+    while (count >= 3 * CHECKSUM_STREAM_BYTES)
+    {
+        uint64_t second = 0;
+        uint64_t third = 0;
+        uint64_t word;
+
+        for(int i = 0; i < CHECKSUM_STREAM_BYTES; i += 8)
+        {
+            memcpy(&word, data + i, 8);
+            value = _mm_crc32_u64(value, word);
+            memcpy(&word, data + CHECKSUM_STREAM_BYTES + i, 8);
+            second = _mm_crc32_u64(second, word);
+            memcpy(&word, data + (2 * CHECKSUM_STREAM_BYTES) + i, 8);
+            third = _mm_crc32_u64(third, word);
+        }
+
+        value = ShiftChecksumSSE((uint32_t)value, CHECKSUM_SHIFT_TWO) ^
+                ShiftChecksumSSE((uint32_t)second, CHECKSUM_SHIFT_ONE) ^ third;
+
+        data += 3 * CHECKSUM_STREAM_BYTES;
+        count -= 3 * CHECKSUM_STREAM_BYTES;
+    }
+
+    while (count >= 8)
+    {
+        uint64_t word;
+
+        memcpy(&word, data, 8);
+        value = _mm_crc32_u64(value, word);
+
+        data += 8;
+        count -= 8;
+    }
+
+    checksum = (uint32_t)value;
+
+    while (count > 0)
+    {
+        checksum = _mm_crc32_u8(checksum, *data);
+
+        data++;
+        count--;
+    }
+
+    return checksum;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: UpdateChecksum
+   $Prototype: uint32_t UpdateChecksum(uint32_t checksum, const uint8_t *data, uint32_t count)
+   $Params:
+       checksum: The checksum so far, CHECKSUM_START for the start of the
+                 data or 0 for a part that is combined later.
+       data: The bytes to add
+       count: How many bytes there are
+   $
+   $Description: Adds bytes to a checksum. $
+   ======================================================================== */
+uint32_t UpdateChecksum(uint32_t checksum, const uint8_t *data, uint32_t count)
+{
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul"))
+    {
+        return UpdateChecksumSSE(checksum, data, count);
+    }
+
+    return UpdateChecksumScalar(checksum, data, count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ShiftChecksum
+   $Prototype: uint32_t ShiftChecksum(uint32_t checksum, uint64_t count)
+   $Params:
+       checksum: The checksum to shift
+       count: How many zero bytes to add
+   $
+   $Description: Returns the checksum with count zero bytes added, which
+   is the checksum times x^(8 * count). The power is built up by squaring
+   x^8, so it only takes a few multiplies for any count. $
+   ======================================================================== */
+uint32_t ShiftChecksum(uint32_t checksum, uint64_t count)
+{
+    // x^8, bit reversed.
+    uint32_t power = 1u << (31 - 8);
+
+    while (count > 0)
+    {
+        if (count & 1)
+        {
+            checksum = MultiplyChecksum(power, checksum);
+        }
+
+        power = MultiplyChecksum(power, power);
+        count >>= 1;
+    }
+
+    return checksum;
+}
@@ -0,0 +1,38 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: checksum.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: CRC32C (Castagnoli) on the SSE4.2 CRC instruction. Parts
+                 of the data can be checksummed on their own and combined
+                 afterwards, so every thread can checksum its own part. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(CHECKSUM_H)
+#define CHECKSUM_H
+
+#include <stdint.h>
+
+// The checksum of data is FinishChecksum(UpdateChecksum(CHECKSUM_START, data)).
+// A part that is checksummed on its own starts from 0 instead and is
+// added on with CombineChecksum.
+#define CHECKSUM_START 0xFFFFFFFF
+
+uint32_t UpdateChecksum(uint32_t checksum, const uint8_t *data, uint32_t count);
+uint32_t ShiftChecksum(uint32_t checksum, uint64_t count);
+
+// Returns the checksum of the data that checksum is for followed by
+// count bytes that have the checksum next (started from 0).
+inline uint32_t CombineChecksum(uint32_t checksum, uint32_t next, uint64_t count)
+{
+    return ShiftChecksum(checksum, count) ^ next;
+}
+
+inline uint32_t FinishChecksum(uint32_t checksum)
+{
+    return ~checksum;
+}
+
+#endif
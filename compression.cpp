@@ -0,0 +1,486 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: compression.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static void SetCompressWord(uint8_t *bytes, uint32_t value)
+static uint32_t GetCompressWord(const uint8_t *bytes)
+static uint32_t GetCompressHash(const uint8_t *bytes)
+static uint8_t *WriteCompressLength(uint8_t *output, uint32_t length)
+static uint32_t CompressBlockData(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length, uint16_t *table)
+static uint32_t CompressBlockTo(const uint8_t *input, uint32_t length, uint8_t *output, uint16_t *table)
+static int DecompressBlockData(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length)
+uint32_t CompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output)
+int DecompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length)
+   $
+   $Description: The compressed data is the 4 byte length of the original
+   data followed by blocks of at most COMPRESS_BLOCK_SIZE bytes. Each
+   block header is the block's length - 1 in the top 16 bits and how many
+   bytes it was stored in - 1 in the bottom 16 bits, most significant byte
+   first. A block that doesn't get smaller is stored as it is, so the
+   stored length is the same as its length.
+
+   A compressed block is a list of sequences the same as LZ4: a token with
+   the literal length in the top 4 bits and the match length - 4 in the
+   bottom 4, a length of 15 carries on in bytes until one isn't 255, then
+   the literals, then the 2 byte (little endian) offset of the match and
+   the rest of the match length. The last sequence is only literals. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "compression.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+
+// The shortest match worth storing, it takes 3 bytes to store one.
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_MAX_OFFSET 0xFFFF
+
+// The match finder remembers the last position of every hash of 4 bytes.
+#define COMPRESS_HASH_BITS 14
+#define COMPRESS_HASH_SIZE (1 << COMPRESS_HASH_BITS)
+
+// After this many bytes without a match the search starts skipping ahead,
+// so data that doesn't compress goes through quickly.
+#define COMPRESS_SKIP_SHIFT 6
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetCompressWord
+   $Prototype: static void SetCompressWord(uint8_t *bytes, uint32_t value)
+   $Params:
+       bytes: The 4 bytes to fill in
+       value: The value to write, most significant byte first.
+   $
+   $Description: Writes a header word. $
+   ======================================================================== */
+static void SetCompressWord(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetCompressWord
+   $Prototype: static uint32_t GetCompressWord(const uint8_t *bytes)
+   $Params:
+       bytes: The 4 bytes of a header word.
+   $
+   $Description: Reads a header word. $
+   ======================================================================== */
+static uint32_t GetCompressWord(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetCompressHash
+   $Prototype: static uint32_t GetCompressHash(const uint8_t *bytes)
+   $Params:
+       bytes: The 4 bytes to hash.
+   $
+   $Description: Returns where the 4 bytes go in the match table. $
+   ======================================================================== */
+static uint32_t GetCompressHash(const uint8_t *bytes)
+{
+    uint32_t value;
+
+    memcpy(&value, bytes, sizeof(uint32_t));
+
+    return (value * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteCompressLength
+   $Prototype: static uint8_t *WriteCompressLength(uint8_t *output, uint32_t length)
+   $Params:
+       output: Where to write the length
+       length: What is left of the length after the 15 in the token.
+   $
+   $Description: Writes the rest of a literal or match length as bytes of
+   255 and then the remainder. Returns the byte after it. $
+   ======================================================================== */
+static uint8_t *WriteCompressLength(uint8_t *output, uint32_t length)
+{
+    while (length >= 255)
+    {
+        *output++ = 255;
+        length -= 255;
+    }
+
+    *output++ = (uint8_t)length;
+
+    return output;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CompressBlockData
+   $Prototype: static uint32_t CompressBlockData(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length, uint16_t *table)
+   $Params:
+       input: The block to compress, at most COMPRESS_BLOCK_SIZE bytes.
+       length: The length of the block
+       output: Where to write the sequences
+       output_length: The most bytes to write.
+       table: COMPRESS_HASH_SIZE entries for the match finder.
+   $
+   $Description: Compresses a block with a greedy search for matches.
+   Returns how many bytes it took, or 0 if it didn't fit in output_length. $
+   ======================================================================== */
+static uint32_t CompressBlockData(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length, uint16_t *table)
+{
+    const uint8_t *position = input;
+    const uint8_t *anchor = input;
+    const uint8_t *end = input + length;
+    uint8_t *out = output;
+    uint8_t *out_end = output + output_length;
+    uint32_t misses = 0;
+
+    memset(table, 0, COMPRESS_HASH_SIZE * sizeof(uint16_t));
+
+    while (position + COMPRESS_MIN_MATCH <= end)
+    {
+        uint32_t hash = GetCompressHash(position);
+        const uint8_t *match = input + table[hash];
+
+        table[hash] = (uint16_t)(position - input);
+
+        if (match >= position || position - match > COMPRESS_MAX_OFFSET ||
+            memcmp(match, position, COMPRESS_MIN_MATCH) != 0)
+        {
+            position += 1 + (misses++ >> COMPRESS_SKIP_SHIFT);
+            continue;
+        }
+
+        // Make the match as long as it goes.
+        const uint8_t *match_end = position + COMPRESS_MIN_MATCH;
+        const uint8_t *source = match + COMPRESS_MIN_MATCH;
+
+        while (match_end < end && *match_end == *source)
+        {
+            match_end++;
+            source++;
+        }
+
+        uint32_t literal_length = (uint32_t)(position - anchor);
+        uint32_t match_length = (uint32_t)(match_end - position) - COMPRESS_MIN_MATCH;
+        uint32_t offset = (uint32_t)(position - match);
+
+        // The token, literals, offset and both lengths at their longest.
+        if ((size_t)(out_end - out) < 1 + literal_length + (literal_length / 255) + 1 + 2 + (match_length / 255) + 1)
+        {
+            return 0;
+        }
+
+        uint8_t *token = out++;
+        *token = (uint8_t)(((literal_length < 15) ? literal_length : 15) << 4);
+        if (literal_length >= 15)
+        {
+            out = WriteCompressLength(out, literal_length - 15);
+        }
+
+        memcpy(out, anchor, literal_length);
+        out += literal_length;
+
+        *out++ = (uint8_t)offset;
+        *out++ = (uint8_t)(offset >> 8);
+
+        *token |= (uint8_t)((match_length < 15) ? match_length : 15);
+        if (match_length >= 15)
+        {
+            out = WriteCompressLength(out, match_length - 15);
+        }
+
+        position = match_end;
+        anchor = position;
+        misses = 0;
+
+        // Remember a position inside the match too, it finds more of the
+        // repeats in text.
+        if (position - 2 >= input && position - 2 + COMPRESS_MIN_MATCH <= end)
+        {
+            table[GetCompressHash(position - 2)] = (uint16_t)(position - 2 - input);
+        }
+    }
+
+    // The last sequence is the rest of the block as literals.
+    uint32_t literal_length = (uint32_t)(end - anchor);
+
+    if ((size_t)(out_end - out) < 1 + literal_length + (literal_length / 255) + 1)
+    {
+        return 0;
+    }
+
+    *out++ = (uint8_t)(((literal_length < 15) ? literal_length : 15) << 4);
+    if (literal_length >= 15)
+    {
+        out = WriteCompressLength(out, literal_length - 15);
+    }
+
+    memcpy(out, anchor, literal_length);
+    out += literal_length;
+
+    return (uint32_t)(out - output);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CompressBlockTo
+   $Prototype: static uint32_t CompressBlockTo(const uint8_t *input, uint32_t length, uint8_t *output, uint16_t *table)
+   $Params:
+       input: The block to compress, 1 to COMPRESS_BLOCK_SIZE bytes.
+       length: The length of the block
+       output: Where to write the block, COMPRESS_BLOCK_HEADER_BYTES +
+               length bytes.
+       table: COMPRESS_HASH_SIZE entries for the match finder.
+   $
+   $Description: Writes the header and bytes of a block. It is only kept
+   compressed if that is smaller. Returns how many bytes were written. $
+   ======================================================================== */
+static uint32_t CompressBlockTo(const uint8_t *input, uint32_t length, uint8_t *output, uint16_t *table)
+{
+    uint8_t *data = output + COMPRESS_BLOCK_HEADER_BYTES;
+    uint32_t stored = CompressBlockData(input, length, data, length - 1, table);
+
+    if (stored == 0)
+    {
+        memcpy(data, input, length);
+        stored = length;
+    }
+
+    SetCompressWord(output, ((length - 1) << 16) | (stored - 1));
+
+    return COMPRESS_BLOCK_HEADER_BYTES + stored;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecompressBlockData
+   $Prototype: static int DecompressBlockData(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length)
+   $Params:
+       input: The sequences of the block
+       length: How many bytes the sequences take
+       output: Where to write the block
+       output_length: The most bytes to write.
+   $
+   $Description: Decompresses a block. Every length and offset is checked
+   so bad data can't read or write outside of the buffers. Returns how
+   many bytes were written, or -1 if the data is bad. $
+   ======================================================================== */
+static int DecompressBlockData(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length)
+{
+    const uint8_t *in = input;
+    const uint8_t *in_end = input + length;
+    uint8_t *out = output;
+    uint8_t *out_end = output + output_length;
+
+    while (in < in_end)
+    {
+        uint8_t token = *in++;
+        uint32_t literal_length = token >> 4;
+        uint32_t match_length = token & 15;
+        uint8_t byte;
+
+        if (literal_length == 15)
+        {
+            do
+            {
+                if (in == in_end)
+                {
+                    return -1;
+                }
+
+                byte = *in++;
+                literal_length += byte;
+            } while (byte == 255);
+        }
+
+        if (literal_length > (uint32_t)(in_end - in) || literal_length > (uint32_t)(out_end - out))
+        {
+            return -1;
+        }
+
+        memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        // The last sequence has no match.
+        if (in == in_end)
+        {
+            break;
+        }
+
+        if (in_end - in < 2)
+        {
+            return -1;
+        }
+
+        uint32_t offset = in[0] | ((uint32_t)in[1] << 8);
+        in += 2;
+
+        if (match_length == 15)
+        {
+            do
+            {
+                if (in == in_end)
+                {
+                    return -1;
+                }
+
+                byte = *in++;
+                match_length += byte;
+            } while (byte == 255);
+        }
+
+        match_length += COMPRESS_MIN_MATCH;
+
+        if (offset == 0 || offset > (uint32_t)(out - output) || match_length > (uint32_t)(out_end - out))
+        {
+            return -1;
+        }
+
+        // A match that overlaps itself repeats the bytes before it, so it
+        // has to go a byte at a time.
+        const uint8_t *match = out - offset;
+
+        if (offset >= match_length)
+        {
+            memcpy(out, match, match_length);
+            out += match_length;
+        }
+        else
+        {
+            for(uint32_t i = 0; i < match_length; i++)
+            {
+                *out++ = *match++;
+            }
+        }
+    }
+
+    return (int)(out - output);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CompressBuffer
+   $Prototype: uint32_t CompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output)
+   $Params:
+       input: The data to compress
+       length: The length of the data
+       output: Where to write the compressed data, GetCompressBound(length)
+               bytes.
+   $
+   $Description: Compresses a whole buffer. Returns how many bytes the
+   compressed data takes. $
+   ======================================================================== */
+uint32_t CompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output)
+{
+    uint16_t *table = (uint16_t*)AllocateMemory(MEMORY_COMPRESSION, COMPRESS_HASH_SIZE * sizeof(uint16_t));
+    uint32_t done = 0;
+    uint32_t output_length = COMPRESS_HEADER_BYTES;
+
+    SetCompressWord(output, length);
+
+    while (done < length)
+    {
+        uint32_t block_length = length - done;
+
+        if (block_length > COMPRESS_BLOCK_SIZE)
+        {
+            block_length = COMPRESS_BLOCK_SIZE;
+        }
+
+        output_length += CompressBlockTo(input + done, block_length, output + output_length, table);
+        done += block_length;
+    }
+
+    FreeMemory(table);
+
+    return output_length;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecompressBuffer
+   $Prototype: int DecompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length)
+   $Params:
+       input: The compressed data
+       length: How many bytes it takes
+       output: Where to write the original data
+       output_length: How big output is.
+   $
+   $Description: Decompresses a whole buffer straight into the output.
+   Returns the length of the original data, or -1 if the data is bad or
+   it doesn't fit. $
+   ======================================================================== */
+int DecompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length)
+{
+    uint32_t total;
+    uint32_t done = 0;
+    uint32_t position = COMPRESS_HEADER_BYTES;
+
+    if (length < COMPRESS_HEADER_BYTES)
+    {
+        return -1;
+    }
+
+    total = GetCompressWord(input);
+
+    if (total > output_length || total > 0x7FFFFFFF)
+    {
+        return -1;
+    }
+
+    while (done < total)
+    {
+        uint32_t value;
+        uint32_t block_length;
+        uint32_t stored;
+
+        if (length - position < COMPRESS_BLOCK_HEADER_BYTES)
+        {
+            return -1;
+        }
+
+        value = GetCompressWord(input + position);
+        position += COMPRESS_BLOCK_HEADER_BYTES;
+
+        block_length = (value >> 16) + 1;
+        stored = (value & 0xFFFF) + 1;
+
+        if (stored > block_length || block_length > total - done || stored > length - position)
+        {
+            return -1;
+        }
+
+        if (stored == block_length)
+        {
+            memcpy(output + done, input + position, block_length);
+        }
+        else if (DecompressBlockData(input + position, stored, output + done, block_length) != (int)block_length)
+        {
+            return -1;
+        }
+
+        position += stored;
+        done += block_length;
+    }
+
+    if (position != length)
+    {
+        return -1;
+    }
+
+    return (int)total;
+}
@@ -0,0 +1,38 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: compression.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: A fast LZ77 compressor for the payload, in the same
+                 spirit as LZ4. The payload is split into chunks that are
+                 each compressed on their own with CompressBuffer. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(COMPRESSION_H)
+#define COMPRESSION_H
+
+#include <stdint.h>
+
+// The compressed data starts with the length of the original data, then
+// each block has a header and its bytes.
+#define COMPRESS_HEADER_BYTES 4
+#define COMPRESS_BLOCK_HEADER_BYTES 4
+
+// How much of the original data each block holds. Blocks are compressed
+// on their own so a decoder only ever needs one of them.
+#define COMPRESS_BLOCK_SIZE (64 * 1024)
+
+// The most bytes length bytes can take up once compressed.
+inline uint32_t GetCompressBound(uint32_t length)
+{
+    uint32_t blocks = (length + COMPRESS_BLOCK_SIZE - 1) / COMPRESS_BLOCK_SIZE;
+
+    return COMPRESS_HEADER_BYTES + length + (blocks * COMPRESS_BLOCK_HEADER_BYTES);
+}
+
+uint32_t CompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output);
+int DecompressBuffer(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t output_length);
+
+#endif
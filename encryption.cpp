@@ -0,0 +1,778 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: encryption.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static uint32_t GetEncryptWord(const uint8_t *bytes)
+static void SetEncryptWord(uint8_t *bytes, uint32_t value)
+static uint64_t GetEncryptLong(const uint8_t *bytes)
+static void CompressSha256(uint32_t *state, const uint8_t *block)
+static void StartSha256(Sha256 *sha)
+static void UpdateSha256(Sha256 *sha, const uint8_t *data, uint32_t length)
+static void FinishSha256(Sha256 *sha, uint8_t *digest)
+void DeriveEncryptKey(const char *password, const uint8_t *salt, uint8_t *key)
+static __m128i ExpandKeyWord(__m128i key, __m128i assist)
+static void ExpandKey128(const uint8_t *key, __m128i *round_keys)
+static void ExpandKey256(const uint8_t *key, __m128i *round_keys)
+static __m128i GetCounterBlock(const Cipher *cipher, uint64_t block)
+static void GetCipherCheck(const Cipher *cipher, uint8_t *check)
+int HasEncryptInstructions()
+void SetCipherKey(Cipher *cipher, AESType aes, const uint8_t *key, const uint8_t *counter)
+int StartEncryption(Cipher *cipher, AESType aes, const char *password, uint8_t *header)
+int StartDecryption(Cipher *cipher, const char *password, const uint8_t *header)
+void CryptBytes(const Cipher *cipher, uint64_t offset, const uint8_t *input, uint8_t *output, uint32_t count)
+void FinishCipher(Cipher *cipher)
+   $
+   $Description: The data is xored with AES encryptions of a counter that
+   goes up by one every 16 bytes (CTR mode, NIST SP 800-38A), so byte i
+   only depends on the key, the first counter block and i. The key is
+   PBKDF2-HMAC-SHA256 of the password and a random salt.
+
+   The header is the AES type (the key length in bytes) and 7 zero bytes,
+   the 16 byte salt, the 16 byte first counter block and the first 8
+   bytes of the all zero block encrypted with the key, which tells a
+   wrong password apart from bad data. The salt and counter are new for
+   every encryption. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "encryption.h"
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SHA256_BLOCK_BYTES 64
+#define SHA256_DIGEST_BYTES 32
+
+// How many blocks are encrypted at once. The AES instructions take a few
+// cycles to finish but a new one can start every cycle, so 8 independent
+// blocks keep them busy.
+#define ENCRYPT_PARALLEL_BLOCKS 8
+
+// Where each part of the header is.
+#define ENCRYPT_TYPE_OFFSET 0
+#define ENCRYPT_SALT_OFFSET 8
+#define ENCRYPT_COUNTER_OFFSET 24
+#define ENCRYPT_CHECK_OFFSET 40
+
+// A SHA-256 hash that is being worked out.
+struct Sha256
+{
+    uint32_t State[8];
+    uint8_t Block[SHA256_BLOCK_BYTES];
+    uint32_t BlockBytes;
+    uint64_t Length;
+};
+
+static const uint32_t sha256_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetEncryptWord
+   $Prototype: static uint32_t GetEncryptWord(const uint8_t *bytes)
+   $Params:
+       bytes: The 4 bytes to read, most significant first.
+   $
+   $Description: Reads a big endian 32 bit number. $
+   ======================================================================== */
+static uint32_t GetEncryptWord(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetEncryptWord
+   $Prototype: static void SetEncryptWord(uint8_t *bytes, uint32_t value)
+   $Params:
+       bytes: Where to write the 4 bytes
+       value: The number to write, most significant byte first.
+   $
+   $Description: Writes a big endian 32 bit number. $
+   ======================================================================== */
+static void SetEncryptWord(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetEncryptLong
+   $Prototype: static uint64_t GetEncryptLong(const uint8_t *bytes)
+   $Params:
+       bytes: The 8 bytes to read, most significant first.
+   $
+   $Description: Reads a big endian 64 bit number. $
+   ======================================================================== */
+static uint64_t GetEncryptLong(const uint8_t *bytes)
+{
+    return ((uint64_t)GetEncryptWord(bytes) << 32) | GetEncryptWord(bytes + 4);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CompressSha256
+   $Prototype: static void CompressSha256(uint32_t *state, const uint8_t *block)
+   $Params:
+       state: The 8 words of the hash so far
+       block: The next 64 bytes of the message
+   $
+   $Description: Mixes one block into the hash (FIPS 180-4). $
+   ======================================================================== */
+static void CompressSha256(uint32_t *state, const uint8_t *block)
+{
+#define ROTATE_RIGHT(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+    uint32_t w[64];
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t f = state[5];
+    uint32_t g = state[6];
+    uint32_t h = state[7];
+
+    for(int i = 0; i < 16; i++)
+    {
+        w[i] = GetEncryptWord(block + (i * 4));
+    }
+
+    for(int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = ROTATE_RIGHT(w[i - 15], 7) ^ ROTATE_RIGHT(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTATE_RIGHT(w[i - 2], 17) ^ ROTATE_RIGHT(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    for(int i = 0; i < 64; i++)
+    {
+        uint32_t s1 = ROTATE_RIGHT(e, 6) ^ ROTATE_RIGHT(e, 11) ^ ROTATE_RIGHT(e, 25);
+        uint32_t choose = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + choose + sha256_constants[i] + w[i];
+        uint32_t s0 = ROTATE_RIGHT(a, 2) ^ ROTATE_RIGHT(a, 13) ^ ROTATE_RIGHT(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+
+#undef ROTATE_RIGHT
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartSha256
+   $Prototype: static void StartSha256(Sha256 *sha)
+   $Params:
+       sha: The hash to start
+   $
+   $Description: Sets up a hash of an empty message. $
+   ======================================================================== */
+static void StartSha256(Sha256 *sha)
+{
+    static const uint32_t initial_state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(sha->State, initial_state, sizeof(initial_state));
+    sha->BlockBytes = 0;
+    sha->Length = 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: UpdateSha256
+   $Prototype: static void UpdateSha256(Sha256 *sha, const uint8_t *data, uint32_t length)
+   $Params:
+       sha: The hash to add to
+       data: The next part of the message
+       length: How many bytes there are
+   $
+   $Description: Adds more of the message to the hash. $
+   ======================================================================== */
+static void UpdateSha256(Sha256 *sha, const uint8_t *data, uint32_t length)
+{
+    sha->Length += length;
+
+    while (length > 0)
+    {
+        uint32_t count = SHA256_BLOCK_BYTES - sha->BlockBytes;
+
+        if (count > length)
+        {
+            count = length;
+        }
+
+        memcpy(sha->Block + sha->BlockBytes, data, count);
+        sha->BlockBytes += count;
+        data += count;
+        length -= count;
+
+        if (sha->BlockBytes == SHA256_BLOCK_BYTES)
+        {
+            CompressSha256(sha->State, sha->Block);
+            sha->BlockBytes = 0;
+        }
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FinishSha256
+   $Prototype: static void FinishSha256(Sha256 *sha, uint8_t *digest)
+   $Params:
+       sha: The hash to finish
+       digest: Where to write the 32 byte hash.
+   $
+   $Description: Pads the message with a 1 bit, zeros and the length in
+   bits, then writes out the hash. $
+   ======================================================================== */
+static void FinishSha256(Sha256 *sha, uint8_t *digest)
+{
+    uint64_t bits = sha->Length * 8;
+
+    sha->Block[sha->BlockBytes++] = 0x80;
+
+    if (sha->BlockBytes > SHA256_BLOCK_BYTES - 8)
+    {
+        memset(sha->Block + sha->BlockBytes, 0, SHA256_BLOCK_BYTES - sha->BlockBytes);
+        CompressSha256(sha->State, sha->Block);
+        sha->BlockBytes = 0;
+    }
+
+    memset(sha->Block + sha->BlockBytes, 0, SHA256_BLOCK_BYTES - 8 - sha->BlockBytes);
+    SetEncryptWord(sha->Block + SHA256_BLOCK_BYTES - 8, (uint32_t)(bits >> 32));
+    SetEncryptWord(sha->Block + SHA256_BLOCK_BYTES - 4, (uint32_t)bits);
+    CompressSha256(sha->State, sha->Block);
+
+    for(int i = 0; i < 8; i++)
+    {
+        SetEncryptWord(digest + (i * 4), sha->State[i]);
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DeriveEncryptKey
+   $Prototype: void DeriveEncryptKey(const char *password, const uint8_t *salt, uint8_t *key)
+   $Params:
+       password: The NUL terminated password
+       salt: The ENCRYPT_SALT_BYTES of salt
+       key: Where to write the 32 byte key. AES-128 uses the first half.
+   $
+   $Description: Works out the key with PBKDF2-HMAC-SHA256 (RFC 8018).
+   The hashes of the password xored with the HMAC pads are only worked out
+   once, so every iteration is two SHA-256 blocks. $
+   ======================================================================== */
+void DeriveEncryptKey(const char *password, const uint8_t *salt, uint8_t *key)
+{
+    uint8_t hmac_key[SHA256_BLOCK_BYTES];
+    uint8_t pad[SHA256_BLOCK_BYTES];
+    uint8_t block_index[4];
+    uint8_t u[SHA256_DIGEST_BYTES];
+    uint32_t password_length = strlen(password);
+    Sha256 inner;
+    Sha256 outer;
+    Sha256 sha;
+
+    // A password longer than a block is hashed first.
+    memset(hmac_key, 0, sizeof(hmac_key));
+
+    if (password_length > SHA256_BLOCK_BYTES)
+    {
+        StartSha256(&sha);
+        UpdateSha256(&sha, (const uint8_t*)password, password_length);
+        FinishSha256(&sha, hmac_key);
+    }
+    else
+    {
+        memcpy(hmac_key, password, password_length);
+    }
+
+    for(int i = 0; i < SHA256_BLOCK_BYTES; i++)
+    {
+        pad[i] = hmac_key[i] ^ 0x36;
+    }
+
+    StartSha256(&inner);
+    UpdateSha256(&inner, pad, SHA256_BLOCK_BYTES);
+
+    for(int i = 0; i < SHA256_BLOCK_BYTES; i++)
+    {
+        pad[i] = hmac_key[i] ^ 0x5c;
+    }
+
+    StartSha256(&outer);
+    UpdateSha256(&outer, pad, SHA256_BLOCK_BYTES);
+
+    // The key is only one block of the output, U1 = HMAC(salt || 1).
+    SetEncryptWord(block_index, 1);
+
+    sha = inner;
+    UpdateSha256(&sha, salt, ENCRYPT_SALT_BYTES);
+    UpdateSha256(&sha, block_index, 4);
+    FinishSha256(&sha, u);
+
+    sha = outer;
+    UpdateSha256(&sha, u, SHA256_DIGEST_BYTES);
+    FinishSha256(&sha, u);
+
+    memcpy(key, u, SHA256_DIGEST_BYTES);
+
+    for(int i = 1; i < ENCRYPT_KEY_ITERATIONS; i++)
+    {
+        sha = inner;
+        UpdateSha256(&sha, u, SHA256_DIGEST_BYTES);
+        FinishSha256(&sha, u);
+
+        sha = outer;
+        UpdateSha256(&sha, u, SHA256_DIGEST_BYTES);
+        FinishSha256(&sha, u);
+
+        for(int j = 0; j < SHA256_DIGEST_BYTES; j++)
+        {
+            key[j] ^= u[j];
+        }
+    }
+
+    memset(hmac_key, 0, sizeof(hmac_key));
+    memset(pad, 0, sizeof(pad));
+    memset(&inner, 0, sizeof(Sha256));
+    memset(&outer, 0, sizeof(Sha256));
+    memset(&sha, 0, sizeof(Sha256));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ExpandKeyWord
+   $Prototype: static __m128i ExpandKeyWord(__m128i key, __m128i assist)
+   $Params:
+       key: The round key from two steps back (one step for AES-128)
+       assist: The result of aeskeygenassist on the last round key, with
+               the word that is needed broadcast to every word.
+   $
+   $Description: Works out the next round key. Each word is the word
+   before it xored with the same word of the older key, which is the
+   older key xored with itself shifted up 1, 2 and 3 words. $
+   ======================================================================== */
+__attribute__((target("aes")))
+static __m128i ExpandKeyWord(__m128i key, __m128i assist)
+{
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+
+    return _mm_xor_si128(key, assist);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ExpandKey128
+   $Prototype: static void ExpandKey128(const uint8_t *key, __m128i *round_keys)
+   $Params:
+       key: The 16 byte key
+       round_keys: Where to write the 11 round keys.
+   $
+   $Description: The AES-128 key schedule. The round constant has to be
+   known at compile time, so the rounds are written out. $
+   ======================================================================== */
+__attribute__((target("aes")))
+static void ExpandKey128(const uint8_t *key, __m128i *round_keys)
+{
+#define EXPAND_KEY_128(i, rcon) \
+    round_keys[i] = ExpandKeyWord(round_keys[i - 1], \
+                                  _mm_shuffle_epi32(_mm_aeskeygenassist_si128(round_keys[i - 1], rcon), 0xFF))
+
+    round_keys[0] = _mm_loadu_si128((const __m128i*)key);
+    EXPAND_KEY_128(1, 0x01);
+    EXPAND_KEY_128(2, 0x02);
+    EXPAND_KEY_128(3, 0x04);
+    EXPAND_KEY_128(4, 0x08);
+    EXPAND_KEY_128(5, 0x10);
+    EXPAND_KEY_128(6, 0x20);
+    EXPAND_KEY_128(7, 0x40);
+    EXPAND_KEY_128(8, 0x80);
+    EXPAND_KEY_128(9, 0x1B);
+    EXPAND_KEY_128(10, 0x36);
+
+#undef EXPAND_KEY_128
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ExpandKey256
+   $Prototype: static void ExpandKey256(const uint8_t *key, __m128i *round_keys)
+   $Params:
+       key: The 32 byte key
+       round_keys: Where to write the 15 round keys.
+   $
+   $Description: The AES-256 key schedule. The even round keys use the
+   rotated, substituted last word with the round constant and the odd
+   ones only the substituted last word. $
+   ======================================================================== */
+__attribute__((target("aes")))
+static void ExpandKey256(const uint8_t *key, __m128i *round_keys)
+{
+#define EXPAND_KEY_256(i, rcon) \
+    round_keys[i] = ExpandKeyWord(round_keys[i - 2], \
+                                  _mm_shuffle_epi32(_mm_aeskeygenassist_si128(round_keys[i - 1], rcon), 0xFF)); \
+    round_keys[i + 1] = ExpandKeyWord(round_keys[i - 1], \
+                                      _mm_shuffle_epi32(_mm_aeskeygenassist_si128(round_keys[i], 0), 0xAA))
+
+    round_keys[0] = _mm_loadu_si128((const __m128i*)key);
+    round_keys[1] = _mm_loadu_si128((const __m128i*)(key + 16));
+    EXPAND_KEY_256(2, 0x01);
+    EXPAND_KEY_256(4, 0x02);
+    EXPAND_KEY_256(6, 0x04);
+    EXPAND_KEY_256(8, 0x08);
+    EXPAND_KEY_256(10, 0x10);
+    EXPAND_KEY_256(12, 0x20);
+    round_keys[14] = ExpandKeyWord(round_keys[12],
+                                   _mm_shuffle_epi32(_mm_aeskeygenassist_si128(round_keys[13], 0x40), 0xFF));
+
+#undef EXPAND_KEY_256
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetCounterBlock
+   $Prototype: static __m128i GetCounterBlock(const Cipher *cipher, uint64_t block)
+   $Params:
+       cipher: The cipher with the first counter block
+       block: Which 16 bytes of the data the counter is for.
+   $
+   $Description: Adds block to the first counter block, carrying into the
+   top half, and returns it in memory order. $
+   ======================================================================== */
+static __m128i GetCounterBlock(const Cipher *cipher, uint64_t block)
+{
+    uint64_t low = cipher->CounterLow + block;
+    uint64_t high = cipher->CounterHigh + (low < block);
+
+    return _mm_set_epi64x((long long)__builtin_bswap64(low), (long long)__builtin_bswap64(high));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetCipherCheck
+   $Prototype: static void GetCipherCheck(const Cipher *cipher, uint8_t *check)
+   $Params:
+       cipher: The cipher with the key
+       check: Where to write the ENCRYPT_CHECK_BYTES.
+   $
+   $Description: Encrypts the all zero block and keeps the start of it.
+   It is only the same for the same key, but doesn't give the key away. $
+   ======================================================================== */
+__attribute__((target("aes")))
+static void GetCipherCheck(const Cipher *cipher, uint8_t *check)
+{
+    uint8_t block[ENCRYPT_BLOCK_BYTES];
+    __m128i value = _mm_loadu_si128((const __m128i*)cipher->RoundKeys[0]);
+
+    for(int r = 1; r < cipher->Rounds; r++)
+    {
+        value = _mm_aesenc_si128(value, _mm_loadu_si128((const __m128i*)cipher->RoundKeys[r]));
+    }
+
+    value = _mm_aesenclast_si128(value, _mm_loadu_si128((const __m128i*)cipher->RoundKeys[cipher->Rounds]));
+    _mm_storeu_si128((__m128i*)block, value);
+
+    memcpy(check, block, ENCRYPT_CHECK_BYTES);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: HasEncryptInstructions
+   $Prototype: int HasEncryptInstructions()
+   $Params: $
+   $Description: Returns 1 if the processor has the AES instructions. $
+   ======================================================================== */
+int HasEncryptInstructions()
+{
+    return __builtin_cpu_supports("aes") ? 1 : 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetCipherKey
+   $Prototype: void SetCipherKey(Cipher *cipher, AESType aes, const uint8_t *key, const uint8_t *counter)
+   $Params:
+       cipher: The cipher to set up
+       aes: Which AES to use
+       key: The 16 or 32 byte key
+       counter: The 16 byte counter block the data starts at.
+   $
+   $Description: Expands the key. The processor has to have the AES
+   instructions (HasEncryptInstructions). $
+   ======================================================================== */
+__attribute__((target("aes")))
+void SetCipherKey(Cipher *cipher, AESType aes, const uint8_t *key, const uint8_t *counter)
+{
+    __m128i round_keys[15];
+
+    cipher->Type = aes;
+
+    if (aes == AES_128)
+    {
+        cipher->Rounds = 10;
+        ExpandKey128(key, round_keys);
+    }
+    else
+    {
+        cipher->Rounds = 14;
+        ExpandKey256(key, round_keys);
+    }
+
+    for(int r = 0; r <= cipher->Rounds; r++)
+    {
+        _mm_storeu_si128((__m128i*)cipher->RoundKeys[r], round_keys[r]);
+    }
+
+    cipher->CounterHigh = GetEncryptLong(counter);
+    cipher->CounterLow = GetEncryptLong(counter + 8);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartEncryption
+   $Prototype: int StartEncryption(Cipher *cipher, AESType aes, const char *password, uint8_t *header)
+   $Params:
+       cipher: The cipher to set up
+       aes: Which AES to use
+       password: The NUL terminated password
+       header: Where to write the ENCRYPT_HEADER_BYTES that go in front
+               of the encrypted data.
+   $
+   $Description: Picks a random salt and counter block and derives the key
+   from the password. Returns 0 on success and -1 if there is no random
+   data. $
+   ======================================================================== */
+int StartEncryption(Cipher *cipher, AESType aes, const char *password, uint8_t *header)
+{
+    uint8_t key[SHA256_DIGEST_BYTES];
+    uint32_t bytes_read = 0;
+    uint32_t bytes_to_read = ENCRYPT_SALT_BYTES + ENCRYPT_BLOCK_BYTES;
+    FILE *fp;
+
+    memset(header, 0, ENCRYPT_HEADER_BYTES);
+
+    // The salt and counter block are next to each other.
+    if ((fp = fopen("/dev/urandom", "r")) == 0)
+    {
+        return -1;
+    }
+
+    while (bytes_read < bytes_to_read)
+    {
+        uint32_t n = fread(header + ENCRYPT_SALT_OFFSET + bytes_read, 1, bytes_to_read - bytes_read, fp);
+
+        if (n == 0)
+        {
+            fclose(fp);
+            return -1;
+        }
+
+        bytes_read += n;
+    }
+
+    fclose(fp);
+
+    header[ENCRYPT_TYPE_OFFSET] = (aes == AES_128) ? 16 : 32;
+
+    DeriveEncryptKey(password, header + ENCRYPT_SALT_OFFSET, key);
+    SetCipherKey(cipher, aes, key, header + ENCRYPT_COUNTER_OFFSET);
+    GetCipherCheck(cipher, header + ENCRYPT_CHECK_OFFSET);
+
+    memset(key, 0, sizeof(key));
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartDecryption
+   $Prototype: int StartDecryption(Cipher *cipher, const char *password, const uint8_t *header)
+   $Params:
+       cipher: The cipher to set up. Type gets set to the AES the header
+               says the data uses.
+       password: The NUL terminated password
+       header: The ENCRYPT_HEADER_BYTES from the front of the data.
+   $
+   $Description: Derives the key from the password and the salt in the
+   header. Returns 0 on success and -1 if the header is bad or the
+   password is wrong. $
+   ======================================================================== */
+int StartDecryption(Cipher *cipher, const char *password, const uint8_t *header)
+{
+    uint8_t key[SHA256_DIGEST_BYTES];
+    uint8_t check[ENCRYPT_CHECK_BYTES];
+    AESType aes;
+
+    if (header[ENCRYPT_TYPE_OFFSET] == 16)
+    {
+        aes = AES_128;
+    }
+    else if (header[ENCRYPT_TYPE_OFFSET] == 32)
+    {
+        aes = AES_256;
+    }
+    else
+    {
+        return -1;
+    }
+
+    DeriveEncryptKey(password, header + ENCRYPT_SALT_OFFSET, key);
+    SetCipherKey(cipher, aes, key, header + ENCRYPT_COUNTER_OFFSET);
+    GetCipherCheck(cipher, check);
+
+    memset(key, 0, sizeof(key));
+
+    if (memcmp(check, header + ENCRYPT_CHECK_OFFSET, ENCRYPT_CHECK_BYTES) != 0)
+    {
+        FinishCipher(cipher);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CryptBytes
+   $Prototype: void CryptBytes(const Cipher *cipher, uint64_t offset, const uint8_t *input, uint8_t *output, uint32_t count)
+   $Params:
+       cipher: The cipher to use
+       offset: Where the bytes are in the data. It has to be a multiple
+               of 16.
+       input: The bytes to encrypt or decrypt
+       output: Where to write them, it can be the input.
+       count: How many bytes there are
+   $
+   $Description: Encrypts or decrypts a part of the data, which is the
+   same thing in CTR mode. 8 counter blocks go through the rounds
+   together, the last few blocks go through one at a time. $
+   ======================================================================== */
+__attribute__((target("aes")))
+void CryptBytes(const Cipher *cipher, uint64_t offset, const uint8_t *input, uint8_t *output, uint32_t count)
+{
+    __m128i round_keys[15];
+    uint64_t block = offset / ENCRYPT_BLOCK_BYTES;
+    int rounds = cipher->Rounds;
+
+    for(int r = 0; r <= rounds; r++)
+    {
+        round_keys[r] = _mm_loadu_si128((const __m128i*)cipher->RoundKeys[r]);
+    }
+
+    while (count >= ENCRYPT_PARALLEL_BLOCKS * ENCRYPT_BLOCK_BYTES)
+    {
+        __m128i values[ENCRYPT_PARALLEL_BLOCKS];
+
+        #pragma GCC unroll 8
+        for(int q = 0; q < ENCRYPT_PARALLEL_BLOCKS; q++)
+        {
+            values[q] = _mm_xor_si128(GetCounterBlock(cipher, block + q), round_keys[0]);
+        }
+
+        for(int r = 1; r < rounds; r++)
+        {
+            #pragma GCC unroll 8
+            for(int q = 0; q < ENCRYPT_PARALLEL_BLOCKS; q++)
+            {
+                values[q] = _mm_aesenc_si128(values[q], round_keys[r]);
+            }
+        }
+
+        #pragma GCC unroll 8
+        for(int q = 0; q < ENCRYPT_PARALLEL_BLOCKS; q++)
+        {
+            __m128i data = _mm_loadu_si128((const __m128i*)input + q);
+
+            values[q] = _mm_aesenclast_si128(values[q], round_keys[rounds]);
+            _mm_storeu_si128((__m128i*)output + q, _mm_xor_si128(data, values[q]));
+        }
+
+        block += ENCRYPT_PARALLEL_BLOCKS;
+        input += ENCRYPT_PARALLEL_BLOCKS * ENCRYPT_BLOCK_BYTES;
+        output += ENCRYPT_PARALLEL_BLOCKS * ENCRYPT_BLOCK_BYTES;
+        count -= ENCRYPT_PARALLEL_BLOCKS * ENCRYPT_BLOCK_BYTES;
+    }
+
+    while (count > 0)
+    {
+        uint8_t stream[ENCRYPT_BLOCK_BYTES];
+        uint32_t bytes = (count < ENCRYPT_BLOCK_BYTES) ? count : ENCRYPT_BLOCK_BYTES;
+        __m128i value = _mm_xor_si128(GetCounterBlock(cipher, block), round_keys[0]);
+
+        for(int r = 1; r < rounds; r++)
+        {
+            value = _mm_aesenc_si128(value, round_keys[r]);
+        }
+
+        value = _mm_aesenclast_si128(value, round_keys[rounds]);
+        _mm_storeu_si128((__m128i*)stream, value);
+
+        for(uint32_t i = 0; i < bytes; i++)
+        {
+            output[i] = input[i] ^ stream[i];
+        }
+
+        block++;
+        input += bytes;
+        output += bytes;
+        count -= bytes;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FinishCipher
+   $Prototype: void FinishCipher(Cipher *cipher)
+   $Params:
+       cipher: The cipher that is done with
+   $
+   $Description: Clears the key out of memory. $
+   ======================================================================== */
+void FinishCipher(Cipher *cipher)
+{
+    volatile uint8_t *bytes = (volatile uint8_t*)cipher;
+
+    for(uint32_t i = 0; i < sizeof(Cipher); i++)
+    {
+        bytes[i] = 0;
+    }
+}
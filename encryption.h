@@ -0,0 +1,59 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: encryption.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: AES in counter mode on the AES-NI instructions, with the
+                 key derived from a password. Any part of the data can be
+                 encrypted on its own, so the payload can be encrypted by
+                 the threads that encode it. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(ENCRYPTION_H)
+#define ENCRYPTION_H
+
+#include <stdint.h>
+
+enum AESType
+{
+    AES_128,
+    AES_256,
+};
+
+// The encrypted data starts with a header holding the AES type, the salt
+// for the password, the first counter block and a check of the key.
+#define ENCRYPT_HEADER_BYTES 48
+#define ENCRYPT_SALT_BYTES 16
+#define ENCRYPT_BLOCK_BYTES 16
+#define ENCRYPT_CHECK_BYTES 8
+
+// How many rounds of HMAC-SHA256 the password goes through.
+#define ENCRYPT_KEY_ITERATIONS 20000
+
+// An expanded key and the counter block the data starts at. It is only
+// read while encrypting, so the threads can share one.
+struct Cipher
+{
+    AESType Type;
+    int Rounds;
+    uint8_t RoundKeys[15][ENCRYPT_BLOCK_BYTES];
+
+    // The first counter block as a 128 bit big endian number.
+    uint64_t CounterHigh;
+    uint64_t CounterLow;
+};
+
+int HasEncryptInstructions();
+
+// Works out a 32 byte key from the password and ENCRYPT_SALT_BYTES of salt.
+void DeriveEncryptKey(const char *password, const uint8_t *salt, uint8_t *key);
+
+void SetCipherKey(Cipher *cipher, AESType aes, const uint8_t *key, const uint8_t *counter);
+int StartEncryption(Cipher *cipher, AESType aes, const char *password, uint8_t *header);
+int StartDecryption(Cipher *cipher, const char *password, const uint8_t *header);
+void CryptBytes(const Cipher *cipher, uint64_t offset, const uint8_t *input, uint8_t *output, uint32_t count);
+void FinishCipher(Cipher *cipher);
+
+#endif
@@ -6,14 +6,42 @@
    $Created On: 2015/09/16 $
    $Functions: 
 int SaveBitmap(const char *filename, const Image *image)
-static Image *LoadBitmap(const char *filename)
+static Image *LoadBitmap(const char *filename, ImageMapMode mode)
 static int FindLeastSignificantBit(uint32_t num)
+static int CheckBitmapHeader(const BitmapHeader *header, uint64_t file_size)
+static int SetBitmapFormat(Image *image, const BitmapHeader *header)
+static void SetArgbFormat(Image *image)
+template <typename Layout> static void SetLayoutFormat(Layout layout, Image *image)
+template <typename Layout> static void ConvertBitmapLayout(Layout layout, const uint8_t *source, uint32_t *dest, uint32_t count)
+static int GetBitmapShuffle(const Image *format, uint8_t *shuffle)
+static uint32_t ConvertBitmapSSSE3(const uint8_t *shuffle, const uint8_t *source, uint32_t *dest, uint32_t count)
+static uint32_t ConvertBitmapAVX2(const uint8_t *shuffle, const uint8_t *source, uint32_t *dest, uint32_t count)
+static void ConvertBitmapJob(void *data, int index)
+static void ConvertBitmapPixels(const Image *format, const uint8_t *source, uint32_t *dest, uint32_t count)
+static void FillBitmapHeader(BitmapHeader *header, const Image *image)
+static size_t GetStripBytes(const Image *format, uint32_t pixel_count)
+static uint32_t GetStripPixels(const Image *format, size_t bytes)
+BitmapStream *OpenBitmapStream(const char *filename)
+BitmapStream *CreateBitmapStream(const char *filename, const Image *format)
+uint32_t ReadBitmapStrip(BitmapStream *stream, uint32_t *pixels, uint32_t pixel_count)
+int WriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_count)
+int RewriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_start, uint32_t pixel_count)
+void CloseBitmapStream(BitmapStream *stream)
 Image *CopyImage(Image *image)
+Image *CopyImage(const ImageView *view)
+int BorrowImageView(const ImageView *view, Image *image)
+ImageView GetImageView(const Image *image)
 Image *CreateRandomImage(const int width, const int height, const int bpp)
 Image *CreateImage(const int width, const int height, const int bpp)
+void FreeImage(Image *image)
 Image *LoadImage(const char *filename)
+Image *LoadImageMapped(const char *filename, ImageMapMode mode)
+void SetImageThreads(int thread_count)
+int SetImageJobThreads(int thread_count)
+int GetImageThreads()
    $
-   $Description: This file handles everything to do with loading/saving the images. $
+   $Description: This file handles everything to do with loading/saving the images.
+   Pixels that aren't mapped from a file come from the memory pool. $
    $Revisions: $
    ======================================================================== */
 
@@ -21,12 +49,19 @@ Image *LoadImage(const char *filename)
 #include "image.h"
 
 #include <fcntl.h>
+#include <immintrin.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "allocator.h"
 #include "image_functions.h"
+#include "pixel_layout.h"
+#include "profiler.h"
+#include "threads.h"
 
 // The header of the bitmap should not have any padding in it.
 #pragma pack(push, 1)
@@ -55,9 +90,57 @@ struct BitmapHeader
 };
 #pragma pack(pop)
 
+// Where SaveBitmap puts the pixels. The header is padded so the pixels
+// are 16 byte aligned when the file is mapped and can be used in place.
+#define BITMAP_PIXEL_OFFSET ((sizeof(BitmapHeader) + 15) & ~15)
+
+// The masks are only there for Bit Field bitmaps, a 24 bit bitmap can
+// have its pixels straight after the rest of the header.
+#define BITMAP_INFO_SIZE offsetof(BitmapHeader, RedMask)
+
+// Set this to 0 to compile out the SIMD pixel conversion and only use the
+// template loops.
+#if !defined(IMAGE_CONVERT_SIMD)
+#define IMAGE_CONVERT_SIMD 1
+#endif
+
+// Images smaller than this aren't worth starting threads to convert.
+#define IMAGE_PARALLEL_MIN_PIXELS (1024 * 1024)
+
+// One part of the pixels that ConvertBitmapPixels splits across threads.
+struct ConvertJob
+{
+    const Image *Format;
+    const uint8_t *Source;
+    uint32_t *Dest;
+    uint32_t Count;
+
+    // How many pixels each job converts. This is always whole rows.
+    uint32_t ChunkSize;
+
+    // Set when every channel is a whole byte, then the pixels can be
+    // converted with Shuffle.
+    int Shuffled;
+    uint8_t Shuffle[16];
+};
+
+// How many threads convert the pixels of a bitmap, 0 uses one per processor.
+static int image_threads = 1;
+
+// The same for the bitmaps loaded on a thread that runs a job of its own,
+// 0 if it isn't.
+static __thread int image_job_threads = 0;
+
 
 static int FindLeastSignificantBit(uint32_t num);
-static Image *LoadBitmap(const char *filename);
+static int CheckBitmapHeader(const BitmapHeader *header, uint64_t file_size);
+static int SetBitmapFormat(Image *image, const BitmapHeader *header);
+static void SetArgbFormat(Image *image);
+template <typename Layout> static void SetLayoutFormat(Layout layout, Image *image);
+static int GetBitmapShuffle(const Image *format, uint8_t *shuffle);
+static void ConvertBitmapPixels(const Image *format, const uint8_t *source, uint32_t *dest, uint32_t count);
+static void FillBitmapHeader(BitmapHeader *header, const Image *image);
+static Image *LoadBitmap(const char *filename, ImageMapMode mode);
 
 
 /* ========================================================================
@@ -68,14 +151,36 @@ static Image *LoadBitmap(const char *filename);
        filename: The file to load
    $
    $Description: This function detects which filetype the filename is 
-   and loads it properly. $
+   and loads it properly. The pixels can be changed without affecting the
+   file. $
    ======================================================================== */
 Image *LoadImage(const char *filename)
 {
+    return LoadImageMapped(filename, IMAGE_MAP_PRIVATE);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: LoadImageMapped
+   $Prototype: Image *LoadImageMapped(const char *filename, ImageMapMode mode)
+   $Params: 
+       filename: The file to load
+       mode: IMAGE_MAP_READ if the pixels are only going to be read,
+             IMAGE_MAP_PRIVATE if they are going to be changed.
+   $
+   $Description: Loads an image, using the pixels in the file without
+   copying them when they are already in the right layout. Pages are only
+   read in when they are touched, so decoding a small payload out of a big
+   image only reads the start of the file. $
+   ======================================================================== */
+Image *LoadImageMapped(const char *filename, ImageMapMode mode)
+{
+    TIMED_BLOCK();
+
     Image *image = 0;
 
     // Check to see if the bitmap was loaded successfully, if so return it.
-    if ((image = LoadBitmap(filename)) != 0)
+    if ((image = LoadBitmap(filename, mode)) != 0)
     {
         return image;
     }
@@ -92,7 +197,8 @@ Image *LoadImage(const char *filename)
        height: The height of the image
        bpp: How many bits are per pixel.
    $
-   $Description: This function creates an empty image of the specified params. $
+   $Description: This function creates an empty image of the specified
+   params. The masks are set to ARGB, a 24 bit image has no alpha. $
    ======================================================================== */
 Image *CreateImage(const int width, const int height, const int bpp)
 {
@@ -102,12 +208,48 @@ Image *CreateImage(const int width, const int height, const int bpp)
     image->Height = height;
     image->PixelCount = width * height;
     image->BitsPerPixel = bpp;
+    image->Pitch = (uint32_t)GetImagePitch(width, bpp);
+
+    image->Pixels = (uint32_t*)AllocateMemory(MEMORY_IMAGE, (size_t)image->Pitch * height);
 
-    image->Pixels = (uint32_t*)malloc(bpp / 8 * width * height);
+    SetArgbFormat(image);
+
+    image->Mapping = 0;
+    image->MappingSize = 0;
+    image->ReadOnly = 0;
 
     return image; 
 }
 
+/* ========================================================================
+   $FUNCTION
+   $Name: FreeImage
+   $Prototype: void FreeImage(Image *image)
+   $Params: 
+       image: The image to free
+   $
+   $Description: Frees the image and its pixels, or unmaps the file the
+   pixels are in. $
+   ======================================================================== */
+void FreeImage(Image *image)
+{
+    if (image == 0)
+    {
+        return;
+    }
+
+    if (image->Mapping)
+    {
+        munmap(image->Mapping, image->MappingSize);
+    }
+    else
+    {
+        FreeMemory(image->Pixels);
+    }
+
+    free(image);
+}
+
 /* ========================================================================
    $FUNCTION
    $Name: CreateRandomImage
@@ -123,20 +265,30 @@ Image *CreateRandomImage(const int width, const int height, const int bpp)
 {
     Image *image = CreateImage(width, height, bpp);
     FILE *fp;
-    int bytes_read = 0;
-    int bytes_to_read = image->PixelCount * (bpp / 8);
+    size_t bytes_read = 0;
+    size_t bytes_to_read = GetImageSize(image);
+    size_t bytes;
 
     if ((fp = fopen("/dev/urandom", "r")) == 0)
     {
-        free(image);
+        FreeImage(image);
         return 0;
     }
 
     while (bytes_read < bytes_to_read)
     {
-        bytes_read += fread(image->Pixels + bytes_read, 1, bytes_to_read - bytes_read, fp);
+        if ((bytes = fread((uint8_t*)image->Pixels + bytes_read, 1, bytes_to_read - bytes_read, fp)) == 0)
+        {
+            fclose(fp);
+            FreeImage(image);
+            return 0;
+        }
+
+        bytes_read += bytes;
     }
 
+    fclose(fp);
+
     return image;
 }
 
@@ -147,23 +299,139 @@ Image *CreateRandomImage(const int width, const int height, const int bpp)
    $Params: 
        image: The image to copy
    $
-   $Description: Returns an exact copy of the image. $
+   $Description: Returns an exact copy of the image. The rows of the copy
+   are packed, even if the image was borrowed from a view with gaps between
+   its rows. $
    ======================================================================== */
 Image *CopyImage(Image *image)
 {
     Image *new_image = CreateImage(image->Width, image->Height, image->BitsPerPixel);
     uint32_t *pixels = new_image->Pixels;
+    uint32_t pitch = new_image->Pitch;
 
     // Copy the meta data
     memcpy(new_image, image, sizeof(Image));
 
-    // Copy the pixel data
+    // Copy the pixel data. The copy is never mapped.
     new_image->Pixels = pixels;
-    memcpy(new_image->Pixels, image->Pixels, image->PixelCount * image->BitsPerPixel / 8);
+    new_image->Pitch = pitch;
+    new_image->Mapping = 0;
+    new_image->MappingSize = 0;
+    new_image->ReadOnly = 0;
+
+    if (image->Pitch == pitch)
+    {
+        memcpy(new_image->Pixels, image->Pixels, GetImageSize(new_image));
+    }
+    else
+    {
+        for(uint32_t y = 0; y < image->Height; y++)
+        {
+            memcpy(GetImageRow(new_image, y), GetImageRow(image, y), pitch);
+        }
+    }
 
     return new_image;
 }
 
+/* ========================================================================
+   $FUNCTION
+   $Name: CopyImage
+   $Prototype: Image *CopyImage(const ImageView *view)
+   $Params:
+       view: The pixels to copy
+   $
+   $Description: Returns an image with a copy of the pixels of the view, or
+   0 if the view can't be used. $
+   ======================================================================== */
+Image *CopyImage(const ImageView *view)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return 0;
+    }
+
+    return CopyImage(&image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: BorrowImageView
+   $Prototype: int BorrowImageView(const ImageView *view, Image *image)
+   $Params:
+       view: The pixels to borrow
+       image: The image to fill out. It must not be given to FreeImage.
+   $
+   $Description: Fills out an image that uses the pixels of the view where
+   they are, so everything that works on an Image works on them without a
+   copy. Returns 0 on success, or -1 if the view isn't 24 or 32 bit, has
+   unknown masks or its pixels or rows aren't 4 byte aligned. $
+   ======================================================================== */
+int BorrowImageView(const ImageView *view, Image *image)
+{
+    if (view->Pixels == 0 || ((uintptr_t)view->Pixels % sizeof(uint32_t)) != 0 ||
+        (view->BitsPerPixel != 24 && view->BitsPerPixel != 32) ||
+        (view->BitsPerPixel == 32 && view->Layout == IMAGE_LAYOUT_OTHER) ||
+        (view->Stride % sizeof(uint32_t)) != 0 || view->Stride < GetImagePitch(view->Width, view->BitsPerPixel) ||
+        (uint64_t)view->Width * view->Height > 0xFFFFFFFF)
+    {
+        printf("Error: the image view can't be used.\n");
+        return -1;
+    }
+
+    image->Width = view->Width;
+    image->Height = view->Height;
+    image->Pixels = (uint32_t*)view->Pixels;
+    image->PixelCount = view->Width * view->Height;
+    image->BitsPerPixel = view->BitsPerPixel;
+    image->Pitch = view->Stride;
+    image->Mapping = 0;
+    image->MappingSize = 0;
+    image->ReadOnly = 0;
+
+    SetArgbFormat(image);
+
+    if (view->BitsPerPixel == 32)
+    {
+        switch (view->Layout)
+        {
+            case IMAGE_LAYOUT_ABGR: SetLayoutFormat(AbgrLayout(), image); break;
+            case IMAGE_LAYOUT_RGBA: SetLayoutFormat(RgbaLayout(), image); break;
+            case IMAGE_LAYOUT_BGRA: SetLayoutFormat(BgraLayout(), image); break;
+            default: break;
+        }
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetImageView
+   $Prototype: ImageView GetImageView(const Image *image)
+   $Params:
+       image: The image to view
+   $
+   $Description: Returns a view of the pixels of the image. They still
+   belong to the image. An image with masks that aren't one of the
+   compiled layouts has IMAGE_LAYOUT_OTHER, which can't be borrowed. $
+   ======================================================================== */
+ImageView GetImageView(const Image *image)
+{
+    ImageView view;
+
+    view.Pixels = image->Pixels;
+    view.Width = image->Width;
+    view.Height = image->Height;
+    view.Stride = image->Pitch;
+    view.BitsPerPixel = image->BitsPerPixel;
+    view.Layout = (image->BitsPerPixel == 24) ? IMAGE_LAYOUT_ARGB : GetImageLayout(image);
+
+    return view;
+}
+
 /*void PrintPixel(Image *image, int x, int y)
 {
     uint8_t red, green, blue, alpha;
@@ -204,20 +472,487 @@ static int FindLeastSignificantBit(uint32_t num)
     return result;
 }
 
+/* ========================================================================
+   $FUNCTION
+   $Name: CheckBitmapHeader
+   $Prototype: static int CheckBitmapHeader(const BitmapHeader *header, uint64_t file_size)
+   $Params: 
+       header: The header to check
+       file_size: How many bytes the file has.
+   $
+   $Description: Makes sure the bitmap is one we know how to load and that
+   all of its pixels are in the file, so a forged size can't send anything
+   past the end of it. Returns 1 if it is, otherwise it prints why and
+   returns 0. $
+   ======================================================================== */
+static int CheckBitmapHeader(const BitmapHeader *header, uint64_t file_size)
+{
+    // Check the header magic number to make sure its a bitmap.
+    if (header->FileType != 0x4d42)
+    {
+        printf("Error loading bitmap magic number.\n");
+        return 0;
+    }
+
+    // I don't support flipped images right now.
+    if (header->Height < 0)
+    {
+        printf("This bitmap is upside down. Time to implement it.\n");
+        return 0;
+    }
+
+    // 32 bit pixels need their masks (Bit Field compression), 24 bit pixels
+    // are always blue, green and red (no compression).
+    if (header->BitsPerPixel == 32 && header->Compression != 3)
+    {
+        printf("Cannot open a 32 bit bitmap without a Bit Field compression.\n");
+        return 0;
+    }
+
+    if (header->BitsPerPixel == 24 && header->Compression != 0)
+    {
+        printf("Cannot open a compressed 24 bit bitmap.\n");
+        return 0;
+    }
+
+    if (header->BitsPerPixel != 32 && header->BitsPerPixel != 24)
+    {
+        printf("Cannot open a bitmap without 24 or 32 bits per pixel.\n");
+        return 0;
+    }
+
+    // Check the header size for different information.
+    if (header->Size == 12)
+    {
+        printf("Need to implement this bitmap header size...\n");
+        return 0;
+    }
+
+    if (header->Width <= 0 || header->Height == 0)
+    {
+        printf("Cannot open a bitmap without any pixels.\n");
+        return 0;
+    }
+
+    // The pixel count and the pitch are kept in 32 bits.
+    uint64_t pitch = GetImagePitch(header->Width, header->BitsPerPixel);
+
+    if ((uint64_t)header->Width * header->Height > 0xFFFFFFFF || pitch > 0xFFFFFFFF)
+    {
+        printf("Cannot open a bitmap this big.\n");
+        return 0;
+    }
+
+    if (header->BitmapOffset > file_size || pitch * header->Height > file_size - header->BitmapOffset)
+    {
+        printf("Error reading bitmap pixels.\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetBitmapFormat
+   $Prototype: static int SetBitmapFormat(Image *image, const BitmapHeader *header)
+   $Params: 
+       image: The image to fill out. The pixels are left alone.
+       header: The header of the bitmap
+   $
+   $Description: Fills out the size, masks and shifts of the image from the
+   header. Returns 1 if the pixels have to be converted to ARGB, or 0 if
+   they can be used as they are. 24 bit pixels are always used as they
+   are. $
+   ======================================================================== */
+static int SetBitmapFormat(Image *image, const BitmapHeader *header)
+{
+    // Find the pixel masks from the header.
+    uint32_t mask_red = header->RedMask;
+    uint32_t mask_green = header->GreenMask;
+    uint32_t mask_blue = header->BlueMask;
+    uint32_t mask_alpha = ~(mask_red | mask_green | mask_blue);
+
+    image->Width = header->Width;
+    image->Height = header->Height;
+    image->PixelCount = (uint32_t)header->Width * header->Height;
+    image->BitsPerPixel = header->BitsPerPixel;
+    image->Pitch = (uint32_t)GetImagePitch(image->Width, image->BitsPerPixel);
+
+    // The masks of a 24 bit bitmap aren't in the header.
+    if (image->BitsPerPixel == 24)
+    {
+        SetArgbFormat(image);
+        return 0;
+    }
+
+    image->MaskRed = mask_red;
+    image->MaskGreen = mask_green;
+    image->MaskBlue = mask_blue;
+    image->MaskAlpha = mask_alpha;
+
+    // Get the amount of bits to shift each mask. This will be used
+    // when loading bitmaps that have different bits per pixel, such
+    // as 8, 16, and 24.
+    image->ShiftRed = FindLeastSignificantBit(mask_red);
+    image->ShiftGreen = FindLeastSignificantBit(mask_green);
+    image->ShiftBlue = FindLeastSignificantBit(mask_blue);
+    image->ShiftAlpha = FindLeastSignificantBit(mask_alpha);
+
+    // If the pixels are already ARGB the conversion does nothing.
+    return !(mask_red == 0x00FF0000 && mask_green == 0x0000FF00 && mask_blue == 0x000000FF);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetArgbFormat
+   $Prototype: static void SetArgbFormat(Image *image)
+   $Params: 
+       image: The image to set the masks of
+   $
+   $Description: Sets the masks and shifts of the image to ARGB, which is
+   what every image is once it has been loaded. 24 bit images are the same
+   without the alpha. $
+   ======================================================================== */
+static void SetArgbFormat(Image *image)
+{
+    image->MaskRed = ArgbLayout::MaskRed;
+    image->MaskGreen = ArgbLayout::MaskGreen;
+    image->MaskBlue = ArgbLayout::MaskBlue;
+    image->MaskAlpha = ArgbLayout::MaskAlpha;
+
+    image->ShiftRed = ArgbLayout::ShiftRed;
+    image->ShiftGreen = ArgbLayout::ShiftGreen;
+    image->ShiftBlue = ArgbLayout::ShiftBlue;
+    image->ShiftAlpha = ArgbLayout::ShiftAlpha;
+
+    if (image->BitsPerPixel == 24)
+    {
+        image->MaskAlpha = 0;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetLayoutFormat
+   $Prototype: template <typename Layout> static void SetLayoutFormat(Layout layout, Image *image)
+   $Params:
+       layout: The layout to use
+       image: The image to set the masks of
+   $
+   $Description: Sets the masks and shifts of the image to the layout. $
+   ======================================================================== */
+template <typename Layout>
+static void SetLayoutFormat(Layout layout, Image *image)
+{
+    image->MaskRed = layout.MaskRed;
+    image->MaskGreen = layout.MaskGreen;
+    image->MaskBlue = layout.MaskBlue;
+    image->MaskAlpha = layout.MaskAlpha;
+
+    image->ShiftRed = layout.ShiftRed;
+    image->ShiftGreen = layout.ShiftGreen;
+    image->ShiftBlue = layout.ShiftBlue;
+    image->ShiftAlpha = layout.ShiftAlpha;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ConvertBitmapLayout
+   $Prototype: template <typename Layout> static void ConvertBitmapLayout(Layout layout, const uint8_t *source, uint32_t *dest, uint32_t count)
+   $Params: 
+       layout: The layout of the source pixels
+       source: The pixels from the file. They don't have to be aligned.
+       dest: Where to put the ARGB pixels. This can be the same as source.
+       count: How many pixels to convert
+   $
+   $Description: Converts pixels from the layout to ARGB. For the compiled
+   layouts this is just moving whole bytes around. $
+   ======================================================================== */
+template <typename Layout>
+static void ConvertBitmapLayout(Layout layout, const uint8_t *source, uint32_t *dest, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t C;
+
+        // The pixels in the file don't have to be aligned.
+        memcpy(&C, source, sizeof(uint32_t));
+        source += sizeof(uint32_t);
+
+        uint32_t red = (C & layout.MaskRed) >> layout.ShiftRed;
+        uint32_t green = (C & layout.MaskGreen) >> layout.ShiftGreen;
+        uint32_t blue = (C & layout.MaskBlue) >> layout.ShiftBlue;
+        uint32_t alpha = (C & layout.MaskAlpha) >> layout.ShiftAlpha;
+
+        dest[i] = ((alpha << 24) |
+                   (red   << 16) |
+                   (green << 8) |
+                   (blue  << 0));
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetBitmapShuffle
+   $Prototype: static int GetBitmapShuffle(const Image *format, uint8_t *shuffle)
+   $Params: 
+       format: The image holding the masks of the source pixels
+       shuffle: 16 bytes that get filled with which source byte each byte
+                of 4 ARGB pixels comes from.
+   $
+   $Description: Converting between layouts where every channel is a whole
+   byte is only moving bytes around, which one shuffle does for a few
+   pixels at a time. Returns 1 if the layout is like that, otherwise 0 and
+   the template loop has to be used. $
+   ======================================================================== */
+static int GetBitmapShuffle(const Image *format, uint8_t *shuffle)
+{
+    // In the order of the bytes of an ARGB pixel.
+    uint32_t masks[4] = { format->MaskBlue, format->MaskGreen, format->MaskRed, format->MaskAlpha };
+    uint8_t shifts[4] = { format->ShiftBlue, format->ShiftGreen, format->ShiftRed, format->ShiftAlpha };
+
+    for(int channel = 0; channel < 4; channel++)
+    {
+        if (shifts[channel] >= 32 || (shifts[channel] & 7) != 0 ||
+            masks[channel] != (0xFFu << shifts[channel]))
+        {
+            return 0;
+        }
+
+        for(int p = 0; p < 4; p++)
+        {
+            shuffle[(p * 4) + channel] = (p * 4) + (shifts[channel] / 8);
+        }
+    }
+
+    return 1;
+}
+
+#if IMAGE_CONVERT_SIMD
+/* ========================================================================
+   $FUNCTION
+   $Name: ConvertBitmapSSSE3
+   $Prototype: static uint32_t ConvertBitmapSSSE3(const uint8_t *shuffle, const uint8_t *source, uint32_t *dest, uint32_t count)
+   $Params: 
+       shuffle: The shuffle from GetBitmapShuffle
+       source: The pixels from the file. They don't have to be aligned.
+       dest: Where to put the ARGB pixels. This can be the same as source.
+       count: How many pixels to convert
+   $
+   $Description: Converts 4 pixels at a time with one pshufb. Returns how
+   many pixels were converted, the rest are left for the template loop. $
+   ======================================================================== */
+__attribute__((target("ssse3")))
+static uint32_t ConvertBitmapSSSE3(const uint8_t *shuffle, const uint8_t *source, uint32_t *dest, uint32_t count)
+{
+    __m128i control = _mm_loadu_si128((const __m128i*)shuffle);
+    uint32_t i;
+
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(source + (i * 4)));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_shuffle_epi8(pixels, control));
+    }
+
+    return i;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ConvertBitmapAVX2
+   $Prototype: static uint32_t ConvertBitmapAVX2(const uint8_t *shuffle, const uint8_t *source, uint32_t *dest, uint32_t count)
+   $Params: 
+       shuffle: The shuffle from GetBitmapShuffle
+       source: The pixels from the file. They don't have to be aligned.
+       dest: Where to put the ARGB pixels. This can be the same as source.
+       count: How many pixels to convert
+   $
+   $Description: The AVX2 version of ConvertBitmapSSSE3, 16 pixels at a
+   time. The shuffle is the same in both 128 bit lanes. $
+   ======================================================================== */
+__attribute__((target("avx2")))
+static uint32_t ConvertBitmapAVX2(const uint8_t *shuffle, const uint8_t *source, uint32_t *dest, uint32_t count)
+{
+    __m256i control = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)shuffle));
+    uint32_t i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        __m256i first = _mm256_loadu_si256((const __m256i*)(source + (i * 4)));
+        __m256i second = _mm256_loadu_si256((const __m256i*)(source + (i * 4) + 32));
+
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_shuffle_epi8(first, control));
+        _mm256_storeu_si256((__m256i*)(dest + i + 8), _mm256_shuffle_epi8(second, control));
+    }
+
+    return i;
+}
+#endif
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ConvertBitmapJob
+   $Prototype: static void ConvertBitmapJob(void *data, int index)
+   $Params: 
+       data: The ConvertJob
+       index: Which chunk of rows to convert
+   $
+   $Description: Converts one chunk of the pixels with the fastest kernel
+   the CPU has. Whatever the SIMD kernel leaves over is done by the
+   template loop. $
+   ======================================================================== */
+static void ConvertBitmapJob(void *data, int index)
+{
+    ConvertJob *job = (ConvertJob*)data;
+    uint32_t start = index * job->ChunkSize;
+    uint32_t count = job->Count - start;
+    uint32_t done = 0;
+
+    if (count > job->ChunkSize)
+    {
+        count = job->ChunkSize;
+    }
+
+    const uint8_t *source = job->Source + ((size_t)start * sizeof(uint32_t));
+    uint32_t *dest = job->Dest + start;
+
+#if IMAGE_CONVERT_SIMD
+    if (job->Shuffled)
+    {
+        if (__builtin_cpu_supports("avx2"))
+        {
+            done = ConvertBitmapAVX2(job->Shuffle, source, dest, count);
+        }
+        else if (__builtin_cpu_supports("ssse3"))
+        {
+            done = ConvertBitmapSSSE3(job->Shuffle, source, dest, count);
+        }
+    }
+#endif
+
+    source += (size_t)done * sizeof(uint32_t);
+    dest += done;
+    count -= done;
+
+    DISPATCH_PIXEL_LAYOUT(job->Format, ConvertBitmapLayout, source, dest, count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ConvertBitmapPixels
+   $Prototype: static void ConvertBitmapPixels(const Image *format, const uint8_t *source, uint32_t *dest, uint32_t count)
+   $Params: 
+       format: The image holding the masks of the source pixels
+       source: The pixels from the file. They don't have to be aligned.
+       dest: Where to put the ARGB pixels. This can be the same as source.
+       count: How many pixels to convert
+   $
+   $Description: Converts pixels from the bitmap layout to ARGB. Pixels
+   that are already ARGB are just copied. Big images are split into chunks
+   of rows across the image threads. $
+   ======================================================================== */
+static void ConvertBitmapPixels(const Image *format, const uint8_t *source, uint32_t *dest, uint32_t count)
+{
+    TIMED_BLOCK();
+
+    int thread_count = GetImageThreads();
+    uint32_t row = (format->Width > 0) ? format->Width : 1;
+    ConvertJob job;
+
+    if (GetImageLayout(format) == IMAGE_LAYOUT_ARGB)
+    {
+        if ((const uint8_t*)dest != source)
+        {
+            memcpy(dest, source, (size_t)count * sizeof(uint32_t));
+        }
+        return;
+    }
+
+    job.Format = format;
+    job.Source = source;
+    job.Dest = dest;
+    job.Count = count;
+    job.ChunkSize = count;
+    job.Shuffled = GetBitmapShuffle(format, job.Shuffle);
+
+    if (thread_count == 1 || count < IMAGE_PARALLEL_MIN_PIXELS)
+    {
+        ConvertBitmapJob(&job, 0);
+        return;
+    }
+
+    // A few chunks per thread so a slow thread doesn't hold up the rest.
+    uint32_t chunk_count = thread_count * 4;
+
+    job.ChunkSize = (count + chunk_count - 1) / chunk_count;
+    job.ChunkSize = ((job.ChunkSize + row - 1) / row) * row;
+
+    ParallelFor(thread_count, (count + job.ChunkSize - 1) / job.ChunkSize, ConvertBitmapJob, &job);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FillBitmapHeader
+   $Prototype: static void FillBitmapHeader(BitmapHeader *header, const Image *image)
+   $Params: 
+       header: The header to fill out
+       image: The image that is being saved
+   $
+   $Description: Fills out the header that SaveBitmap writes. $
+   ======================================================================== */
+static void FillBitmapHeader(BitmapHeader *header, const Image *image)
+{
+    header->FileType = 0x4d42; // The bitmap magic number
+    header->FileSize = 0;
+    header->Reserved1 = 0;
+    header->Reserved2 = 0;
+    header->BitmapOffset = BITMAP_PIXEL_OFFSET;
+    header->Size = 40;
+    header->Width = image->Width;
+    header->Height = image->Height;
+    header->Planes = 1;
+    header->BitsPerPixel = image->BitsPerPixel;
+    header->Compression = 3; // Compression is Bit Field
+    header->SizeOfBitmap = (size_t)GetImagePitch(image->Width, image->BitsPerPixel) * image->Height;
+    header->HorizontalResolution = 0;
+    header->VerticalResolution = 0;
+    header->ColoursUsed = 0;
+    header->ColoursImportant = 0;
+
+    header->RedMask = image->MaskRed;
+    header->GreenMask = image->MaskGreen;
+    header->BlueMask = image->MaskBlue;
+
+    // 24 bit pixels are always blue, green and red and have no masks.
+    if (image->BitsPerPixel == 24)
+    {
+        header->Compression = 0;
+        header->RedMask = 0;
+        header->GreenMask = 0;
+        header->BlueMask = 0;
+    }
+}
+
 /* ========================================================================
    $FUNCTION
    $Name: LoadBitmap
-   $Prototype: static Image *LoadBitmap(const char *filename)
+   $Prototype: static Image *LoadBitmap(const char *filename, ImageMapMode mode)
    $Params: 
        filename: The file to load
+       mode: How the pixels are mapped if they can be used without converting.
    $
-   $Description: Loads a file into a bitmap type. $
+   $Description: Loads a file into a bitmap type. The file is memory mapped
+   and if its pixels are already in our ARGB layout the image points
+   straight into the mapping. Otherwise the pixels are converted into a new
+   buffer and the file is unmapped. $
    ======================================================================== */
-static Image *LoadBitmap(const char *filename)
+static Image *LoadBitmap(const char *filename, ImageMapMode mode)
 {
 
-    char *buffer;
     int fp;
+    struct stat file_stat;
+    uint8_t *file_data;
     Image *bitmap = 0;
     BitmapHeader header;
 
@@ -228,163 +963,395 @@ static Image *LoadBitmap(const char *filename)
         return 0;
     }
 
-    // Attempt to read the header.
-    if (read(fp, (char*)&header, sizeof(BitmapHeader)) != sizeof(BitmapHeader))
+    if (fstat(fp, &file_stat) != 0 || file_stat.st_size < (off_t)BITMAP_INFO_SIZE)
     {
         printf("Error reading bitmap file header.\n");
+        close(fp);
         return 0;
     }
-    
-    // Check the header magic number to make sure its a bitmap.
-    if (header.FileType != 0x4d42)
+
+    // Map the whole file. A private mapping means anything written to the
+    // pixels never makes it back to the file.
+    file_data = (uint8_t*)mmap(0, file_stat.st_size,
+                               (mode == IMAGE_MAP_READ) ? PROT_READ : (PROT_READ | PROT_WRITE),
+                               MAP_PRIVATE, fp, 0);
+    close(fp);
+
+    if (file_data == MAP_FAILED)
     {
-        printf("Error loading bitmap magic number.\n");
+        printf("Error mapping bitmap file.\n");
+        return 0;
+    }
+
+    // Read the header.
+    memset(&header, 0, sizeof(BitmapHeader));
+    memcpy(&header, file_data, ((size_t)file_stat.st_size < sizeof(BitmapHeader)) ? file_stat.st_size : sizeof(BitmapHeader));
+
+    // This makes sure the whole pixel array is in the file.
+    if (!CheckBitmapHeader(&header, file_stat.st_size))
+    {
+        munmap(file_data, file_stat.st_size);
         return 0;
     }
 
+    size_t pixel_bytes = GetImagePitch(header.Width, header.BitsPerPixel) * header.Height;
 
-    // Set the image pixel data location.
     bitmap = (Image*)malloc(sizeof(Image));
-    bitmap->Pixels = (uint32_t*)malloc(sizeof(uint32_t) * header.Width * header.Height);
-    bitmap->PixelCount = header.Width * header.Height;
-    bitmap->Width = header.Width;
-    bitmap->Height = header.Height;
+    bitmap->Mapping = 0;
+    bitmap->MappingSize = 0;
+    bitmap->ReadOnly = 0;
 
-    // I don't support flipped images right now.
-    if (header.Height < 0)
+    int convert = SetBitmapFormat(bitmap, &header);
+
+    // Use the mapped pixels as they are if they don't need converting.
+    // They have to be 4 byte aligned to be used as uint32_t's.
+    if (!convert && (header.BitmapOffset % sizeof(uint32_t)) == 0)
     {
-        printf("This bitmap is upside down. Time to implement it.\n");
+        bitmap->Pixels = (uint32_t*)(file_data + header.BitmapOffset);
+        bitmap->Mapping = file_data;
+        bitmap->MappingSize = file_stat.st_size;
+        bitmap->ReadOnly = (mode == IMAGE_MAP_READ);
+    }
+    else if (!convert)
+    {
+        // Usually a 24 bit bitmap with the pixels right after a 54 byte
+        // header. They only need to be moved somewhere aligned.
+        bitmap->Pixels = (uint32_t*)AllocateMemory(MEMORY_IMAGE, pixel_bytes);
+        memcpy(bitmap->Pixels, file_data + header.BitmapOffset, pixel_bytes);
+
+        munmap(file_data, file_stat.st_size);
+    }
+    else
+    {
+        Image source = *bitmap;
+
+        // Loop through each pixel and put it into our image. From here on
+        // the masks have to describe the converted pixels.
+        bitmap->Pixels = (uint32_t*)AllocateMemory(MEMORY_IMAGE, sizeof(uint32_t) * bitmap->PixelCount);
+        ConvertBitmapPixels(&source, file_data + header.BitmapOffset, bitmap->Pixels, bitmap->PixelCount);
+        SetArgbFormat(bitmap);
+
+        // The pixels have been copied out so the file isn't needed anymore.
+        munmap(file_data, file_stat.st_size);
+    }
+
+    // FlipVertical(bitmap);
+
+    return bitmap;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: OpenBitmapStream
+   $Prototype: BitmapStream *OpenBitmapStream(const char *filename)
+   $Params: 
+       filename: The bitmap to read
+   $
+   $Description: Opens a bitmap so its pixels can be read a strip at a
+   time with ReadBitmapStrip. Only the header is read here. $
+   ======================================================================== */
+BitmapStream *OpenBitmapStream(const char *filename)
+{
+    BitmapStream *stream;
+    BitmapHeader header;
+    struct stat file_stat;
+    int fp;
+
+    if ((fp = open(filename, O_RDONLY)) < 0)
+    {
+        printf("Error opening file.\n");
         return 0;
     }
 
-    // I don't support bitmaps that don't have 32 bit pixels.
-    if (header.BitsPerPixel != 32)
+    memset(&header, 0, sizeof(BitmapHeader));
+
+    if (read(fp, &header, sizeof(BitmapHeader)) < (ssize_t)BITMAP_INFO_SIZE)
     {
-        printf("Cannot open a bitmap without 32 bits per pixel.\n");
+        printf("Error reading bitmap file header.\n");
+        close(fp);
         return 0;
     }
 
-    // The compression type needs to be Bit Field.
-    if (header.Compression != 3)
+    // Something that isn't a file, like a pipe, can't be measured. A short
+    // one is found when its strips are read.
+    if (fstat(fp, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
     {
-        printf("Cannot open a bitmap without a Bit Field compression.\n");
+        file_stat.st_size = INT64_MAX;
+    }
+
+    if (!CheckBitmapHeader(&header, file_stat.st_size))
+    {
+        close(fp);
         return 0;
     }
 
-    // Check the header size for different information.
-    if (header.Size == 12)
+    stream = (BitmapStream*)malloc(sizeof(BitmapStream));
+    stream->File = fp;
+    stream->PixelOffset = header.BitmapOffset;
+    stream->PixelsDone = 0;
+    stream->Convert = SetBitmapFormat(&stream->Format, &header);
+
+    stream->Format.Pixels = 0;
+    stream->Format.Mapping = 0;
+    stream->Format.MappingSize = 0;
+    stream->Format.ReadOnly = 0;
+
+    // The strips are read as ARGB, the file's masks are only needed to
+    // convert them.
+    stream->Source = stream->Format;
+    SetArgbFormat(&stream->Format);
+
+    // The stream only reads forward from here.
+    posix_fadvise(fp, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return stream;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CreateBitmapStream
+   $Prototype: BitmapStream *CreateBitmapStream(const char *filename, const Image *format)
+   $Params: 
+       filename: The bitmap to create
+       format: The image with the size and masks of the bitmap. Its pixels
+               aren't used.
+   $
+   $Description: Creates a bitmap and writes its header so the pixels can
+   be written a strip at a time with WriteBitmapStrip. The file is the same
+   as what SaveBitmap writes. $
+   ======================================================================== */
+BitmapStream *CreateBitmapStream(const char *filename, const Image *format)
+{
+    BitmapStream *stream;
+    BitmapHeader header;
+    char padding[BITMAP_PIXEL_OFFSET];
+    int fp;
+
+    if ((fp = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
     {
-        printf("Need to implement this bitmap header size...\n");
+        printf("Error creating save file.\n");
         return 0;
     }
-    else
+
+    // Write the header with the padding before the pixels zeroed.
+    FillBitmapHeader(&header, format);
+    memset(padding, 0, BITMAP_PIXEL_OFFSET);
+    memcpy(padding, &header, sizeof(BitmapHeader));
+
+    if (write(fp, padding, BITMAP_PIXEL_OFFSET) != BITMAP_PIXEL_OFFSET)
     {
-        // Seek to the start of the data array
-        lseek(fp, header.BitmapOffset, SEEK_SET);
+        printf("Error writing bitmap header.\n");
+        close(fp);
+        return 0;
     }
 
-    // Allocate size for the bitmap.
-    buffer = (char*)malloc(header.BitsPerPixel * header.Width * header.Height);
+    stream = (BitmapStream*)malloc(sizeof(BitmapStream));
+    memcpy(&stream->Format, format, sizeof(Image));
+    stream->File = fp;
+    stream->PixelOffset = BITMAP_PIXEL_OFFSET;
+    stream->PixelsDone = 0;
+    stream->Convert = 0;
+
+    stream->Format.Pixels = 0;
+    stream->Format.Mapping = 0;
+    stream->Format.MappingSize = 0;
+    stream->Format.ReadOnly = 0;
+    stream->Source = stream->Format;
 
-    int bytes_read = 0;
-    int n = 1;
-    int bytes_left = (header.BitsPerPixel / 8) * header.Width * header.Height;
+    return stream;
+}
 
-    // Read the whole file into the buffer.
-    while(n > 0)
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStripBytes
+   $Prototype: static size_t GetStripBytes(const Image *format, uint32_t pixel_count)
+   $Params: 
+       format: The image that is being streamed
+       pixel_count: How many pixels. For 24 bit images this has to be
+                    whole rows.
+   $
+   $Description: Returns how many bytes the pixels take in the file. $
+   ======================================================================== */
+static size_t GetStripBytes(const Image *format, uint32_t pixel_count)
+{
+    if (format->BitsPerPixel == 24)
     {
-        n = read(fp, buffer + bytes_read, bytes_left);
-        bytes_read += n;
+        return (size_t)(pixel_count / format->Width) * format->Pitch;
     }
 
-    // printf("bytes read: %d\n", bytes_read);
-    // printf("pixel size: %d\n", bitmap->PixelCount * 4);
-
-    // Find the pixel masks from the header.
-    uint32_t mask_red = header.RedMask;
-    uint32_t mask_green = header.GreenMask;
-    uint32_t mask_blue = header.BlueMask;
-    uint32_t mask_alpha = ~(mask_red | mask_green | mask_blue);
+    return (size_t)pixel_count * sizeof(uint32_t);
+}
 
-    // Get the amount of bits to shift each mask. This will be used
-    // when loading bitmaps that have different bits per pixel, such
-    // as 8, 16, and 24.
-    uint32_t shift_red = FindLeastSignificantBit(mask_red);
-    uint32_t shift_green = FindLeastSignificantBit(mask_green);
-    uint32_t shift_blue = FindLeastSignificantBit(mask_blue);
-    uint32_t shift_alpha = FindLeastSignificantBit(mask_alpha);
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStripPixels
+   $Prototype: static uint32_t GetStripPixels(const Image *format, size_t bytes)
+   $Params: 
+       format: The image that is being streamed
+       bytes: How many bytes of the file
+   $
+   $Description: Returns how many whole pixels are in the bytes. For 24
+   bit images this is whole rows. $
+   ======================================================================== */
+static uint32_t GetStripPixels(const Image *format, size_t bytes)
+{
+    if (format->BitsPerPixel == 24)
+    {
+        return (uint32_t)(bytes / format->Pitch) * format->Width;
+    }
 
-    // float max = 255.0f;
-    // float invmax = 1.0f / max;
+    return (uint32_t)(bytes / sizeof(uint32_t));
+}
 
-    // Calculate the pitch or how many bytes per horizontal line.
-    // uint32_t pitch = header.Width * (header.BitsPerPixel / 8);
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadBitmapStrip
+   $Prototype: uint32_t ReadBitmapStrip(BitmapStream *stream, uint32_t *pixels, uint32_t pixel_count)
+   $Params: 
+       stream: The stream to read from
+       pixels: Where to put the pixels
+       pixel_count: How many pixels to read. 24 bit bitmaps are read in
+                    whole rows, with their padding.
+   $
+   $Description: Reads the next pixels of the bitmap in ARGB, the same as
+   LoadImage would give. Returns how many pixels were read, which is less
+   than asked for at the end of the image or if the file is short. $
+   ======================================================================== */
+uint32_t ReadBitmapStrip(BitmapStream *stream, uint32_t *pixels, uint32_t pixel_count)
+{
+    size_t bytes_read = 0;
+    size_t bytes_left;
+    off_t offset = stream->PixelOffset + (off_t)GetStripBytes(&stream->Format, stream->PixelsDone);
 
-    // Loop through each pixel and put it into our image.
-    uint32_t *source = (uint32_t*)buffer;
-    uint32_t *dest = bitmap->Pixels;
-    for(int y = 0; y < header.Height; y++)
+    if (pixel_count > stream->Format.PixelCount - stream->PixelsDone)
     {
+        pixel_count = stream->Format.PixelCount - stream->PixelsDone;
+    }
 
-        // The image is upside down to SDL so we need to start from the bottom and go to the top.
-        // uint32_t *dest = (uint32_t*)((uint8_t*)bitmap->Pixels + (pitch * y));
+    bytes_left = GetStripBytes(&stream->Format, pixel_count);
 
-        for(int x = 0; x < header.Width; x++)
+    while (bytes_read < bytes_left)
+    {
+        ssize_t n = pread(stream->File, (uint8_t*)pixels + bytes_read, bytes_left - bytes_read, offset + bytes_read);
+
+        if (n <= 0)
         {
+            break;
+        }
+
+        bytes_read += n;
+    }
+
+    pixel_count = GetStripPixels(&stream->Format, bytes_read);
+
+    // The conversion works in place.
+    if (stream->Convert)
+    {
+        ConvertBitmapPixels(&stream->Source, (uint8_t*)pixels, pixels, pixel_count);
+    }
 
-            uint32_t C = *source++;
-
-            // Get the RGBA values.
-            float red = (C & mask_red) >> shift_red;
-            float green = (C & mask_green) >> shift_green;
-            float blue = (C & mask_blue) >> shift_blue;
-            float alpha = (C & mask_alpha) >> shift_alpha;
-
-/*
-// We can use the following code to convert from non-32 bit bitmaps
-// to 32 bit.
-// Convert to proper ARGB values
-red = SQUARE(invmax * red);
-green = SQUARE(invmax * green);
-blue = SQUARE(invmax * blue);
-alpha = invmax * alpha;
-
-red *= alpha;
-green *= alpha;
-blue *= alpha;
-
-red = max * SQUAREROOT(red);
-green = max * SQUAREROOT(green);
-blue = max * SQUAREROOT(blue);
-alpha = max * alpha;
-*/
-
-            // Set the pixel in the correct buffer with the RGBA values rounded up.
-            *dest++ = (((uint32_t)(alpha + 0.5f) << 24) |
-                       ((uint32_t)(red   + 0.5f) << 16) |
-                       ((uint32_t)(green + 0.5f) << 8) |
-                       ((uint32_t)(blue  + 0.5f) << 0));
+    stream->PixelsDone += pixel_count;
 
+    return pixel_count;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteBitmapStrip
+   $Prototype: int WriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_count)
+   $Params: 
+       stream: The stream to write to
+       pixels: The next pixels of the image
+       pixel_count: How many pixels to write. 24 bit bitmaps are written
+                    in whole rows, with their padding.
+   $
+   $Description: Writes the next pixels of the bitmap. Returns 0 on success
+   and 1 if the write failed. $
+   ======================================================================== */
+int WriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_count)
+{
+    size_t bytes_written = 0;
+    size_t bytes_left = GetStripBytes(&stream->Format, pixel_count);
+
+    while (bytes_written < bytes_left)
+    {
+        ssize_t n = write(stream->File, (const uint8_t*)pixels + bytes_written, bytes_left - bytes_written);
+
+        if (n <= 0)
+        {
+            printf("Error writing bitmap pixels.\n");
+            return 1;
         }
 
+        bytes_written += n;
     }
 
-    // Fill out the rest of the data in the image struct.
-    bitmap->BitsPerPixel = 32;
+    stream->PixelsDone += pixel_count;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RewriteBitmapStrip
+   $Prototype: int RewriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_start, uint32_t pixel_count)
+   $Params: 
+       stream: The stream to write to
+       pixels: The new pixels
+       pixel_start: The first pixel to write over. 24 bit bitmaps are
+                    written in whole rows, so it has to start a row.
+       pixel_count: How many pixels to write over.
+   $
+   $Description: Writes over pixels that were already written with
+   WriteBitmapStrip, for when they aren't known until later. Returns 0 on
+   success and 1 if the write failed. $
+   ======================================================================== */
+int RewriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_start, uint32_t pixel_count)
+{
+    size_t bytes_written = 0;
+    size_t bytes_left = GetStripBytes(&stream->Format, pixel_count);
+    off_t offset = stream->PixelOffset + (off_t)GetStripBytes(&stream->Format, pixel_start);
 
-    bitmap->MaskRed = mask_red;
-    bitmap->MaskGreen = mask_green;
-    bitmap->MaskBlue = mask_blue;
-    bitmap->MaskAlpha = mask_alpha;
+    if (pixel_start + pixel_count > stream->PixelsDone)
+    {
+        printf("Error writing bitmap pixels.\n");
+        return 1;
+    }
 
-    bitmap->ShiftRed = shift_red;
-    bitmap->ShiftGreen = shift_green;
-    bitmap->ShiftBlue = shift_blue;
-    bitmap->ShiftAlpha = shift_alpha;
+    while (bytes_written < bytes_left)
+    {
+        ssize_t n = pwrite(stream->File, (const uint8_t*)pixels + bytes_written, bytes_left - bytes_written, offset + bytes_written);
 
-    // FlipVertical(bitmap);
+        if (n <= 0)
+        {
+            printf("Error writing bitmap pixels.\n");
+            return 1;
+        }
 
-    return bitmap;
+        bytes_written += n;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CloseBitmapStream
+   $Prototype: void CloseBitmapStream(BitmapStream *stream)
+   $Params: 
+       stream: The stream to close
+   $
+   $Description: Closes the file and frees the stream. $
+   ======================================================================== */
+void CloseBitmapStream(BitmapStream *stream)
+{
+    if (stream == 0)
+    {
+        return;
+    }
+
+    close(stream->File);
+    free(stream);
 }
 
 /* ========================================================================
@@ -395,59 +1362,121 @@ alpha = max * alpha;
        filename: The filename to save to
        image: The image to save
    $
-   $Description: Saves the image as a bitmap. $
+   $Description: Saves the image as a bitmap. The pixels are written
+   straight from the image after the header, a row at a time if there are
+   gaps between its rows. Returns 0 on success and 1 if the file can't be
+   written. $
    ======================================================================== */
 int SaveBitmap(const char *filename, const Image *image)
 {
-    
+    TIMED_BLOCK();
+
     BitmapHeader header;
+    uint8_t padding[BITMAP_PIXEL_OFFSET];
     int fp;
-    char *buffer;
-    int bytes_written;
-    int buffer_len;
+    uint32_t row_bytes = (uint32_t)GetImagePitch(image->Width, image->BitsPerPixel);
+    uint32_t rows = image->Height;
     
-    // Fill out the bitmap header
-    header.FileType = 0x4d42; // The bitmap magic number
-    header.FileSize = 0;
-    header.Reserved1 = 0;
-    header.Reserved2 = 0;
-    header.BitmapOffset = sizeof(BitmapHeader);
-    header.Size = 40;
-    header.Width = image->Width;
-    header.Height = image->Height;
-    header.Planes = 1;
-    header.BitsPerPixel = image->BitsPerPixel;
-    header.Compression = 3; // Compression is Bit Field
-    header.SizeOfBitmap = image->PixelCount * image->BitsPerPixel / 8;
-    header.HorizontalResolution = 0;
-    header.VerticalResolution = 0;
-    header.ColoursUsed = 0;
-    header.ColoursImportant = 0;
-
-    header.RedMask = image->MaskRed;
-    header.GreenMask = image->MaskGreen;
-    header.BlueMask = image->MaskBlue;
-    
-    if ((fp = open(filename, O_WRONLY | O_CREAT, 0666)) < 0)
+    // Packed rows are written in one go.
+    if (image->Pitch == row_bytes)
+    {
+        row_bytes *= rows;
+        rows = (rows > 0) ? 1 : 0;
+    }
+
+
+    if ((fp = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
     {
         printf("Error creating save file.\n");
         return 1;
     }
 
-    // Create the buffer to store the data.
-    buffer_len = sizeof(BitmapHeader) + (image->PixelCount * image->BitsPerPixel / 8);
-    buffer = (char*)malloc(buffer_len);
+    // Write the header with the padding before the pixels zeroed.
+    FillBitmapHeader(&header, image);
+    memset(padding, 0, BITMAP_PIXEL_OFFSET);
+    memcpy(padding, &header, sizeof(BitmapHeader));
 
-    // Put the data in the buffer.
-    memcpy(buffer, &header, sizeof(BitmapHeader));
-    memcpy(buffer + sizeof(BitmapHeader), image->Pixels, image->PixelCount * image->BitsPerPixel / 8);
-    
-    // Write the buffer to the file.
-    bytes_written = 0;
-    while (bytes_written < buffer_len)
+    if (write(fp, padding, BITMAP_PIXEL_OFFSET) != BITMAP_PIXEL_OFFSET)
     {
-        bytes_written += write(fp, buffer + bytes_written, buffer_len - bytes_written);
+        printf("Error writing bitmap header.\n");
+        close(fp);
+        return 1;
     }
-    
+
+    for(uint32_t y = 0; y < rows; y++)
+    {
+        const uint8_t *row = (const uint8_t*)GetImageRow(image, y);
+        size_t bytes_written = 0;
+
+        while (bytes_written < row_bytes)
+        {
+            ssize_t n = write(fp, row + bytes_written, row_bytes - bytes_written);
+
+            if (n <= 0)
+            {
+                printf("Error writing bitmap pixels.\n");
+                close(fp);
+                return 1;
+            }
+
+            bytes_written += n;
+        }
+    }
+
+    close(fp);
+
     return 0;
 }
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetImageThreads
+   $Prototype: void SetImageThreads(int thread_count)
+   $Params: 
+       thread_count: How many threads to use, 0 uses one per processor.
+   $
+   $Description: Sets how many threads convert the pixels of the bitmaps
+   that are loaded. $
+   ======================================================================== */
+void SetImageThreads(int thread_count)
+{
+    image_threads = (thread_count < 0) ? 1 : thread_count;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetImageJobThreads
+   $Prototype: int SetImageJobThreads(int thread_count)
+   $Params: 
+       thread_count: How many threads to use, 0 goes back to what
+                     SetImageThreads set.
+   $
+   $Description: Sets how many threads convert the bitmaps loaded on the
+   calling thread, like SetStegoJobThreads. Returns what it was. $
+   ======================================================================== */
+int SetImageJobThreads(int thread_count)
+{
+    int previous = image_job_threads;
+
+    image_job_threads = (thread_count < 0) ? 1 : thread_count;
+
+    return previous;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetImageThreads
+   $Prototype: int GetImageThreads()
+   $Params: $
+   $Description: Returns how many threads convert the pixels of bitmaps
+   loaded on the calling thread. $
+   ======================================================================== */
+int GetImageThreads()
+{
+    if (image_job_threads > 0)
+    {
+        return image_job_threads;
+    }
+
+    return (image_threads > 0) ? image_threads : GetProcessorCount();
+}
@@ -12,12 +12,27 @@
 #define IMAGE_H
 
 #include <math.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define SQUARE(a) ((a)*(a))
 #define SQUAREROOT(a) (sqrtf(a))
 #define GETPIXEL(x,y,width) (((y)*(width))+(x))
 
+// The layouts with their own compiled loops (see pixel_layout.h), named
+// from the most significant byte of the pixel. ARGB is what images are
+// loaded as.
+enum ImageLayout
+{
+    IMAGE_LAYOUT_ARGB,
+    IMAGE_LAYOUT_ABGR,
+    IMAGE_LAYOUT_RGBA,
+    IMAGE_LAYOUT_BGRA,
+
+    // Any other masks, including channels that aren't 8 bits.
+    IMAGE_LAYOUT_OTHER,
+};
+
 // The internal Image structure that our program will know how to
 // use. When an image is loaded into the program they will all get
 // converted to this.
@@ -33,6 +48,11 @@ struct Image
 
     uint32_t BitsPerPixel;
 
+    // How many bytes each row of pixels takes. Rows of 24 bit pixels are
+    // padded to 4 bytes, the same as in the file. The rows of an image
+    // borrowed from an ImageView can take more than their pixels.
+    uint32_t Pitch;
+
     // Masking
     uint32_t MaskRed;
     uint32_t MaskGreen;
@@ -44,27 +64,205 @@ struct Image
     uint8_t ShiftGreen;
     uint8_t ShiftBlue;
     uint8_t ShiftAlpha;
+
+    // If the pixels point into a memory mapped file this is the mapping,
+    // otherwise it is 0 and the pixels came from the memory pool (or
+    // belong to the view the image borrows them from).
+    void *Mapping;
+    size_t MappingSize;
+
+    // Set when the pixels can't be written to.
+    uint8_t ReadOnly;
+};
+
+// How LoadImageMapped maps the pixels of a file that doesn't need to be
+// converted.
+enum ImageMapMode
+{
+    // The pixels are read only. Use this for decoding.
+    IMAGE_MAP_READ,
+
+    // The pixels are copy on write, changes never reach the file.
+    IMAGE_MAP_PRIVATE,
+};
+
+// Pixels that are owned by something else, like an SDL surface or a
+// decoded video frame. Stride is how many bytes each row takes, which can
+// be more than its pixels. 32 bit pixels have the Layout, which can't be
+// IMAGE_LAYOUT_OTHER, and 24 bit pixels are always blue, green then red.
+// The pixels and the stride have to be 4 byte aligned.
+struct ImageView
+{
+    void *Pixels;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    uint32_t BitsPerPixel;
+    ImageLayout Layout;
+};
+
+// Reads or writes the pixels of a bitmap file a strip at a time, so the
+// whole image never has to be in memory.
+struct BitmapStream
+{
+    int File;
+
+    // The size, masks and shifts of the strips. There are no pixels.
+    Image Format;
+
+    // The masks and shifts of the pixels in the file. This is only
+    // different to Format when they are converted.
+    Image Source;
+
+    // Where the pixels start in the file and how many have been
+    // read or written so far.
+    uint32_t PixelOffset;
+    uint32_t PixelsDone;
+
+    // Set when the pixels in the file have to be converted to ARGB.
+    uint8_t Convert;
 };
 
-// Returns the pixel from the image.
+// Returns how many bytes a row of pixels takes, padded to 4 bytes. It is
+// worked out in 64 bits so a width from a file can't wrap it around.
+inline uint64_t GetImagePitch(uint32_t width, uint32_t bits_per_pixel)
+{
+    return (((uint64_t)width * (bits_per_pixel / 8)) + 3) & ~(uint64_t)3;
+}
+
+// Returns 1 if the pixels are one array of 32 bit pixels. 24 bit images
+// and the ones with gaps between their rows have to be gone through a
+// row at a time.
+inline int IsImageContiguous(const Image *image)
+{
+    return (image->BitsPerPixel == 32 && image->Pitch == image->Width * sizeof(uint32_t));
+}
+
+// Returns how many bytes the pixels of the image take.
+inline size_t GetImageSize(const Image *image)
+{
+    if (!IsImageContiguous(image))
+    {
+        return (size_t)image->Pitch * image->Height;
+    }
+
+    return (size_t)image->PixelCount * (image->BitsPerPixel / 8);
+}
+
+// Returns the first pixel of a row.
+inline uint32_t *GetImageRow(const Image *image, uint32_t y)
+{
+    return (uint32_t*)((uint8_t*)image->Pixels + ((size_t)y * image->Pitch));
+}
+
+// Returns the pixel from the image. This only works on 32 bit images.
 inline uint32_t GetPixel(Image *image, int x, int y)
 {
-    return image->Pixels[(y * image->Width) + x];
+    return GetImageRow(image, y)[x];
 }
 
 // Sets the pixel in an image
 inline void SetPixel(Image *image, int x, int y, uint32_t value)
 {
-    image->Pixels[(y * image->Width) + x] = value;
+    GetImageRow(image, y)[x] = value;
 }
 
 
 Image *CreateImage(const int width, const int height, const int bpp);
 Image *CreateRandomImage(const int width, const int height, const int bpp);
 Image *CopyImage(Image *image);
+Image *CopyImage(const ImageView *view);
+void FreeImage(Image *image);
+
+// An image that borrows the pixels of the view is never freed, it only
+// lives as long as the view. BorrowImageView returns 0 on success and -1
+// if the view can't be used.
+int BorrowImageView(const ImageView *view, Image *image);
+ImageView GetImageView(const Image *image);
 Image *LoadImage(const char *filename);
+Image *LoadImageMapped(const char *filename, ImageMapMode mode);
 void PrintPixel(Image *image, int x, int y);
 
 int SaveBitmap(const char *filename, const Image *image);
 
+BitmapStream *OpenBitmapStream(const char *filename);
+BitmapStream *CreateBitmapStream(const char *filename, const Image *format);
+uint32_t ReadBitmapStrip(BitmapStream *stream, uint32_t *pixels, uint32_t pixel_count);
+int WriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_count);
+int RewriteBitmapStrip(BitmapStream *stream, const uint32_t *pixels, uint32_t pixel_start, uint32_t pixel_count);
+void CloseBitmapStream(BitmapStream *stream);
+
+void SetImageThreads(int thread_count);
+int GetImageThreads();
+int SetImageJobThreads(int thread_count);
+
+// Owns an image and frees it when it goes out of scope. It can be moved
+// but not copied, so there is only ever one owner of the pixels.
+struct OwnedImage
+{
+    Image *Pointer;
+
+    OwnedImage() : Pointer(0)
+    {
+    }
+
+    explicit OwnedImage(Image *image) : Pointer(image)
+    {
+    }
+
+    OwnedImage(OwnedImage &&other) : Pointer(other.Pointer)
+    {
+        other.Pointer = 0;
+    }
+
+    OwnedImage &operator=(OwnedImage &&other)
+    {
+        if (this != &other)
+        {
+            FreeImage(Pointer);
+            Pointer = other.Pointer;
+            other.Pointer = 0;
+        }
+
+        return *this;
+    }
+
+    OwnedImage(const OwnedImage &other) = delete;
+    OwnedImage &operator=(const OwnedImage &other) = delete;
+
+    ~OwnedImage()
+    {
+        FreeImage(Pointer);
+    }
+
+    Image *Get() const
+    {
+        return Pointer;
+    }
+
+    // Gives up the image without freeing it.
+    Image *Release()
+    {
+        Image *image = Pointer;
+
+        Pointer = 0;
+        return image;
+    }
+
+    ImageView View() const
+    {
+        return GetImageView(Pointer);
+    }
+
+    Image *operator->() const
+    {
+        return Pointer;
+    }
+
+    explicit operator bool() const
+    {
+        return Pointer != 0;
+    }
+};
+
 #endif
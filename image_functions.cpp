@@ -5,70 +5,96 @@
    $Developer: Jordan Marling $
    $Created On: 2015/09/24 $
    $Functions: $
-   $Description: These are image manipulation functions. $
+   $Description: These are image manipulation functions. 24 bit images are
+   packed blue, green and red bytes with padded rows, so they have their
+   own loops. Every function also takes an ImageView, which borrows the
+   pixels where they are. $
    $Revisions: $
    ======================================================================== */
 
-#include <mmintrin.h>
+#include <emmintrin.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "allocator.h"
 #include "image.h"
-#include "timer.h"
+#include "image_functions.h"
+#include "pixel_layout.h"
+#include "profiler.h"
 
-// Remove the TIMED_BLOCK macro because we don't want to ouput the times of these functions
-#ifdef TIMED_BLOCK
-#undef TIMED_BLOCK
-#endif
-#define TIMED_BLOCK()
-
-#if IMAGE_FUNCTIONS_SSE
 /* ========================================================================
    $FUNCTION
-   $Name: NegateImage
-   $Prototype: void NegateImage(Image *image)
+   $Name: NegateLayout
+   $Prototype: template <typename Layout> static void NegateLayout(Layout layout, Image *image)
    $Params: 
+       layout: The channel layout of the image
        image: The image to negate
    $
-   $Description: Turns black to white and white to black. This is the SSE version. $
+   $Description: Negates the RGB values of every pixel. 255 - value is the
+   same as flipping every bit of the channel, so this is one xor per pixel
+   and the alpha is left alone. With IMAGE_FUNCTIONS_SSE the xor is done
+   on groups of 4 pixels and the rest of the row is done one at a time. $
    ======================================================================== */
-void NegateImage(Image *image)
+template <typename Layout>
+static void NegateLayout(Layout layout, Image *image)
 {
-    TIMED_BLOCK();
+    // Packed pixels are gone through as one long row.
+    uint32_t rows = IsImageContiguous(image) ? 1 : image->Height;
+    uint32_t count = IsImageContiguous(image) ? image->PixelCount : image->Width;
 
     // Set the mask of the RGB values.
-    uint32_t high_value = ((0xFF << image->ShiftRed) |
-                           (0xFF << image->ShiftGreen) |
-                           (0xFF << image->ShiftBlue) |
-                           (0x00 << image->ShiftAlpha));
-
-    // Set the mask of the alpha value
-    uint32_t alpha_value = (0xFF << image->ShiftAlpha);
-
-    // Set the values of the 128 bit registers.
-    __m128i alpha_mask = _mm_set_epi32(alpha_value, alpha_value, alpha_value, alpha_value);
-    __m128i high = _mm_set_epi32(high_value, high_value, high_value, high_value);
-    __m128i values;
-    __m128i output;
-
-    // Loop through each group of 4 pixels.
-    for(uint32_t i = 0; i < image->PixelCount; i += 4)
+    uint32_t colour_mask = layout.MaskRed | layout.MaskGreen | layout.MaskBlue;
+
+#if IMAGE_FUNCTIONS_SSE
+    __m128i colour = _mm_set1_epi32((int)colour_mask);
+#endif
+
+    for(uint32_t y = 0; y < rows; y++)
     {
+        uint32_t *pixels = GetImageRow(image, y);
+        uint32_t i = 0;
 
-        // Load group of pixels
-        values = _mm_load_si128((__m128i*)(image->Pixels + i));
+#if IMAGE_FUNCTIONS_SSE
+        // Loop through each group of 4 pixels. Rows of views don't have to
+        // be aligned, so these are unaligned loads and stores.
+        for(; i + 4 <= count; i += 4)
+        {
+            __m128i values = _mm_loadu_si128((__m128i*)(pixels + i));
+            _mm_storeu_si128((__m128i*)(pixels + i), _mm_xor_si128(values, colour));
+        }
+#endif
 
-        // Subtract 255 from each RGB value.
-        output = _mm_sub_epi8(high, values);
+        // Loop through each pixel that is left.
+        for(; i < count; i++)
+        {
+            pixels[i] ^= colour_mask;
+        }
+    }
+}
 
-        // Make sure the alpha is still there.
-        output = _mm_or_si128(output, alpha_mask);
+/* ========================================================================
+   $FUNCTION
+   $Name: NegatePacked
+   $Prototype: static void NegatePacked(Image *image)
+   $Params: 
+       image: The 24 bit image to negate
+   $
+   $Description: Negates every byte of each row, leaving the padding. $
+   ======================================================================== */
+static void NegatePacked(Image *image)
+{
+    for(uint32_t y = 0; y < image->Height; y++)
+    {
+        uint8_t *row = (uint8_t*)image->Pixels + ((size_t)y * image->Pitch);
 
-        // Store the value back in the pixel array.
-        _mm_storeu_si128((__m128i*)(image->Pixels + i), output);
+        for(uint32_t i = 0; i < image->Width * 3; i++)
+        {
+            row[i] ^= 0xFF;
+        }
     }
 }
-#else
+
 /* ========================================================================
    $FUNCTION
    $Name: NegateImage
@@ -82,32 +108,14 @@ void NegateImage(Image *image)
 {
     TIMED_BLOCK();
 
-    uint8_t red, green, blue, alpha;
-
-    // Loop through each pixel.
-    for(uint32_t i = 0; i < image->PixelCount; i++)
+    if (image->BitsPerPixel == 24)
     {
-
-        // Get each of the RGBA values from the pixel
-        red = (image->Pixels[i] & image->MaskRed) >> image->ShiftRed;
-        green = (image->Pixels[i] & image->MaskGreen) >> image->ShiftGreen;
-        blue = (image->Pixels[i] & image->MaskBlue) >> image->ShiftBlue;
-        alpha = (image->Pixels[i] & image->MaskAlpha) >> image->ShiftAlpha;
-
-        // Set each of the RGB values to be the negative of itself.
-        red = 255 - red;
-        green = 255 - green;
-        blue = 255 - blue;
-
-        // Set the pixel data.
-        image->Pixels[i] = ((red << image->ShiftRed) |
-                            (green << image->ShiftGreen) |
-                            (blue << image->ShiftBlue) |
-                            (alpha << image->ShiftAlpha));
-
+        NegatePacked(image);
+        return;
     }
+
+    DISPATCH_PIXEL_LAYOUT(image, NegateLayout, image);
 }
-#endif
 
 
 /* ========================================================================
@@ -143,7 +151,7 @@ Image *Scale(Image *image, float percent_width, float percent_height)
     new_image->ShiftAlpha = image->ShiftAlpha;
 
     // Set the new image to be transparent.
-    memset(new_image->Pixels, 0, new_image->Width * new_image->Height * new_image->BitsPerPixel / 8);
+    memset(new_image->Pixels, 0, GetImageSize(new_image));
 
     // Get the ratio of the new image and the old image.
     // +1 at the end deals with rounding issues.
@@ -161,13 +169,102 @@ Image *Scale(Image *image, float percent_width, float percent_height)
             int y2 = ((y * y_rat) >> 16);
 
             // Set the pixel data to be the same as the old pixel.
-            SetPixel(new_image, x, y, GetPixel(image, x2, y2));
+            if (image->BitsPerPixel == 24)
+            {
+                memcpy((uint8_t*)new_image->Pixels + ((size_t)y * new_image->Pitch) + (x * 3),
+                       (uint8_t*)image->Pixels + ((size_t)y2 * image->Pitch) + (x2 * 3), 3);
+            }
+            else
+            {
+                SetPixel(new_image, x, y, GetPixel(image, x2, y2));
+            }
         }
     }
 
     return new_image;
 }
 
+/* ========================================================================
+   $FUNCTION
+   $Name: BasicGrayscaleLayout
+   $Prototype: template <typename Layout> static void BasicGrayscaleLayout(Layout layout, Image *image)
+   $Params: 
+       layout: The channel layout of the image
+       image: The image to grayscale
+   $
+   $Description: Sets the RGB values of every pixel to their average. $
+   ======================================================================== */
+template <typename Layout>
+static void BasicGrayscaleLayout(Layout layout, Image *image)
+{
+    // Packed pixels are gone through as one long row.
+    uint32_t rows = IsImageContiguous(image) ? 1 : image->Height;
+    uint32_t count = IsImageContiguous(image) ? image->PixelCount : image->Width;
+
+    uint8_t red, green, blue, average;
+    uint32_t alpha;
+
+    for(uint32_t y = 0; y < rows; y++)
+    {
+        uint32_t *pixels = GetImageRow(image, y);
+
+        // Loop through each pixel.
+        for(uint32_t i = 0; i < count; i++)
+        {
+            uint32_t pixel = pixels[i];
+
+            // Get each of the RGB values from the pixel. The alpha is kept
+            // where it is.
+            red = (pixel & layout.MaskRed) >> layout.ShiftRed;
+            green = (pixel & layout.MaskGreen) >> layout.ShiftGreen;
+            blue = (pixel & layout.MaskBlue) >> layout.ShiftBlue;
+            alpha = pixel & layout.MaskAlpha;
+
+            // Calculate the average of the RGB values.
+            average = (uint8_t)((float)((short)red + green + blue) / 3);
+
+            // Set the average value to each of the RGB values.
+            pixels[i] = (((uint32_t)average << layout.ShiftRed) |
+                         ((uint32_t)average << layout.ShiftGreen) |
+                         ((uint32_t)average << layout.ShiftBlue) |
+                         alpha);
+        }
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: BasicGrayscalePacked
+   $Prototype: static void BasicGrayscalePacked(Image *image)
+   $Params: 
+       image: The 24 bit image to grayscale
+   $
+   $Description: Sets the RGB values of every pixel to their average. $
+   ======================================================================== */
+static void BasicGrayscalePacked(Image *image)
+{
+    uint8_t red, green, blue, average;
+
+    for(uint32_t y = 0; y < image->Height; y++)
+    {
+        uint8_t *pixel = (uint8_t*)image->Pixels + ((size_t)y * image->Pitch);
+
+        for(uint32_t x = 0; x < image->Width; x++, pixel += 3)
+        {
+            // The bytes are blue, green then red.
+            blue = pixel[0];
+            green = pixel[1];
+            red = pixel[2];
+
+            average = (uint8_t)((float)((short)red + green + blue) / 3);
+
+            pixel[0] = average;
+            pixel[1] = average;
+            pixel[2] = average;
+        }
+    }
+}
+
 /* ========================================================================
    $FUNCTION
    $Name: BasicGrayscale
@@ -181,30 +278,93 @@ void BasicGrayscale(Image *image)
 {
     TIMED_BLOCK();
 
-    uint8_t red, green, blue, alpha, average;
+    if (image->BitsPerPixel == 24)
+    {
+        BasicGrayscalePacked(image);
+        return;
+    }
+
+    DISPATCH_PIXEL_LAYOUT(image, BasicGrayscaleLayout, image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: LuminanceGrayscaleLayout
+   $Prototype: template <typename Layout> static void LuminanceGrayscaleLayout(Layout layout, Image *image)
+   $Params: 
+       layout: The channel layout of the image
+       image: The image to grayscale
+   $
+   $Description: Sets the RGB values of every pixel to their weighted average. $
+   ======================================================================== */
+template <typename Layout>
+static void LuminanceGrayscaleLayout(Layout layout, Image *image)
+{
+    // Packed pixels are gone through as one long row.
+    uint32_t rows = IsImageContiguous(image) ? 1 : image->Height;
+    uint32_t count = IsImageContiguous(image) ? image->PixelCount : image->Width;
+
+    uint8_t red, green, blue, average;
+    uint32_t alpha;
 
-    // Loop through each pixel.
-    for(uint32_t i = 0; i < image->PixelCount; i++)
+    for(uint32_t y = 0; y < rows; y++)
     {
+        uint32_t *pixels = GetImageRow(image, y);
 
-        // Get each of the RGBA values from the pixel
-        red = (image->Pixels[i] & image->MaskRed) >> image->ShiftRed;
-        green = (image->Pixels[i] & image->MaskGreen) >> image->ShiftGreen;
-        blue = (image->Pixels[i] & image->MaskBlue) >> image->ShiftBlue;
-        alpha = (image->Pixels[i] & image->MaskAlpha) >> image->ShiftAlpha;
+        // Loop through each pixel.
+        for(uint32_t i = 0; i < count; i++)
+        {
+            uint32_t pixel = pixels[i];
+
+            // Get each of the RGB values from the pixel. The alpha is kept
+            // where it is.
+            red = (pixel & layout.MaskRed) >> layout.ShiftRed;
+            green = (pixel & layout.MaskGreen) >> layout.ShiftGreen;
+            blue = (pixel & layout.MaskBlue) >> layout.ShiftBlue;
+            alpha = pixel & layout.MaskAlpha;
+
+            // Calculate the weighted average of the red/green/blue colours.
+            average = (uint8_t)((0.299f * red) + (0.587f * green) + (0.114f * blue));
+
+            // Set the average value to each of the RGB values.
+            pixels[i] = (((uint32_t)average << layout.ShiftRed) |
+                         ((uint32_t)average << layout.ShiftGreen) |
+                         ((uint32_t)average << layout.ShiftBlue) |
+                         alpha);
+        }
+    }
+}
 
-        // Calculate the average of the RGB values.
-        average = (uint8_t)((float)((short)red + green + blue) / 3);
+/* ========================================================================
+   $FUNCTION
+   $Name: LuminanceGrayscalePacked
+   $Prototype: static void LuminanceGrayscalePacked(Image *image)
+   $Params: 
+       image: The 24 bit image to grayscale
+   $
+   $Description: Sets the RGB values of every pixel to their weighted average. $
+   ======================================================================== */
+static void LuminanceGrayscalePacked(Image *image)
+{
+    uint8_t red, green, blue, average;
+
+    for(uint32_t y = 0; y < image->Height; y++)
+    {
+        uint8_t *pixel = (uint8_t*)image->Pixels + ((size_t)y * image->Pitch);
 
-        // Set the average value to each of the RGB values
-        red = green = blue = average;
+        for(uint32_t x = 0; x < image->Width; x++, pixel += 3)
+        {
+            // The bytes are blue, green then red.
+            blue = pixel[0];
+            green = pixel[1];
+            red = pixel[2];
 
-        // Set the pixel data.
-        image->Pixels[i] = ((red << image->ShiftRed) |
-                            (green << image->ShiftGreen) |
-                            (blue << image->ShiftBlue) |
-                            (alpha << image->ShiftAlpha));
+            average = (uint8_t)((0.299f * red) + (0.587f * green) + (0.114f * blue));
 
+            pixel[0] = average;
+            pixel[1] = average;
+            pixel[2] = average;
+        }
     }
 }
 
@@ -221,64 +381,56 @@ void LuminanceGrayscale(Image *image)
 {
     TIMED_BLOCK();
 
-    uint8_t red, green, blue, alpha, average;
-
-    // Loop through each pixel.
-    for(uint32_t i = 0; i < image->PixelCount; i++)
+    if (image->BitsPerPixel == 24)
     {
-
-        // Get each of the RGBA values from the pixel.
-        red = (image->Pixels[i] & image->MaskRed) >> image->ShiftRed;
-        green = (image->Pixels[i] & image->MaskGreen) >> image->ShiftGreen;
-        blue = (image->Pixels[i] & image->MaskBlue) >> image->ShiftBlue;
-        alpha = (image->Pixels[i] & image->MaskAlpha) >> image->ShiftAlpha;
-
-        // Calculate the weighted average of the red/green/blue colours.
-        average = (uint8_t)((0.299f * red) + (0.587f * green) + (0.114f * blue));
-
-        // Set the average value to each of the RGB values.
-        red = green = blue = average;
-
-        // Set the pixel data.
-        image->Pixels[i] = ((red << image->ShiftRed) |
-                            (green << image->ShiftGreen) |
-                            (blue << image->ShiftBlue) |
-                            (alpha << image->ShiftAlpha));
-
+        LuminanceGrayscalePacked(image);
+        return;
     }
+
+    DISPATCH_PIXEL_LAYOUT(image, LuminanceGrayscaleLayout, image);
 }
 
 /* ========================================================================
    $FUNCTION
    $Name: FlipVertical
-   $Prototype: void FlipVertical(Image *image)
+   $Prototype: int FlipVertical(Image *image)
    $Params: 
        image: The image to flip
    $
-   $Description: Flips an image vertically. $
+   $Description: Flips an image vertically. The rows are swapped whole,
+   so it works the same for every pixel size. Only the pixels are swapped,
+   anything after them in a row of a view belongs to someone else. Returns
+   0 on success or -1 if there is no memory for a row, when the image is
+   left as it was. $
    ======================================================================== */
-void FlipVertical(Image *image)
+int FlipVertical(Image *image)
 {
     TIMED_BLOCK();
 
-    uint32_t top, bottom;
+    uint32_t row_bytes = image->Width * (image->BitsPerPixel / 8);
+    uint8_t *row = (uint8_t*)AllocateMemory(MEMORY_IMAGE, row_bytes);
 
-    for(uint32_t y = 0; y < image->Height/2; y++)
+    if (row == 0)
     {
-        for(uint32_t x = 0; x < image->Width; x++)
-        {
-            
-            top = GetPixel(image, x, y);
-            bottom = GetPixel(image, x, image->Height - y - 1);
+        printf("Error: out of memory.\n");
+        return -1;
+    }
 
-            SetPixel(image, x, y, bottom);
-            SetPixel(image, x, image->Height - y - 1, top);
+    for(uint32_t y = 0; y < image->Height/2; y++)
+    {
+        uint8_t *top = (uint8_t*)GetImageRow(image, y);
+        uint8_t *bottom = (uint8_t*)GetImageRow(image, image->Height - y - 1);
 
-        }
+        memcpy(row, top, row_bytes);
+        memcpy(top, bottom, row_bytes);
+        memcpy(bottom, row, row_bytes);
     }
+
+    FreeMemory(row);
+
+    return 0;
 }
 
-// TODO(jordan): Finish this someday...
 /* ========================================================================
    $FUNCTION
    $Name: FlipHorizontal
@@ -286,8 +438,191 @@ void FlipVertical(Image *image)
    $Params: 
        image: The image to flip.
    $
-   $Description: Flips an image horizontally. $
+   $Description: Flips an image horizontally. The pixels of each row are
+   swapped from both ends in, a word at a time for 32 bit pixels and a
+   byte at a time for 24 bit ones. $
    ======================================================================== */
 void FlipHorizontal(Image *image)
 {
+    TIMED_BLOCK();
+
+    uint32_t pixel_bytes = image->BitsPerPixel / 8;
+
+    if (image->Width == 0)
+    {
+        return;
+    }
+
+    for(uint32_t y = 0; y < image->Height; y++)
+    {
+        uint8_t *left = (uint8_t*)GetImageRow(image, y);
+        uint8_t *right = left + ((image->Width - 1) * pixel_bytes);
+
+        if (pixel_bytes == 4)
+        {
+            for(; left < right; left += 4, right -= 4)
+            {
+                uint32_t pixel = *(uint32_t*)left;
+
+                *(uint32_t*)left = *(uint32_t*)right;
+                *(uint32_t*)right = pixel;
+            }
+        }
+        else
+        {
+            for(; left < right; left += pixel_bytes, right -= pixel_bytes)
+            {
+                for(uint32_t i = 0; i < pixel_bytes; i++)
+                {
+                    uint8_t byte = left[i];
+
+                    left[i] = right[i];
+                    right[i] = byte;
+                }
+            }
+        }
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: NegateImage
+   $Prototype: int NegateImage(const ImageView *view)
+   $Params:
+       view: The pixels to change
+   $
+   $Description: Negates the pixels of the view where they are. Returns 0
+   on success or -1 if the view can't be used. $
+   ======================================================================== */
+int NegateImage(const ImageView *view)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    NegateImage(&image);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: BasicGrayscale
+   $Prototype: int BasicGrayscale(const ImageView *view)
+   $Params:
+       view: The pixels to change
+   $
+   $Description: Does a simple grayscale to the pixels of the view where
+   they are. Returns 0 on success or -1 if the view can't be used. $
+   ======================================================================== */
+int BasicGrayscale(const ImageView *view)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    BasicGrayscale(&image);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: LuminanceGrayscale
+   $Prototype: int LuminanceGrayscale(const ImageView *view)
+   $Params:
+       view: The pixels to change
+   $
+   $Description: Does the complex grayscale to the pixels of the view where
+   they are. Returns 0 on success or -1 if the view can't be used. $
+   ======================================================================== */
+int LuminanceGrayscale(const ImageView *view)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    LuminanceGrayscale(&image);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FlipVertical
+   $Prototype: int FlipVertical(const ImageView *view)
+   $Params:
+       view: The pixels to change
+   $
+   $Description: Flips the pixels of the view vertically where they are.
+   Returns 0 on success or -1 if the view can't be used or there is no
+   memory for a row. $
+   ======================================================================== */
+int FlipVertical(const ImageView *view)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return FlipVertical(&image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FlipHorizontal
+   $Prototype: int FlipHorizontal(const ImageView *view)
+   $Params:
+       view: The pixels to change
+   $
+   $Description: Flips the pixels of the view horizontally where they are.
+   Returns 0 on success or -1 if the view can't be used. $
+   ======================================================================== */
+int FlipHorizontal(const ImageView *view)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    FlipHorizontal(&image);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: Scale
+   $Prototype: Image *Scale(const ImageView *view, float percent_width, float percent_height)
+   $Params:
+       view: The pixels to scale
+       percent_width: How much to scale horizontally
+       percent_height: How much to scale vertically
+   $
+   $Description: Scales the pixels of the view into a new image. Returns 0
+   if the view can't be used. $
+   ======================================================================== */
+Image *Scale(const ImageView *view, float percent_width, float percent_height)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return 0;
+    }
+
+    return Scale(&image, percent_width, percent_height);
 }
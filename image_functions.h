@@ -11,6 +11,9 @@
 #if !defined(IMAGE_FUNCTIONS_H)
 #define IMAGE_FUNCTIONS_H
 
+#include "image.h"
+
+// Negates four 32 bit pixels at a time with SSE2.
 #define IMAGE_FUNCTIONS_SSE 1
 
 void NegateImage(Image *image);
@@ -18,7 +21,17 @@ Image *Scale(Image *image, float percent_width, float percent_height);
 void BasicGrayscale(Image *image);
 void LuminanceGrayscale(Image *image);
 
-void FlipVertical(Image *image);
+int FlipVertical(Image *image);
 void FlipHorizontal(Image *image);
 
+// The same on pixels that are owned by something else. They are changed
+// where they are and -1 is returned if the view can't be used.
+int NegateImage(const ImageView *view);
+Image *Scale(const ImageView *view, float percent_width, float percent_height);
+int BasicGrayscale(const ImageView *view);
+int LuminanceGrayscale(const ImageView *view);
+
+int FlipVertical(const ImageView *view);
+int FlipHorizontal(const ImageView *view);
+
 #endif
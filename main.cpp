@@ -5,27 +5,64 @@
    $Developer: Jordan Marling $
    $Created On: 2015/09/14 $
    $Functions: 
+        static void FinishProfiling()
         void Usage(const char *program)
         int main(int argc, char **argv)
    $
    $Description: This program uses steganography to hide data inside of
                  bitmap images. $
    $Revisions: $
-   $NOTES: To convert an image to a 32 bit bitmap, use ImageMagick:
+   $NOTES: 24 bit and 32 bit bitmaps can be used as they are. To convert
+   an image to a 32 bit bitmap, use ImageMagick:
    "convert <source bmp> -type truecolormatte <output bmp>"
    ======================================================================== */
 
-#include <SDL2/SDL.h>
-
 #include <getopt.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "allocator.h"
+#include "archive.h"
+#include "stripe.h"
+#include "batch.h"
 #include "image.h"
 #include "image_functions.h"
-#include "platform.h"
 #include "steganography.h"
-#include "timer.h"
+#include "profiler.h"
+
+// The viewer build shows the images in SDL windows. The normal build
+// doesn't link SDL at all and exits as soon as the work is done.
+#if STEGANOGRAPHY_VIEWER
+#include "platform.h"
+#endif
+
+// Set by -z and -Z, used when the program exits.
+static char profile_report = 0;
+static char *profile_trace = 0;
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FinishProfiling
+   $Prototype: static void FinishProfiling()
+   $Params: $
+   $Description: Prints the profiler and memory reports and writes the
+   trace if they were asked for. This is run when the program exits. $
+   ======================================================================== */
+static void FinishProfiling()
+{
+    if (profile_report)
+    {
+        PrintProfilerReport(stderr);
+        PrintMemoryReport(stderr);
+    }
+
+    if (profile_trace)
+    {
+        WriteProfilerTrace(profile_trace);
+    }
+}
 
 /* ========================================================================
    $FUNCTION
@@ -38,7 +75,7 @@
    ======================================================================== */
 void Usage(const char *program)
 {
-    printf("%s -i <image> -t -e <filename/text> -d -o <output> -h -r -m\n", program);
+    printf("%s -i <image> -t -e <filename/text> -d -o <output> -h -r -m -j <threads> -p -s <buffer size> -q <image> -b <manifest> -l <depth> -c -k <password> -a <bits> -R <offset>,<length> -A -L -x <name> -M -S <password> -z -Z <trace> [files]\n", program);
     printf("\t-i: The image to encode into.\n");
     printf("\t-t: Encodes/Decodes text. You supply a string into the encode flag.\n");
     printf("\t-e: The encode parameter. This will be a filename or text with the -t flag.\n");
@@ -47,6 +84,23 @@ void Usage(const char *program)
     printf("\t-h: Prints this help message.\n");
     printf("\t-r: Creates a random image to encode a message into\n");
     printf("\t-m: Shows the amount of bytes that can fit in the image.\n");
+    printf("\t-j: How many threads to load, encode and decode with. 0 uses one per processor. Defaults to 1.\n");
+    printf("\t-p: Encodes straight into the input image instead of a copy of it. Only the pixels holding the data are touched.\n");
+    printf("\t-s: Streams a file through the image a strip at a time, holding about <buffer size> bytes of pixels. 0 uses the default of 4MB.\n");
+    printf("\t-q: Prints the size, capacity and stored length, depth and flags of an image, only reading its header.\n");
+    printf("\t-b: Runs every job in the manifest, one \"<encode|decode> <carrier> <payload> <output>\" per line. -j sets how many run at once, the default is one per processor.\n");
+    printf("\t-l: How many of the lowest bits of each colour to hide the data in, 1 to 4. Defaults to 1. Decoding finds it in the image.\n");
+    printf("\t-c: Compresses the data before encoding it, unless it doesn't get any smaller. Decoding finds out from the image.\n");
+    printf("\t-k: Encrypts the data with a key made from the password, or decrypts it. Can't be used with -p or -s.\n");
+    printf("\t-a: The AES key size to encrypt with, 128 or 256. Defaults to 256. Decoding finds it in the image.\n");
+    printf("\t-R: Decodes only <length> bytes of the text or file from <offset> on, which only reads the part of the image that holds them.\n");
+    printf("\t-A: Encodes the -e file and the files after the flags as an archive, or extracts every file of one with -d. -o is the directory to extract into.\n");
+    printf("\t-L: Lists the files in an archive, only decoding its table.\n");
+    printf("\t-x: Extracts one file from an archive, only decoding that file. -o is the file to write it to.\n");
+    printf("\t-M: Stripes the -e file across the images after the flags, or decodes it from all of them with -d in any order. -o is what the images are called, with _<stripe> in front of the .bmp.\n");
+    printf("\t-S: Scatters the data over the image in an order made from the password instead of putting it in the first pixels. Decoding needs the same password. Can't be used with -s.\n");
+    printf("\t-z: Prints how long each part of the program took and how much memory each part used when it exits.\n");
+    printf("\t-Z: Writes every timed zone to a Chrome trace (chrome://tracing or Perfetto) when the program exits.\n");
 }
 
 /* ========================================================================
@@ -60,11 +114,13 @@ void Usage(const char *program)
    ======================================================================== */
 int main(int argc, char **argv)
 {
+#if STEGANOGRAPHY_VIEWER
     Window *window_input = 0;
     Window *window_output = 0;
+#endif
 
-    Image *image_input = 0;
-    Image *image_output = 0;
+    OwnedImage image_input;
+    OwnedImage image_output;
 
     // Command line arguments.
     char text_mode = 0;
@@ -73,6 +129,20 @@ int main(int argc, char **argv)
     char decode = 0;
     char *output = 0;
     char random = 0;
+    char in_place = 0;
+    char stream = 0;
+    int stream_size = 0;
+    char *batch = 0;
+    int thread_count = 0;
+    char *password = 0;
+    AESType aes = AES_256;
+    char range = 0;
+    uint32_t range_offset = 0;
+    int range_length = 0;
+    char archive = 0;
+    char list = 0;
+    char *extract = 0;
+    char stripe = 0;
 
     char *output_buffer;
 
@@ -85,12 +155,32 @@ int main(int argc, char **argv)
         { "help", no_argument, 0, 'h' },
         { "random", no_argument, 0, 'r' },
         { "max", required_argument, 0, 'm' },
+        { "threads", required_argument, 0, 'j' },
+        { "in-place", no_argument, 0, 'p' },
+        { "stream", required_argument, 0, 's' },
+        { "probe", required_argument, 0, 'q' },
+        { "batch", required_argument, 0, 'b' },
+        { "depth", required_argument, 0, 'l' },
+        { "compress", no_argument, 0, 'c' },
+        { "key", required_argument, 0, 'k' },
+        { "aes", required_argument, 0, 'a' },
+        { "range", required_argument, 0, 'R' },
+        { "archive", no_argument, 0, 'A' },
+        { "list", no_argument, 0, 'L' },
+        { "extract", required_argument, 0, 'x' },
+        { "stripe", no_argument, 0, 'M' },
+        { "scatter", required_argument, 0, 'S' },
+        { "profile", no_argument, 0, 'z' },
+        { "trace", required_argument, 0, 'Z' },
+        { 0, 0, 0, 0 },
     };
     
-    const char *short_options = "i:e:dto:hrm:";
+    const char *short_options = "i:e:dto:hrm:j:ps:q:b:l:ck:a:R:ALx:MS:zZ:";
     int option_index = 0;
     char opt = 0; 
     
+    atexit(FinishProfiling);
+
     while ((opt = getopt_long(argc, argv, short_options, long_options, &option_index)) != -1)
     {
  
@@ -134,15 +224,136 @@ int main(int argc, char **argv)
 
             case 'm':
             {
-                if (optarg)
+                StegoProbe probe;
+
+                if (optarg && ProbeStegoImage(optarg, &probe) == 0)
+                {
+                    printf("You can fit %d bytes of data in this image.\n", probe.Capacity);
+                    return 0;
+                }
+            } break;
+
+            case 'q':
+            {
+                StegoProbe probe;
+
+                if (ProbeStegoImage(optarg, &probe) != 0)
+                {
+                    return -1;
+                }
+
+                printf("width=%u height=%u capacity=%d length=%u depth=%d compressed=%d encrypted=%d scattered=%d payload=%d stripe=%d/%d\n",
+                       probe.Width, probe.Height, probe.Capacity, probe.PayloadLength, probe.Depth,
+                       probe.Compressed, probe.Encrypted, probe.Scattered, probe.HasPayload, probe.StripeIndex, probe.StripeCount);
+                return 0;
+            } break;
+
+            case 'p':
+            {
+                in_place = 1;
+            } break;
+
+            case 'j':
+            {
+                thread_count = atoi(optarg);
+                SetStegoThreads(thread_count);
+                SetImageThreads(thread_count);
+            } break;
+
+            case 'b':
+            {
+                batch = optarg;
+            } break;
+
+            case 's':
+            {
+                stream = 1;
+                stream_size = atoi(optarg);
+            } break;
+
+            case 'l':
+            {
+                if (SetStegoDepth(atoi(optarg)) != 0)
+                {
+                    return -1;
+                }
+            } break;
+
+            case 'c':
+            {
+                SetStegoCompression(1);
+            } break;
+
+            case 'k':
+            {
+                password = optarg;
+            } break;
+
+            case 'a':
+            {
+                if (atoi(optarg) == 128)
+                {
+                    aes = AES_128;
+                }
+                else if (atoi(optarg) == 256)
+                {
+                    aes = AES_256;
+                }
+                else
+                {
+                    printf("The AES key size has to be 128 or 256.\n");
+                    return -1;
+                }
+            } break;
+
+            case 'R':
+            {
+                if (sscanf(optarg, "%u,%d", &range_offset, &range_length) != 2 || range_length < 0)
                 {
-                    image_input = LoadImage(optarg);
-                    if (image_input)
-                    {
-                        printf("You can fit %d bytes of data in this image.\n", StegoMaxBytes(image_input));
-                        return 0;
-                    }
+                    printf("The range has to be <offset>,<length>.\n");
+                    return -1;
                 }
+
+                range = 1;
+            } break;
+
+            case 'A':
+            {
+                archive = 1;
+            } break;
+
+            case 'L':
+            {
+                archive = 1;
+                list = 1;
+                decode = 1;
+            } break;
+
+            case 'x':
+            {
+                archive = 1;
+                extract = optarg;
+                decode = 1;
+            } break;
+
+            case 'M':
+            {
+                stripe = 1;
+            } break;
+
+            case 'S':
+            {
+                SetStegoScatter(optarg);
+            } break;
+
+            case 'z':
+            {
+                profile_report = 1;
+            } break;
+
+            case 'Z':
+            {
+                profile_trace = optarg;
             } break;
 
             default:
@@ -152,6 +363,35 @@ int main(int argc, char **argv)
         }
     }
 
+    // A batch runs its own jobs, -j sets how many run at once.
+    if (batch)
+    {
+        return (RunStegoBatch(batch, thread_count) == 0) ? 0 : -1;
+    }
+
+    // A stripe is in each of the images after the flags, there is no -i.
+    if (stripe)
+    {
+        if (text_mode || stream || in_place || range || archive || input_file || random)
+        {
+            printf("Striping can't be used with -i, -r, -t, -p, -s, -R or an archive.\n");
+            return -1;
+        }
+
+        if (optind >= argc || (!encode && !decode))
+        {
+            Usage(argv[0]);
+            return -1;
+        }
+
+        if (encode)
+        {
+            return EncodeStegoFileStriped(argv + optind, argc - optind, encode, output ? output : "stego_output.bmp", aes, password);
+        }
+
+        return (DecodeStegoFileStriped(argv + optind, argc - optind, output, password) < 0) ? -1 : 0;
+    }
+
     if (!input_file && !random)
     {
         Usage(argv[0]);
@@ -165,18 +405,55 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    // The encrypted payload is encoded and decoded in one go.
+    if (password && (stream || in_place))
+    {
+        printf("A password can't be used with -p or -s.\n");
+        return -1;
+    }
+
+    if (GetStegoScatter() && stream)
+    {
+        printf("A scatter password can't be used with -s.\n");
+        return -1;
+    }
+
+    if (range && (stream || encode))
+    {
+        printf("A range can only be decoded, and not with -s.\n");
+        return -1;
+    }
+
+    if (archive && (text_mode || stream || in_place || range))
+    {
+        printf("An archive can't be used with -t, -p, -s or -R.\n");
+        return -1;
+    }
+
+    // Streaming works on the files without loading the image, so there
+    // is nothing to show in a window afterwards.
+    if (stream && encode && input_file && !text_mode)
+    {
+        return EncodeStegoFileStreamed(input_file, encode, output ? output : "stego_output.bmp", stream_size);
+    }
+    else if (stream && decode && input_file && !text_mode)
+    {
+        return (DecodeStegoFileStreamed(input_file, output, stream_size) < 0) ? -1 : 0;
+    }
+
     // Load the image
     if (input_file)
     {
-        image_input = LoadImage(input_file);
+        // Decoding never writes to the pixels so they can be mapped read only.
+        image_input = OwnedImage(LoadImageMapped(input_file, encode ? IMAGE_MAP_PRIVATE : IMAGE_MAP_READ));
     }
     else if (random)
     {
-        image_input = CreateRandomImage(300, 300, 32);
+        image_input = OwnedImage(CreateRandomImage(300, 300, 32));
     }
 
     // Check to see if the image was successfully loaded.
-    if (image_input == 0)
+    if (!image_input)
     {
         printf("The image %s failed to load.\n", input_file);
         return -1;
@@ -184,40 +461,156 @@ int main(int argc, char **argv)
 
 
     // Check for encoding.
-    if (encode)
+    if (encode && in_place)
     {
+        int result;
+
+        // Encode straight into the loaded image, there is no output image.
         if (text_mode)
         {
-            image_output = EncodeStegoBuffer(image_input, encode, strlen(encode));
+            result = EncodeStegoBufferInPlace(image_input.Get(), encode, strlen(encode));
+        }
+        else
+        {
+            result = EncodeStegoFileInPlace(image_input.Get(), encode);
+        }
+
+        if (result != 0)
+        {
+            return -1;
+        }
+
+        if (output)
+        {
+            SaveBitmap(output, image_input.Get());
+        }
+        else
+        {
+            SaveBitmap("stego_output.bmp", image_input.Get());
+        }
+    }
+    else if (encode)
+    {
+        if (archive)
+        {
+            // The files after the flags go in the archive along with -e.
+            int file_count = argc - optind + 1;
+            char **filenames = (char**)malloc(sizeof(char*) * file_count);
+
+            filenames[0] = encode;
+            memcpy(filenames + 1, argv + optind, sizeof(char*) * (file_count - 1));
+
+            if (password)
+            {
+                image_output = OwnedImage(EncodeStegoArchiveEnc(image_input.Get(), filenames, file_count, aes, password));
+            }
+            else
+            {
+                image_output = OwnedImage(EncodeStegoArchive(image_input.Get(), filenames, file_count));
+            }
+
+            free(filenames);
+        }
+        else if (text_mode && password)
+        {
+            image_output = OwnedImage(EncodeStegoBufferEnc(image_input.Get(), encode, strlen(encode), aes, password));
+        }
+        else if (text_mode)
+        {
+            image_output = OwnedImage(EncodeStegoBuffer(image_input.Get(), encode, strlen(encode)));
+        }
+        else if (password)
+        {
+            image_output = OwnedImage(EncodeStegoFileEnc(image_input.Get(), encode, aes, password));
         }
         else
         {
-            image_output = EncodeStegoFile(image_input, encode);
+            image_output = OwnedImage(EncodeStegoFile(image_input.Get(), encode));
         }
 
-        if (image_output == 0)
+        if (!image_output)
         {
             return -1;
         }
 
         if (output)
         {
-            SaveBitmap(output, image_output);
+            SaveBitmap(output, image_output.Get());
         }
         else
         {
-            SaveBitmap("stego_output.bmp", image_output);
+            SaveBitmap("stego_output.bmp", image_output.Get());
+        }
+    }
+    else if (decode && archive)
+    {
+        StegoArchive *stego_archive;
+        int result = 0;
+
+        if ((stego_archive = OpenStegoArchive(image_input.Get(), password)) == 0)
+        {
+            return -1;
+        }
+
+        if (list)
+        {
+            for(int i = 0; i < stego_archive->FileCount; i++)
+            {
+                printf("%10u %08x %s\n", stego_archive->Files[i].Length, stego_archive->Files[i].Checksum, stego_archive->Files[i].Name);
+            }
+        }
+        else if (extract)
+        {
+            result = (ExtractStegoArchiveFile(stego_archive, extract, output) < 0) ? -1 : 0;
+        }
+        else
+        {
+            result = (ExtractStegoArchive(stego_archive, output) == 0) ? 0 : -1;
+        }
+
+        CloseStegoArchive(stego_archive);
+
+        if (result != 0)
+        {
+            return -1;
         }
     }
     else if (decode)
     {
         if (text_mode)
         {
-            int size = StegoMaxBytes(image_input);
+            int size = range ? range_length : password ? StegoDecodedBytesEnc(image_input.Get(), password) : StegoDecodedBytes(image_input.Get());
             int bytes_used;
 
-            output_buffer = (char*)malloc(sizeof(char) * size);
-            bytes_used = DecodeStegoBuffer(image_input, output_buffer, size);
+            if (size < 0)
+            {
+                return -1;
+            }
+
+            output_buffer = (char*)AllocateMemory(MEMORY_PAYLOAD, size);
+
+            if (range && password)
+            {
+                bytes_used = DecodeStegoRangeEnc(image_input.Get(), output_buffer, range_offset, size, password);
+            }
+            else if (range)
+            {
+                bytes_used = DecodeStegoRange(image_input.Get(), output_buffer, range_offset, size);
+            }
+            else if (password)
+            {
+                bytes_used = DecodeStegoBufferEnc(image_input.Get(), output_buffer, size, password);
+            }
+            else
+            {
+                bytes_used = DecodeStegoBuffer(image_input.Get(), output_buffer, size);
+            }
+
+            if (bytes_used < 0)
+            {
+                FreeMemory(output_buffer);
+                return -1;
+            }
 
             if (output)
             {
@@ -227,6 +620,7 @@ int main(int argc, char **argv)
                 if ((fp = fopen(output, "w")) == 0)
                 {
                     printf("Error writing to file: %s\n", output);
+                    FreeMemory(output_buffer);
                     return -1;
                 }
 
@@ -240,22 +634,40 @@ int main(int argc, char **argv)
             {
                 printf("Decoded Text:\n%.*s\n", bytes_used, output_buffer);
             }
+
+            FreeMemory(output_buffer);
         }
         else
         {
-            if (output)
+            int result;
+
+            // output is 0 if the stored filename is used.
+            if (range && password)
             {
-                DecodeStegoFile(image_input, output);
+                result = DecodeStegoFileRangeEnc(image_input.Get(), output, range_offset, range_length, password);
+            }
+            else if (range)
+            {
+                result = DecodeStegoFileRange(image_input.Get(), output, range_offset, range_length);
+            }
+            else if (password)
+            {
+                result = DecodeStegoFileEnc(image_input.Get(), output, password);
             }
             else
             {
-                DecodeStegoFile(image_input, 0);
+                result = DecodeStegoFile(image_input.Get(), output);
+            }
+
+            if (result < 0)
+            {
+                return -1;
             }
         }
 
     }
 
-    
+#if STEGANOGRAPHY_VIEWER
     // Create a window that is the same size as the image.
     if ((window_input = CreateWindow(image_input->Width, image_input->Height, "Input")) == 0)
     {
@@ -270,20 +682,29 @@ int main(int argc, char **argv)
     }
 
     // Render the images. We need to flip them because of the how the
-    // pixel buffers are interpreted.
+    // pixel buffers are interpreted. A read only image has to be copied
+    // before it can be flipped.
+    if (image_input->ReadOnly)
+    {
+        image_input = OwnedImage(CopyImage(image_input.Get()));
+    }
+
     if (window_input && image_input)
     {
-        FlipVertical(image_input);
-        RenderSurface(window_input, image_input);
+        FlipVertical(image_input.Get());
+        RenderSurface(window_input, image_input.Get());
     }
     if (window_output && image_output)
     {
-        FlipVertical(image_output);
-        RenderSurface(window_output, image_output);
+        FlipVertical(image_output.Get());
+        RenderSurface(window_output, image_output.Get());
     }
 
-    // Handle window update loop
-    while (UpdateWindow(window_input) == 0 && UpdateWindow(window_output) == 0);
-    
+    // Handle window update loop. All of the windows share one event
+    // queue, so waiting on the input window handles both.
+    while (UpdateWindow(window_input) == 0);
+#endif
+
+    // The images are freed when they go out of scope.
     return 0;
 }
@@ -0,0 +1,115 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: pixel_layout.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: The channel layouts that the pixel loops are compiled
+                 for. A loop is written once as a template on the layout,
+                 so for the common layouts every mask and shift is a
+                 constant, and the MaskLayout version reads them from the
+                 image for anything else. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(PIXEL_LAYOUT_H)
+#define PIXEL_LAYOUT_H
+
+#include <stdint.h>
+
+#include "image.h"
+
+// A layout that is known at compile time. Each channel is 8 bits.
+template <int Red, int Green, int Blue, int Alpha>
+struct PixelLayout
+{
+    static const uint32_t MaskRed = 0xFFu << Red;
+    static const uint32_t MaskGreen = 0xFFu << Green;
+    static const uint32_t MaskBlue = 0xFFu << Blue;
+    static const uint32_t MaskAlpha = 0xFFu << Alpha;
+
+    static const uint32_t ShiftRed = Red;
+    static const uint32_t ShiftGreen = Green;
+    static const uint32_t ShiftBlue = Blue;
+    static const uint32_t ShiftAlpha = Alpha;
+};
+
+typedef PixelLayout<16, 8, 0, 24> ArgbLayout;
+typedef PixelLayout<0, 8, 16, 24> AbgrLayout;
+typedef PixelLayout<24, 16, 8, 0> RgbaLayout;
+typedef PixelLayout<8, 16, 24, 0> BgraLayout;
+
+// The layout of an image that isn't one of the above, read at run time.
+struct MaskLayout
+{
+    uint32_t MaskRed;
+    uint32_t MaskGreen;
+    uint32_t MaskBlue;
+    uint32_t MaskAlpha;
+
+    uint32_t ShiftRed;
+    uint32_t ShiftGreen;
+    uint32_t ShiftBlue;
+    uint32_t ShiftAlpha;
+
+    MaskLayout(const Image *image)
+    {
+        MaskRed = image->MaskRed;
+        MaskGreen = image->MaskGreen;
+        MaskBlue = image->MaskBlue;
+        MaskAlpha = image->MaskAlpha;
+
+        ShiftRed = image->ShiftRed;
+        ShiftGreen = image->ShiftGreen;
+        ShiftBlue = image->ShiftBlue;
+        ShiftAlpha = image->ShiftAlpha;
+    }
+};
+
+// Returns 1 if the image has the masks of the layout.
+template <typename Layout>
+inline int IsImageLayout(const Image *image)
+{
+    return (image->MaskRed == Layout::MaskRed && image->MaskGreen == Layout::MaskGreen &&
+            image->MaskBlue == Layout::MaskBlue && image->MaskAlpha == Layout::MaskAlpha &&
+            image->ShiftRed == Layout::ShiftRed && image->ShiftGreen == Layout::ShiftGreen &&
+            image->ShiftBlue == Layout::ShiftBlue && image->ShiftAlpha == Layout::ShiftAlpha);
+}
+
+// Returns which compiled layout the image has.
+inline ImageLayout GetImageLayout(const Image *image)
+{
+    if (IsImageLayout<ArgbLayout>(image))
+    {
+        return IMAGE_LAYOUT_ARGB;
+    }
+    if (IsImageLayout<AbgrLayout>(image))
+    {
+        return IMAGE_LAYOUT_ABGR;
+    }
+    if (IsImageLayout<RgbaLayout>(image))
+    {
+        return IMAGE_LAYOUT_RGBA;
+    }
+    if (IsImageLayout<BgraLayout>(image))
+    {
+        return IMAGE_LAYOUT_BGRA;
+    }
+
+    return IMAGE_LAYOUT_OTHER;
+}
+
+// Calls function(layout, ...) with the layout of the image, where
+// function is a template on the layout type. This is the only place that
+// looks at the masks, the loop itself never does.
+#define DISPATCH_PIXEL_LAYOUT(image, function, ...)                      \
+    switch (GetImageLayout(image))                                      \
+    {                                                                   \
+        case IMAGE_LAYOUT_ARGB: function(ArgbLayout(), __VA_ARGS__); break; \
+        case IMAGE_LAYOUT_ABGR: function(AbgrLayout(), __VA_ARGS__); break; \
+        case IMAGE_LAYOUT_RGBA: function(RgbaLayout(), __VA_ARGS__); break; \
+        case IMAGE_LAYOUT_BGRA: function(BgraLayout(), __VA_ARGS__); break; \
+        default: function(MaskLayout(image), __VA_ARGS__); break;       \
+    }
+
+#endif
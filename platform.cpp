@@ -7,6 +7,7 @@
    $Functions: 
 struct Window *CreateWindow(int width, int height, const char *window_title)
 int RenderSurface(Window *window, Image *image)
+static int HandleWindowEvent(SDL_Event *event)
 int UpdateWindow(Window *window)
    $
    $Description: This file contains all of the window functions. $
@@ -106,6 +107,51 @@ int RenderSurface(Window *window, Image *image)
     return 0;
 }
 
+/* ========================================================================
+   $FUNCTION
+   $Name: HandleWindowEvent
+   $Prototype: static int HandleWindowEvent(SDL_Event *event)
+   $Params: 
+       event: The event to handle.
+   $
+   $Description: Returns 1 if the event closes the program. $
+   ======================================================================== */
+static int HandleWindowEvent(SDL_Event *event)
+{
+    int has_exited = 0;
+
+    switch(event->type)
+    {
+        // Handle the window events
+        case SDL_WINDOWEVENT:
+        {
+            if (event->window.event == SDL_WINDOWEVENT_CLOSE)
+            {
+                has_exited = 1;
+            }
+        } break;
+
+        // If the close button was pressed
+        case SDL_QUIT:
+        {
+            has_exited = 1;
+        } break;
+
+        // If a key on the keyboard is pressed down
+        case SDL_KEYDOWN:
+        {
+            // If the key is escape
+            if (event->key.keysym.scancode == SDL_SCANCODE_ESCAPE)
+            {
+                has_exited = 1;
+            }
+        } break;
+
+    }
+
+    return has_exited;
+}
+
 /* ========================================================================
    $FUNCTION
    $Name: UpdateWindow
@@ -113,45 +159,26 @@ int RenderSurface(Window *window, Image *image)
    $Params: 
        window: The window to update.
    $
-   $Description: Returns 1 on exit. Otherwise returns 0. It handles window events. $
+   $Description: Returns 1 on exit. Otherwise returns 0. It sleeps until
+   there is an event and then handles all of the window events. $
    ======================================================================== */
 int UpdateWindow(Window *window)
 {
     SDL_Event event;
     int has_exited = 0;
 
-    // Loop through each of the window events
+    // Wait for an event instead of spinning, there is nothing to draw
+    // until something happens.
     // TODO(jordan): Possibly make the window resize and keep the image centered.
-    while (SDL_PollEvent(&event))
+    if (SDL_WaitEvent(&event))
     {
-        switch(event.type)
-        {
-            // Handle the window events
-            case SDL_WINDOWEVENT:
-            {
-                if (event.window.event == SDL_WINDOWEVENT_CLOSE)
-                {
-                    has_exited = 1;
-                }
-            } break;
-
-            // If the close button was pressed
-            case SDL_QUIT:
-            {
-                has_exited = 1;
-            } break;
+        has_exited |= HandleWindowEvent(&event);
+    }
 
-            // If a key on the keyboard is pressed down
-            case SDL_KEYDOWN:
-            {
-                // If the key is escape
-                if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)
-                {
-                    has_exited = 1;
-                }
-            } break;
-
-        }
+    // Loop through the rest of the window events
+    while (SDL_PollEvent(&event))
+    {
+        has_exited |= HandleWindowEvent(&event);
     }
 
     return has_exited;
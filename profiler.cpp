@@ -0,0 +1,492 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: profiler.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static uint64_t GetProfilerTime(clockid_t clock)
+static ProfilerThread *GetProfilerThread()
+int BeginProfilerZone(const char *name)
+void EndProfilerZone(int zone)
+static int CompareProfilerEvents(const void *a, const void *b)
+static int CompareProfilerTotals(const void *a, const void *b)
+static ProfilerEvent **GatherProfilerEvents(int *event_count)
+void PrintProfilerReport(FILE *fp)
+int WriteProfilerTrace(const char *filename)
+   $
+   $Description: Every thread gets its own buffer of zones the first time
+   it starts one, so recording a zone never takes a lock. A zone stores
+   the wall clock (CLOCK_MONOTONIC) and the thread's CPU time
+   (CLOCK_THREAD_CPUTIME_ID) when it starts and ends, and adds its wall
+   time to the zone it is nested in so the self time can be worked out.
+   The buffers are only read when the report or trace is written, which
+   has to be after the threads are done. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// How deep zones can be nested. Deeper zones aren't recorded.
+#define PROFILER_MAX_DEPTH 64
+
+// The most zones a thread records, so a zone in a loop can't use up
+// all of the memory. Zones after this are counted as dropped.
+#define PROFILER_MAX_EVENTS (1 << 20)
+
+// One run of a zone.
+struct ProfilerEvent
+{
+    const char *Name;
+
+    // Nanoseconds. WallStart is from when the first thread started
+    // profiling, CpuStart is the thread's CPU time.
+    uint64_t WallStart;
+    uint64_t WallTime;
+    uint64_t CpuStart;
+    uint64_t CpuTime;
+
+    // The wall time of the zones nested directly inside this one.
+    uint64_t ChildTime;
+
+    int Thread;
+    uint8_t Done;
+};
+
+// The buffer of one thread. These are never freed so the zones of
+// threads that have exited are still in the report.
+struct ProfilerThread
+{
+    int Index;
+
+    ProfilerEvent *Events;
+    int EventCount;
+    int EventSize;
+    int Dropped;
+
+    // The zones that are currently open, -1 for one that was dropped.
+    int Stack[PROFILER_MAX_DEPTH];
+    int Depth;
+
+    ProfilerThread *Next;
+};
+
+// The totals of every run of one zone.
+struct ProfilerTotal
+{
+    const char *Name;
+    int Count;
+
+    uint64_t WallTime;
+    uint64_t SelfTime;
+    uint64_t CpuTime;
+
+    uint64_t P50;
+    uint64_t P90;
+    uint64_t P99;
+    uint64_t Max;
+};
+
+static pthread_mutex_t profiler_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProfilerThread *profiler_threads = 0;
+static int profiler_thread_count = 0;
+static uint64_t profiler_start = 0;
+
+static __thread ProfilerThread *profiler_thread = 0;
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetProfilerTime
+   $Prototype: static uint64_t GetProfilerTime(clockid_t clock)
+   $Params:
+       clock: The clock to read.
+   $
+   $Description: Returns the time of the clock in nanoseconds. $
+   ======================================================================== */
+static uint64_t GetProfilerTime(clockid_t clock)
+{
+    timespec time;
+
+    clock_gettime(clock, &time);
+
+    return ((uint64_t)time.tv_sec * 1000000000) + time.tv_nsec;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetProfilerThread
+   $Prototype: static ProfilerThread *GetProfilerThread()
+   $Params: $
+   $Description: Returns the buffer of the calling thread, creating it
+   the first time. Returns 0 if it can't be allocated. $
+   ======================================================================== */
+static ProfilerThread *GetProfilerThread()
+{
+    ProfilerThread *thread = profiler_thread;
+
+    if (thread)
+    {
+        return thread;
+    }
+
+    if ((thread = (ProfilerThread*)calloc(1, sizeof(ProfilerThread))) == 0)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&profiler_lock);
+
+    if (profiler_thread_count == 0)
+    {
+        profiler_start = GetProfilerTime(CLOCK_MONOTONIC);
+    }
+
+    thread->Index = profiler_thread_count++;
+    thread->Next = profiler_threads;
+    profiler_threads = thread;
+
+    pthread_mutex_unlock(&profiler_lock);
+
+    profiler_thread = thread;
+
+    return thread;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: BeginProfilerZone
+   $Prototype: int BeginProfilerZone(const char *name)
+   $Params:
+       name: The name of the zone. It has to stay around until the report
+             is written, which a string literal or __FUNCTION__ does.
+   $
+   $Description: Starts a zone on the calling thread. Returns the zone to
+   give to EndProfilerZone. $
+   ======================================================================== */
+int BeginProfilerZone(const char *name)
+{
+    ProfilerThread *thread = GetProfilerThread();
+    ProfilerEvent *event;
+    int zone;
+
+    if (thread == 0 || thread->Depth == PROFILER_MAX_DEPTH)
+    {
+        if (thread)
+        {
+            thread->Dropped++;
+        }
+
+        return -2;
+    }
+
+    // Grow the buffer, or drop the zone if it is full.
+    if (thread->EventCount == thread->EventSize)
+    {
+        int size = (thread->EventSize == 0) ? 1024 : thread->EventSize * 2;
+        ProfilerEvent *events = 0;
+
+        if (size <= PROFILER_MAX_EVENTS)
+        {
+            events = (ProfilerEvent*)realloc(thread->Events, sizeof(ProfilerEvent) * size);
+        }
+
+        if (events == 0)
+        {
+            thread->Dropped++;
+            thread->Stack[thread->Depth++] = -1;
+            return -1;
+        }
+
+        thread->Events = events;
+        thread->EventSize = size;
+    }
+
+    zone = thread->EventCount++;
+    event = thread->Events + zone;
+
+    event->Name = name;
+    event->ChildTime = 0;
+    event->Thread = thread->Index;
+    event->Done = 0;
+
+    thread->Stack[thread->Depth++] = zone;
+
+    // Read the clocks last so setting up the zone isn't counted.
+    event->CpuStart = GetProfilerTime(CLOCK_THREAD_CPUTIME_ID);
+    event->WallStart = GetProfilerTime(CLOCK_MONOTONIC);
+
+    return zone;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EndProfilerZone
+   $Prototype: void EndProfilerZone(int zone)
+   $Params:
+       zone: What BeginProfilerZone returned.
+   $
+   $Description: Ends the zone and adds its time to the zone it is in. $
+   ======================================================================== */
+void EndProfilerZone(int zone)
+{
+    uint64_t wall_end = GetProfilerTime(CLOCK_MONOTONIC);
+    uint64_t cpu_end = GetProfilerTime(CLOCK_THREAD_CPUTIME_ID);
+    ProfilerThread *thread = profiler_thread;
+    ProfilerEvent *event;
+    int parent;
+
+    if (zone == -2 || thread == 0)
+    {
+        return;
+    }
+
+    thread->Depth--;
+
+    if (zone == -1)
+    {
+        return;
+    }
+
+    event = thread->Events + zone;
+    event->WallTime = wall_end - event->WallStart;
+    event->CpuTime = cpu_end - event->CpuStart;
+    event->WallStart -= profiler_start;
+    event->Done = 1;
+
+    parent = (thread->Depth > 0) ? thread->Stack[thread->Depth - 1] : -1;
+
+    if (parent >= 0)
+    {
+        thread->Events[parent].ChildTime += event->WallTime;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CompareProfilerEvents
+   $Prototype: static int CompareProfilerEvents(const void *a, const void *b)
+   $Params:
+       a: The first ProfilerEvent*
+       b: The second ProfilerEvent*
+   $
+   $Description: Sorts events by name and then by wall time, so the runs
+   of each zone are together and in order for the percentiles. $
+   ======================================================================== */
+static int CompareProfilerEvents(const void *a, const void *b)
+{
+    const ProfilerEvent *event_a = *(const ProfilerEvent**)a;
+    const ProfilerEvent *event_b = *(const ProfilerEvent**)b;
+    int result = strcmp(event_a->Name, event_b->Name);
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    return (event_a->WallTime > event_b->WallTime) - (event_a->WallTime < event_b->WallTime);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CompareProfilerTotals
+   $Prototype: static int CompareProfilerTotals(const void *a, const void *b)
+   $Params:
+       a: The first ProfilerTotal
+       b: The second ProfilerTotal
+   $
+   $Description: Sorts the zones with the most wall time first. $
+   ======================================================================== */
+static int CompareProfilerTotals(const void *a, const void *b)
+{
+    const ProfilerTotal *total_a = (const ProfilerTotal*)a;
+    const ProfilerTotal *total_b = (const ProfilerTotal*)b;
+
+    return (total_a->WallTime < total_b->WallTime) - (total_a->WallTime > total_b->WallTime);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GatherProfilerEvents
+   $Prototype: static ProfilerEvent **GatherProfilerEvents(int *event_count)
+   $Params:
+       event_count: Gets set to how many events there are.
+   $
+   $Description: Returns an array pointing at every finished event of
+   every thread. It needs to be freed. Returns 0 if there are none. $
+   ======================================================================== */
+static ProfilerEvent **GatherProfilerEvents(int *event_count)
+{
+    ProfilerEvent **events;
+    int count = 0;
+
+    pthread_mutex_lock(&profiler_lock);
+
+    for(ProfilerThread *thread = profiler_threads; thread; thread = thread->Next)
+    {
+        count += thread->EventCount;
+    }
+
+    *event_count = 0;
+
+    if (count == 0 || (events = (ProfilerEvent**)malloc(sizeof(ProfilerEvent*) * count)) == 0)
+    {
+        pthread_mutex_unlock(&profiler_lock);
+        return 0;
+    }
+
+    for(ProfilerThread *thread = profiler_threads; thread; thread = thread->Next)
+    {
+        for(int i = 0; i < thread->EventCount; i++)
+        {
+            if (thread->Events[i].Done)
+            {
+                events[(*event_count)++] = thread->Events + i;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&profiler_lock);
+
+    return events;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: PrintProfilerReport
+   $Prototype: void PrintProfilerReport(FILE *fp)
+   $Params:
+       fp: Where to print the report.
+   $
+   $Description: Prints how many times every zone ran, its total, self
+   (without the zones nested in it) and CPU time, and the percentiles of
+   its wall time. $
+   ======================================================================== */
+void PrintProfilerReport(FILE *fp)
+{
+    ProfilerEvent **events;
+    ProfilerTotal *totals;
+    int event_count;
+    int total_count = 0;
+    int dropped = 0;
+
+    if ((events = GatherProfilerEvents(&event_count)) == 0)
+    {
+        return;
+    }
+
+    if ((totals = (ProfilerTotal*)calloc(event_count, sizeof(ProfilerTotal))) == 0)
+    {
+        free(events);
+        return;
+    }
+
+    qsort(events, event_count, sizeof(ProfilerEvent*), CompareProfilerEvents);
+
+    // The runs of each zone are next to each other and sorted by time.
+    for(int start = 0, end; start < event_count; start = end)
+    {
+        ProfilerTotal *total = totals + total_count++;
+
+        for(end = start; end < event_count && strcmp(events[end]->Name, events[start]->Name) == 0; end++)
+        {
+            total->WallTime += events[end]->WallTime;
+            total->SelfTime += events[end]->WallTime - events[end]->ChildTime;
+            total->CpuTime += events[end]->CpuTime;
+        }
+
+        total->Name = events[start]->Name;
+        total->Count = end - start;
+        total->P50 = events[start + ((total->Count - 1) * 50 / 100)]->WallTime;
+        total->P90 = events[start + ((total->Count - 1) * 90 / 100)]->WallTime;
+        total->P99 = events[start + ((total->Count - 1) * 99 / 100)]->WallTime;
+        total->Max = events[end - 1]->WallTime;
+    }
+
+    qsort(totals, total_count, sizeof(ProfilerTotal), CompareProfilerTotals);
+
+    fprintf(fp, "%-32s %8s %12s %12s %12s %10s %10s %10s %10s\n",
+            "zone", "calls", "total_ms", "self_ms", "cpu_ms", "p50_us", "p90_us", "p99_us", "max_us");
+
+    for(int i = 0; i < total_count; i++)
+    {
+        fprintf(fp, "%-32s %8d %12.3f %12.3f %12.3f %10.1f %10.1f %10.1f %10.1f\n",
+                totals[i].Name, totals[i].Count,
+                totals[i].WallTime / 1000000.0, totals[i].SelfTime / 1000000.0, totals[i].CpuTime / 1000000.0,
+                totals[i].P50 / 1000.0, totals[i].P90 / 1000.0, totals[i].P99 / 1000.0, totals[i].Max / 1000.0);
+    }
+
+    pthread_mutex_lock(&profiler_lock);
+
+    for(ProfilerThread *thread = profiler_threads; thread; thread = thread->Next)
+    {
+        dropped += thread->Dropped;
+    }
+
+    pthread_mutex_unlock(&profiler_lock);
+
+    if (dropped)
+    {
+        fprintf(fp, "%d zones were dropped.\n", dropped);
+    }
+
+    free(totals);
+    free(events);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteProfilerTrace
+   $Prototype: int WriteProfilerTrace(const char *filename)
+   $Params:
+       filename: The file to write to.
+   $
+   $Description: Writes every zone as a Chrome trace event, which can be
+   opened in chrome://tracing or Perfetto. Returns 0 on success and -1 if
+   the file can't be written. $
+   ======================================================================== */
+int WriteProfilerTrace(const char *filename)
+{
+    ProfilerEvent **events;
+    int event_count;
+    FILE *fp;
+
+    if ((fp = fopen(filename, "w")) == 0)
+    {
+        printf("Unable to open file: %s\n", filename);
+        return -1;
+    }
+
+    events = GatherProfilerEvents(&event_count);
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for(int i = 0; i < event_count; i++)
+    {
+        // Complete events with the times in microseconds.
+        fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cpu_us\":%.3f}}",
+                (i == 0) ? "" : ",", events[i]->Name, events[i]->Thread,
+                events[i]->WallStart / 1000.0, events[i]->WallTime / 1000.0, events[i]->CpuTime / 1000.0);
+    }
+
+    fprintf(fp, "\n]}\n");
+
+    free(events);
+
+    if (fclose(fp) != 0)
+    {
+        printf("Error writing to file: %s\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
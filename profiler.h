@@ -0,0 +1,71 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: profiler.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: Times blocks of code without printing anything while
+                 they run. Every thread records its zones into its own
+                 buffer and they are added up when the report is made. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(PROFILER_H)
+#define PROFILER_H
+
+#include <stdio.h>
+
+// Set this to 0 (or build with -DPROFILER_ENABLED=0) to compile out all
+// of the zones. TIMED_BLOCK then expands to nothing and the report
+// functions do nothing.
+#if !defined(PROFILER_ENABLED)
+#define PROFILER_ENABLED 1
+#endif
+
+#if PROFILER_ENABLED
+
+// These macros create a zone for the block of code. (There can be
+// multiple per function, and they can be nested)
+#define TIMED_BLOCK_(BlockName, Number) ProfilerZone TimedBlock_##Number(BlockName)
+#define TIMED_BLOCK() TIMED_BLOCK_(__FUNCTION__, __LINE__)
+
+int BeginProfilerZone(const char *name);
+void EndProfilerZone(int zone);
+
+// Records the wall and CPU time of the current block of code. When the
+// block goes out of scope the destructor ends the zone.
+struct ProfilerZone
+{
+    int Zone;
+
+    ProfilerZone(const char *name)
+    {
+        Zone = BeginProfilerZone(name);
+    }
+
+    ~ProfilerZone()
+    {
+        EndProfilerZone(Zone);
+    }
+};
+
+void PrintProfilerReport(FILE *fp);
+int WriteProfilerTrace(const char *filename);
+
+#else
+
+#define TIMED_BLOCK_(BlockName, Number)
+#define TIMED_BLOCK()
+
+inline void PrintProfilerReport(FILE *fp)
+{
+}
+
+inline int WriteProfilerTrace(const char *filename)
+{
+    return 0;
+}
+
+#endif
+
+#endif
@@ -5,314 +5,5254 @@
    $Developer: Jordan Marling $
    $Created On: 2015/09/30 $
    $Functions: 
-inline static void SetStegoByte(Image *image, char data, int offset)
-inline static void GetStegoByte(Image *image, int offset, char *data)
+static int StartStegoPayloadScatter(Image *image, const StegoHeader *header, StegoPayload *payload)
+static const StegoScatter *GetStegoPayloadScatter(const StegoPayload *payload)
+static uint32_t EncodeStegoSpan(StegoJob *job, const char *buffer, uint32_t start, int count)
+static uint32_t DecodeStegoSpan(StegoJob *job, char *buffer, uint32_t start, int count)
+static void EncodeStegoJob(void *data, int index)
+static void DecodeStegoJob(void *data, int index)
+static int SplitStegoJob(StegoJob *job, int thread_count)
+static uint32_t CombineStegoJob(StegoJob *job, int part_count)
+static uint32_t EncodeStegoParallel(Image *image, const char *buffer, int count, uint32_t pixel, int depth, const StegoScatter *scatter)
+static uint32_t DecodeStegoParallel(Image *image, uint32_t pixel, char *buffer, int count, int depth, const StegoScatter *scatter)
+static void SetStegoHeader(char *bytes, const StegoHeader *header)
+static int GetStegoHeader(const char *bytes, StegoHeader *header)
+static uint32_t GetStegoHeaderImagePixels(const Image *format, uint32_t pixel_count)
+static void SetStegoWord(char *bytes, uint32_t value)
+static uint32_t GetStegoWord(const char *bytes)
+static void SetStegoStripe(char *bytes, const StegoStripe *stripe)
+static int GetStegoStripe(const char *bytes, StegoStripe *stripe)
+static uint32_t GetStegoIndexBytes(uint32_t chunk_count)
+static uint32_t GetStegoChunkLength(const StegoIndex *index, uint32_t chunk)
+static uint32_t GetStegoChunkStored(const StegoIndex *index, uint32_t chunk)
+static uint32_t GetStegoChunkSlot(const StegoIndex *index)
+static StegoChunk *AllocateStegoChunks(uint32_t chunk_count)
+static void *GrowStegoBuffer(MemoryUse use, void *buffer, size_t used, size_t size)
+static void StartStegoIndex(StegoIndex *index, uint32_t data_length)
+static void PlaceStegoChunks(StegoIndex *index)
+static void FreeStegoIndex(StegoIndex *index)
+static void SetStegoIndex(char *bytes, const StegoIndex *index)
+static int GetStegoIndexHeader(const char *bytes, StegoIndex *index, uint32_t stored_length)
+static int GetStegoChunk(const char *bytes, StegoIndex *index, uint32_t chunk)
+static uint32_t GetStegoChunkChecksum(uint32_t checksum, uint32_t count)
+static void EncodeStegoChunkJob(void *data, int index)
+static int UnpackStegoChunk(const StegoIndex *index, uint32_t chunk, const char *bytes, uint32_t checksum, char *output)
+static int DecodeStegoChunk(StegoJob *job, uint32_t chunk, char *output)
+static void DecodeStegoChunkJob(void *data, int index)
+static int CheckStegoChunk(int result)
+static void EncodeStegoChunks(Image *image, StegoIndex *index, uint32_t pixel, int depth, const StegoScatter *scatter, const Cipher *key)
+static int DecodeStegoChunks(Image *image, StegoPayload *payload, const Cipher *key, char *buffer, uint32_t first, uint32_t count)
+static int GetStegoCapacity(uint32_t pixel_count, int depth)
+static uint32_t GetStegoCursorBytes(StegoCursor *cursor, uint32_t pixel_end, uint32_t wanted)
+static void AdvanceStegoCursor(StegoCursor *cursor, uint32_t count)
+void SetStegoThreads(int thread_count)
+int SetStegoJobThreads(int thread_count)
+int GetStegoThreads()
+int SetStegoDepth(int depth)
+int GetStegoDepth()
+void SetStegoCompression(int compression)
+int GetStegoCompression()
+int SetStegoScatter(const char *password)
+int GetStegoScatter()
 int StegoMaxBytes(Image *image)
+int StegoStripeMaxBytes(int max_bytes, int encrypted)
+int ProbeStegoImage(const char *filename, StegoProbe *probe)
+static void PackStegoChunkJob(void *data, int index)
+static void SplitStegoBuffer(StegoIndex *index, const char *buffer, int buffer_length)
+static uint64_t GetStegoPayloadSize(const StegoIndex *index, int encrypted, int striped)
+static void EncodeStegoPayload(Image *image, StegoIndex *index, const Cipher *key, const uint8_t *key_header, const StegoStripe *stripe)
+static int StartStegoCipher(Cipher *key, AESType aes, const char *password, uint8_t *key_header)
+int EncodeStegoBufferInPlace(Image *image, const char *buffer, int buffer_length)
 Image *EncodeStegoBuffer(Image *image, const char *buffer, int buffer_length)
+static int StartStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password, StegoIndex *index, Cipher *key, uint8_t *key_header)
+Image *EncodeStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password)
+int EncodeStegoBufferInPlaceEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password)
+char *ReadStegoFile(const char *filename, int *buffer_length)
 Image *EncodeStegoFile(Image *image, const char *filename)
+int EncodeStegoFileInPlace(Image *image, const char *filename)
+Image *EncodeStegoFileEnc(Image *image, const char *filename, AESType aes, const char *password)
+int EncodeStegoFileInPlaceEnc(Image *image, const char *filename, AESType aes, const char *password)
+int EncodeStegoStripeInPlace(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe)
+int EncodeStegoStripeInPlaceEnc(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password)
+static uint32_t GetStegoStripPixels(const Image *format, int buffer_size)
+static int ReadStegoPlain(StegoSource *source, char *buffer, int count)
+static const char *PackStegoChunk(StegoChunk *chunk, const char *block, uint32_t length, char *packed)
+static int SpillStegoSource(StegoSource *source, uint32_t capacity)
+static void FreeStegoSpill(StegoSource *source)
+static int LoadStegoChunk(StegoSource *source)
+static int ReadStegoSource(StegoSource *source, char *buffer, int count)
+int EncodeStegoFileStreamed(const char *image_filename, const char *filename, const char *output_filename, int buffer_size)
+static int CheckStegoHeader(const char *bytes, StegoHeader *header, uint32_t pixel_count)
+static int ReadStegoHeader(Image *image, StegoHeader *header)
+static int CheckStegoChecksum(uint32_t checksum, uint32_t stored_checksum)
+static int OpenStegoPayload(Image *image, const char *password, Cipher *key, StegoPayload *payload, int striped)
+static int ReadStegoIndex(Image *image, StegoPayload *payload, uint32_t first, uint32_t count)
+static int DecodeStegoPayload(Image *image, char *buffer, int buffer_len, StegoPayload *payload, const Cipher *key)
+static int DecodeStegoPayloadRange(Image *image, char *buffer, uint32_t offset, int length, StegoPayload *payload, const Cipher *key)
+int StegoDecodedBytes(Image *image)
+int StegoDecodedBytesEnc(Image *image, const char *password)
 int DecodeStegoBuffer(Image *image, char *buffer, int buffer_len)
+int DecodeStegoBufferEnc(Image *image, char *buffer, int buffer_len, const char *password)
+int ReadStegoStripe(Image *image, StegoStripe *stripe)
+int DecodeStegoStripe(Image *image, char *buffer, int buffer_len)
+int DecodeStegoStripeEnc(Image *image, char *buffer, int buffer_len, const char *password)
+int DecodeStegoRange(Image *image, char *buffer, uint32_t offset, int length)
+int DecodeStegoRangeEnc(Image *image, char *buffer, uint32_t offset, int length, const char *password)
+StegoReader *OpenStegoReader(Image *image, const char *password)
+int StegoReaderBytes(StegoReader *reader)
+int StegoReaderChunkBytes(StegoReader *reader)
+int DecodeStegoReaderRange(StegoReader *reader, char *buffer, uint32_t offset, int length)
+void CloseStegoReader(StegoReader *reader)
+static uint32_t GetStegoSinkWanted(StegoSink *sink)
+static int WriteStegoSinkData(StegoSink *sink, const char *buffer, uint32_t count)
+static int ReadStegoSinkIndex(StegoSink *sink)
+static int WriteStegoSink(StegoSink *sink, const char *buffer, uint32_t count, uint32_t checksum)
+static void StartStegoSink(StegoSink *sink, Image *image, const char *filename)
+static int FinishStegoSink(StegoSink *sink, int result)
+static int WriteStegoChunks(Image *image, StegoPayload *payload, const Cipher *key, StegoSink *sink)
 int DecodeStegoFile(Image *image, const char *filename)
+int DecodeStegoFileEnc(Image *image, const char *filename, const char *password)
+static int WriteStegoFileRange(Image *image, const char *filename, uint32_t offset, int length, StegoPayload *payload, const Cipher *key)
+int DecodeStegoFileRange(Image *image, const char *filename, uint32_t offset, int length)
+int DecodeStegoFileRangeEnc(Image *image, const char *filename, uint32_t offset, int length, const char *password)
+int DecodeStegoFileStreamed(const char *image_filename, const char *filename, int buffer_size)
+int StegoMaxBytes(const ImageView *view)
+int EncodeStegoBufferInPlace(const ImageView *view, const char *buffer, int buffer_length)
+int EncodeStegoBufferInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, AESType aes, const char *password)
+int EncodeStegoFileInPlace(const ImageView *view, const char *filename)
+int EncodeStegoFileInPlaceEnc(const ImageView *view, const char *filename, AESType aes, const char *password)
+int EncodeStegoStripeInPlace(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe)
+int EncodeStegoStripeInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password)
+int ReadStegoStripe(const ImageView *view, StegoStripe *stripe)
+int DecodeStegoStripe(const ImageView *view, char *buffer, int buffer_len)
+int DecodeStegoStripeEnc(const ImageView *view, char *buffer, int buffer_len, const char *password)
+int StegoDecodedBytes(const ImageView *view)
+int StegoDecodedBytesEnc(const ImageView *view, const char *password)
+int DecodeStegoBuffer(const ImageView *view, char *buffer, int buffer_len)
+int DecodeStegoBufferEnc(const ImageView *view, char *buffer, int buffer_len, const char *password)
+int DecodeStegoRange(const ImageView *view, char *buffer, uint32_t offset, int length)
+int DecodeStegoRangeEnc(const ImageView *view, char *buffer, uint32_t offset, int length, const char *password)
+int DecodeStegoFile(const ImageView *view, const char *filename)
+int DecodeStegoFileEnc(const ImageView *view, const char *filename, const char *password)
+int DecodeStegoFileRange(const ImageView *view, const char *filename, uint32_t offset, int length)
+int DecodeStegoFileRangeEnc(const ImageView *view, const char *filename, uint32_t offset, int length, const char *password)
+StegoReader *OpenStegoReader(const ImageView *view, const char *password)
    $
-   $Description: $
+   $Description: The payload starts with a STEGO_HEADER_BYTES header in
+   the first 32 pixels, one bit in each channel: the "STEG" magic, the
+   version, a byte of flags holding the depth - 1 and whether the payload
+   is compressed (see compression.cpp) or encrypted, the stripe index and
+   count, then the length of everything after the header and the CRC32C
+   (see checksum.cpp) of the index, most significant byte first. An
+   image without the magic and version is turned away before anything is
+   allocated for it. The rest starts at pixel 32 and uses the lowest depth
+   bits of every channel (see stego_kernels.cpp). A scattered payload
+   goes through the pixels from 32 on in an order made from a password
+   instead (see StegoScatter), the header is always in the first 32.
+
+   The data is split into STEGO_CHUNK_BYTES chunks that are compressed,
+   encrypted and checksummed on their own. The index comes first and
+   holds the length of the data, then the offset, length and CRC32C of
+   every chunk, so any byte of the data can be decoded by reading its
+   entry and its chunk, without touching the rest of the image
+   (DecodeStegoRange). Every chunk starts on a whole group of pixels at
+   every depth.
+
+   A payload striped across several images (see stripe.cpp) has the
+   STEGO_STRIPE_BYTES stripe header after the header in each of them, and
+   each image is a payload of its own holding part of the data.
+
+   An encrypted payload (the *Enc functions) has the ENCRYPT_HEADER_BYTES
+   of the encryption header in front of the index, and the chunks are
+   encrypted with AES-CTR (see encryption.cpp) at their offset. The index
+   isn't encrypted. Compression happens before encryption and the
+   checksums are of the encrypted bytes.
+
+   The checksum of each chunk is worked out by the thread that encodes or
+   decodes it, a part at a time while it is in the cache, so checking it
+   doesn't take another pass over the data. $
    $Revisions: $
    ======================================================================== */
 
-#include "steganography.h"
+#include "steganography.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "allocator.h"
+#include "checksum.h"
+#include "compression.h"
+#include "encryption.h"
+#include "image.h"
+#include "stego_kernels.h"
+#include "threads.h"
+#include "profiler.h"
+
+// Payloads smaller than this aren't worth starting threads for.
+#define STEGO_PARALLEL_MIN_BYTES (256 * 1024)
+
+// Every job is a multiple of this many bytes so the SIMD kernels never
+// have to drop to the scalar path in the middle of the payload, and a
+// job always starts on a whole group of pixels at every depth.
+#define STEGO_PARALLEL_ALIGN 192
+
+// The payload is encoded/decoded this many bytes at a time, so each part
+// is checksummed (and encrypted) while it is still in the cache. It is
+// whole groups of pixels and AES blocks.
+#define STEGO_PASS_BYTES (STEGO_PARALLEL_ALIGN * 32)
+
+// The header is the magic, the version, the flags, 2 zero bytes, the
+// length and the checksum.
+#define STEGO_MAGIC 0x53544547
+#define STEGO_VERSION 2
+#define STEGO_FLAG_DEPTH 0x03
+#define STEGO_FLAG_COMPRESSED 0x04
+#define STEGO_FLAG_ENCRYPTED 0x08
+#define STEGO_FLAG_SCATTERED 0x10
+
+// A payload striped across several images has the index of its stripe
+// and how many there are in bytes 6 and 7 of the header, which are 0
+// otherwise. The stripe header comes right after the header, at the
+// depth of the payload: the ID of the payload, the length of all of its
+// data and where this stripe's data starts in it, then 8 zero bytes so
+// it is whole groups of pixels at every depth.
+#define STEGO_MAX_STRIPES 255
+#define STEGO_STRIPE_BYTES 24
+
+// The header takes 16 bytes in the first 32 pixels.
+#define STEGO_HEADER_BYTES 16
+#define STEGO_HEADER_PIXELS 32
+
+// The length and the header together have to fit in an int.
+#define STEGO_MAX_LENGTH (0x7FFFFFFF - STEGO_HEADER_BYTES)
+
+// The data is split into chunks of this many bytes, which are compressed
+// and checksummed on their own so any of them can be decoded without the
+// rest. It is whole compression blocks and whole jobs.
+#define STEGO_CHUNK_BYTES (3 * COMPRESS_BLOCK_SIZE)
+
+// The biggest chunks an image can say it has, so a damaged index can't
+// ask for a huge buffer.
+#define STEGO_MAX_CHUNK_BYTES (16 * 1024 * 1024)
+
+// The index is the length of the data and the chunk size, then the
+// offset, length and checksum of each chunk. A compressed chunk has the
+// top bit of its length set. The index is padded to whole groups of
+// pixels at every depth, so the chunks start on one and any entry can be
+// decoded on its own.
+#define STEGO_INDEX_HEADER_BYTES 8
+#define STEGO_INDEX_ENTRY_BYTES 12
+#define STEGO_INDEX_ALIGN 24
+#define STEGO_CHUNK_COMPRESSED 0x80000000
+
+// What the header of a payload says.
+struct StegoHeader
+{
+    uint32_t Length;
+    int Depth;
+    int Compressed;
+    int Encrypted;
+    int Scattered;
+
+    // Which stripe the payload is and how many there are, both 0 if it
+    // isn't striped.
+    int StripeIndex;
+    int StripeCount;
+
+    // The CRC32C of the stripe header, the encryption header and the
+    // index, which holds the checksums of the chunks.
+    uint32_t Checksum;
+};
+
+// Where a chunk of the data is stored.
+struct StegoChunk
+{
+    // Where the chunk starts, counted from the end of the index, and how
+    // many bytes it takes. Every chunk but the last is padded to a
+    // multiple of STEGO_PARALLEL_ALIGN, so they all start on a whole
+    // group of pixels.
+    uint32_t Offset;
+    uint32_t Length;
+    int Compressed;
+
+    // The CRC32C of the chunk as it is stored, with its padding.
+    uint32_t Checksum;
+
+    // The bytes to store, while encoding.
+    const char *Data;
+};
+
+// The chunks of a payload and where they are.
+struct StegoIndex
+{
+    uint32_t DataLength;
+    uint32_t ChunkBytes;
+    uint32_t ChunkCount;
+    StegoChunk *Chunks;
+
+    // How many bytes the chunks take with their padding, and whether any
+    // of them are compressed.
+    uint32_t StoredLength;
+    int Compressed;
+
+    // Where the compressed chunks go while encoding, a slot for each.
+    char *Packed;
+};
+
+// Where the data of a payload is once the header, the encryption header
+// if there is one and the start of the index have been read.
+struct StegoPayload
+{
+    int Depth;
+
+    // Set if the payload is scattered over the image with Scatter.
+    int Scattered;
+    StegoScatter Scatter;
+
+    // The pixels the index and the chunks start at.
+    uint32_t IndexPixel;
+    uint32_t Pixel;
+
+    // The index, which only has the entries that have been read.
+    StegoIndex Index;
+
+    // The checksum of the bytes before the index, which the checksum of
+    // the index is added on to, and the checksum from the header.
+    uint32_t Checksum;
+    uint32_t StoredChecksum;
+};
+
+// A payload that has been opened for decoding ranges of (see
+// OpenStegoReader). Payload never has any of the chunk entries, each range
+// reads the ones it needs into a copy of it.
+struct StegoReader
+{
+    Image *Carrier;
+
+    // The image that borrows the pixels of a view, if the reader was
+    // opened on one. Carrier points at it.
+    Image View;
+
+    StegoPayload Payload;
+    Cipher Key;
+    int Encrypted;
+};
+
+// A part of the payload that is encoded/decoded by the worker threads.
+// It is either split evenly into parts of PartSize, or a job per chunk
+// if Index is set.
+struct StegoJob
+{
+    Image *Carrier;
+    char *Buffer;
+    int Count;
+    uint32_t Pixel;
+    int Depth;
+    int PartSize;
+
+    // Set if the payload is scattered, see StegoScatter.
+    const StegoScatter *Scatter;
+
+    // Set if the chunks are encrypted on the way in or out. Byte 0 of the
+    // chunks is at offset 0 of the cipher.
+    const Cipher *Key;
+
+    // The checksum of each part of the bytes as they are stored.
+    uint32_t *Checksums;
+
+    // The chunks from FirstChunk on. Chunk FirstChunk + i is decoded to
+    // Buffer + i * ChunkBytes and Results[i] says whether it worked.
+    StegoIndex *Index;
+    uint32_t FirstChunk;
+    int *Results;
+};
+
+// Where the next byte of the header or payload goes. The header is
+// always at depth 1 and the payload at Depth, so the bytes have to be
+// handed out a part at a time.
+struct StegoCursor
+{
+    uint32_t Byte;
+    uint32_t Pixel;
+    int Depth;
+};
+
+// Which part of the payload the streaming functions are up to.
+enum StegoStage
+{
+    STEGO_STAGE_HEADER,
+    STEGO_STAGE_INDEX,
+    STEGO_STAGE_CHUNKS,
+    STEGO_STAGE_DONE
+};
+
+// Feeds the streaming encoder the bytes that get encoded: the header,
+// the index and then the chunks of the NUL terminated filename and the
+// contents of the file.
+struct StegoSource
+{
+    StegoStage Stage;
+    uint32_t Done;
+
+    // The checksums aren't known until the chunks have been encoded, so
+    // these are written again at the end.
+    char Header[STEGO_HEADER_BYTES];
+    char *IndexBytes;
+    uint32_t IndexLength;
+
+    const char *Name;
+    int NameLength;
+    int NameDone;
+
+    FILE *File;
+
+    // A file that can't be measured before it is encoded, like a pipe, is
+    // read into a slot for each of its chunks first, already compressed.
+    char **Spill;
+    uint32_t SpillCount;
+
+    // The chunk being encoded. Block is read from the file and ChunkData
+    // is either it or Packed, what it was compressed to. Offset is where
+    // the next chunk goes, as the chunks are placed once they are read.
+    StegoIndex Index;
+    uint32_t Chunk;
+    uint32_t Offset;
+    char *Block;
+    char *Packed;
+    const char *ChunkData;
+};
+
+// Takes the decoded bytes of a file in order and writes the contents out
+// a chunk at a time, once the chunk has been checked.
+struct StegoSink
+{
+    StegoStage Stage;
+
+    // The header, how many bytes are stored after it and at what depth.
+    char Header[STEGO_HEADER_BYTES];
+    uint32_t HeaderDone;
+    uint32_t StoredLength;
+    uint32_t StoredChecksum;
+    int Depth;
+
+    // The index is read in two goes, first the part with its header and
+    // then the rest once the number of chunks is known.
+    StegoIndex Index;
+    char *IndexBytes;
+    uint32_t IndexLength;
+    uint32_t IndexDone;
+
+    // The chunk being read and the checksum of it so far. Output is what
+    // a compressed chunk decompresses to.
+    uint32_t Chunk;
+    char *ChunkBytes;
+    uint32_t ChunkDone;
+    uint32_t Checksum;
+    char *Output;
+
+    // The length of the filename and contents.
+    uint32_t DataLength;
+    uint32_t DataDone;
+
+    // The filename stored in the image.
+    char *Name;
+    uint32_t NameLength;
+    uint32_t NameSize;
+    int NameDone;
+
+    // The file to write to, Filename is 0 if Name is used.
+    const char *Filename;
+    FILE *File;
+
+    // How many pixels the image has.
+    uint32_t PixelCount;
+
+    // Set if a chunk turned out to be damaged, so the part of the file
+    // that was written gets deleted.
+    int Damaged;
+};
+
+// How many threads encode/decode with, 0 uses one per processor.
+static int stego_threads = 1;
+
+// Set on a thread that runs a job of its own, like a job of a batch, so
+// its encodes and decodes use that many threads instead. 0 if it isn't.
+static __thread int stego_job_threads = 0;
+
+// How many bits of each channel new payloads use.
+static int stego_depth = 1;
+
+// Whether new payloads are compressed.
+static int stego_compression = 0;
+
+// Whether new payloads are scattered, and the key the order is made from.
+static int stego_scatter = 0;
+static uint8_t stego_scatter_key[STEGO_SCATTER_KEY_BYTES];
+
+// The scatter key is made from the password with this salt, so the same
+// password always gives the same order.
+static const uint8_t stego_scatter_salt[ENCRYPT_SALT_BYTES] = {
+    'S', 'T', 'E', 'G', ' ', 's', 'c', 'a', 't', 't', 'e', 'r', ' ', 'k', 'e', 'y'
+};
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartStegoPayloadScatter
+   $Prototype: static int StartStegoPayloadScatter(Image *image, const StegoHeader *header, StegoPayload *payload)
+   $Params:
+       image: The image the payload is in
+       header: The header of the payload
+       payload: Its Scatter gets set up if the header says it is scattered.
+   $
+   $Description: Works out the order a scattered payload is in. Returns 0
+   on success and -1 if it is scattered and there is no scatter key, or
+   the image is too small to scatter over. $
+   ======================================================================== */
+static int StartStegoPayloadScatter(Image *image, const StegoHeader *header, StegoPayload *payload)
+{
+    payload->Scattered = header->Scattered;
+
+    if (!header->Scattered)
+    {
+        return 0;
+    }
+
+    if (!stego_scatter)
+    {
+        printf("Cannot decode image. The data is scattered, it needs the scatter password.\n");
+        return -1;
+    }
+
+    if (StartStegoScatter(&payload->Scatter, stego_scatter_key, STEGO_HEADER_PIXELS, GetStegoImagePixels(image)) != 0)
+    {
+        printf("Cannot decode image. It is too small to have a scattered payload.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoPayloadScatter
+   $Prototype: static const StegoScatter *GetStegoPayloadScatter(const StegoPayload *payload)
+   $Params:
+       payload: The payload
+   $
+   $Description: Returns the scatter to hand to the kernels, 0 if the
+   payload isn't scattered. $
+   ======================================================================== */
+static const StegoScatter *GetStegoPayloadScatter(const StegoPayload *payload)
+{
+    return payload->Scattered ? &payload->Scatter : 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoSpan
+   $Prototype: static uint32_t EncodeStegoSpan(StegoJob *job, const char *buffer, uint32_t start, int count)
+   $Params:
+       job: The payload that is being encoded
+       buffer: The bytes to encode.
+       start: Where the bytes go, counted from job->Pixel. It is a
+              multiple of STEGO_PARALLEL_ALIGN.
+       count: How many bytes to encode.
+   $
+   $Description: Encodes part of the payload a STEGO_PASS_BYTES at a time.
+   Each pass is encrypted into a buffer if there is a key, checksummed and
+   encoded while it is still in the cache, so the plain bytes are only
+   read once. Returns the checksum of the bytes as they are stored,
+   started from 0. $
+   ======================================================================== */
+static uint32_t EncodeStegoSpan(StegoJob *job, const char *buffer, uint32_t start, int count)
+{
+    char crypted[STEGO_PASS_BYTES];
+    uint32_t checksum = 0;
+
+    for(int done = 0; done < count; done += STEGO_PASS_BYTES)
+    {
+        int bytes = (count - done < STEGO_PASS_BYTES) ? (count - done) : STEGO_PASS_BYTES;
+        const char *pass = buffer + done;
+
+        if (job->Key)
+        {
+            CryptBytes(job->Key, start + done, (const uint8_t*)pass, (uint8_t*)crypted, bytes);
+            pass = crypted;
+        }
+
+        checksum = UpdateChecksum(checksum, (const uint8_t*)pass, bytes);
+        EncodeStegoBytesScattered(job->Carrier, pass, bytes, job->Pixel + GetStegoPixelCount(start + done, job->Depth), job->Depth, job->Scatter);
+    }
+
+    return checksum;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoSpan
+   $Prototype: static uint32_t DecodeStegoSpan(StegoJob *job, char *buffer, uint32_t start, int count)
+   $Params:
+       job: The payload that is being decoded
+       buffer: Where to decode the bytes to.
+       start: Where the bytes are, counted from job->Pixel. It is a
+              multiple of STEGO_PARALLEL_ALIGN.
+       count: How many bytes to decode.
+   $
+   $Description: Decodes part of the payload a STEGO_PASS_BYTES at a time,
+   checksumming each pass and then decrypting it in place as soon as it is
+   decoded. Returns the checksum of the bytes as they were stored, started
+   from 0. $
+   ======================================================================== */
+static uint32_t DecodeStegoSpan(StegoJob *job, char *buffer, uint32_t start, int count)
+{
+    uint32_t checksum = 0;
+
+    for(int done = 0; done < count; done += STEGO_PASS_BYTES)
+    {
+        int bytes = (count - done < STEGO_PASS_BYTES) ? (count - done) : STEGO_PASS_BYTES;
+        uint8_t *pass = (uint8_t*)buffer + done;
+
+        DecodeStegoBytesScattered(job->Carrier, job->Pixel + GetStegoPixelCount(start + done, job->Depth), (char*)pass, bytes, job->Depth, job->Scatter);
+        checksum = UpdateChecksum(checksum, pass, bytes);
+
+        if (job->Key)
+        {
+            CryptBytes(job->Key, start + done, pass, pass, bytes);
+        }
+    }
+
+    return checksum;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoJob
+   $Prototype: static void EncodeStegoJob(void *data, int index)
+   $Params:
+       data: The StegoJob to encode.
+       index: Which part of the payload to encode.
+   $
+   $Description: Encodes one part of the payload. Byte i always lands in
+   the same pixels and every part is whole groups, so the parts don't
+   overlap. $
+   ======================================================================== */
+static void EncodeStegoJob(void *data, int index)
+{
+    TIMED_BLOCK();
+
+    StegoJob *job = (StegoJob*)data;
+    int start = index * job->PartSize;
+    int count = job->Count - start;
+
+    if (count > job->PartSize)
+    {
+        count = job->PartSize;
+    }
+
+    job->Checksums[index] = EncodeStegoSpan(job, job->Buffer + start, start, count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoJob
+   $Prototype: static void DecodeStegoJob(void *data, int index)
+   $Params:
+       data: The StegoJob to decode.
+       index: Which part of the payload to decode.
+   $
+   $Description: Decodes one part of the payload. $
+   ======================================================================== */
+static void DecodeStegoJob(void *data, int index)
+{
+    TIMED_BLOCK();
+
+    StegoJob *job = (StegoJob*)data;
+    int start = index * job->PartSize;
+    int count = job->Count - start;
+
+    if (count > job->PartSize)
+    {
+        count = job->PartSize;
+    }
+
+    job->Checksums[index] = DecodeStegoSpan(job, job->Buffer + start, start, count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SplitStegoJob
+   $Prototype: static int SplitStegoJob(StegoJob *job, int thread_count)
+   $Params:
+       job: The job to split up. PartSize and Checksums get filled out.
+       thread_count: How many threads will be working on it.
+   $
+   $Description: Splits the payload into a few parts per thread so a slow
+   thread doesn't hold up the rest. Returns how many parts there are. $
+   ======================================================================== */
+static int SplitStegoJob(StegoJob *job, int thread_count)
+{
+    int part_count = thread_count * 4;
+
+    job->PartSize = (job->Count + part_count - 1) / part_count;
+    job->PartSize = ((job->PartSize + STEGO_PARALLEL_ALIGN - 1) / STEGO_PARALLEL_ALIGN) * STEGO_PARALLEL_ALIGN;
+
+    part_count = (job->Count + job->PartSize - 1) / job->PartSize;
+    job->Checksums = (uint32_t*)AllocateMemory(MEMORY_CHUNK, part_count * sizeof(uint32_t));
+
+    return part_count;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CombineStegoJob
+   $Prototype: static uint32_t CombineStegoJob(StegoJob *job, int part_count)
+   $Params:
+       job: The job that was split up and run.
+       part_count: What SplitStegoJob returned.
+   $
+   $Description: Adds the checksums of the parts together in order and
+   frees them. Returns the checksum of the whole job, started from 0. $
+   ======================================================================== */
+static uint32_t CombineStegoJob(StegoJob *job, int part_count)
+{
+    uint32_t checksum = 0;
+
+    for(int i = 0; i < part_count; i++)
+    {
+        int count = job->Count - (i * job->PartSize);
+
+        if (count > job->PartSize)
+        {
+            count = job->PartSize;
+        }
+
+        checksum = CombineChecksum(checksum, job->Checksums[i], count);
+    }
+
+    FreeMemory(job->Checksums);
+
+    return checksum;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoParallel
+   $Prototype: static uint32_t EncodeStegoParallel(Image *image, const char *buffer, int count, uint32_t pixel, int depth, const StegoScatter *scatter)
+   $Params:
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at
+       depth: How many bits of each channel to use.
+       scatter: The scatter of the payload, or 0.
+   $
+   $Description: Encodes the buffer on the stego threads. The output is
+   the same no matter how many threads are used. Returns the checksum of
+   the bytes, started from 0. $
+   ======================================================================== */
+static uint32_t EncodeStegoParallel(Image *image, const char *buffer, int count, uint32_t pixel, int depth, const StegoScatter *scatter)
+{
+    int thread_count = GetStegoThreads();
+    int part_count;
+    StegoJob job;
+
+    memset(&job, 0, sizeof(StegoJob));
+    job.Carrier = image;
+    job.Buffer = (char*)buffer;
+    job.Count = count;
+    job.Pixel = pixel;
+    job.Depth = depth;
+    job.Scatter = scatter;
+
+    if (thread_count == 1 || count < STEGO_PARALLEL_MIN_BYTES)
+    {
+        return EncodeStegoSpan(&job, buffer, 0, count);
+    }
+
+    part_count = SplitStegoJob(&job, thread_count);
+    ParallelFor(thread_count, part_count, EncodeStegoJob, &job);
+
+    return CombineStegoJob(&job, part_count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoParallel
+   $Prototype: static uint32_t DecodeStegoParallel(Image *image, uint32_t pixel, char *buffer, int count, int depth, const StegoScatter *scatter)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+       depth: How many bits of each channel were used.
+       scatter: The scatter of the payload, or 0.
+   $
+   $Description: Decodes into the buffer on the stego threads. Returns the
+   checksum of the bytes, started from 0. $
+   ======================================================================== */
+static uint32_t DecodeStegoParallel(Image *image, uint32_t pixel, char *buffer, int count, int depth, const StegoScatter *scatter)
+{
+    int thread_count = GetStegoThreads();
+    int part_count;
+    StegoJob job;
+
+    memset(&job, 0, sizeof(StegoJob));
+    job.Carrier = image;
+    job.Buffer = buffer;
+    job.Count = count;
+    job.Pixel = pixel;
+    job.Depth = depth;
+    job.Scatter = scatter;
+
+    if (thread_count == 1 || count < STEGO_PARALLEL_MIN_BYTES)
+    {
+        return DecodeStegoSpan(&job, buffer, 0, count);
+    }
+
+    part_count = SplitStegoJob(&job, thread_count);
+    ParallelFor(thread_count, part_count, DecodeStegoJob, &job);
+
+    return CombineStegoJob(&job, part_count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoHeader
+   $Prototype: static void SetStegoHeader(char *bytes, const StegoHeader *header)
+   $Params:
+       bytes: The STEGO_HEADER_BYTES to fill in.
+       header: What goes in them. The length is at most STEGO_MAX_LENGTH.
+   $
+   $Description: Makes the bytes that go in the first 32 pixels. $
+   ======================================================================== */
+static void SetStegoHeader(char *bytes, const StegoHeader *header)
+{
+    uint8_t *out = (uint8_t*)bytes;
+    uint8_t flags = (uint8_t)(header->Depth - 1);
+
+    if (header->Compressed)
+    {
+        flags |= STEGO_FLAG_COMPRESSED;
+    }
+
+    if (header->Encrypted)
+    {
+        flags |= STEGO_FLAG_ENCRYPTED;
+    }
+
+    if (header->Scattered)
+    {
+        flags |= STEGO_FLAG_SCATTERED;
+    }
+
+    memset(out, 0, STEGO_HEADER_BYTES);
+
+    // Most significant byte first.
+    out[0] = (uint8_t)(STEGO_MAGIC >> 24);
+    out[1] = (uint8_t)(STEGO_MAGIC >> 16);
+    out[2] = (uint8_t)(STEGO_MAGIC >> 8);
+    out[3] = (uint8_t)STEGO_MAGIC;
+    out[4] = STEGO_VERSION;
+    out[5] = flags;
+    out[6] = (uint8_t)header->StripeIndex;
+    out[7] = (uint8_t)header->StripeCount;
+
+    out[8] = (uint8_t)(header->Length >> 24);
+    out[9] = (uint8_t)(header->Length >> 16);
+    out[10] = (uint8_t)(header->Length >> 8);
+    out[11] = (uint8_t)header->Length;
+
+    out[12] = (uint8_t)(header->Checksum >> 24);
+    out[13] = (uint8_t)(header->Checksum >> 16);
+    out[14] = (uint8_t)(header->Checksum >> 8);
+    out[15] = (uint8_t)header->Checksum;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoHeader
+   $Prototype: static int GetStegoHeader(const char *bytes, StegoHeader *header)
+   $Params:
+       bytes: The STEGO_HEADER_BYTES from the first 32 pixels.
+       header: Gets filled out.
+   $
+   $Description: Reads the header. Returns 0 on success, -1 if the bytes
+   don't have the magic or known flags, which is what an image without a
+   payload gives, and -2 if the payload is from another version. $
+   ======================================================================== */
+static int GetStegoHeader(const char *bytes, StegoHeader *header)
+{
+    const uint8_t *in = (const uint8_t*)bytes;
+    uint32_t magic = ((uint32_t)in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3];
+
+    if (magic != STEGO_MAGIC)
+    {
+        return -1;
+    }
+
+    if (in[4] != STEGO_VERSION)
+    {
+        return -2;
+    }
+
+    // A stripe index has to be less than the stripe count.
+    if (((in[7] == 0) ? (in[6] != 0) : (in[6] >= in[7])) ||
+        (in[5] & ~(STEGO_FLAG_DEPTH | STEGO_FLAG_COMPRESSED | STEGO_FLAG_ENCRYPTED | STEGO_FLAG_SCATTERED)) != 0)
+    {
+        return -1;
+    }
+
+    header->Depth = (in[5] & STEGO_FLAG_DEPTH) + 1;
+    header->Compressed = (in[5] & STEGO_FLAG_COMPRESSED) ? 1 : 0;
+    header->Encrypted = (in[5] & STEGO_FLAG_ENCRYPTED) ? 1 : 0;
+    header->Scattered = (in[5] & STEGO_FLAG_SCATTERED) ? 1 : 0;
+    header->StripeIndex = in[6];
+    header->StripeCount = in[7];
+    header->Length = ((uint32_t)in[8] << 24) | (in[9] << 16) | (in[10] << 8) | in[11];
+    header->Checksum = ((uint32_t)in[12] << 24) | (in[13] << 16) | (in[14] << 8) | in[15];
+
+    if (header->Length > STEGO_MAX_LENGTH)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoHeaderImagePixels
+   $Prototype: static uint32_t GetStegoHeaderImagePixels(const Image *format, uint32_t pixel_count)
+   $Params:
+       format: The image that is being streamed
+       pixel_count: How many of the first pixels are needed.
+   $
+   $Description: Returns how many pixels of the image have to be read to
+   get the first pixel_count. 24 bit bitmaps are read in whole rows, so it
+   is the rows that hold them. Returns 0 if the image is too small for
+   them. $
+   ======================================================================== */
+static uint32_t GetStegoHeaderImagePixels(const Image *format, uint32_t pixel_count)
+{
+    uint32_t row_pixels;
+    uint32_t rows;
+
+    if (format->BitsPerPixel != 24)
+    {
+        return (format->PixelCount < pixel_count) ? 0 : pixel_count;
+    }
+
+    if ((row_pixels = GetStegoRowPixels(format)) == 0)
+    {
+        return 0;
+    }
+
+    rows = (pixel_count + row_pixels - 1) / row_pixels;
+
+    return (rows > format->Height) ? 0 : rows * format->Width;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoWord
+   $Prototype: static void SetStegoWord(char *bytes, uint32_t value)
+   $Params:
+       bytes: Where the 4 bytes go
+       value: The value to write
+   $
+   $Description: Writes a value of the index, most significant byte
+   first like the header. $
+   ======================================================================== */
+static void SetStegoWord(char *bytes, uint32_t value)
+{
+    uint8_t *out = (uint8_t*)bytes;
+
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoWord
+   $Prototype: static uint32_t GetStegoWord(const char *bytes)
+   $Params:
+       bytes: The 4 bytes to read
+   $
+   $Description: Reads a value of the index. $
+   ======================================================================== */
+static uint32_t GetStegoWord(const char *bytes)
+{
+    const uint8_t *in = (const uint8_t*)bytes;
+
+    return ((uint32_t)in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3];
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoStripe
+   $Prototype: static void SetStegoStripe(char *bytes, const StegoStripe *stripe)
+   $Params:
+       bytes: The STEGO_STRIPE_BYTES to fill in.
+       stripe: The stripe to write
+   $
+   $Description: Makes the stripe header, which goes after the header. $
+   ======================================================================== */
+static void SetStegoStripe(char *bytes, const StegoStripe *stripe)
+{
+    memset(bytes, 0, STEGO_STRIPE_BYTES);
+    SetStegoWord(bytes, (uint32_t)(stripe->PayloadId >> 32));
+    SetStegoWord(bytes + 4, (uint32_t)stripe->PayloadId);
+    SetStegoWord(bytes + 8, stripe->DataLength);
+    SetStegoWord(bytes + 12, stripe->Offset);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoStripe
+   $Prototype: static int GetStegoStripe(const char *bytes, StegoStripe *stripe)
+   $Params:
+       bytes: The STEGO_STRIPE_BYTES after the header.
+       stripe: Gets the ID, data length and offset.
+   $
+   $Description: Reads the stripe header. Returns 0 on success and -1 if
+   it is damaged. $
+   ======================================================================== */
+static int GetStegoStripe(const char *bytes, StegoStripe *stripe)
+{
+    stripe->PayloadId = ((uint64_t)GetStegoWord(bytes) << 32) | GetStegoWord(bytes + 4);
+    stripe->DataLength = GetStegoWord(bytes + 8);
+    stripe->Offset = GetStegoWord(bytes + 12);
+
+    if (GetStegoWord(bytes + 16) != 0 || GetStegoWord(bytes + 20) != 0 ||
+        stripe->Offset > stripe->DataLength)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoIndexBytes
+   $Prototype: static uint32_t GetStegoIndexBytes(uint32_t chunk_count)
+   $Params:
+       chunk_count: How many chunks there are.
+   $
+   $Description: Returns how many bytes the index takes, with its
+   padding. $
+   ======================================================================== */
+static uint32_t GetStegoIndexBytes(uint32_t chunk_count)
+{
+    uint32_t length = STEGO_INDEX_HEADER_BYTES + (chunk_count * STEGO_INDEX_ENTRY_BYTES);
+
+    return ((length + STEGO_INDEX_ALIGN - 1) / STEGO_INDEX_ALIGN) * STEGO_INDEX_ALIGN;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoChunkLength
+   $Prototype: static uint32_t GetStegoChunkLength(const StegoIndex *index, uint32_t chunk)
+   $Params:
+       index: The index of the payload
+       chunk: Which chunk
+   $
+   $Description: Returns how many bytes of the data are in the chunk,
+   which is ChunkBytes for every chunk but the last. $
+   ======================================================================== */
+static uint32_t GetStegoChunkLength(const StegoIndex *index, uint32_t chunk)
+{
+    uint32_t start = chunk * index->ChunkBytes;
+
+    return (index->DataLength - start < index->ChunkBytes) ? (index->DataLength - start) : index->ChunkBytes;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoChunkStored
+   $Prototype: static uint32_t GetStegoChunkStored(const StegoIndex *index, uint32_t chunk)
+   $Params:
+       index: The index of the payload
+       chunk: Which chunk
+   $
+   $Description: Returns how many bytes the chunk takes in the image. Every
+   chunk but the last is padded to a multiple of STEGO_PARALLEL_ALIGN. $
+   ======================================================================== */
+static uint32_t GetStegoChunkStored(const StegoIndex *index, uint32_t chunk)
+{
+    uint32_t length = index->Chunks[chunk].Length;
+
+    if (chunk + 1 == index->ChunkCount)
+    {
+        return length;
+    }
+
+    return ((length + STEGO_PARALLEL_ALIGN - 1) / STEGO_PARALLEL_ALIGN) * STEGO_PARALLEL_ALIGN;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoChunkSlot
+   $Prototype: static uint32_t GetStegoChunkSlot(const StegoIndex *index)
+   $Params:
+       index: The index of the payload
+   $
+   $Description: Returns the most bytes a chunk can take in the image,
+   compressed and padded. $
+   ======================================================================== */
+static uint32_t GetStegoChunkSlot(const StegoIndex *index)
+{
+    uint32_t bound = GetCompressBound(index->ChunkBytes);
+
+    return ((bound + STEGO_PARALLEL_ALIGN - 1) / STEGO_PARALLEL_ALIGN) * STEGO_PARALLEL_ALIGN;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: AllocateStegoChunks
+   $Prototype: static StegoChunk *AllocateStegoChunks(uint32_t chunk_count)
+   $Params:
+       chunk_count: How many chunks the index has.
+   $
+   $Description: Gets the zeroed chunks of an index from the memory pool,
+   with one more at the end. FreeStegoIndex frees them. $
+   ======================================================================== */
+static StegoChunk *AllocateStegoChunks(uint32_t chunk_count)
+{
+    size_t bytes = ((size_t)chunk_count + 1) * sizeof(StegoChunk);
+    StegoChunk *chunks = (StegoChunk*)AllocateMemory(MEMORY_CHUNK, bytes);
+
+    memset(chunks, 0, bytes);
+
+    return chunks;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GrowStegoBuffer
+   $Prototype: static void *GrowStegoBuffer(MemoryUse use, void *buffer, size_t used, size_t size)
+   $Params:
+       use: What the buffer is for
+       buffer: The buffer to grow, or 0.
+       used: How many bytes of it to keep
+       size: How big it needs to be
+   $
+   $Description: The pool only hands out blocks of the size they were
+   asked for, so this gets a new one and moves the used bytes into it.
+   Returns the new buffer, buffer itself is freed. $
+   ======================================================================== */
+static void *GrowStegoBuffer(MemoryUse use, void *buffer, size_t used, size_t size)
+{
+    void *grown = AllocateMemory(use, size);
+
+    if (used > 0)
+    {
+        memcpy(grown, buffer, used);
+    }
+
+    FreeMemory(buffer);
+
+    return grown;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartStegoIndex
+   $Prototype: static void StartStegoIndex(StegoIndex *index, uint32_t data_length)
+   $Params:
+       index: The index to set up
+       data_length: How long the data is.
+   $
+   $Description: Splits the data into chunks that are stored as they are.
+   FreeStegoIndex frees it. $
+   ======================================================================== */
+static void StartStegoIndex(StegoIndex *index, uint32_t data_length)
+{
+    memset(index, 0, sizeof(StegoIndex));
+    index->DataLength = data_length;
+    index->ChunkBytes = STEGO_CHUNK_BYTES;
+    index->ChunkCount = (data_length + STEGO_CHUNK_BYTES - 1) / STEGO_CHUNK_BYTES;
+    index->Chunks = AllocateStegoChunks(index->ChunkCount);
+
+    for(uint32_t i = 0; i < index->ChunkCount; i++)
+    {
+        index->Chunks[i].Length = GetStegoChunkLength(index, i);
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: PlaceStegoChunks
+   $Prototype: static void PlaceStegoChunks(StegoIndex *index)
+   $Params:
+       index: The index, once the length of every chunk is known.
+   $
+   $Description: Works out where each chunk goes, one after the other. $
+   ======================================================================== */
+static void PlaceStegoChunks(StegoIndex *index)
+{
+    uint32_t offset = 0;
+
+    index->Compressed = 0;
+
+    for(uint32_t i = 0; i < index->ChunkCount; i++)
+    {
+        index->Chunks[i].Offset = offset;
+        index->Compressed |= index->Chunks[i].Compressed;
+        offset += GetStegoChunkStored(index, i);
+    }
+
+    index->StoredLength = offset;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FreeStegoIndex
+   $Prototype: static void FreeStegoIndex(StegoIndex *index)
+   $Params:
+       index: The index to free
+   $
+   $Description: Frees the chunks of an index. $
+   ======================================================================== */
+static void FreeStegoIndex(StegoIndex *index)
+{
+    FreeMemory(index->Chunks);
+    FreeMemory(index->Packed);
+    index->Chunks = 0;
+    index->Packed = 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoIndex
+   $Prototype: static void SetStegoIndex(char *bytes, const StegoIndex *index)
+   $Params:
+       bytes: The GetStegoIndexBytes to fill in.
+       index: What goes in them.
+   $
+   $Description: Makes the bytes of the index. $
+   ======================================================================== */
+static void SetStegoIndex(char *bytes, const StegoIndex *index)
+{
+    memset(bytes, 0, GetStegoIndexBytes(index->ChunkCount));
+    SetStegoWord(bytes, index->DataLength);
+    SetStegoWord(bytes + 4, index->ChunkBytes);
+
+    for(uint32_t i = 0; i < index->ChunkCount; i++)
+    {
+        const StegoChunk *chunk = &index->Chunks[i];
+        char *entry = bytes + STEGO_INDEX_HEADER_BYTES + (i * STEGO_INDEX_ENTRY_BYTES);
+
+        SetStegoWord(entry, chunk->Offset);
+        SetStegoWord(entry + 4, chunk->Length | (chunk->Compressed ? STEGO_CHUNK_COMPRESSED : 0));
+        SetStegoWord(entry + 8, chunk->Checksum);
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoIndexHeader
+   $Prototype: static int GetStegoIndexHeader(const char *bytes, StegoIndex *index, uint32_t stored_length)
+   $Params:
+       bytes: The first STEGO_INDEX_ALIGN bytes of the index.
+       index: Gets filled out, without any chunks.
+       stored_length: How many bytes the index and the chunks have.
+   $
+   $Description: Reads the length of the data and the chunk size. Returns
+   0 on success and -1 if they are bad or the index doesn't fit. $
+   ======================================================================== */
+static int GetStegoIndexHeader(const char *bytes, StegoIndex *index, uint32_t stored_length)
+{
+    uint32_t index_bytes;
+
+    memset(index, 0, sizeof(StegoIndex));
+    index->DataLength = GetStegoWord(bytes);
+    index->ChunkBytes = GetStegoWord(bytes + 4);
+
+    if (index->DataLength > 0x7FFFFFFF || index->ChunkBytes == 0 ||
+        index->ChunkBytes > STEGO_MAX_CHUNK_BYTES || (index->ChunkBytes % STEGO_PARALLEL_ALIGN) != 0)
+    {
+        return -1;
+    }
+
+    index->ChunkCount = (index->DataLength + index->ChunkBytes - 1) / index->ChunkBytes;
+    index_bytes = GetStegoIndexBytes(index->ChunkCount);
+
+    if (index_bytes > stored_length)
+    {
+        return -1;
+    }
+
+    index->StoredLength = stored_length - index_bytes;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoChunk
+   $Prototype: static int GetStegoChunk(const char *bytes, StegoIndex *index, uint32_t chunk)
+   $Params:
+       bytes: The entry of the chunk in the index.
+       index: The index to fill in the chunk of.
+       chunk: Which chunk it is
+   $
+   $Description: Reads the entry of a chunk. Returns 0 on success and -1
+   if it doesn't fit in the image or its length can't be right. $
+   ======================================================================== */
+static int GetStegoChunk(const char *bytes, StegoIndex *index, uint32_t chunk)
+{
+    StegoChunk *entry = &index->Chunks[chunk];
+    uint32_t length = GetStegoChunkLength(index, chunk);
+    uint32_t stored;
+
+    entry->Offset = GetStegoWord(bytes);
+    entry->Length = GetStegoWord(bytes + 4) & ~STEGO_CHUNK_COMPRESSED;
+    entry->Compressed = (GetStegoWord(bytes + 4) & STEGO_CHUNK_COMPRESSED) ? 1 : 0;
+    entry->Checksum = GetStegoWord(bytes + 8);
+
+    if (entry->Compressed ? (entry->Length < COMPRESS_HEADER_BYTES || entry->Length > GetCompressBound(length))
+                          : (entry->Length != length))
+    {
+        return -1;
+    }
+
+    stored = GetStegoChunkStored(index, chunk);
+
+    if ((entry->Offset % STEGO_PARALLEL_ALIGN) != 0 || (uint64_t)entry->Offset + stored > index->StoredLength)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoChunkChecksum
+   $Prototype: static uint32_t GetStegoChunkChecksum(uint32_t checksum, uint32_t count)
+   $Params:
+       checksum: The checksum of a chunk, started from 0.
+       count: How many bytes the chunk is stored in.
+   $
+   $Description: Returns the finished CRC32C of the chunk, which is what
+   goes in the index. $
+   ======================================================================== */
+static uint32_t GetStegoChunkChecksum(uint32_t checksum, uint32_t count)
+{
+    return FinishChecksum(CombineChecksum(CHECKSUM_START, checksum, count));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoChunkJob
+   $Prototype: static void EncodeStegoChunkJob(void *data, int index)
+   $Params:
+       data: The StegoJob to encode.
+       index: Which chunk to encode.
+   $
+   $Description: Encodes one chunk and fills in its checksum. $
+   ======================================================================== */
+static void EncodeStegoChunkJob(void *data, int index)
+{
+    TIMED_BLOCK();
+
+    StegoJob *job = (StegoJob*)data;
+    StegoChunk *chunk = &job->Index->Chunks[index];
+    uint32_t stored = GetStegoChunkStored(job->Index, index);
+
+    chunk->Checksum = GetStegoChunkChecksum(EncodeStegoSpan(job, chunk->Data, chunk->Offset, stored), stored);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: UnpackStegoChunk
+   $Prototype: static int UnpackStegoChunk(const StegoIndex *index, uint32_t chunk, const char *bytes, uint32_t checksum, char *output)
+   $Params:
+       index: The index of the payload
+       chunk: Which chunk it is
+       bytes: The chunk as it was stored, decrypted.
+       checksum: The checksum of the chunk as it was stored, started from 0.
+       output: Where a compressed chunk is decompressed to. A chunk that
+               isn't compressed is left in bytes.
+   $
+   $Description: Checks the chunk against the index and decompresses it
+   if it was compressed. Returns 0 on success, -1 if the checksum doesn't
+   match and -2 if the compressed data is bad. $
+   ======================================================================== */
+static int UnpackStegoChunk(const StegoIndex *index, uint32_t chunk, const char *bytes, uint32_t checksum, char *output)
+{
+    const StegoChunk *entry = &index->Chunks[chunk];
+    uint32_t length = GetStegoChunkLength(index, chunk);
+
+    if (GetStegoChunkChecksum(checksum, GetStegoChunkStored(index, chunk)) != entry->Checksum)
+    {
+        return -1;
+    }
+
+    if (entry->Compressed &&
+        DecompressBuffer((const uint8_t*)bytes, entry->Length, (uint8_t*)output, length) != (int)length)
+    {
+        return -2;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoChunk
+   $Prototype: static int DecodeStegoChunk(StegoJob *job, uint32_t chunk, char *output)
+   $Params:
+       job: The payload that is being decoded
+       chunk: Which chunk to decode
+       output: Where the data of the chunk goes.
+   $
+   $Description: Decodes, checks, decrypts and decompresses one chunk.
+   Returns what UnpackStegoChunk does. $
+   ======================================================================== */
+static int DecodeStegoChunk(StegoJob *job, uint32_t chunk, char *output)
+{
+    const StegoChunk *entry = &job->Index->Chunks[chunk];
+    uint32_t stored = GetStegoChunkStored(job->Index, chunk);
+    uint32_t checksum;
+    char *packed;
+    int result;
+
+    if (!entry->Compressed)
+    {
+        checksum = DecodeStegoSpan(job, output, entry->Offset, stored);
+        return UnpackStegoChunk(job->Index, chunk, output, checksum, output);
+    }
+
+    packed = (char*)AllocateMemory(MEMORY_CHUNK, stored);
+    checksum = DecodeStegoSpan(job, packed, entry->Offset, stored);
+    result = UnpackStegoChunk(job->Index, chunk, packed, checksum, output);
+    FreeMemory(packed);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoChunkJob
+   $Prototype: static void DecodeStegoChunkJob(void *data, int index)
+   $Params:
+       data: The StegoJob to decode.
+       index: Which of its chunks to decode.
+   $
+   $Description: Decodes one chunk into its place in the buffer. $
+   ======================================================================== */
+static void DecodeStegoChunkJob(void *data, int index)
+{
+    TIMED_BLOCK();
+
+    StegoJob *job = (StegoJob*)data;
+
+    job->Results[index] = DecodeStegoChunk(job, job->FirstChunk + index,
+                                           job->Buffer + (size_t)index * job->Index->ChunkBytes);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CheckStegoChunk
+   $Prototype: static int CheckStegoChunk(int result)
+   $Params:
+       result: What UnpackStegoChunk returned.
+   $
+   $Description: Says what was wrong with a chunk. Returns 0 if nothing
+   was and -1 if something was. $
+   ======================================================================== */
+static int CheckStegoChunk(int result)
+{
+    if (result == -1)
+    {
+        printf("Cannot decode image. The checksum doesn't match, the image is damaged.\n");
+    }
+    else if (result != 0)
+    {
+        printf("Cannot decode image. The compressed data is bad.\n");
+    }
+
+    return (result == 0) ? 0 : -1;
+}
+
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoChunks
+   $Prototype: static void EncodeStegoChunks(Image *image, StegoIndex *index, uint32_t pixel, int depth, const StegoScatter *scatter, const Cipher *key)
+   $Params:
+       image: The image to encode into
+       index: The chunks to encode. Their checksums get filled in.
+       pixel: The pixel the chunks start at
+       depth: How many bits of each channel to use.
+       scatter: The scatter of the payload, or 0.
+       key: The cipher to encrypt the chunks with, 0 to store them as they
+            are.
+   $
+   $Description: Encodes every chunk, a chunk per job on the stego
+   threads. $
+   ======================================================================== */
+static void EncodeStegoChunks(Image *image, StegoIndex *index, uint32_t pixel, int depth, const StegoScatter *scatter, const Cipher *key)
+{
+    int thread_count = GetStegoThreads();
+    StegoJob job;
+
+    memset(&job, 0, sizeof(StegoJob));
+    job.Carrier = image;
+    job.Pixel = pixel;
+    job.Depth = depth;
+    job.Scatter = scatter;
+    job.Key = key;
+    job.Index = index;
+
+    if (thread_count == 1 || index->StoredLength < STEGO_PARALLEL_MIN_BYTES)
+    {
+        for(uint32_t i = 0; i < index->ChunkCount; i++)
+        {
+            EncodeStegoChunkJob(&job, i);
+        }
+
+        return;
+    }
+
+    ParallelFor(thread_count, index->ChunkCount, EncodeStegoChunkJob, &job);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoChunks
+   $Prototype: static int DecodeStegoChunks(Image *image, StegoPayload *payload, const Cipher *key, char *buffer, uint32_t first, uint32_t count)
+   $Params:
+       image: The image to decode from
+       payload: The payload, with the entries of the chunks read.
+       key: The cipher to decrypt the chunks with, or 0.
+       buffer: Where the data of the chunks goes, one after the other.
+       first: The first chunk to decode
+       count: How many chunks to decode
+   $
+   $Description: Decodes the chunks, a chunk per job on the stego threads.
+   Each chunk is checked against its checksum before it is decompressed.
+   Returns 0 on success and -1 if any of them are damaged. $
+   ======================================================================== */
+static int DecodeStegoChunks(Image *image, StegoPayload *payload, const Cipher *key, char *buffer, uint32_t first, uint32_t count)
+{
+    int thread_count = GetStegoThreads();
+    int result = 0;
+    StegoJob job;
+
+    memset(&job, 0, sizeof(StegoJob));
+    job.Carrier = image;
+    job.Buffer = buffer;
+    job.Pixel = payload->Pixel;
+    job.Depth = payload->Depth;
+    job.Scatter = GetStegoPayloadScatter(payload);
+    job.Key = key;
+    job.Index = &payload->Index;
+    job.FirstChunk = first;
+    job.Results = (int*)AllocateMemory(MEMORY_CHUNK, count * sizeof(int));
+
+    if (thread_count == 1 || count == 1 || (uint64_t)count * payload->Index.ChunkBytes < STEGO_PARALLEL_MIN_BYTES)
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            DecodeStegoChunkJob(&job, i);
+        }
+    }
+    else
+    {
+        ParallelFor(thread_count, count, DecodeStegoChunkJob, &job);
+    }
+
+    for(uint32_t i = 0; i < count && result == 0; i++)
+    {
+        result = CheckStegoChunk(job.Results[i]);
+    }
+
+    FreeMemory(job.Results);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoCapacity
+   $Prototype: static int GetStegoCapacity(uint32_t pixel_count, int depth)
+   $Params:
+       pixel_count: How many pixels the image has.
+       depth: The depth of the payload.
+   $
+   $Description: Returns how many bytes fit in the image, including the
+   STEGO_HEADER_BYTES of the header. $
+   ======================================================================== */
+static int GetStegoCapacity(uint32_t pixel_count, int depth)
+{
+    uint64_t capacity;
+
+    if (pixel_count < STEGO_HEADER_PIXELS)
+    {
+        return pixel_count / 2;
+    }
+
+    capacity = STEGO_HEADER_BYTES + (uint64_t)GetStegoByteCount(pixel_count - STEGO_HEADER_PIXELS, depth);
+
+    if (capacity > STEGO_HEADER_BYTES + STEGO_MAX_LENGTH)
+    {
+        capacity = STEGO_HEADER_BYTES + STEGO_MAX_LENGTH;
+    }
+
+    return (int)capacity;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoCursorBytes
+   $Prototype: static uint32_t GetStegoCursorBytes(StegoCursor *cursor, uint32_t pixel_end, uint32_t wanted)
+   $Params:
+       cursor: Where the next byte goes.
+       pixel_end: The pixel to stop before.
+       wanted: The most bytes to hand out.
+   $
+   $Description: Returns how many bytes can be encoded/decoded at the
+   cursor in one go, stopping at pixel_end and at the end of the header. $
+   ======================================================================== */
+static uint32_t GetStegoCursorBytes(StegoCursor *cursor, uint32_t pixel_end, uint32_t wanted)
+{
+    uint32_t count;
+
+    if (pixel_end <= cursor->Pixel)
+    {
+        return 0;
+    }
+
+    if (cursor->Byte < STEGO_HEADER_BYTES)
+    {
+        count = GetStegoByteCount(pixel_end - cursor->Pixel, 1);
+
+        if (count > STEGO_HEADER_BYTES - cursor->Byte)
+        {
+            count = STEGO_HEADER_BYTES - cursor->Byte;
+        }
+    }
+    else
+    {
+        count = GetStegoByteCount(pixel_end - cursor->Pixel, cursor->Depth);
+    }
+
+    return (count < wanted) ? count : wanted;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: AdvanceStegoCursor
+   $Prototype: static void AdvanceStegoCursor(StegoCursor *cursor, uint32_t count)
+   $Params:
+       cursor: The cursor to move.
+       count: What GetStegoCursorBytes returned.
+   $
+   $Description: Moves the cursor past bytes that were encoded/decoded. $
+   ======================================================================== */
+static void AdvanceStegoCursor(StegoCursor *cursor, uint32_t count)
+{
+    cursor->Pixel += GetStegoPixelCount(count, (cursor->Byte < STEGO_HEADER_BYTES) ? 1 : cursor->Depth);
+    cursor->Byte += count;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoThreads
+   $Prototype: void SetStegoThreads(int thread_count)
+   $Params:
+       thread_count: How many threads to use, 0 uses one per processor.
+   $
+   $Description: Sets how many threads encoding and decoding use. $
+   ======================================================================== */
+void SetStegoThreads(int thread_count)
+{
+    stego_threads = (thread_count < 0) ? 1 : thread_count;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoJobThreads
+   $Prototype: int SetStegoJobThreads(int thread_count)
+   $Params:
+       thread_count: How many threads to use, 0 goes back to what
+                     SetStegoThreads set.
+   $
+   $Description: Sets how many threads the encodes and decodes on the
+   calling thread use, without changing it for the rest of the program.
+   A job that runs alongside others sets it before it starts and puts
+   back what it was when it is done, since ParallelFor runs jobs on the
+   calling thread too. Returns what it was. $
+   ======================================================================== */
+int SetStegoJobThreads(int thread_count)
+{
+    int previous = stego_job_threads;
+
+    stego_job_threads = (thread_count < 0) ? 1 : thread_count;
+
+    return previous;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoThreads
+   $Prototype: int GetStegoThreads()
+   $Params: $
+   $Description: Returns how many threads encoding and decoding use on
+   the calling thread. $
+   ======================================================================== */
+int GetStegoThreads()
+{
+    if (stego_job_threads > 0)
+    {
+        return stego_job_threads;
+    }
+
+    return (stego_threads > 0) ? stego_threads : GetProcessorCount();
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoDepth
+   $Prototype: int SetStegoDepth(int depth)
+   $Params:
+       depth: How many bits of each channel to use, STEGO_MIN_DEPTH to
+              STEGO_MAX_DEPTH.
+   $
+   $Description: Sets the depth that encoding uses. Decoding always uses
+   the depth stored in the image. Returns 0 on success and -1 if the
+   depth is out of range. $
+   ======================================================================== */
+int SetStegoDepth(int depth)
+{
+    if (depth < STEGO_MIN_DEPTH || depth > STEGO_MAX_DEPTH)
+    {
+        printf("Error: the depth has to be from %d to %d.\n", STEGO_MIN_DEPTH, STEGO_MAX_DEPTH);
+        return -1;
+    }
+
+    stego_depth = depth;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoDepth
+   $Prototype: int GetStegoDepth()
+   $Params: $
+   $Description: Returns the depth that encoding uses. $
+   ======================================================================== */
+int GetStegoDepth()
+{
+    return stego_depth;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoCompression
+   $Prototype: void SetStegoCompression(int compression)
+   $Params:
+       compression: 1 to compress new payloads, 0 to store them as they are.
+   $
+   $Description: Sets whether encoding compresses the payload. A payload
+   that doesn't get smaller is always stored as it is. Decoding finds out
+   from the image. $
+   ======================================================================== */
+void SetStegoCompression(int compression)
+{
+    stego_compression = compression ? 1 : 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoCompression
+   $Prototype: int GetStegoCompression()
+   $Params: $
+   $Description: Returns 1 if encoding compresses the payload. $
+   ======================================================================== */
+int GetStegoCompression()
+{
+    return stego_compression;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoScatter
+   $Prototype: int SetStegoScatter(const char *password)
+   $Params:
+       password: The password the order of the pixels is made from, 0 to
+                 go through them in order.
+   $
+   $Description: Sets whether encoding scatters the payload and the key
+   that decoding unscatters it with. The key is derived like an
+   encryption key, so it is only worked out once here. Returns 0. $
+   ======================================================================== */
+int SetStegoScatter(const char *password)
+{
+    stego_scatter = 0;
+
+    if (password)
+    {
+        DeriveEncryptKey(password, stego_scatter_salt, stego_scatter_key);
+        stego_scatter = 1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoScatter
+   $Prototype: int GetStegoScatter()
+   $Params: $
+   $Description: Returns 1 if encoding scatters the payload. $
+   ======================================================================== */
+int GetStegoScatter()
+{
+    return stego_scatter;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoMaxBytes
+   $Prototype: int StegoMaxBytes(Image *image)
+   $Params: 
+       image: The image to calculate how many bytes can fit into.
+   $
+   $Description: Calculates how many bytes can fit into an image at the
+   current depth, including the STEGO_HEADER_BYTES of the header. Nothing
+   fits if payloads are scattered and the image is too small to scatter
+   over. $
+   ======================================================================== */
+int StegoMaxBytes(Image *image)
+{
+    StegoScatter scatter;
+
+    if (stego_scatter &&
+        StartStegoScatter(&scatter, stego_scatter_key, STEGO_HEADER_PIXELS, GetStegoImagePixels(image)) != 0)
+    {
+        return 0;
+    }
+
+    return GetStegoCapacity(GetStegoImagePixels(image), stego_depth);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoStripeMaxBytes
+   $Prototype: int StegoStripeMaxBytes(int max_bytes, int encrypted)
+   $Params:
+       max_bytes: How many bytes fit in the image, from StegoMaxBytes or
+                  ProbeStegoImage.
+       encrypted: 1 if the stripe is encrypted.
+   $
+   $Description: Returns how many bytes of data a stripe in the image can
+   hold, after the header, the stripe header, the encryption header and
+   the index. The index is worked out for the most chunks it could have,
+   so the data always fits. $
+   ======================================================================== */
+int StegoStripeMaxBytes(int max_bytes, int encrypted)
+{
+    int available = max_bytes - STEGO_HEADER_BYTES - STEGO_STRIPE_BYTES - (encrypted ? ENCRYPT_HEADER_BYTES : 0);
+    int length;
+
+    if (available <= 0)
+    {
+        return 0;
+    }
+
+    length = available - GetStegoIndexBytes((available + STEGO_CHUNK_BYTES - 1) / STEGO_CHUNK_BYTES);
+
+    return (length > 0) ? length : 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ProbeStegoImage
+   $Prototype: int ProbeStegoImage(const char *filename, StegoProbe *probe)
+   $Params: 
+       filename: The bitmap to probe
+       probe: Gets filled out with what was found.
+   $
+   $Description: Finds the size, capacity and stored length and depth of a
+   bitmap by reading only its header and the 32 pixels that hold the
+   payload header. The capacity is at the current depth. The bitmap header
+   is checked the same way as when the image is loaded. Returns 0 on
+   success and -1 if the bitmap can't be read or its pixels aren't all in
+   the file. $
+   ======================================================================== */
+int ProbeStegoImage(const char *filename, StegoProbe *probe)
+{
+    BitmapStream *input;
+    uint32_t *pixels;
+    uint32_t header_read;
+    char bytes[STEGO_HEADER_BYTES];
+    StegoHeader header;
+    Image header_pixels;
+
+    if ((input = OpenBitmapStream(filename)) == 0)
+    {
+        return -1;
+    }
+
+    probe->Width = input->Format.Width;
+    probe->Height = input->Format.Height;
+    probe->Capacity = StegoMaxBytes(&input->Format);
+    probe->PayloadLength = 0;
+    probe->Depth = 0;
+    probe->Compressed = 0;
+    probe->Encrypted = 0;
+    probe->Scattered = 0;
+    probe->StripeIndex = 0;
+    probe->StripeCount = 0;
+    probe->HasPayload = 0;
+
+    header_read = GetStegoHeaderImagePixels(&input->Format, STEGO_HEADER_PIXELS);
+
+    if ((pixels = (uint32_t*)AllocateMemory(MEMORY_STREAM, header_read * sizeof(uint32_t))) == 0)
+    {
+        printf("Error: out of memory.\n");
+        CloseBitmapStream(input);
+        return -1;
+    }
+
+    // Decode the header from the first 32 pixels.
+    if (header_read > 0 && ReadBitmapStrip(input, pixels, header_read) == header_read)
+    {
+        memcpy(&header_pixels, &input->Format, sizeof(Image));
+        header_pixels.Pixels = pixels;
+        header_pixels.PixelCount = header_read;
+        header_pixels.Height = header_read / header_pixels.Width;
+
+        DecodeStegoBytesDepth(&header_pixels, 0, bytes, STEGO_HEADER_BYTES, 1);
+
+        if (GetStegoHeader(bytes, &header) == 0)
+        {
+            probe->PayloadLength = header.Length;
+            probe->Depth = header.Depth;
+            probe->Compressed = header.Compressed;
+            probe->Encrypted = header.Encrypted;
+            probe->Scattered = header.Scattered;
+            probe->StripeIndex = header.StripeIndex;
+            probe->StripeCount = header.StripeCount;
+            probe->HasPayload = (header.Length + STEGO_HEADER_BYTES <=
+                                 (uint32_t)GetStegoCapacity(GetStegoImagePixels(&input->Format), header.Depth));
+        }
+    }
+
+    FreeMemory(pixels);
+    CloseBitmapStream(input);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: PackStegoChunkJob
+   $Prototype: static void PackStegoChunkJob(void *data, int index)
+   $Params:
+       data: The StegoIndex of the buffer.
+       index: Which chunk to compress.
+   $
+   $Description: Compresses one chunk into its slot of Packed, and keeps
+   it if it got smaller. The padding after it is zeroed. $
+   ======================================================================== */
+static void PackStegoChunkJob(void *data, int index)
+{
+    TIMED_BLOCK();
+
+    StegoIndex *stego_index = (StegoIndex*)data;
+    StegoChunk *chunk = &stego_index->Chunks[index];
+    char *packed = stego_index->Packed + (size_t)index * GetStegoChunkSlot(stego_index);
+    uint32_t length = CompressBuffer((const uint8_t*)chunk->Data, chunk->Length, (uint8_t*)packed);
+
+    if (length < chunk->Length)
+    {
+        chunk->Data = packed;
+        chunk->Length = length;
+        chunk->Compressed = 1;
+        memset(packed + length, 0, GetStegoChunkStored(stego_index, index) - length);
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SplitStegoBuffer
+   $Prototype: static void SplitStegoBuffer(StegoIndex *index, const char *buffer, int buffer_length)
+   $Params:
+       index: Gets set up with the chunks of the buffer.
+       buffer: The buffer of data that is going to be encoded
+       buffer_length: The length of the buffer
+   $
+   $Description: Splits the buffer into chunks and, if compression is
+   turned on, compresses them on the stego threads. Each chunk is only
+   kept compressed if it got smaller. FreeStegoIndex frees it. $
+   ======================================================================== */
+static void SplitStegoBuffer(StegoIndex *index, const char *buffer, int buffer_length)
+{
+    TIMED_BLOCK();
+
+    int thread_count = GetStegoThreads();
+
+    StartStegoIndex(index, buffer_length);
+
+    for(uint32_t i = 0; i < index->ChunkCount; i++)
+    {
+        index->Chunks[i].Data = buffer + (size_t)i * index->ChunkBytes;
+    }
+
+    if (stego_compression && index->ChunkCount > 0)
+    {
+        index->Packed = (char*)AllocateMemory(MEMORY_CHUNK, (size_t)index->ChunkCount * GetStegoChunkSlot(index));
+
+        if (thread_count == 1 || index->ChunkCount == 1)
+        {
+            for(uint32_t i = 0; i < index->ChunkCount; i++)
+            {
+                PackStegoChunkJob(index, i);
+            }
+        }
+        else
+        {
+            ParallelFor(thread_count, index->ChunkCount, PackStegoChunkJob, index);
+        }
+    }
+
+    PlaceStegoChunks(index);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoPayloadSize
+   $Prototype: static uint64_t GetStegoPayloadSize(const StegoIndex *index, int encrypted, int striped)
+   $Params:
+       index: The chunks of the payload
+       encrypted: 1 if the payload is encrypted.
+       striped: 1 if the payload is a stripe.
+   $
+   $Description: Returns how many bytes the payload takes with the header,
+   the stripe header, the encryption header and the index, to check
+   against StegoMaxBytes. $
+   ======================================================================== */
+static uint64_t GetStegoPayloadSize(const StegoIndex *index, int encrypted, int striped)
+{
+    return (uint64_t)STEGO_HEADER_BYTES + (striped ? STEGO_STRIPE_BYTES : 0) + (encrypted ? ENCRYPT_HEADER_BYTES : 0) +
+           GetStegoIndexBytes(index->ChunkCount) + index->StoredLength;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoPayload
+   $Prototype: static void EncodeStegoPayload(Image *image, StegoIndex *index, const Cipher *key, const uint8_t *key_header, const StegoStripe *stripe)
+   $Params:
+       image: The image to encode into. It has to have room for the payload.
+       index: The chunks to store
+       key: The cipher to encrypt the chunks with, or 0.
+       key_header: The encryption header that goes in front of the
+                   index, 0 if there is no key.
+       stripe: Which stripe of a payload this is, or 0 if it isn't striped.
+   $
+   $Description: Writes the chunks into the image, then the index, which
+   holds the checksums the threads worked out as they encoded them, and
+   then the header. $
+   ======================================================================== */
+static void EncodeStegoPayload(Image *image, StegoIndex *index, const Cipher *key, const uint8_t *key_header, const StegoStripe *stripe)
+{
+    char bytes[STEGO_HEADER_BYTES];
+    char stripe_bytes[STEGO_STRIPE_BYTES];
+    StegoHeader header;
+    uint32_t pixel = STEGO_HEADER_PIXELS;
+    uint32_t checksum = CHECKSUM_START;
+    uint32_t index_length = GetStegoIndexBytes(index->ChunkCount);
+    char *index_bytes = (char*)AllocateMemory(MEMORY_CHUNK, index_length);
+    StegoScatter scatter;
+
+    // StegoMaxBytes has already checked the image is big enough to scatter.
+    if (stego_scatter)
+    {
+        StartStegoScatter(&scatter, stego_scatter_key, STEGO_HEADER_PIXELS, GetStegoImagePixels(image));
+    }
+
+    if (stripe)
+    {
+        SetStegoStripe(stripe_bytes, stripe);
+        EncodeStegoBytesScattered(image, stripe_bytes, STEGO_STRIPE_BYTES, pixel, stego_depth, stego_scatter ? &scatter : 0);
+        pixel += GetStegoPixelCount(STEGO_STRIPE_BYTES, stego_depth);
+        checksum = UpdateChecksum(checksum, (const uint8_t*)stripe_bytes, STEGO_STRIPE_BYTES);
+    }
+
+    if (key)
+    {
+        EncodeStegoBytesScattered(image, (const char*)key_header, ENCRYPT_HEADER_BYTES, pixel, stego_depth, stego_scatter ? &scatter : 0);
+        pixel += GetStegoPixelCount(ENCRYPT_HEADER_BYTES, stego_depth);
+        checksum = UpdateChecksum(checksum, key_header, ENCRYPT_HEADER_BYTES);
+    }
+
+    // Write the chunks
+    EncodeStegoChunks(image, index, pixel + GetStegoPixelCount(index_length, stego_depth), stego_depth, stego_scatter ? &scatter : 0, key);
+
+    // Write the index, now the checksums of the chunks are known.
+    SetStegoIndex(index_bytes, index);
+    checksum = CombineChecksum(checksum, EncodeStegoParallel(image, index_bytes, index_length, pixel, stego_depth, stego_scatter ? &scatter : 0), index_length);
+    FreeMemory(index_bytes);
+
+    // Write the header.
+    header.Length = (stripe ? STEGO_STRIPE_BYTES : 0) + (key ? ENCRYPT_HEADER_BYTES : 0) + index_length + index->StoredLength;
+    header.Depth = stego_depth;
+    header.Compressed = index->Compressed;
+    header.Encrypted = (key != 0);
+    header.Scattered = stego_scatter;
+    header.StripeIndex = stripe ? stripe->Index : 0;
+    header.StripeCount = stripe ? stripe->Count : 0;
+    header.Checksum = FinishChecksum(checksum);
+
+    SetStegoHeader(bytes, &header);
+    EncodeStegoBytesDepth(image, bytes, STEGO_HEADER_BYTES, 0, 1);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartStegoCipher
+   $Prototype: static int StartStegoCipher(Cipher *key, AESType aes, const char *password, uint8_t *key_header)
+   $Params: 
+       key: The cipher to set up
+       aes: Which AES to use
+       password: The password to derive the key from
+       key_header: Where to write the encryption header.
+   $
+   $Description: Sets up the cipher for a new payload. Returns 0 on
+   success and -1 if it can't encrypt. $
+   ======================================================================== */
+static int StartStegoCipher(Cipher *key, AESType aes, const char *password, uint8_t *key_header)
+{
+    if (!HasEncryptInstructions())
+    {
+        printf("Error: this processor doesn't have the AES instructions.\n");
+        return -1;
+    }
+
+    if (StartEncryption(key, aes, password, key_header) != 0)
+    {
+        printf("Error: unable to read random data for the encryption.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBufferInPlace
+   $Prototype: int EncodeStegoBufferInPlace(Image *image, const char *buffer, int buffer_length)
+   $Params:
+       image: The image to encode into. Its pixels get overwritten.
+       buffer: The buffer of data to put into the image
+       buffer_length: The length of the buffer
+   $
+   $Description: Encodes a buffer of data straight into the image. Only the
+   pixels that hold the header and the buffer are touched, so the cost
+   depends on the buffer size instead of the image size. The buffer is
+   compressed first if compression is on. Returns 0 on success and -1 if
+   the buffer doesn't fit. $
+   ======================================================================== */
+int EncodeStegoBufferInPlace(Image *image, const char *buffer, int buffer_length)
+{
+    TIMED_BLOCK();
+
+    StegoIndex index;
+
+    SplitStegoBuffer(&index, buffer, buffer_length);
+
+    // Check to see if we can store the buffer in the image, after the header.
+    if (GetStegoPayloadSize(&index, 0, 0) > (uint64_t)StegoMaxBytes(image))
+    {
+        printf("Error: buffer is too long to store.\n");
+        FreeStegoIndex(&index);
+        return -1;
+    }
+
+    EncodeStegoPayload(image, &index, 0, 0, 0);
+    FreeStegoIndex(&index);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBuffer
+   $Prototype: Image *EncodeStegoBuffer(Image *image, const char *buffer, int buffer_length)
+   $Params:
+       image: The image to encode
+       buffer: The buffer of data to put into the image
+       buffer_length: The length of the buffer
+   $
+   $Description: Encodes a buffer of data into a copy of the image. $
+   ======================================================================== */
+Image *EncodeStegoBuffer(Image *image, const char *buffer, int buffer_length)
+{
+    TIMED_BLOCK();
+
+    Image *encoded_image;
+    StegoIndex index;
+
+    SplitStegoBuffer(&index, buffer, buffer_length);
+
+    // Check before copying so a buffer that doesn't fit costs nothing.
+    if (GetStegoPayloadSize(&index, 0, 0) > (uint64_t)StegoMaxBytes(image))
+    {
+        printf("Error: buffer is too long to store.\n");
+        FreeStegoIndex(&index);
+        return 0;
+    }
+
+    // Create a new image to return.
+    encoded_image = CopyImage(image);
+
+    EncodeStegoPayload(encoded_image, &index, 0, 0, 0);
+    FreeStegoIndex(&index);
+
+    return encoded_image;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartStegoBufferEnc
+   $Prototype: static int StartStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password, StegoIndex *index, Cipher *key, uint8_t *key_header)
+   $Params:
+       image: The image the buffer is going to be encoded into
+       buffer: The buffer of data
+       buffer_length: The length of the buffer
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+       index: Gets the chunks of the buffer
+       key: Gets the key
+       key_header: Gets the ENCRYPT_HEADER_BYTES that go before the chunks
+   $
+   $Description: Splits the buffer into chunks, checks they fit in the
+   image encrypted and derives the key. Returns 0 on success, otherwise -1
+   and there is nothing to free. $
+   ======================================================================== */
+static int StartStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password, StegoIndex *index, Cipher *key, uint8_t *key_header)
+{
+    SplitStegoBuffer(index, buffer, buffer_length);
+
+    if (GetStegoPayloadSize(index, 1, 0) > (uint64_t)StegoMaxBytes(image))
+    {
+        printf("Error: buffer is too long to store.\n");
+        FreeStegoIndex(index);
+        return -1;
+    }
+
+    if (StartStegoCipher(key, aes, password, key_header) != 0)
+    {
+        FreeStegoIndex(index);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBufferEnc
+   $Prototype: Image *EncodeStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password)
+   $Params:
+       image: The image to encode
+       buffer: The buffer of data to put into the image
+       buffer_length: The length of the buffer
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: Encodes a buffer of data into a copy of the image,
+   encrypted with a key derived from the password. The chunks are
+   compressed first if compression is on, then each thread encrypts its
+   chunks as it encodes them. The index isn't encrypted. It takes
+   ENCRYPT_HEADER_BYTES more room than EncodeStegoBuffer. $
+   ======================================================================== */
+Image *EncodeStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password)
+{
+    TIMED_BLOCK();
+
+    Image *encoded_image;
+    Cipher key;
+    uint8_t key_header[ENCRYPT_HEADER_BYTES];
+    StegoIndex index;
+
+    if (StartStegoBufferEnc(image, buffer, buffer_length, aes, password, &index, &key, key_header) != 0)
+    {
+        return 0;
+    }
+
+    encoded_image = CopyImage(image);
+
+    EncodeStegoPayload(encoded_image, &index, &key, key_header, 0);
+    FinishCipher(&key);
+    FreeStegoIndex(&index);
+
+    return encoded_image;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBufferInPlaceEnc
+   $Prototype: int EncodeStegoBufferInPlaceEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password)
+   $Params:
+       image: The image to encode into. Its pixels get overwritten.
+       buffer: The buffer of data to put into the image
+       buffer_length: The length of the buffer
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: Encodes an encrypted buffer of data straight into the
+   image, the same as EncodeStegoBufferEnc without the copy. Returns 0 on
+   success and -1 on failure. $
+   ======================================================================== */
+int EncodeStegoBufferInPlaceEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password)
+{
+    TIMED_BLOCK();
+
+    Cipher key;
+    uint8_t key_header[ENCRYPT_HEADER_BYTES];
+    StegoIndex index;
+
+    if (StartStegoBufferEnc(image, buffer, buffer_length, aes, password, &index, &key, key_header) != 0)
+    {
+        return -1;
+    }
+
+    EncodeStegoPayload(image, &index, &key, key_header, 0);
+    FinishCipher(&key);
+    FreeStegoIndex(&index);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoFile
+   $Prototype: char *ReadStegoFile(const char *filename, int *buffer_length)
+   $Params: 
+       filename: The file to read
+       buffer_length: Gets set to the length of the returned buffer.
+   $
+   $Description: Reads a file into a buffer that starts with the NUL
+   terminated filename, ready to be encoded. The buffer needs to be freed
+   with FreeMemory.
+   Returns 0 if the file can't be read. $
+   ======================================================================== */
+char *ReadStegoFile(const char *filename, int *buffer_length)
+{
+    FILE *fp;
+    uint32_t file_length;
+    uint32_t bytes_read = 0;
+    char *buffer;
+    uint32_t overhead_size = 0;
+
+    if ((fp = fopen(filename, "r")) == 0)
+    {
+        printf("Unable to open file: %s\n", filename);
+        return 0;
+    }
+
+    overhead_size = strlen(filename) + 1;
+
+    // Get the file size.
+    fseek(fp, 0, SEEK_END);
+    file_length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    buffer = (char*)AllocateMemory(MEMORY_PAYLOAD, file_length + overhead_size);
+
+    while (bytes_read < file_length)
+    {
+        uint32_t n = fread(buffer + bytes_read + overhead_size, 1, file_length - bytes_read, fp);
+
+        if (n == 0)
+        {
+            printf("Error reading file: %s\n", filename);
+            FreeMemory(buffer);
+            fclose(fp);
+            return 0;
+        }
+
+        bytes_read += n;
+    }
+
+    fclose(fp);
+
+    // Write the filename
+    memcpy(buffer, filename, overhead_size - 1);
+    buffer[overhead_size - 1] = 0;
+
+    *buffer_length = file_length + overhead_size;
+
+    return buffer;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoFile
+   $Prototype: Image *EncodeStegoFile(Image *image, const char *filename)
+   $Params: 
+       image: The image to encode into
+       filename: The filename to put into the image
+   $
+   $Description: Encodes a filename into a copy of the image. $
+   ======================================================================== */
+Image *EncodeStegoFile(Image *image, const char *filename)
+{
+    TIMED_BLOCK();
+
+    Image *encoded_image = 0;    
+    int buffer_length;
+    char *buffer;
+
+    if ((buffer = ReadStegoFile(filename, &buffer_length)) == 0)
+    {
+        return 0;
+    }
+
+    encoded_image = EncodeStegoBuffer(image, buffer, buffer_length);
+    FreeMemory(buffer);
+
+    return encoded_image;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoFileInPlace
+   $Prototype: int EncodeStegoFileInPlace(Image *image, const char *filename)
+   $Params: 
+       image: The image to encode into. Its pixels get overwritten.
+       filename: The filename to put into the image
+   $
+   $Description: Encodes a file straight into the image. Returns 0 on
+   success and -1 on failure. $
+   ======================================================================== */
+int EncodeStegoFileInPlace(Image *image, const char *filename)
+{
+    TIMED_BLOCK();
+
+    int buffer_length;
+    char *buffer;
+    int result;
+
+    if ((buffer = ReadStegoFile(filename, &buffer_length)) == 0)
+    {
+        return -1;
+    }
+
+    result = EncodeStegoBufferInPlace(image, buffer, buffer_length);
+    FreeMemory(buffer);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoFileEnc
+   $Prototype: Image *EncodeStegoFileEnc(Image *image, const char *filename, AESType aes, const char *password)
+   $Params: 
+       image: The image to encode into
+       filename: The filename to put into the image
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: Encodes an encrypted file into a copy of the image. $
+   ======================================================================== */
+Image *EncodeStegoFileEnc(Image *image, const char *filename, AESType aes, const char *password)
+{
+    TIMED_BLOCK();
+
+    Image *encoded_image = 0;
+    int buffer_length;
+    char *buffer;
+
+    if ((buffer = ReadStegoFile(filename, &buffer_length)) == 0)
+    {
+        return 0;
+    }
+
+    encoded_image = EncodeStegoBufferEnc(image, buffer, buffer_length, aes, password);
+    FreeMemory(buffer);
+
+    return encoded_image;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoFileInPlaceEnc
+   $Prototype: int EncodeStegoFileInPlaceEnc(Image *image, const char *filename, AESType aes, const char *password)
+   $Params:
+       image: The image to encode into. Its pixels get overwritten.
+       filename: The filename to put into the image
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: Encodes an encrypted file straight into the image.
+   Returns 0 on success and -1 on failure. $
+   ======================================================================== */
+int EncodeStegoFileInPlaceEnc(Image *image, const char *filename, AESType aes, const char *password)
+{
+    TIMED_BLOCK();
+
+    int buffer_length;
+    char *buffer;
+    int result;
+
+    if ((buffer = ReadStegoFile(filename, &buffer_length)) == 0)
+    {
+        return -1;
+    }
+
+    result = EncodeStegoBufferInPlaceEnc(image, buffer, buffer_length, aes, password);
+    FreeMemory(buffer);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoStripeInPlace
+   $Prototype: int EncodeStegoStripeInPlace(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe)
+   $Params:
+       image: The image to encode into. Its pixels get overwritten.
+       buffer: This stripe's part of the data
+       buffer_length: The length of the part
+       stripe: Which stripe it is, and the ID and length of all of the data.
+   $
+   $Description: Encodes one stripe of a payload that is split across
+   several images straight into the image. The stripe header goes after
+   the header and is covered by its checksum. Returns 0 on success and -1
+   if the part doesn't fit. $
+   ======================================================================== */
+int EncodeStegoStripeInPlace(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe)
+{
+    TIMED_BLOCK();
+
+    StegoIndex index;
+
+    SplitStegoBuffer(&index, buffer, buffer_length);
+
+    if (GetStegoPayloadSize(&index, 0, 1) > (uint64_t)StegoMaxBytes(image))
+    {
+        printf("Error: stripe %d is too long to store.\n", stripe->Index + 1);
+        FreeStegoIndex(&index);
+        return -1;
+    }
+
+    EncodeStegoPayload(image, &index, 0, 0, stripe);
+    FreeStegoIndex(&index);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoStripeInPlaceEnc
+   $Prototype: int EncodeStegoStripeInPlaceEnc(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password)
+   $Params:
+       image: The image to encode into. Its pixels get overwritten.
+       buffer: This stripe's part of the data
+       buffer_length: The length of the part
+       stripe: Which stripe it is, and the ID and length of all of the data.
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: EncodeStegoStripeInPlace, encrypted. Every stripe has a
+   salt and key of its own, so no two of them use the same counters. The
+   stripe header isn't encrypted. Returns 0 on success and -1. $
+   ======================================================================== */
+int EncodeStegoStripeInPlaceEnc(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password)
+{
+    TIMED_BLOCK();
+
+    Cipher key;
+    uint8_t key_header[ENCRYPT_HEADER_BYTES];
+    StegoIndex index;
+
+    SplitStegoBuffer(&index, buffer, buffer_length);
+
+    if (GetStegoPayloadSize(&index, 1, 1) > (uint64_t)StegoMaxBytes(image))
+    {
+        printf("Error: stripe %d is too long to store.\n", stripe->Index + 1);
+        FreeStegoIndex(&index);
+        return -1;
+    }
+
+    if (StartStegoCipher(&key, aes, password, key_header) != 0)
+    {
+        FreeStegoIndex(&index);
+        return -1;
+    }
+
+    EncodeStegoPayload(image, &index, &key, key_header, stripe);
+    FinishCipher(&key);
+    FreeStegoIndex(&index);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoStripPixels
+   $Prototype: static uint32_t GetStegoStripPixels(const Image *format, int buffer_size)
+   $Params: 
+       format: The image that is being streamed
+       buffer_size: How many bytes of pixels can be held at once.
+   $
+   $Description: Works out how many pixels the streaming functions handle
+   at a time. Strips are whole rows, at least one, and always an even
+   number of pixels so a group of pixels is never split between two
+   strips. $
+   ======================================================================== */
+static uint32_t GetStegoStripPixels(const Image *format, int buffer_size)
+{
+    uint32_t rows = buffer_size / (format->Width * sizeof(uint32_t));
+
+    if (rows < 1)
+    {
+        rows = 1;
+    }
+
+    if ((rows * format->Width) & 1)
+    {
+        rows++;
+    }
+
+    return rows * format->Width;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoPlain
+   $Prototype: static int ReadStegoPlain(StegoSource *source, char *buffer, int count)
+   $Params: 
+       source: Where the bytes come from
+       buffer: The buffer to fill
+       count: How many bytes to read
+   $
+   $Description: Reads the next bytes of the filename and then the file,
+   before they are compressed. Returns how many bytes were read. $
+   ======================================================================== */
+static int ReadStegoPlain(StegoSource *source, char *buffer, int count)
+{
+    int bytes_read = 0;
+
+    // Use up the filename first.
+    if (source->NameDone < source->NameLength)
+    {
+        bytes_read = source->NameLength - source->NameDone;
+        if (bytes_read > count)
+        {
+            bytes_read = count;
+        }
+
+        memcpy(buffer, source->Name + source->NameDone, bytes_read);
+        source->NameDone += bytes_read;
+    }
+
+    while (bytes_read < count)
+    {
+        int n = fread(buffer + bytes_read, 1, count - bytes_read, source->File);
+
+        if (n == 0)
+        {
+            break;
+        }
+
+        bytes_read += n;
+    }
+
+    return bytes_read;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: PackStegoChunk
+   $Prototype: static const char *PackStegoChunk(StegoChunk *chunk, const char *block, uint32_t length, char *packed)
+   $Params:
+       chunk: Gets the length of the chunk and whether it is compressed.
+       block: The bytes of the chunk
+       length: How many bytes there are
+       packed: Where to compress them to, a slot of GetStegoChunkSlot
+               bytes. 0 if compression is off.
+   $
+   $Description: Compresses a chunk that is read a block at a time, and
+   keeps it if it got smaller. Returns the bytes to store, which are
+   either packed or block. $
+   ======================================================================== */
+static const char *PackStegoChunk(StegoChunk *chunk, const char *block, uint32_t length, char *packed)
+{
+    chunk->Length = length;
+    chunk->Compressed = 0;
+
+    if (packed != 0)
+    {
+        uint32_t packed_length = CompressBuffer((const uint8_t*)block, length, (uint8_t*)packed);
+
+        if (packed_length < length)
+        {
+            chunk->Length = packed_length;
+            chunk->Compressed = 1;
+            return packed;
+        }
+    }
+
+    return block;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SpillStegoSource
+   $Prototype: static int SpillStegoSource(StegoSource *source, uint32_t capacity)
+   $Params:
+       source: The filename and a file that can't be measured up front.
+       capacity: How many bytes the image can hold.
+   $
+   $Description: Reads the whole file into Spill a chunk at a time,
+   compressing each one as it goes, then starts the index with how long
+   it turned out to be. The file is only read once, so this works on
+   pipes, and it stops as soon as the chunks can't fit in the image.
+   Returns 0 on success and -1 if the file is too long. $
+   ======================================================================== */
+static int SpillStegoSource(StegoSource *source, uint32_t capacity)
+{
+    TIMED_BLOCK();
+
+    StegoChunk *chunks = 0;
+    uint32_t allocated = 0;
+    uint32_t data_length = 0;
+    uint32_t offset = 0;
+    uint32_t slot;
+    int result = 0;
+
+    // Only the chunk size is needed until the length is known.
+    StartStegoIndex(&source->Index, 0);
+    slot = GetStegoChunkSlot(&source->Index);
+    FreeStegoIndex(&source->Index);
+
+    for(;;)
+    {
+        uint32_t length = ReadStegoPlain(source, source->Block, STEGO_CHUNK_BYTES);
+        StegoChunk *chunk;
+        char *spill;
+        const char *bytes;
+
+        if (length == 0)
+        {
+            break;
+        }
+
+        if (source->SpillCount == allocated)
+        {
+            allocated = allocated ? allocated * 2 : 16;
+            chunks = (StegoChunk*)GrowStegoBuffer(MEMORY_STREAM, chunks, source->SpillCount * sizeof(StegoChunk), allocated * sizeof(StegoChunk));
+            source->Spill = (char**)GrowStegoBuffer(MEMORY_STREAM, source->Spill, source->SpillCount * sizeof(char*), allocated * sizeof(char*));
+        }
+
+        chunk = &chunks[source->SpillCount];
+        spill = (char*)AllocateMemory(MEMORY_STREAM, slot);
+        source->Spill[source->SpillCount++] = spill;
+
+        bytes = PackStegoChunk(chunk, source->Block, length, stego_compression ? spill : 0);
+        if (bytes != spill)
+        {
+            memcpy(spill, bytes, length);
+        }
+
+        memset(spill + chunk->Length, 0, slot - chunk->Length);
+
+        // The last chunk isn't padded, so this one is only checked with its length.
+        if ((uint64_t)data_length + length > STEGO_MAX_LENGTH ||
+            (uint64_t)STEGO_HEADER_BYTES + GetStegoIndexBytes(source->SpillCount) + offset + chunk->Length > capacity)
+        {
+            printf("Error: buffer is too long to store.\n");
+            result = -1;
+            break;
+        }
+
+        data_length += length;
+        offset += ((chunk->Length + STEGO_PARALLEL_ALIGN - 1) / STEGO_PARALLEL_ALIGN) * STEGO_PARALLEL_ALIGN;
+
+        if (length < STEGO_CHUNK_BYTES)
+        {
+            break;
+        }
+    }
+
+    if (result == 0)
+    {
+        StartStegoIndex(&source->Index, data_length);
+
+        for(uint32_t i = 0; i < source->Index.ChunkCount; i++)
+        {
+            source->Index.Chunks[i].Length = chunks[i].Length;
+            source->Index.Chunks[i].Compressed = chunks[i].Compressed;
+        }
+
+        PlaceStegoChunks(&source->Index);
+    }
+
+    FreeMemory(chunks);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FreeStegoSpill
+   $Prototype: static void FreeStegoSpill(StegoSource *source)
+   $Params:
+       source: The source to free the spilled chunks of.
+   $
+   $Description: Frees what SpillStegoSource read, if anything. $
+   ======================================================================== */
+static void FreeStegoSpill(StegoSource *source)
+{
+    for(uint32_t i = 0; i < source->SpillCount; i++)
+    {
+        FreeMemory(source->Spill[i]);
+    }
+
+    FreeMemory(source->Spill);
+    source->Spill = 0;
+    source->SpillCount = 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: LoadStegoChunk
+   $Prototype: static int LoadStegoChunk(StegoSource *source)
+   $Params:
+       source: The source to load the next chunk of.
+   $
+   $Description: Gets the next chunk ready to encode and places it after
+   the last one. It is either read from the file and compressed if that
+   makes it smaller, or taken from Spill if the file was spilled. Returns
+   0 on success and -1 if the file is shorter than it was. $
+   ======================================================================== */
+static int LoadStegoChunk(StegoSource *source)
+{
+    StegoIndex *index = &source->Index;
+    StegoChunk *chunk = &index->Chunks[source->Chunk];
+    uint32_t length = GetStegoChunkLength(index, source->Chunk);
+
+    if (source->Spill != 0)
+    {
+        source->ChunkData = source->Spill[source->Chunk];
+    }
+    else
+    {
+        if ((uint32_t)ReadStegoPlain(source, source->Block, length) != length)
+        {
+            return -1;
+        }
+
+        source->ChunkData = PackStegoChunk(chunk, source->Block, length, source->Packed);
+
+        if (chunk->Compressed)
+        {
+            memset(source->Packed + chunk->Length, 0, GetStegoChunkStored(index, source->Chunk) - chunk->Length);
+        }
+    }
+
+    chunk->Offset = source->Offset;
+    source->Offset += GetStegoChunkStored(index, source->Chunk);
+    index->Compressed |= chunk->Compressed;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoSource
+   $Prototype: static int ReadStegoSource(StegoSource *source, char *buffer, int count)
+   $Params:
+       source: Where the bytes come from
+       buffer: The buffer to fill
+       count: How many bytes to read
+   $
+   $Description: Reads the next bytes that need to be encoded: the header,
+   the index and then the chunks. The checksum of each chunk is worked out
+   as it is handed out. Returns how many bytes were read, which is short
+   if the file can't be read. $
+   ======================================================================== */
+static int ReadStegoSource(StegoSource *source, char *buffer, int count)
+{
+    int bytes_read = 0;
+
+    while (bytes_read < count && source->Stage != STEGO_STAGE_DONE)
+    {
+        const char *bytes;
+        uint32_t length;
+        uint32_t n;
+
+        if (source->Stage == STEGO_STAGE_HEADER)
+        {
+            bytes = source->Header;
+            length = STEGO_HEADER_BYTES;
+        }
+        else if (source->Stage == STEGO_STAGE_INDEX)
+        {
+            bytes = source->IndexBytes;
+            length = source->IndexLength;
+        }
+        else
+        {
+            if (source->Done == 0 && LoadStegoChunk(source) != 0)
+            {
+                break;
+            }
+
+            bytes = source->ChunkData;
+            length = GetStegoChunkStored(&source->Index, source->Chunk);
+        }
+
+        n = length - source->Done;
+        if (n > (uint32_t)(count - bytes_read))
+        {
+            n = count - bytes_read;
+        }
+
+        memcpy(buffer + bytes_read, bytes + source->Done, n);
+        bytes_read += n;
+        source->Done += n;
+
+        if (source->Stage == STEGO_STAGE_CHUNKS)
+        {
+            StegoChunk *chunk = &source->Index.Chunks[source->Chunk];
+
+            chunk->Checksum = UpdateChecksum(chunk->Checksum, (const uint8_t*)buffer + bytes_read - n, n);
+
+            if (source->Done == length)
+            {
+                chunk->Checksum = GetStegoChunkChecksum(chunk->Checksum, length);
+                source->Chunk++;
+            }
+        }
+
+        // Move on to the next part.
+        if (source->Done == length)
+        {
+            source->Done = 0;
+
+            if (source->Stage != STEGO_STAGE_CHUNKS || source->Chunk == source->Index.ChunkCount)
+            {
+                source->Stage = (StegoStage)(source->Stage + 1);
+            }
+        }
+
+        if (source->Stage == STEGO_STAGE_CHUNKS && source->Index.ChunkCount == 0)
+        {
+            source->Stage = STEGO_STAGE_DONE;
+        }
+    }
+
+    return bytes_read;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoFileStreamed
+   $Prototype: int EncodeStegoFileStreamed(const char *image_filename, const char *filename, const char *output_filename, int buffer_size)
+   $Params:
+       image_filename: The bitmap to encode into
+       filename: The filename to put into the image
+       output_filename: The bitmap to write
+       buffer_size: Roughly how many bytes of pixels to hold at once, 0
+                    uses STEGO_STREAM_BUFFER_SIZE.
+   $
+   $Description: Encodes a file into a bitmap without loading either of
+   them. The image is read a strip of rows at a time, the part of the file
+   that goes in the strip is encoded into it and the strip is written out
+   before the next one is read. The output is the same as saving the image
+   from EncodeStegoFile. The file is only read once, and each chunk is
+   compressed once as it is read, so it can be a pipe. A file that can't
+   be measured up front is spilled into memory first (SpillStegoSource).
+
+   Where the chunks go and their checksums aren't known until the whole
+   file has been encoded, so the strips holding the header and the index
+   are kept and written again at the end with the real index. Returns 0
+   on success and -1 on failure, when the output is removed. $
+   ======================================================================== */
+int EncodeStegoFileStreamed(const char *image_filename, const char *filename, const char *output_filename, int buffer_size)
+{
+    TIMED_BLOCK();
+
+    BitmapStream *input;
+    BitmapStream *output;
+    StegoSource source;
+    StegoCursor cursor;
+    StegoHeader header;
+    Image strip;
+    Image header_strip;
+    size_t header_strip_done = 0;
+    uint32_t strip_pixels;
+    uint32_t strip_start = 0;
+    uint32_t pixel_count;
+    char *payload;
+    struct stat file_stat;
+    uint32_t capacity;
+    uint32_t bytes_left;
+    int result = 0;
+
+    if (buffer_size <= 0)
+    {
+        buffer_size = STEGO_STREAM_BUFFER_SIZE;
+    }
+
+    // The strips are encoded in order, a scattered payload would need all of them.
+    if (stego_scatter)
+    {
+        printf("Error: a scattered payload can't be streamed.\n");
+        return -1;
+    }
+
+    if ((input = OpenBitmapStream(image_filename)) == 0)
+    {
+        return -1;
+    }
+
+    memset(&source, 0, sizeof(StegoSource));
+
+    if ((source.File = fopen(filename, "r")) == 0)
+    {
+        printf("Unable to open file: %s\n", filename);
+        CloseBitmapStream(input);
+        return -1;
+    }
+
+    // The payload is the NUL terminated filename, then the file.
+    source.Name = filename;
+    source.NameLength = strlen(filename) + 1;
+    source.Block = (char*)AllocateMemory(MEMORY_STREAM, STEGO_CHUNK_BYTES);
+    capacity = StegoMaxBytes(&input->Format);
+
+    if (fstat(fileno(source.File), &file_stat) == 0 && S_ISREG(file_stat.st_mode))
+    {
+        // Until the chunks are compressed they are placed as they are, so
+        // the payload is as long as this at most. A file that can't fit
+        // without compression isn't worth trying.
+        if ((!stego_compression && (uint64_t)file_stat.st_size > capacity) ||
+            (uint64_t)file_stat.st_size + source.NameLength > STEGO_MAX_LENGTH)
+        {
+            printf("Error: buffer is too long to store.\n");
+            result = -1;
+        }
+        else
+        {
+            StartStegoIndex(&source.Index, file_stat.st_size + source.NameLength);
+            PlaceStegoChunks(&source.Index);
+            source.Packed = stego_compression ? (char*)AllocateMemory(MEMORY_STREAM, GetStegoChunkSlot(&source.Index)) : 0;
+
+            if (!stego_compression && GetStegoPayloadSize(&source.Index, 0, 0) > capacity)
+            {
+                printf("Error: buffer is too long to store.\n");
+                result = -1;
+            }
+        }
+    }
+    else
+    {
+        result = SpillStegoSource(&source, capacity);
+    }
+
+    if (result == 0 && (output = CreateBitmapStream(output_filename, &input->Format)) == 0)
+    {
+        result = -1;
+    }
+
+    if (result != 0)
+    {
+        FreeStegoSpill(&source);
+        FreeMemory(source.Packed);
+        FreeMemory(source.Block);
+        FreeStegoIndex(&source.Index);
+        fclose(source.File);
+        CloseBitmapStream(input);
+        return -1;
+    }
+
+    // Where the chunks go and the checksums are filled in at the end.
+    source.IndexLength = GetStegoIndexBytes(source.Index.ChunkCount);
+    source.IndexBytes = (char*)AllocateMemory(MEMORY_STREAM, source.IndexLength);
+    SetStegoIndex(source.IndexBytes, &source.Index);
+
+    header.Length = source.IndexLength + source.Index.StoredLength;
+    header.Depth = stego_depth;
+    header.Compressed = source.Index.Compressed;
+    header.Encrypted = 0;
+    header.Scattered = 0;
+    header.StripeIndex = 0;
+    header.StripeCount = 0;
+    header.Checksum = 0;
+    SetStegoHeader(source.Header, &header);
+
+    // The strip is an image with the masks of the bitmap and a few rows of pixels.
+    strip_pixels = GetStegoStripPixels(&input->Format, buffer_size);
+    memcpy(&strip, &input->Format, sizeof(Image));
+    strip.Pixels = (uint32_t*)AllocateMemory(MEMORY_STREAM, strip_pixels * sizeof(uint32_t));
+    payload = (char*)AllocateMemory(MEMORY_STREAM, GetStegoByteCount(strip_pixels, stego_depth) + STEGO_HEADER_BYTES);
+
+    // A copy of the pixels that hold the header and the index.
+    memcpy(&header_strip, &input->Format, sizeof(Image));
+    header_strip.PixelCount = GetStegoHeaderImagePixels(&input->Format, STEGO_HEADER_PIXELS + GetStegoPixelCount(source.IndexLength, stego_depth));
+    header_strip.Height = header_strip.PixelCount / header_strip.Width;
+    header_strip.Pixels = (uint32_t*)AllocateMemory(MEMORY_STREAM, header_strip.PixelCount * sizeof(uint32_t));
+
+    memset(&cursor, 0, sizeof(StegoCursor));
+    cursor.Depth = stego_depth;
+    bytes_left = header.Length + STEGO_HEADER_BYTES;
+
+    while ((pixel_count = ReadBitmapStrip(input, strip.Pixels, strip_pixels)) > 0)
+    {
+        uint32_t count;
+        uint32_t strip_end;
+
+        strip.PixelCount = pixel_count;
+        strip.Height = pixel_count / strip.Width;
+        strip_end = strip_start + GetStegoImagePixels(&strip);
+
+        // The header and the rest can both be in the same strip. Compressed
+        // chunks can come up short of bytes_left.
+        while (result == 0 && (count = GetStegoCursorBytes(&cursor, strip_end, bytes_left)) > 0)
+        {
+            uint32_t n = ReadStegoSource(&source, payload, count);
+
+            if (n != count && source.Stage != STEGO_STAGE_DONE)
+            {
+                printf("Error reading file: %s\n", filename);
+                result = -1;
+                break;
+            }
+
+            EncodeStegoParallel(&strip, payload, n, cursor.Pixel - strip_start,
+                                (cursor.Byte < STEGO_HEADER_BYTES) ? 1 : cursor.Depth, 0);
+
+            AdvanceStegoCursor(&cursor, n);
+            bytes_left = (source.Stage == STEGO_STAGE_DONE) ? 0 : bytes_left - n;
+        }
+
+        // Keep the pixels that hold the header and the index, as they are in the file.
+        if (header_strip_done < GetImageSize(&header_strip))
+        {
+            size_t bytes = GetImageSize(&header_strip) - header_strip_done;
+
+            if (bytes > GetImageSize(&strip))
+            {
+                bytes = GetImageSize(&strip);
+            }
+
+            memcpy((uint8_t*)header_strip.Pixels + header_strip_done, strip.Pixels, bytes);
+            header_strip_done += bytes;
+        }
+
+        if (result != 0 || WriteBitmapStrip(output, strip.Pixels, pixel_count) != 0)
+        {
+            result = -1;
+            break;
+        }
+
+        strip_start = strip_end;
+    }
+
+    if (result == 0 && output->PixelsDone != input->Format.PixelCount)
+    {
+        printf("Error reading bitmap pixels.\n");
+        result = -1;
+    }
+
+    // The compressed chunks ran out of room before they were all encoded.
+    if (result == 0 && source.Stage != STEGO_STAGE_DONE)
+    {
+        printf("Error: buffer is too long to store.\n");
+        result = -1;
+    }
+
+    // Now the chunks are placed and the checksums are known the header
+    // and the index can be written.
+    if (result == 0)
+    {
+        source.Index.StoredLength = source.Offset;
+        header.Length = source.IndexLength + source.Index.StoredLength;
+        header.Compressed = source.Index.Compressed;
+
+        SetStegoIndex(source.IndexBytes, &source.Index);
+        header.Checksum = FinishChecksum(UpdateChecksum(CHECKSUM_START, (const uint8_t*)source.IndexBytes, source.IndexLength));
+        SetStegoHeader(source.Header, &header);
+
+        EncodeStegoBytesDepth(&header_strip, source.Header, STEGO_HEADER_BYTES, 0, 1);
+        EncodeStegoBytesDepth(&header_strip, source.IndexBytes, source.IndexLength, STEGO_HEADER_PIXELS, stego_depth);
+
+        if (RewriteBitmapStrip(output, header_strip.Pixels, 0, header_strip.PixelCount) != 0)
+        {
+            result = -1;
+        }
+    }
+
+    FreeMemory(header_strip.Pixels);
+    FreeMemory(payload);
+    FreeMemory(strip.Pixels);
+    FreeMemory(source.IndexBytes);
+    FreeStegoSpill(&source);
+    FreeMemory(source.Packed);
+    FreeMemory(source.Block);
+    FreeStegoIndex(&source.Index);
+    fclose(source.File);
+    CloseBitmapStream(output);
+    CloseBitmapStream(input);
+
+    // Don't leave half an image behind.
+    if (result != 0)
+    {
+        remove(output_filename);
+    }
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CheckStegoHeader
+   $Prototype: static int CheckStegoHeader(const char *bytes, StegoHeader *header, uint32_t pixel_count)
+   $Params:
+       bytes: The STEGO_HEADER_BYTES from the first 32 pixels.
+       header: Gets filled out.
+       pixel_count: How many pixels the image has.
+   $
+   $Description: Reads the header and says what is wrong with it if it
+   can't be decoded. Returns 0 on success and -1 if the image doesn't have
+   a payload this version can read or the length doesn't fit in the
+   image. $
+   ======================================================================== */
+static int CheckStegoHeader(const char *bytes, StegoHeader *header, uint32_t pixel_count)
+{
+    int result = GetStegoHeader(bytes, header);
+
+    if (result == -2)
+    {
+        printf("Cannot decode image. The payload is from a different version.\n");
+        return -1;
+    }
+
+    if (result != 0)
+    {
+        printf("Cannot decode image. It doesn't have a payload.\n");
+        return -1;
+    }
+
+    if (header->Length + STEGO_HEADER_BYTES > (uint32_t)GetStegoCapacity(pixel_count, header->Depth))
+    {
+        printf("Cannot decode image. The stored length is bigger than the image.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoHeader
+   $Prototype: static int ReadStegoHeader(Image *image, StegoHeader *header)
+   $Params:
+       image: The image to read the header from
+       header: Gets filled out.
+   $
+   $Description: Reads the header of the payload from the first 32
+   pixels. Returns 0 on success and -1 if the image doesn't have a payload
+   or the length doesn't fit in the image. $
+   ======================================================================== */
+static int ReadStegoHeader(Image *image, StegoHeader *header)
+{
+    char bytes[STEGO_HEADER_BYTES];
+    uint32_t pixel_count = GetStegoImagePixels(image);
+
+    if (pixel_count < STEGO_HEADER_PIXELS)
+    {
+        printf("Cannot decode image. It doesn't have a payload.\n");
+        return -1;
+    }
+
+    DecodeStegoBytesDepth(image, 0, bytes, STEGO_HEADER_BYTES, 1);
+
+    return CheckStegoHeader(bytes, header, pixel_count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CheckStegoChecksum
+   $Prototype: static int CheckStegoChecksum(uint32_t checksum, uint32_t stored_checksum)
+   $Params:
+       checksum: The checksum of the encryption header and the index, not
+                 finished yet.
+       stored_checksum: The checksum from the header.
+   $
+   $Description: Returns 0 if the checksums match and -1 if they don't. $
+   ======================================================================== */
+static int CheckStegoChecksum(uint32_t checksum, uint32_t stored_checksum)
+{
+    if (FinishChecksum(checksum) != stored_checksum)
+    {
+        printf("Cannot decode image. The checksum doesn't match, the image is damaged.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: OpenStegoPayload
+   $Prototype: static int OpenStegoPayload(Image *image, const char *password, Cipher *key, StegoPayload *payload, int striped)
+   $Params:
+       image: The image to read from
+       password: The password the payload was encrypted with, 0 if it
+                 isn't encrypted.
+       key: Gets set up to decrypt the payload if there is a password.
+       payload: Gets filled out.
+       striped: 1 if the payload can be a stripe of a bigger one.
+   $
+   $Description: Reads the header of the payload, then the stripe header
+   if it is a stripe, the encryption header if there is a password and
+   then the start of the index, which says how long the data is. None of
+   the chunk entries are read yet. Returns how many bytes of data there
+   are, or -1 if there is no payload, it needs a password that wasn't
+   given (or the other way around) or the password is wrong. $
+   ======================================================================== */
+static int OpenStegoPayload(Image *image, const char *password, Cipher *key, StegoPayload *payload, int striped)
+{
+    uint8_t key_header[ENCRYPT_HEADER_BYTES];
+    char stripe_bytes[STEGO_STRIPE_BYTES];
+    char index_header[STEGO_INDEX_ALIGN];
+    StegoHeader header;
+    uint32_t length;
+
+    if (ReadStegoHeader(image, &header) != 0)
+    {
+        return -1;
+    }
+
+    if (header.StripeCount > 0 && !striped)
+    {
+        printf("Cannot decode image. It is stripe %d of %d, they have to be decoded together.\n", header.StripeIndex + 1, header.StripeCount);
+        return -1;
+    }
+
+    if (header.Encrypted && !password)
+    {
+        printf("Cannot decode image. The data is encrypted, it needs a password.\n");
+        return -1;
+    }
+
+    if (!header.Encrypted && password)
+    {
+        printf("Cannot decode image. The data isn't encrypted.\n");
+        return -1;
+    }
+
+    if (StartStegoPayloadScatter(image, &header, payload) != 0)
+    {
+        return -1;
+    }
+
+    length = header.Length;
+    payload->Depth = header.Depth;
+    payload->IndexPixel = STEGO_HEADER_PIXELS;
+    payload->Checksum = CHECKSUM_START;
+    payload->StoredChecksum = header.Checksum;
+
+    if (header.StripeCount > 0)
+    {
+        if (length < STEGO_STRIPE_BYTES)
+        {
+            printf("Cannot decode image. The stripe header is missing.\n");
+            return -1;
+        }
+
+        DecodeStegoBytesScattered(image, payload->IndexPixel, stripe_bytes, STEGO_STRIPE_BYTES, payload->Depth, GetStegoPayloadScatter(payload));
+
+        length -= STEGO_STRIPE_BYTES;
+        payload->IndexPixel += GetStegoPixelCount(STEGO_STRIPE_BYTES, payload->Depth);
+        payload->Checksum = UpdateChecksum(payload->Checksum, (const uint8_t*)stripe_bytes, STEGO_STRIPE_BYTES);
+    }
+
+    if (password)
+    {
+        if (!HasEncryptInstructions())
+        {
+            printf("Error: this processor doesn't have the AES instructions.\n");
+            return -1;
+        }
+
+        if (length < ENCRYPT_HEADER_BYTES)
+        {
+            printf("Cannot decode image. The encryption header is missing.\n");
+            return -1;
+        }
+
+        DecodeStegoBytesScattered(image, payload->IndexPixel, (char*)key_header, ENCRYPT_HEADER_BYTES, payload->Depth, GetStegoPayloadScatter(payload));
+
+        if (StartDecryption(key, password, key_header) != 0)
+        {
+            printf("Cannot decode image. The password is wrong.\n");
+            return -1;
+        }
+
+        length -= ENCRYPT_HEADER_BYTES;
+        payload->IndexPixel += GetStegoPixelCount(ENCRYPT_HEADER_BYTES, payload->Depth);
+        payload->Checksum = UpdateChecksum(payload->Checksum, key_header, ENCRYPT_HEADER_BYTES);
+    }
+
+    // The start of the index says how long the data is and how it is split up.
+    if (length >= STEGO_INDEX_ALIGN)
+    {
+        DecodeStegoBytesScattered(image, payload->IndexPixel, index_header, STEGO_INDEX_ALIGN, payload->Depth, GetStegoPayloadScatter(payload));
+    }
+
+    if (length < STEGO_INDEX_ALIGN || GetStegoIndexHeader(index_header, &payload->Index, length) != 0)
+    {
+        printf("Cannot decode image. The index is bad.\n");
+
+        if (password)
+        {
+            FinishCipher(key);
+        }
+
+        return -1;
+    }
+
+    payload->Pixel = payload->IndexPixel + GetStegoPixelCount(GetStegoIndexBytes(payload->Index.ChunkCount), payload->Depth);
+
+    return payload->Index.DataLength;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoIndex
+   $Prototype: static int ReadStegoIndex(Image *image, StegoPayload *payload, uint32_t first, uint32_t count)
+   $Params:
+       image: The image to read from
+       payload: The payload to read the entries of.
+       first: The first chunk to read the entry of
+       count: How many entries to read
+   $
+   $Description: Reads the entries of some of the chunks. Only the groups
+   of pixels that hold them are decoded. When the whole index is read its
+   checksum is checked, which is what the checksums of the chunks are
+   trusted from. The entries are freed with FreeStegoIndex. Returns 0 on
+   success and -1 if the index is damaged. $
+   ======================================================================== */
+static int ReadStegoIndex(Image *image, StegoPayload *payload, uint32_t first, uint32_t count)
+{
+    StegoIndex *index = &payload->Index;
+    uint32_t index_bytes = GetStegoIndexBytes(index->ChunkCount);
+    uint32_t start = STEGO_INDEX_HEADER_BYTES + (first * STEGO_INDEX_ENTRY_BYTES);
+    uint32_t end = start + (count * STEGO_INDEX_ENTRY_BYTES);
+    int whole = (first == 0 && count == index->ChunkCount);
+    uint32_t checksum;
+    char *bytes;
+
+    if (whole)
+    {
+        start = 0;
+        end = index_bytes;
+    }
+
+    // Decode from the start of the group of pixels the first entry is in.
+    start = (start / STEGO_INDEX_ALIGN) * STEGO_INDEX_ALIGN;
+    bytes = (char*)AllocateMemory(MEMORY_CHUNK, end - start);
+    checksum = DecodeStegoParallel(image, payload->IndexPixel + GetStegoPixelCount(start, payload->Depth),
+                                   bytes, end - start, payload->Depth, GetStegoPayloadScatter(payload));
+
+    if (whole && CheckStegoChecksum(CombineChecksum(payload->Checksum, checksum, index_bytes), payload->StoredChecksum) != 0)
+    {
+        FreeMemory(bytes);
+        return -1;
+    }
+
+    if (!index->Chunks)
+    {
+        index->Chunks = AllocateStegoChunks(index->ChunkCount);
+    }
+
+    for(uint32_t i = first; i < first + count; i++)
+    {
+        const char *entry = bytes + STEGO_INDEX_HEADER_BYTES + (i * STEGO_INDEX_ENTRY_BYTES) - start;
+
+        if (GetStegoChunk(entry, index, i) != 0)
+        {
+            printf("Cannot decode image. The index is bad.\n");
+            FreeMemory(bytes);
+            return -1;
+        }
+    }
+
+    FreeMemory(bytes);
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoPayload
+   $Prototype: static int DecodeStegoPayload(Image *image, char *buffer, int buffer_len, StegoPayload *payload, const Cipher *key)
+   $Params:
+       image: The image to decode from
+       buffer: The buffer to write into
+       buffer_len: The max size of the buffer
+       payload: The payload from OpenStegoPayload.
+       key: The cipher to decrypt the data with, or 0.
+   $
+   $Description: Reads and checks the whole index, then decodes every
+   chunk straight into its place in the buffer. Each chunk is checked
+   against its checksum before it is decompressed. Returns the length of
+   the data or -1. $
+   ======================================================================== */
+static int DecodeStegoPayload(Image *image, char *buffer, int buffer_len, StegoPayload *payload, const Cipher *key)
+{
+    int result;
+
+    if ((uint32_t)buffer_len < payload->Index.DataLength)
+    {
+        printf("Cannot decode image. Buffer is too small to write to.\n");
+        return -1;
+    }
+
+    result = ReadStegoIndex(image, payload, 0, payload->Index.ChunkCount);
+
+    if (result == 0)
+    {
+        result = DecodeStegoChunks(image, payload, key, buffer, 0, payload->Index.ChunkCount);
+    }
+
+    FreeStegoIndex(&payload->Index);
+
+    return (result == 0) ? (int)payload->Index.DataLength : -1;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoPayloadRange
+   $Prototype: static int DecodeStegoPayloadRange(Image *image, char *buffer, uint32_t offset, int length, StegoPayload *payload, const Cipher *key)
+   $Params:
+       image: The image to decode from
+       buffer: The buffer to write into, with room for length bytes.
+       offset: The first byte of the data to decode
+       length: How many bytes to decode. It is cut short at the end of the
+               data.
+       payload: The payload from OpenStegoPayload.
+       key: The cipher to decrypt the data with, or 0.
+   $
+   $Description: Decodes part of the data. Only the index entries and the
+   pixels of the chunks that hold the range are decoded, so it takes as
+   long for a range at the end of a huge payload as at the start of a
+   small one. The chunks in the middle go straight into the buffer and the
+   ones at the ends go through a chunk sized buffer. The checksum in the
+   header can't be checked without reading the whole index, but every
+   chunk is still checked against its own. Returns how many bytes were
+   decoded or -1. $
+   ======================================================================== */
+static int DecodeStegoPayloadRange(Image *image, char *buffer, uint32_t offset, int length, StegoPayload *payload, const Cipher *key)
+{
+    StegoIndex *index = &payload->Index;
+    uint32_t end;
+    uint32_t first;
+    uint32_t last;
+    uint32_t whole_first;
+    uint32_t whole_end;
+    char *chunk_buffer = 0;
+    int result = 0;
+
+    if (offset > index->DataLength || length < 0)
+    {
+        printf("Cannot decode image. The range is past the end of the data.\n");
+        return -1;
+    }
+
+    if ((uint32_t)length > index->DataLength - offset)
+    {
+        length = index->DataLength - offset;
+    }
+
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    // The chunks the range touches, and the ones it covers completely.
+    end = offset + length;
+    first = offset / index->ChunkBytes;
+    last = (end - 1) / index->ChunkBytes;
+    whole_first = (offset + index->ChunkBytes - 1) / index->ChunkBytes;
+    whole_end = (end == index->DataLength) ? index->ChunkCount : (end / index->ChunkBytes);
+
+    if (ReadStegoIndex(image, payload, first, last - first + 1) != 0)
+    {
+        FreeStegoIndex(index);
+        return -1;
+    }
+
+    if (whole_first < whole_end)
+    {
+        result = DecodeStegoChunks(image, payload, key, buffer + ((size_t)whole_first * index->ChunkBytes - offset),
+                                   whole_first, whole_end - whole_first);
+    }
+
+    for(uint32_t chunk = first; chunk <= last && result == 0; chunk++)
+    {
+        uint32_t chunk_start = chunk * index->ChunkBytes;
+        uint32_t from;
+        uint32_t to;
+        StegoJob job;
+
+        if (chunk >= whole_first && chunk < whole_end)
+        {
+            continue;
+        }
+
+        if (!chunk_buffer)
+        {
+            chunk_buffer = (char*)AllocateMemory(MEMORY_CHUNK, index->ChunkBytes);
+        }
+
+        memset(&job, 0, sizeof(StegoJob));
+        job.Carrier = image;
+        job.Pixel = payload->Pixel;
+        job.Depth = payload->Depth;
+        job.Scatter = GetStegoPayloadScatter(payload);
+        job.Key = key;
+        job.Index = index;
+
+        if ((result = CheckStegoChunk(DecodeStegoChunk(&job, chunk, chunk_buffer))) == 0)
+        {
+            from = (offset > chunk_start) ? (offset - chunk_start) : 0;
+            to = (end - chunk_start < GetStegoChunkLength(index, chunk)) ? (end - chunk_start) : GetStegoChunkLength(index, chunk);
+
+            memcpy(buffer + (chunk_start + from - offset), chunk_buffer + from, to - from);
+        }
+    }
+
+    FreeMemory(chunk_buffer);
+    FreeStegoIndex(index);
+
+    return (result == 0) ? length : -1;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoDecodedBytes
+   $Prototype: int StegoDecodedBytes(Image *image)
+   $Params:
+       image: The image to check
+   $
+   $Description: Returns how big a buffer DecodeStegoBuffer needs for the
+   payload of the image, which is the length of the data before it was
+   compressed. Returns -1 if the image doesn't have a payload. $
+   ======================================================================== */
+int StegoDecodedBytes(Image *image)
+{
+    StegoPayload payload;
+
+    return OpenStegoPayload(image, 0, 0, &payload, 0);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoDecodedBytesEnc
+   $Prototype: int StegoDecodedBytesEnc(Image *image, const char *password)
+   $Params:
+       image: The image to check
+       password: The password it was encrypted with
+   $
+   $Description: Returns how big a buffer DecodeStegoBufferEnc needs for
+   the encrypted payload of the image, or -1 if it can't be decrypted. $
+   ======================================================================== */
+int StegoDecodedBytesEnc(Image *image, const char *password)
+{
+    Cipher key;
+    StegoPayload payload;
+    int length;
+
+    if ((length = OpenStegoPayload(image, password, &key, &payload, 0)) < 0)
+    {
+        return -1;
+    }
+
+    FinishCipher(&key);
+
+    return length;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBuffer
+   $Prototype: int DecodeStegoBuffer(Image *image, char *buffer, int buffer_len)
+   $Params:
+       image: The image to decode the buffer from
+       buffer: The buffer to write into
+       buffer_len: The max size of the buffer. StegoDecodedBytes says how
+                   big it has to be.
+   $
+   $Description: Decodes a buffer of data from an image, decompressing it
+   if it was compressed. Returns the length of the data or -1, which
+   includes when a checksum doesn't match. $
+   ======================================================================== */
+int DecodeStegoBuffer(Image *image, char *buffer, int buffer_len)
+{
+    TIMED_BLOCK();
+
+    StegoPayload payload;
+
+    // Read the header.
+    if (OpenStegoPayload(image, 0, 0, &payload, 0) < 0)
+    {
+        return -1;
+    }
+
+    return DecodeStegoPayload(image, buffer, buffer_len, &payload, 0);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBufferEnc
+   $Prototype: int DecodeStegoBufferEnc(Image *image, char *buffer, int buffer_len, const char *password)
+   $Params:
+       image: The image to decode the buffer from
+       buffer: The buffer to write into
+       buffer_len: The max size of the buffer. StegoDecodedBytesEnc says
+                   how big it has to be.
+       password: The password it was encrypted with
+   $
+   $Description: Decodes a buffer of data that was encoded with
+   EncodeStegoBufferEnc. Each thread decrypts its chunks as soon as it has
+   decoded them. Returns the length of the data or -1. $
+   ======================================================================== */
+int DecodeStegoBufferEnc(Image *image, char *buffer, int buffer_len, const char *password)
+{
+    TIMED_BLOCK();
+
+    Cipher key;
+    StegoPayload payload;
+    int length;
+
+    if (OpenStegoPayload(image, password, &key, &payload, 0) < 0)
+    {
+        return -1;
+    }
+
+    length = DecodeStegoPayload(image, buffer, buffer_len, &payload, &key);
+    FinishCipher(&key);
+
+    return length;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoStripe
+   $Prototype: int ReadStegoStripe(Image *image, StegoStripe *stripe)
+   $Params:
+       image: The image with a stripe in it
+       stripe: Gets filled out.
+   $
+   $Description: Reads which stripe the image has and how long its part
+   of the data is, from the header, the stripe header and the start of
+   the index, none of which are encrypted. Returns 0 on success and -1 if
+   the image doesn't have a stripe. $
+   ======================================================================== */
+int ReadStegoStripe(Image *image, StegoStripe *stripe)
+{
+    char stripe_bytes[STEGO_STRIPE_BYTES];
+    char index_header[STEGO_INDEX_ALIGN];
+    StegoHeader header;
+    StegoIndex index;
+    StegoPayload payload;
+    uint32_t pixel = STEGO_HEADER_PIXELS;
+    uint32_t before = STEGO_STRIPE_BYTES;
+
+    if (ReadStegoHeader(image, &header) != 0 || StartStegoPayloadScatter(image, &header, &payload) != 0)
+    {
+        return -1;
+    }
+
+    if (header.StripeCount == 0)
+    {
+        printf("Cannot decode image. It isn't a stripe of a payload.\n");
+        return -1;
+    }
+
+    // The index is after the encryption header, if there is one.
+    if (header.Encrypted)
+    {
+        before += ENCRYPT_HEADER_BYTES;
+    }
+
+    if (header.Length < before + STEGO_INDEX_ALIGN)
+    {
+        printf("Cannot decode image. The stripe header is missing.\n");
+        return -1;
+    }
+
+    DecodeStegoBytesScattered(image, pixel, stripe_bytes, STEGO_STRIPE_BYTES, header.Depth, GetStegoPayloadScatter(&payload));
+    pixel += GetStegoPixelCount(before, header.Depth);
+    DecodeStegoBytesScattered(image, pixel, index_header, STEGO_INDEX_ALIGN, header.Depth, GetStegoPayloadScatter(&payload));
+
+    if (GetStegoStripe(stripe_bytes, stripe) != 0 || GetStegoIndexHeader(index_header, &index, header.Length - before) != 0 ||
+        index.DataLength > stripe->DataLength - stripe->Offset)
+    {
+        printf("Cannot decode image. The stripe header is bad.\n");
+        return -1;
+    }
+
+    stripe->Length = index.DataLength;
+    stripe->Index = header.StripeIndex;
+    stripe->Count = header.StripeCount;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoStripe
+   $Prototype: int DecodeStegoStripe(Image *image, char *buffer, int buffer_len)
+   $Params:
+       image: The image with a stripe in it
+       buffer: The buffer to write the stripe's part of the data into
+       buffer_len: The max size of the buffer. ReadStegoStripe says how
+                   big it has to be.
+   $
+   $Description: Decodes the part of the data one stripe holds. Returns
+   the length of the part or -1. $
+   ======================================================================== */
+int DecodeStegoStripe(Image *image, char *buffer, int buffer_len)
+{
+    TIMED_BLOCK();
+
+    StegoPayload payload;
+
+    if (OpenStegoPayload(image, 0, 0, &payload, 1) < 0)
+    {
+        return -1;
+    }
+
+    return DecodeStegoPayload(image, buffer, buffer_len, &payload, 0);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoStripeEnc
+   $Prototype: int DecodeStegoStripeEnc(Image *image, char *buffer, int buffer_len, const char *password)
+   $Params:
+       image: The image with a stripe in it
+       buffer: The buffer to write the stripe's part of the data into
+       buffer_len: The max size of the buffer
+       password: The password it was encrypted with
+   $
+   $Description: DecodeStegoStripe for a stripe encoded with
+   EncodeStegoStripeInPlaceEnc. Returns the length of the part or -1. $
+   ======================================================================== */
+int DecodeStegoStripeEnc(Image *image, char *buffer, int buffer_len, const char *password)
+{
+    TIMED_BLOCK();
+
+    Cipher key;
+    StegoPayload payload;
+    int length;
+
+    if (OpenStegoPayload(image, password, &key, &payload, 1) < 0)
+    {
+        return -1;
+    }
+
+    length = DecodeStegoPayload(image, buffer, buffer_len, &payload, &key);
+    FinishCipher(&key);
+
+    return length;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoRange
+   $Prototype: int DecodeStegoRange(Image *image, char *buffer, uint32_t offset, int length)
+   $Params:
+       image: The image to decode from
+       buffer: The buffer to write into, with room for length bytes.
+       offset: The first byte of the data to decode
+       length: How many bytes to decode
+   $
+   $Description: Decodes length bytes of the data from offset on, without
+   decoding the rest of it. It only touches the pixels of the chunks the
+   range is in, so how long it takes doesn't depend on how big the
+   payload is. Returns how many bytes were decoded, which is less than
+   length if the data ends first, or -1. $
+   ======================================================================== */
+int DecodeStegoRange(Image *image, char *buffer, uint32_t offset, int length)
+{
+    TIMED_BLOCK();
+
+    StegoPayload payload;
+
+    if (OpenStegoPayload(image, 0, 0, &payload, 0) < 0)
+    {
+        return -1;
+    }
+
+    return DecodeStegoPayloadRange(image, buffer, offset, length, &payload, 0);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoRangeEnc
+   $Prototype: int DecodeStegoRangeEnc(Image *image, char *buffer, uint32_t offset, int length, const char *password)
+   $Params:
+       image: The image to decode from
+       buffer: The buffer to write into, with room for length bytes.
+       offset: The first byte of the data to decode
+       length: How many bytes to decode
+       password: The password it was encrypted with
+   $
+   $Description: DecodeStegoRange for a payload encoded with
+   EncodeStegoBufferEnc. Returns how many bytes were decoded or -1. $
+   ======================================================================== */
+int DecodeStegoRangeEnc(Image *image, char *buffer, uint32_t offset, int length, const char *password)
+{
+    TIMED_BLOCK();
+
+    Cipher key;
+    StegoPayload payload;
+    int result;
+
+    if (OpenStegoPayload(image, password, &key, &payload, 0) < 0)
+    {
+        return -1;
+    }
+
+    result = DecodeStegoPayloadRange(image, buffer, offset, length, &payload, &key);
+    FinishCipher(&key);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: OpenStegoReader
+   $Prototype: StegoReader *OpenStegoReader(Image *image, const char *password)
+   $Params:
+       image: The image to decode from. It has to stay loaded until the
+              reader is closed.
+       password: The password it was encrypted with, 0 if it isn't
+                 encrypted.
+   $
+   $Description: Reads the header of the payload and derives the key once,
+   so that many ranges can be decoded with DecodeStegoReaderRange without
+   doing it again for each one. Returns 0 if there is no payload or it
+   can't be decrypted. $
+   ======================================================================== */
+StegoReader *OpenStegoReader(Image *image, const char *password)
+{
+    StegoReader *reader = (StegoReader*)AllocateMemory(MEMORY_PAYLOAD, sizeof(StegoReader));
+    int length;
+
+    if (password)
+    {
+        length = OpenStegoPayload(image, password, &reader->Key, &reader->Payload, 0);
+    }
+    else
+    {
+        length = OpenStegoPayload(image, 0, 0, &reader->Payload, 0);
+    }
+
+    if (length < 0)
+    {
+        FreeMemory(reader);
+        return 0;
+    }
+
+    reader->Carrier = image;
+    reader->Encrypted = (password != 0);
+
+    return reader;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoReaderBytes
+   $Prototype: int StegoReaderBytes(StegoReader *reader)
+   $Params:
+       reader: The reader to check
+   $
+   $Description: Returns how many bytes of data the payload has. $
+   ======================================================================== */
+int StegoReaderBytes(StegoReader *reader)
+{
+    return reader->Payload.Index.DataLength;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoReaderChunkBytes
+   $Prototype: int StegoReaderChunkBytes(StegoReader *reader)
+   $Params:
+       reader: The reader to check
+   $
+   $Description: Returns how many bytes of data each chunk holds. A range
+   that starts and ends on a multiple of it doesn't decode any chunk that
+   it only has part of. $
+   ======================================================================== */
+int StegoReaderChunkBytes(StegoReader *reader)
+{
+    return reader->Payload.Index.ChunkBytes;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoReaderRange
+   $Prototype: int DecodeStegoReaderRange(StegoReader *reader, char *buffer, uint32_t offset, int length)
+   $Params:
+       reader: The reader from OpenStegoReader
+       buffer: The buffer to write into, with room for length bytes.
+       offset: The first byte of the data to decode
+       length: How many bytes to decode
+   $
+   $Description: DecodeStegoRange on a payload that is already open. The
+   index entries it needs are read into a copy of the payload, so ranges
+   can be decoded from the same reader on many threads at once. Returns
+   how many bytes were decoded or -1. $
+   ======================================================================== */
+int DecodeStegoReaderRange(StegoReader *reader, char *buffer, uint32_t offset, int length)
+{
+    TIMED_BLOCK();
+
+    StegoPayload payload = reader->Payload;
+
+    return DecodeStegoPayloadRange(reader->Carrier, buffer, offset, length, &payload, reader->Encrypted ? &reader->Key : 0);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CloseStegoReader
+   $Prototype: void CloseStegoReader(StegoReader *reader)
+   $Params:
+       reader: The reader to free
+   $
+   $Description: Clears the key and frees the reader. $
+   ======================================================================== */
+void CloseStegoReader(StegoReader *reader)
+{
+    if (reader->Encrypted)
+    {
+        FinishCipher(&reader->Key);
+    }
+
+    FreeMemory(reader);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoSinkWanted
+   $Prototype: static uint32_t GetStegoSinkWanted(StegoSink *sink)
+   $Params:
+       sink: The sink to check
+   $
+   $Description: Returns how many more bytes the sink needs before it can
+   do something with them: the rest of the header, of the index or of the
+   chunk it is on. $
+   ======================================================================== */
+static uint32_t GetStegoSinkWanted(StegoSink *sink)
+{
+    switch (sink->Stage)
+    {
+        case STEGO_STAGE_HEADER:
+            return STEGO_HEADER_BYTES - sink->HeaderDone;
+
+        case STEGO_STAGE_INDEX:
+            return sink->IndexLength - sink->IndexDone;
+
+        case STEGO_STAGE_CHUNKS:
+            return GetStegoChunkStored(&sink->Index, sink->Chunk) - sink->ChunkDone;
+
+        default:
+            return 0;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteStegoSinkData
+   $Prototype: static int WriteStegoSinkData(StegoSink *sink, const char *buffer, uint32_t count)
+   $Params: 
+       sink: The sink to give the bytes to
+       buffer: The next bytes of the filename and file, decompressed.
+       count: How many bytes there are
+   $
+   $Description: Takes the NUL terminated filename, which opens the output
+   file, then the contents of the file, which are written straight out.
+   Returns 0 on success and -1 if the data is bad or the file can't be
+   written. $
+   ======================================================================== */
+static int WriteStegoSinkData(StegoSink *sink, const char *buffer, uint32_t count)
+{
+    // Collect the filename until its NUL.
+    while (!sink->NameDone && count > 0)
+    {
+        if (sink->NameLength == sink->NameSize)
+        {
+            sink->NameSize = (sink->NameSize > 0) ? (sink->NameSize * 2) : 256;
+            sink->Name = (char*)GrowStegoBuffer(MEMORY_STREAM, sink->Name, sink->NameLength, sink->NameSize);
+        }
+
+        sink->Name[sink->NameLength++] = *buffer;
+        sink->NameDone = (*buffer == 0);
+        sink->DataDone++;
+        buffer++;
+        count--;
+
+        if (sink->NameDone)
+        {
+            // If there was no filename specified, use the one in the file.
+            const char *file = sink->Filename ? sink->Filename : sink->Name;
+
+            // An archive starts with an empty filename (see archive.cpp).
+            if (sink->NameLength == 1)
+            {
+                printf("Cannot decode image. The data is an archive of files, it has to be extracted.\n");
+                return -1;
+            }
+
+            if ((sink->File = fopen(file, "w")) == 0)
+            {
+                printf("Error writing file: %s\n", file);
+                return -1;
+            }
+        }
+        else if (sink->DataDone == sink->DataLength)
+        {
+            printf("Cannot decode image. The filename is not terminated.\n");
+            return -1;
+        }
+    }
+
+    // Write to the file.
+    uint32_t bytes_written = 0;
+    while (bytes_written < count)
+    {
+        uint32_t n = fwrite(buffer + bytes_written, 1, count - bytes_written, sink->File);
+
+        if (n == 0)
+        {
+            printf("Error writing file: %s\n", sink->Filename ? sink->Filename : sink->Name);
+            return -1;
+        }
+
+        bytes_written += n;
+    }
+
+    sink->DataDone += count;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ReadStegoSinkIndex
+   $Prototype: static int ReadStegoSinkIndex(StegoSink *sink)
+   $Params:
+       sink: The sink that has all of IndexLength bytes of the index.
+   $
+   $Description: Reads the start of the index, after which IndexLength is
+   how long the whole index is, or the whole index once it has all of it.
+   The checksum of the index is checked before any of it is used. Returns
+   0 on success and -1 if the index is damaged. $
+   ======================================================================== */
+static int ReadStegoSinkIndex(StegoSink *sink)
+{
+    StegoIndex *index = &sink->Index;
+
+    // The start of it, which says how long the rest is.
+    if (index->ChunkBytes == 0)
+    {
+        if (GetStegoIndexHeader(sink->IndexBytes, index, sink->StoredLength) != 0)
+        {
+            printf("Cannot decode image. The index is bad.\n");
+            return -1;
+        }
+
+        sink->IndexLength = GetStegoIndexBytes(index->ChunkCount);
+        sink->IndexBytes = (char*)GrowStegoBuffer(MEMORY_STREAM, sink->IndexBytes, sink->IndexDone, sink->IndexLength);
+
+        if (sink->IndexDone < sink->IndexLength)
+        {
+            return 0;
+        }
+    }
+
+    if (CheckStegoChecksum(sink->Checksum, sink->StoredChecksum) != 0)
+    {
+        return -1;
+    }
+
+    index->Chunks = AllocateStegoChunks(index->ChunkCount);
+
+    for(uint32_t i = 0; i < index->ChunkCount; i++)
+    {
+        if (GetStegoChunk(sink->IndexBytes + STEGO_INDEX_HEADER_BYTES + (i * STEGO_INDEX_ENTRY_BYTES), index, i) != 0)
+        {
+            printf("Cannot decode image. The index is bad.\n");
+            return -1;
+        }
+    }
+
+    sink->ChunkBytes = (char*)AllocateMemory(MEMORY_CHUNK, GetStegoChunkSlot(index));
+    sink->Output = (char*)AllocateMemory(MEMORY_CHUNK, index->ChunkBytes);
+    sink->DataLength = index->DataLength;
+    sink->Checksum = 0;
+    sink->Stage = (index->ChunkCount > 0) ? STEGO_STAGE_CHUNKS : STEGO_STAGE_DONE;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteStegoSink
+   $Prototype: static int WriteStegoSink(StegoSink *sink, const char *buffer, uint32_t count, uint32_t checksum)
+   $Params:
+       sink: The sink to give the bytes to
+       buffer: The next decoded bytes
+       count: How many bytes there are, at most GetStegoSinkWanted.
+       checksum: The checksum of the bytes from DecodeStegoParallel.
+   $
+   $Description: Takes the next decoded bytes. The header comes first,
+   then the index and then the chunks. Each chunk is collected and checked
+   against its checksum, then decompressed if it was compressed and
+   written out. Returns 0 on success and -1 if the data is bad or the file
+   can't be written. $
+   ======================================================================== */
+static int WriteStegoSink(StegoSink *sink, const char *buffer, uint32_t count, uint32_t checksum)
+{
+    StegoHeader header;
+    StegoChunk *chunk;
+    uint32_t stored;
+    int result;
+
+    if (sink->Stage == STEGO_STAGE_HEADER)
+    {
+        memcpy(sink->Header + sink->HeaderDone, buffer, count);
+        sink->HeaderDone += count;
+
+        if (sink->HeaderDone < STEGO_HEADER_BYTES)
+        {
+            return 0;
+        }
+
+        if (CheckStegoHeader(sink->Header, &header, sink->PixelCount) != 0)
+        {
+            return -1;
+        }
+
+        if (header.StripeCount > 0)
+        {
+            printf("Cannot decode image. It is stripe %d of %d, they have to be decoded together.\n", header.StripeIndex + 1, header.StripeCount);
+            return -1;
+        }
+
+        if (header.Encrypted)
+        {
+            printf("Cannot decode image. The data is encrypted, it needs a password.\n");
+            return -1;
+        }
+
+        if (header.Scattered)
+        {
+            printf("Cannot decode image. The data is scattered, it can't be streamed.\n");
+            return -1;
+        }
+
+        if (header.Length < STEGO_INDEX_ALIGN)
+        {
+            printf("Cannot decode image. The index is bad.\n");
+            return -1;
+        }
+
+        sink->StoredLength = header.Length;
+        sink->StoredChecksum = header.Checksum;
+        sink->Depth = header.Depth;
+        sink->Checksum = CHECKSUM_START;
+        sink->IndexLength = STEGO_INDEX_ALIGN;
+        sink->IndexBytes = (char*)AllocateMemory(MEMORY_STREAM, sink->IndexLength);
+        sink->Stage = STEGO_STAGE_INDEX;
+
+        return 0;
+    }
+
+    if (sink->Stage == STEGO_STAGE_INDEX)
+    {
+        memcpy(sink->IndexBytes + sink->IndexDone, buffer, count);
+        sink->IndexDone += count;
+        sink->Checksum = CombineChecksum(sink->Checksum, checksum, count);
+
+        return (sink->IndexDone < sink->IndexLength) ? 0 : ReadStegoSinkIndex(sink);
+    }
+
+    chunk = &sink->Index.Chunks[sink->Chunk];
+    stored = GetStegoChunkStored(&sink->Index, sink->Chunk);
+
+    memcpy(sink->ChunkBytes + sink->ChunkDone, buffer, count);
+    sink->ChunkDone += count;
+    sink->Checksum = CombineChecksum(sink->Checksum, checksum, count);
+
+    if (sink->ChunkDone < stored)
+    {
+        return 0;
+    }
+
+    if ((result = UnpackStegoChunk(&sink->Index, sink->Chunk, sink->ChunkBytes, sink->Checksum, sink->Output)) != 0)
+    {
+        sink->Damaged = 1;
+        return CheckStegoChunk(result);
+    }
+
+    if (WriteStegoSinkData(sink, chunk->Compressed ? sink->Output : sink->ChunkBytes, GetStegoChunkLength(&sink->Index, sink->Chunk)) != 0)
+    {
+        return -1;
+    }
+
+    sink->Chunk++;
+    sink->ChunkDone = 0;
+    sink->Checksum = 0;
+
+    if (sink->Chunk == sink->Index.ChunkCount)
+    {
+        sink->Stage = STEGO_STAGE_DONE;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartStegoSink
+   $Prototype: static void StartStegoSink(StegoSink *sink, Image *image, const char *filename)
+   $Params:
+       sink: The sink to set up
+       image: The image that is being decoded
+       filename: The filename to write to, 0 if the original filename is used.
+   $
+   $Description: Sets up a sink for decoding a file. $
+   ======================================================================== */
+static void StartStegoSink(StegoSink *sink, Image *image, const char *filename)
+{
+    memset(sink, 0, sizeof(StegoSink));
+    sink->Filename = filename;
+    sink->PixelCount = GetStegoImagePixels(image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: FinishStegoSink
+   $Prototype: static int FinishStegoSink(StegoSink *sink, int result)
+   $Params:
+       sink: The sink to finish
+       result: 0 if the decoding went well, otherwise -1.
+   $
+   $Description: Closes the file and frees the sink. Nothing is written
+   until it has been checked, but if a chunk after the first turns out to
+   be damaged the part of the file that was written is deleted. Returns
+   how many bytes of the file were written, or -1 on failure. $
+   ======================================================================== */
+static int FinishStegoSink(StegoSink *sink, int result)
+{
+    if (sink->File)
+    {
+        fclose(sink->File);
+    }
+
+    if (result != 0 && sink->Damaged && sink->NameDone)
+    {
+        remove(sink->Filename ? sink->Filename : sink->Name);
+    }
+
+    FreeMemory(sink->Name);
+    FreeMemory(sink->IndexBytes);
+    FreeMemory(sink->ChunkBytes);
+    FreeMemory(sink->Output);
+    FreeStegoIndex(&sink->Index);
+
+    if (result != 0 || !sink->NameDone)
+    {
+        return -1;
+    }
+
+    return sink->DataLength - sink->NameLength;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteStegoChunks
+   $Prototype: static int WriteStegoChunks(Image *image, StegoPayload *payload, const Cipher *key, StegoSink *sink)
+   $Params:
+       image: The image to decode from
+       payload: The payload from OpenStegoPayload.
+       key: The cipher to decrypt the data with, or 0.
+       sink: Where the filename and file go.
+   $
+   $Description: Reads and checks the index, then decodes the chunks on
+   the stego threads about STEGO_STREAM_BUFFER_SIZE at a time and writes
+   each lot out before the next one is decoded, so the whole file is never
+   held in memory. Returns 0 on success and -1 on failure. $
+   ======================================================================== */
+static int WriteStegoChunks(Image *image, StegoPayload *payload, const Cipher *key, StegoSink *sink)
+{
+    StegoIndex *index = &payload->Index;
+    uint32_t batch = STEGO_STREAM_BUFFER_SIZE / index->ChunkBytes;
+    char *buffer;
+    int result;
+
+    if ((result = ReadStegoIndex(image, payload, 0, index->ChunkCount)) != 0)
+    {
+        FreeStegoIndex(index);
+        return -1;
+    }
+
+    if (batch < 1)
+    {
+        batch = 1;
+    }
+
+    if (batch > index->ChunkCount)
+    {
+        batch = index->ChunkCount;
+    }
+
+    buffer = (char*)AllocateMemory(MEMORY_CHUNK, (size_t)batch * index->ChunkBytes);
+    sink->DataLength = index->DataLength;
+
+    for(uint32_t first = 0; first < index->ChunkCount && result == 0; first += batch)
+    {
+        uint32_t count = (index->ChunkCount - first < batch) ? (index->ChunkCount - first) : batch;
+        uint32_t start = first * index->ChunkBytes;
+        uint32_t end = (first + count == index->ChunkCount) ? index->DataLength : (first + count) * index->ChunkBytes;
+
+        if ((result = DecodeStegoChunks(image, payload, key, buffer, first, count)) != 0)
+        {
+            sink->Damaged = 1;
+            break;
+        }
+
+        result = WriteStegoSinkData(sink, buffer, end - start);
+    }
+
+    FreeMemory(buffer);
+    FreeStegoIndex(index);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFile
+   $Prototype: int DecodeStegoFile(Image *image, const char *filename)
+   $Params:
+       image: The image to decode
+       filename: The filename to write to, 0 if the original filename is used.
+   $
+   $Description: Decodes a file that is stored within an image. The chunks
+   are decoded a few at a time and written out before the next ones are
+   decoded, so only a few chunks are ever held in memory. Returns how many
+   bytes the file has, or -1 on failure. $
+   ======================================================================== */
+int DecodeStegoFile(Image *image, const char *filename)
+{
+    TIMED_BLOCK();
+
+    StegoSink sink;
+    StegoPayload payload;
+
+    if (OpenStegoPayload(image, 0, 0, &payload, 0) < 0)
+    {
+        return -1;
+    }
+
+    StartStegoSink(&sink, image, filename);
+
+    return FinishStegoSink(&sink, WriteStegoChunks(image, &payload, 0, &sink));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFileEnc
+   $Prototype: int DecodeStegoFileEnc(Image *image, const char *filename, const char *password)
+   $Params:
+       image: The image to decode
+       filename: The filename to write to, 0 if the original filename is used.
+       password: The password it was encrypted with
+   $
+   $Description: Decodes a file that was encoded with EncodeStegoFileEnc.
+   Returns how many bytes the file has, or -1 on failure. $
+   ======================================================================== */
+int DecodeStegoFileEnc(Image *image, const char *filename, const char *password)
+{
+    TIMED_BLOCK();
+
+    StegoSink sink;
+    Cipher key;
+    StegoPayload payload;
+    int result;
+
+    if (OpenStegoPayload(image, password, &key, &payload, 0) < 0)
+    {
+        return -1;
+    }
+
+    StartStegoSink(&sink, image, filename);
+    result = WriteStegoChunks(image, &payload, &key, &sink);
+    FinishCipher(&key);
+
+    return FinishStegoSink(&sink, result);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteStegoFileRange
+   $Prototype: static int WriteStegoFileRange(Image *image, const char *filename, uint32_t offset, int length, StegoPayload *payload, const Cipher *key)
+   $Params:
+       image: The image to decode from
+       filename: The filename to write to, 0 if the original filename is used.
+       offset: The first byte of the file to decode
+       length: How many bytes of the file to decode
+       payload: The payload from OpenStegoPayload.
+       key: The cipher to decrypt the data with, or 0.
+   $
+   $Description: Finds the end of the filename in the first chunk, then
+   decodes the range of the file after it and writes it out. Returns how
+   many bytes were written, or -1 on failure. $
+   ======================================================================== */
+static int WriteStegoFileRange(Image *image, const char *filename, uint32_t offset, int length, StegoPayload *payload, const Cipher *key)
+{
+    StegoSink sink;
+    uint32_t data_length = payload->Index.DataLength;
+    int name_length = (data_length < payload->Index.ChunkBytes) ? data_length : payload->Index.ChunkBytes;
+    char *buffer = (char*)AllocateMemory(MEMORY_PAYLOAD, name_length);
+    char *name_end;
+    int result = -1;
+
+    StartStegoSink(&sink, image, filename);
+
+    if ((name_length = DecodeStegoPayloadRange(image, buffer, 0, name_length, payload, key)) >= 0)
+    {
+        if ((name_end = (char*)memchr(buffer, 0, name_length)) == 0)
+        {
+            printf("Cannot decode image. The filename is not terminated.\n");
+        }
+        else if (offset > data_length - (name_end - buffer + 1))
+        {
+            printf("Cannot decode image. The range is past the end of the data.\n");
+        }
+        else
+        {
+            name_length = name_end - buffer + 1;
+
+            if ((uint32_t)length > data_length - name_length - offset)
+            {
+                length = data_length - name_length - offset;
+            }
+
+            // The filename and the range go through the sink as if they
+            // were all of the data.
+            sink.DataLength = name_length + length;
+            result = WriteStegoSinkData(&sink, buffer, name_length);
+            FreeMemory(buffer);
+            buffer = (char*)AllocateMemory(MEMORY_PAYLOAD, length);
+
+            if (result == 0 && DecodeStegoPayloadRange(image, buffer, name_length + offset, length, payload, key) < 0)
+            {
+                sink.Damaged = 1;
+                result = -1;
+            }
+
+            if (result == 0)
+            {
+                result = WriteStegoSinkData(&sink, buffer, length);
+            }
+        }
+    }
+
+    FreeMemory(buffer);
+
+    return FinishStegoSink(&sink, result);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFileRange
+   $Prototype: int DecodeStegoFileRange(Image *image, const char *filename, uint32_t offset, int length)
+   $Params:
+       image: The image to decode
+       filename: The filename to write to, 0 if the original filename is used.
+       offset: The first byte of the file to decode
+       length: How many bytes of the file to decode
+   $
+   $Description: Decodes part of a file that is stored within an image and
+   writes it to a file of its own. Like DecodeStegoRange only the chunks
+   that hold the filename and the range are decoded. Returns how many
+   bytes were written, or -1 on failure. $
+   ======================================================================== */
+int DecodeStegoFileRange(Image *image, const char *filename, uint32_t offset, int length)
+{
+    TIMED_BLOCK();
+
+    StegoPayload payload;
+
+    if (OpenStegoPayload(image, 0, 0, &payload, 0) < 0)
+    {
+        return -1;
+    }
+
+    return WriteStegoFileRange(image, filename, offset, length, &payload, 0);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFileRangeEnc
+   $Prototype: int DecodeStegoFileRangeEnc(Image *image, const char *filename, uint32_t offset, int length, const char *password)
+   $Params:
+       image: The image to decode
+       filename: The filename to write to, 0 if the original filename is used.
+       offset: The first byte of the file to decode
+       length: How many bytes of the file to decode
+       password: The password it was encrypted with
+   $
+   $Description: DecodeStegoFileRange for a file that was encoded with
+   EncodeStegoFileEnc. Returns how many bytes were written, or -1. $
+   ======================================================================== */
+int DecodeStegoFileRangeEnc(Image *image, const char *filename, uint32_t offset, int length, const char *password)
+{
+    TIMED_BLOCK();
+
+    Cipher key;
+    StegoPayload payload;
+    int result;
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+    if (OpenStegoPayload(image, password, &key, &payload, 0) < 0)
+    {
+        return -1;
+    }
 
-#include "image.h"
-#include "timer.h"
+    result = WriteStegoFileRange(image, filename, offset, length, &payload, &key);
+    FinishCipher(&key);
+
+    return result;
+}
 
 /* ========================================================================
    $FUNCTION
-   $Name: SetStegoByte
-   $Prototype: inline static void SetStegoByte(Image *image, char data, int offset)
+   $Name: DecodeStegoFileStreamed
+   $Prototype: int DecodeStegoFileStreamed(const char *image_filename, const char *filename, int buffer_size)
    $Params: 
-       image: The image to set the byte on.
-       data: The byte to put into the image.
-       offset: The offset to put the data at.
+       image_filename: The bitmap to decode
+       filename: The filename to write to, 0 if the original filename is used.
+       buffer_size: Roughly how many bytes of pixels to hold at once, 0
+                    uses STEGO_STREAM_BUFFER_SIZE.
    $
-   $Description: This puts a single byte of data into two pixels. $
+   $Description: Decodes a file from a bitmap without loading it. The
+   image is read a strip of rows at a time and whatever part of the file is
+   in the strip is written out straight away. Reading stops as soon as the
+   file is done. The checksum can only be checked once all of the file has
+   been written, so the file is deleted if it doesn't match. Returns how
+   many bytes the file has, or -1 on failure. $
    ======================================================================== */
-inline static void SetStegoByte(Image *image, char data, int offset)
+int DecodeStegoFileStreamed(const char *image_filename, const char *filename, int buffer_size)
 {
-    uint8_t red, blue, green, alpha;
+    TIMED_BLOCK();
 
-    for(int i = 1; i >= 0; i--)
+    BitmapStream *input;
+    StegoSink sink;
+    StegoCursor cursor;
+    Image strip;
+    uint32_t strip_pixels;
+    uint32_t strip_start = 0;
+    uint32_t pixel_count;
+    char *payload;
+    int result = 0;
+
+    if (buffer_size <= 0)
+    {
+        buffer_size = STEGO_STREAM_BUFFER_SIZE;
+    }
+
+    if ((input = OpenBitmapStream(image_filename)) == 0)
     {
+        return -1;
+    }
 
-        // Get each of the RGBA values from the pixel
-        red = (image->Pixels[offset + i] & image->MaskRed) >> image->ShiftRed;
-        green = (image->Pixels[offset + i] & image->MaskGreen) >> image->ShiftGreen;
-        blue = (image->Pixels[offset + i] & image->MaskBlue) >> image->ShiftBlue;
-        alpha = (image->Pixels[offset + i] & image->MaskAlpha) >> image->ShiftAlpha;
+    StartStegoSink(&sink, &input->Format, filename);
 
-        // Write the data backwards so when we read it, it makes sense.
-        alpha &= 0xFE;
-        alpha |= data & 0x01;
-        data >>= 1;
+    // The strip is an image with the masks of the bitmap and a few rows of pixels.
+    strip_pixels = GetStegoStripPixels(&input->Format, buffer_size);
+    memcpy(&strip, &input->Format, sizeof(Image));
+    strip.Pixels = (uint32_t*)AllocateMemory(MEMORY_STREAM, strip_pixels * sizeof(uint32_t));
+    payload = (char*)AllocateMemory(MEMORY_STREAM, GetStegoByteCount(strip_pixels, STEGO_MAX_DEPTH));
+    memset(&cursor, 0, sizeof(StegoCursor));
+
+    while (result == 0 && GetStegoSinkWanted(&sink) > 0 &&
+           (pixel_count = ReadBitmapStrip(input, strip.Pixels, strip_pixels)) > 0)
+    {
+        uint32_t count;
+        uint32_t strip_end;
 
-        blue &= 0xFE;
-        blue |= data & 0x01;
-        data >>= 1;
+        strip.PixelCount = pixel_count;
+        strip.Height = pixel_count / strip.Width;
+        strip_end = strip_start + GetStegoImagePixels(&strip);
 
-        green &= 0xFE;
-        green |= data & 0x01;
-        data >>= 1;
+        // The header is read first, so it can take a few goes to find out
+        // how much of the strip is wanted and at what depth.
+        while ((count = GetStegoCursorBytes(&cursor, strip_end, GetStegoSinkWanted(&sink))) > 0)
+        {
+            uint32_t checksum = DecodeStegoParallel(&strip, cursor.Pixel - strip_start, payload, count,
+                                                    (cursor.Byte < STEGO_HEADER_BYTES) ? 1 : cursor.Depth, 0);
+            if ((result = WriteStegoSink(&sink, payload, count, checksum)) != 0)
+            {
+                break;
+            }
 
-        red &= 0xFE;
-        red |= data & 0x01;
-        data >>= 1;
+            AdvanceStegoCursor(&cursor, count);
+            cursor.Depth = sink.Depth;
+        }
 
-        // Set the pixel data.
-        image->Pixels[offset + i] = ((red << image->ShiftRed) |
-                                     (green << image->ShiftGreen) |
-                                     (blue << image->ShiftBlue) |
-                                     (alpha << image->ShiftAlpha));
+        strip_start = strip_end;
+    }
 
+    if (result == 0 && GetStegoSinkWanted(&sink) > 0)
+    {
+        printf("Error reading bitmap pixels.\n");
+        result = -1;
     }
+
+    FreeMemory(payload);
+    FreeMemory(strip.Pixels);
+    CloseBitmapStream(input);
+
+    return FinishStegoSink(&sink, result);
 }
 
 /* ========================================================================
    $FUNCTION
-   $Name: GetStegoByte
-   $Prototype: inline static void GetStegoByte(Image *image, int offset, char *data)
-   $Params: 
-       image: The image to set the byte on.
-       offset: The offset to get the data at.
-       data: The byte of data inside the image
+   $Name: StegoMaxBytes
+   $Prototype: int StegoMaxBytes(const ImageView *view)
+   $Params:
+       view: The view of the image
    $
-   $Description: This gets a single byte of data from two pixels at the offset. $
+   $Description: Returns how many bytes fit in the view. $
    ======================================================================== */
-inline static void GetStegoByte(Image *image, int offset, char *data)
+int StegoMaxBytes(const ImageView *view)
 {
-    uint8_t red, blue, green, alpha;
-    *data = 0;
+    Image image;
 
-    for(int i = 0; i < 2; i++)
+    if (BorrowImageView(view, &image) != 0)
     {
+        return -1;
+    }
 
-        // Get each of the RGBA values from the pixel
-        red = (image->Pixels[offset + i] & image->MaskRed) >> image->ShiftRed;
-        green = (image->Pixels[offset + i] & image->MaskGreen) >> image->ShiftGreen;
-        blue = (image->Pixels[offset + i] & image->MaskBlue) >> image->ShiftBlue;
-        alpha = (image->Pixels[offset + i] & image->MaskAlpha) >> image->ShiftAlpha;
+    return StegoMaxBytes(&image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBufferInPlace
+   $Prototype: int EncodeStegoBufferInPlace(const ImageView *view, const char *buffer, int buffer_length)
+   $Params:
+       view: The view of the image
+       buffer: The buffer of data to put into the view
+       buffer_length: The length of the buffer
+   $
+   $Description: Encodes a buffer of data into the pixels of the view.
+   Returns 0 on success and -1 on failure. $
+   ======================================================================== */
+int EncodeStegoBufferInPlace(const ImageView *view, const char *buffer, int buffer_length)
+{
+    Image image;
 
-        *data <<= 1;
-        *data |= red & 0x1;
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
 
-        *data <<= 1;
-        *data |= green & 0x1;
+    return EncodeStegoBufferInPlace(&image, buffer, buffer_length);
+}
 
-        *data <<= 1;
-        *data |= blue & 0x1;
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBufferInPlaceEnc
+   $Prototype: int EncodeStegoBufferInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, AESType aes, const char *password)
+   $Params:
+       view: The view of the image
+       buffer: The buffer of data to put into the view
+       buffer_length: The length of the buffer
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: Encodes an encrypted buffer of data into the pixels of the
+   view. Returns 0 on success and -1 on failure. $
+   ======================================================================== */
+int EncodeStegoBufferInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, AESType aes, const char *password)
+{
+    Image image;
 
-        *data <<= 1;
-        *data |= alpha & 0x1;
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
     }
+
+    return EncodeStegoBufferInPlaceEnc(&image, buffer, buffer_length, aes, password);
 }
 
 /* ========================================================================
    $FUNCTION
-   $Name: StegoMaxBytes
-   $Prototype: int StegoMaxBytes(Image *image)
-   $Params: 
-       image: The image to calculate how many bytes can fit into.
+   $Name: EncodeStegoFileInPlace
+   $Prototype: int EncodeStegoFileInPlace(const ImageView *view, const char *filename)
+   $Params:
+       view: The view of the image
+       filename: The filename to put into the view
    $
-   $Description: Calculates how many bytes can fit into an image. $
+   $Description: Encodes a file into the pixels of the view. Returns 0 on
+   success and -1 on failure. $
    ======================================================================== */
-int StegoMaxBytes(Image *image)
+int EncodeStegoFileInPlace(const ImageView *view, const char *filename)
 {
-    return image->Width * image->Height / 2;
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return EncodeStegoFileInPlace(&image, filename);
 }
 
 /* ========================================================================
    $FUNCTION
-   $Name: EncodeStegoBuffer
-   $Prototype: Image *EncodeStegoBuffer(Image *image, const char *buffer, int buffer_length)
-   $Params: 
-       image: The image to encode
-       buffer: The buffer of data to put into the image
-       buffer_length: The length of the buffer
+   $Name: EncodeStegoFileInPlaceEnc
+   $Prototype: int EncodeStegoFileInPlaceEnc(const ImageView *view, const char *filename, AESType aes, const char *password)
+   $Params:
+       view: The view of the image
+       filename: The filename to put into the view
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
    $
-   $Description: Encodes a buffer of data into an image. $
+   $Description: Encodes an encrypted file into the pixels of the view.
+   Returns 0 on success and -1 on failure. $
    ======================================================================== */
-Image *EncodeStegoBuffer(Image *image, const char *buffer, int buffer_length)
+int EncodeStegoFileInPlaceEnc(const ImageView *view, const char *filename, AESType aes, const char *password)
 {
-    TIMED_BLOCK();
+    Image image;
 
-    Image *encoded_image;
-    uint32_t current_pixel;
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return EncodeStegoFileInPlaceEnc(&image, filename, aes, password);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoStripeInPlace
+   $Prototype: int EncodeStegoStripeInPlace(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe)
+   $Params:
+       view: The view of the image
+       buffer: The data of the whole payload
+       buffer_length: The length of the data
+       stripe: Which part of the data goes in the view
+   $
+   $Description: Encodes one stripe of the data into the pixels of the
+   view. Returns 0 on success and -1 on failure. $
+   ======================================================================== */
+int EncodeStegoStripeInPlace(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe)
+{
+    Image image;
 
-    // Check to see if we can store the buffer in the image.
-    // 4 bytes extra for storing the buffer length.
-    if (buffer_length + 4 > StegoMaxBytes(image))
+    if (BorrowImageView(view, &image) != 0)
     {
-        printf("Error: buffer is too long to store.\n");
-        return 0;
+        return -1;
     }
 
-    // Create a new image to return.
-    encoded_image = CopyImage(image);
+    return EncodeStegoStripeInPlace(&image, buffer, buffer_length, stripe);
+}
 
-    // Write the buffer length
-    uint8_t *size = (uint8_t*)&buffer_length;
-    SetStegoByte(encoded_image, size[3], 0);
-    SetStegoByte(encoded_image, size[2], 2);
-    SetStegoByte(encoded_image, size[1], 4);
-    SetStegoByte(encoded_image, size[0], 6);
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoStripeInPlaceEnc
+   $Prototype: int EncodeStegoStripeInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password)
+   $Params:
+       view: The view of the image
+       buffer: The data of the whole payload
+       buffer_length: The length of the data
+       stripe: Which part of the data goes in the view
+       aes: Which AES to encrypt with
+       password: The password to derive the key from
+   $
+   $Description: Encodes one encrypted stripe of the data into the pixels
+   of the view. Returns 0 on success and -1 on failure. $
+   ======================================================================== */
+int EncodeStegoStripeInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password)
+{
+    Image image;
 
-    // Write the data
-    current_pixel = 8;
-    for(int i = 0; i < buffer_length; i++)
+    if (BorrowImageView(view, &image) != 0)
     {
-        SetStegoByte(encoded_image, buffer[i], current_pixel);
-        current_pixel += 2;
+        return -1;
     }
 
-    return encoded_image;
+    return EncodeStegoStripeInPlaceEnc(&image, buffer, buffer_length, stripe, aes, password);
 }
 
 /* ========================================================================
    $FUNCTION
-   $Name: EncodeStegoFile
-   $Prototype: Image *EncodeStegoFile(Image *image, const char *filename)
-   $Params: 
-       image: The image to encode into
-       filename: The filename to put into the image
+   $Name: ReadStegoStripe
+   $Prototype: int ReadStegoStripe(const ImageView *view, StegoStripe *stripe)
+   $Params:
+       view: The view of the image
+       stripe: Gets the stripe header
    $
-   $Description: Encodes a filename into an image. $
+   $Description: Reads the stripe header of the view. Returns 0 on success
+   and -1 if there isn't one. $
    ======================================================================== */
-Image *EncodeStegoFile(Image *image, const char *filename)
+int ReadStegoStripe(const ImageView *view, StegoStripe *stripe)
 {
-    TIMED_BLOCK();
+    Image image;
 
-    Image *encoded_image = 0;    
-    FILE *fp;
-    uint32_t file_length;
-    uint32_t bytes_read = 0;
-    char *buffer;
-    uint32_t overhead_size = 0;
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
 
-    if ((fp = fopen(filename, "r")) == 0)
+    return ReadStegoStripe(&image, stripe);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoStripe
+   $Prototype: int DecodeStegoStripe(const ImageView *view, char *buffer, int buffer_len)
+   $Params:
+       view: The view of the image
+       buffer: Gets the part of the data in the stripe
+       buffer_len: The length of the buffer
+   $
+   $Description: Decodes the part of the data in the stripe of the view.
+   Returns the length of it, or -1. $
+   ======================================================================== */
+int DecodeStegoStripe(const ImageView *view, char *buffer, int buffer_len)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
     {
-        printf("Unable to open file: %s\n", filename);
-        return 0;
+        return -1;
     }
 
-    overhead_size = strlen(filename) + 1;
+    return DecodeStegoStripe(&image, buffer, buffer_len);
+}
 
-    // Get the file size.
-    fseek(fp, 0, SEEK_END);
-    file_length = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoStripeEnc
+   $Prototype: int DecodeStegoStripeEnc(const ImageView *view, char *buffer, int buffer_len, const char *password)
+   $Params:
+       view: The view of the image
+       buffer: Gets the part of the data in the stripe
+       buffer_len: The length of the buffer
+       password: The password the payload was encrypted with
+   $
+   $Description: Decodes the part of the data in the encrypted stripe of
+   the view. Returns the length of it, or -1. $
+   ======================================================================== */
+int DecodeStegoStripeEnc(const ImageView *view, char *buffer, int buffer_len, const char *password)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
 
-    buffer = (char*)malloc(file_length + overhead_size);
+    return DecodeStegoStripeEnc(&image, buffer, buffer_len, password);
+}
 
-    while (bytes_read < file_length)
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoDecodedBytes
+   $Prototype: int StegoDecodedBytes(const ImageView *view)
+   $Params:
+       view: The view of the image
+   $
+   $Description: Returns how big a buffer DecodeStegoBuffer needs for the
+   payload of the view, or -1. $
+   ======================================================================== */
+int StegoDecodedBytes(const ImageView *view)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
     {
-        bytes_read += fread(buffer + bytes_read + overhead_size, 1, file_length - bytes_read, fp);
+        return -1;
     }
 
-    // Write the filename
-    memcpy(buffer, filename, overhead_size - 1);
-    buffer[overhead_size - 1] = 0;
+    return StegoDecodedBytes(&image);
+}
 
-    encoded_image = EncodeStegoBuffer(image, buffer, file_length + overhead_size);
+/* ========================================================================
+   $FUNCTION
+   $Name: StegoDecodedBytesEnc
+   $Prototype: int StegoDecodedBytesEnc(const ImageView *view, const char *password)
+   $Params:
+       view: The view of the image
+       password: The password the payload was encrypted with
+   $
+   $Description: Returns how big a buffer DecodeStegoBufferEnc needs for
+   the payload of the view, or -1. $
+   ======================================================================== */
+int StegoDecodedBytesEnc(const ImageView *view, const char *password)
+{
+    Image image;
 
-    return encoded_image;
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return StegoDecodedBytesEnc(&image, password);
 }
 
 /* ========================================================================
    $FUNCTION
    $Name: DecodeStegoBuffer
-   $Prototype: int DecodeStegoBuffer(Image *image, char *buffer, int buffer_len)
-   $Params: 
-       image: The image to decode the buffer from
-       buffer: The buffer to write into
-       buffer_len: The max size of the buffer.
+   $Prototype: int DecodeStegoBuffer(const ImageView *view, char *buffer, int buffer_len)
+   $Params:
+       view: The view of the image
+       buffer: Gets the data
+       buffer_len: The length of the buffer
    $
-   $Description: Decodes a buffer of data from an image. $
+   $Description: Decodes the data in the view. Returns the length of it, or
+   -1. $
    ======================================================================== */
-int DecodeStegoBuffer(Image *image, char *buffer, int buffer_len)
+int DecodeStegoBuffer(const ImageView *view, char *buffer, int buffer_len)
 {
-    TIMED_BLOCK();
+    Image image;
 
-    uint32_t image_buffer_length = 0;
-    int offset = 8;
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return DecodeStegoBuffer(&image, buffer, buffer_len);
+}
 
-    // Read the buffer length
-    uint8_t *size = (uint8_t*)&image_buffer_length;
-    GetStegoByte(image, 0, (char*)(size + 3));
-    GetStegoByte(image, 2, (char*)(size + 2));
-    GetStegoByte(image, 4, (char*)(size + 1));
-    GetStegoByte(image, 6, (char*)(size + 0));
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBufferEnc
+   $Prototype: int DecodeStegoBufferEnc(const ImageView *view, char *buffer, int buffer_len, const char *password)
+   $Params:
+       view: The view of the image
+       buffer: Gets the data
+       buffer_len: The length of the buffer
+       password: The password the payload was encrypted with
+   $
+   $Description: Decodes the encrypted data in the view. Returns the length
+   of it, or -1. $
+   ======================================================================== */
+int DecodeStegoBufferEnc(const ImageView *view, char *buffer, int buffer_len, const char *password)
+{
+    Image image;
 
-    if (buffer_len < (int)image_buffer_length)
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return DecodeStegoBufferEnc(&image, buffer, buffer_len, password);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoRange
+   $Prototype: int DecodeStegoRange(const ImageView *view, char *buffer, uint32_t offset, int length)
+   $Params:
+       view: The view of the image
+       buffer: Gets the bytes
+       offset: The first byte of the data to decode
+       length: How many bytes to decode
+   $
+   $Description: Decodes length bytes of the data in the view from offset
+   on. Returns how many bytes were decoded, or -1. $
+   ======================================================================== */
+int DecodeStegoRange(const ImageView *view, char *buffer, uint32_t offset, int length)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
     {
-        printf("Cannot decode image. Buffer is too small to write to.\n");
         return -1;
     }
 
-    // Read the data
-    for(uint32_t i = 0; i < image_buffer_length; i++)
+    return DecodeStegoRange(&image, buffer, offset, length);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoRangeEnc
+   $Prototype: int DecodeStegoRangeEnc(const ImageView *view, char *buffer, uint32_t offset, int length, const char *password)
+   $Params:
+       view: The view of the image
+       buffer: Gets the bytes
+       offset: The first byte of the data to decode
+       length: How many bytes to decode
+       password: The password the payload was encrypted with
+   $
+   $Description: Decodes length bytes of the encrypted data in the view
+   from offset on. Returns how many bytes were decoded, or -1. $
+   ======================================================================== */
+int DecodeStegoRangeEnc(const ImageView *view, char *buffer, uint32_t offset, int length, const char *password)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
     {
-        GetStegoByte(image, offset, buffer + i);
-        offset += 2;
+        return -1;
     }
 
-    return image_buffer_length;
+    return DecodeStegoRangeEnc(&image, buffer, offset, length, password);
 }
 
 /* ========================================================================
    $FUNCTION
    $Name: DecodeStegoFile
-   $Prototype: int DecodeStegoFile(Image *image, const char *filename)
-   $Params: 
-       image: The image to decode
-       filename: The filename to write to, 0 if the original filename is used.
+   $Prototype: int DecodeStegoFile(const ImageView *view, const char *filename)
+   $Params:
+       view: The view of the image
+       filename: The file to write, or 0 for the name that was stored
    $
-   $Description: Decodes a file that is stored within an image. $
+   $Description: Decodes the file in the view. Returns how many bytes the
+   file has, or -1 on failure. $
    ======================================================================== */
-int DecodeStegoFile(Image *image, const char *filename)
+int DecodeStegoFile(const ImageView *view, const char *filename)
 {
-    TIMED_BLOCK();
+    Image image;
 
-    FILE *fp = 0;
-    const char *file = filename;
-    int max_size = StegoMaxBytes(image);
-    int actual_size;
-    int bytes_written = 0;
-    char *buffer;
-    char *data;
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return DecodeStegoFile(&image, filename);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFileEnc
+   $Prototype: int DecodeStegoFileEnc(const ImageView *view, const char *filename, const char *password)
+   $Params:
+       view: The view of the image
+       filename: The file to write, or 0 for the name that was stored
+       password: The password the payload was encrypted with
+   $
+   $Description: Decodes the encrypted file in the view. Returns how many
+   bytes the file has, or -1 on failure. $
+   ======================================================================== */
+int DecodeStegoFileEnc(const ImageView *view, const char *filename, const char *password)
+{
+    Image image;
+
+    if (BorrowImageView(view, &image) != 0)
+    {
+        return -1;
+    }
+
+    return DecodeStegoFileEnc(&image, filename, password);
+}
 
-    buffer = (char*)malloc(max_size);
-    actual_size = DecodeStegoBuffer(image, buffer, max_size);
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFileRange
+   $Prototype: int DecodeStegoFileRange(const ImageView *view, const char *filename, uint32_t offset, int length)
+   $Params:
+       view: The view of the image
+       filename: The file to write, or 0 for the name that was stored
+       offset: The first byte of the file to decode
+       length: How many bytes to decode
+   $
+   $Description: Decodes length bytes of the file in the view from offset
+   on. Returns how many bytes were written, or -1 on failure. $
+   ======================================================================== */
+int DecodeStegoFileRange(const ImageView *view, const char *filename, uint32_t offset, int length)
+{
+    Image image;
 
-    // If there was no filename specified, use the one in the file.
-    if (file == 0)
+    if (BorrowImageView(view, &image) != 0)
     {
-        file = buffer;
+        return -1;
     }
 
-    // Strip the filename off the size and buffer
-    actual_size -= strlen(buffer) + 1;
-    data = buffer + strlen(buffer) + 1;
+    return DecodeStegoFileRange(&image, filename, offset, length);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFileRangeEnc
+   $Prototype: int DecodeStegoFileRangeEnc(const ImageView *view, const char *filename, uint32_t offset, int length, const char *password)
+   $Params:
+       view: The view of the image
+       filename: The file to write, or 0 for the name that was stored
+       offset: The first byte of the file to decode
+       length: How many bytes to decode
+       password: The password the payload was encrypted with
+   $
+   $Description: Decodes length bytes of the encrypted file in the view
+   from offset on. Returns how many bytes were written, or -1 on failure. $
+   ======================================================================== */
+int DecodeStegoFileRangeEnc(const ImageView *view, const char *filename, uint32_t offset, int length, const char *password)
+{
+    Image image;
 
-    if ((fp = fopen(file, "w")) == 0)
+    if (BorrowImageView(view, &image) != 0)
     {
-        printf("Error writing file: %s\n", file);
         return -1;
     }
 
-    // Write to the file.
-    while (bytes_written < actual_size)
+    return DecodeStegoFileRangeEnc(&image, filename, offset, length, password);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: OpenStegoReader
+   $Prototype: StegoReader *OpenStegoReader(const ImageView *view, const char *password)
+   $Params:
+       view: The view of the image. It has to outlive the reader.
+       password: The password the payload was encrypted with, or 0
+   $
+   $Description: Opens the payload in the view to decode ranges from. The
+   reader keeps the image that borrows the pixels itself. Returns 0 if the
+   view can't be used or doesn't hold a payload. $
+   ======================================================================== */
+StegoReader *OpenStegoReader(const ImageView *view, const char *password)
+{
+    Image image;
+    StegoReader *reader;
+
+    if (BorrowImageView(view, &image) != 0 ||
+        (reader = OpenStegoReader(&image, password)) == 0)
     {
-        bytes_written += fwrite(data + bytes_written, 1, actual_size - bytes_written, fp);
+        return 0;
     }
 
-    return actual_size;
+    reader->View = image;
+    reader->Carrier = &reader->View;
+
+    return reader;
 }
@@ -11,20 +11,161 @@
 #if !defined(STEGANOGRAPHY_H)
 #define STEGANOGRAPHY_H
 
+#include "encryption.h"
 #include "image.h"
+#include "stego_kernels.h"
+
+// How many bytes of pixels the streaming functions hold at once when
+// they aren't given a buffer size.
+#define STEGO_STREAM_BUFFER_SIZE (4 * 1024 * 1024)
+
+// What ProbeStegoImage finds out about a bitmap.
+struct StegoProbe
+{
+    uint32_t Width;
+    uint32_t Height;
+
+    // How many bytes fit in the image at the current depth (StegoMaxBytes).
+    int Capacity;
+
+    // The length and depth stored in the image, and whether the payload
+    // is compressed, encrypted or scattered. HasPayload is set when the
+    // image has a payload header and the length fits in the image,
+    // otherwise the rest are 0.
+    uint32_t PayloadLength;
+    int Depth;
+    int Compressed;
+    int Encrypted;
+    int Scattered;
+    int HasPayload;
+
+    // Which stripe the payload is and how many there are, 0 if it isn't
+    // striped.
+    int StripeIndex;
+    int StripeCount;
+};
+
+// One part of a payload that is striped across several images. Every
+// stripe has the same PayloadId, Count and DataLength, and holds Length
+// bytes of the data from Offset on.
+struct StegoStripe
+{
+    uint64_t PayloadId;
+    uint32_t DataLength;
+    uint32_t Offset;
+    uint32_t Length;
+    int Index;
+    int Count;
+};
+
+void SetStegoThreads(int thread_count);
+int GetStegoThreads();
+
+// How many threads the calling thread's encodes and decodes use while it
+// runs a job alongside others, 0 clears it. Returns what it was.
+int SetStegoJobThreads(int thread_count);
+
+// How many bits of each channel encoding uses, 1 (the default) to 4.
+int SetStegoDepth(int depth);
+int GetStegoDepth();
+
+// Whether encoding compresses the payload first, off by default. It is
+// only kept compressed if it gets smaller.
+void SetStegoCompression(int compression);
+int GetStegoCompression();
+
+// Scatters new payloads over the image in an order made from the
+// password, or stops if it is 0. A scattered payload can only be decoded
+// once the same password is set. Returns 0 on success.
+int SetStegoScatter(const char *password);
+int GetStegoScatter();
 
 int StegoMaxBytes(Image *image);
+int ProbeStegoImage(const char *filename, StegoProbe *probe);
 
+// The *Enc functions encrypt the payload with a key derived from the
+// password. It has to be decoded with the same password, the AES it was
+// encrypted with is read from the encryption header.
 Image *EncodeStegoBuffer(Image *image, const char *buffer, int buffer_length);
-// Image *EncodeStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password);
+int EncodeStegoBufferInPlace(Image *image, const char *buffer, int buffer_length);
+Image *EncodeStegoBufferEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password);
+int EncodeStegoBufferInPlaceEnc(Image *image, const char *buffer, int buffer_length, AESType aes, const char *password);
 
 Image *EncodeStegoFile(Image *image, const char *filename);
-// Image *EncodeStegoFileEnc(Image *image, const char *filename, const char *password);
+int EncodeStegoFileInPlace(Image *image, const char *filename);
+int EncodeStegoFileStreamed(const char *image_filename, const char *filename, const char *output_filename, int buffer_size);
+Image *EncodeStegoFileEnc(Image *image, const char *filename, AESType aes, const char *password);
+int EncodeStegoFileInPlaceEnc(Image *image, const char *filename, AESType aes, const char *password);
+
+// Reads a file into a buffer that starts with its NUL terminated name,
+// which is how files are stored. The buffer needs to be freed with
+// FreeMemory.
+char *ReadStegoFile(const char *filename, int *buffer_length);
+
+// A stripe holds part of the data of a payload that doesn't fit in one
+// image (see stripe.h). StegoStripeMaxBytes says how much of the data
+// fits in an image StegoMaxBytes says max_bytes fit in.
+int StegoStripeMaxBytes(int max_bytes, int encrypted);
+int EncodeStegoStripeInPlace(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe);
+int EncodeStegoStripeInPlaceEnc(Image *image, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password);
+int ReadStegoStripe(Image *image, StegoStripe *stripe);
+int DecodeStegoStripe(Image *image, char *buffer, int buffer_len);
+int DecodeStegoStripeEnc(Image *image, char *buffer, int buffer_len, const char *password);
 
+int StegoDecodedBytes(Image *image);
+int StegoDecodedBytesEnc(Image *image, const char *password);
 int DecodeStegoBuffer(Image *image, char *buffer, int buffer_len);
-// int DecodeStegoBufferEnc(Image *image, char *buffer, int buffer_len, AESType aes, const char *password);
+int DecodeStegoBufferEnc(Image *image, char *buffer, int buffer_len, const char *password);
+
+// Decode length bytes of the data (or of the file) from offset on, only
+// touching the pixels of the chunks that hold them.
+int DecodeStegoRange(Image *image, char *buffer, uint32_t offset, int length);
+int DecodeStegoRangeEnc(Image *image, char *buffer, uint32_t offset, int length, const char *password);
+
+// A payload that is opened once to decode many ranges from, on any
+// number of threads. The password is 0 if it isn't encrypted.
+struct StegoReader;
+StegoReader *OpenStegoReader(Image *image, const char *password);
+int StegoReaderBytes(StegoReader *reader);
+int StegoReaderChunkBytes(StegoReader *reader);
+int DecodeStegoReaderRange(StegoReader *reader, char *buffer, uint32_t offset, int length);
+void CloseStegoReader(StegoReader *reader);
 
 int DecodeStegoFile(Image *image, const char *filename);
-// int DecodeStegoFileEnc(Image *image, const char *filename, const char *password);
+int DecodeStegoFileStreamed(const char *image_filename, const char *filename, int buffer_size);
+int DecodeStegoFileEnc(Image *image, const char *filename, const char *password);
+int DecodeStegoFileRange(Image *image, const char *filename, uint32_t offset, int length);
+int DecodeStegoFileRangeEnc(Image *image, const char *filename, uint32_t offset, int length, const char *password);
+
+// The same functions on the pixels of a view, which are read and written
+// where they are without a copy (see ImageView). A payload encoded into a
+// view decodes from a copy of it and the other way around. They return -1
+// if the view can't be used.
+int StegoMaxBytes(const ImageView *view);
+
+int EncodeStegoBufferInPlace(const ImageView *view, const char *buffer, int buffer_length);
+int EncodeStegoBufferInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, AESType aes, const char *password);
+int EncodeStegoFileInPlace(const ImageView *view, const char *filename);
+int EncodeStegoFileInPlaceEnc(const ImageView *view, const char *filename, AESType aes, const char *password);
+int EncodeStegoStripeInPlace(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe);
+int EncodeStegoStripeInPlaceEnc(const ImageView *view, const char *buffer, int buffer_length, const StegoStripe *stripe, AESType aes, const char *password);
+
+int ReadStegoStripe(const ImageView *view, StegoStripe *stripe);
+int DecodeStegoStripe(const ImageView *view, char *buffer, int buffer_len);
+int DecodeStegoStripeEnc(const ImageView *view, char *buffer, int buffer_len, const char *password);
+
+int StegoDecodedBytes(const ImageView *view);
+int StegoDecodedBytesEnc(const ImageView *view, const char *password);
+int DecodeStegoBuffer(const ImageView *view, char *buffer, int buffer_len);
+int DecodeStegoBufferEnc(const ImageView *view, char *buffer, int buffer_len, const char *password);
+int DecodeStegoRange(const ImageView *view, char *buffer, uint32_t offset, int length);
+int DecodeStegoRangeEnc(const ImageView *view, char *buffer, uint32_t offset, int length, const char *password);
+int DecodeStegoFile(const ImageView *view, const char *filename);
+int DecodeStegoFileEnc(const ImageView *view, const char *filename, const char *password);
+int DecodeStegoFileRange(const ImageView *view, const char *filename, uint32_t offset, int length);
+int DecodeStegoFileRangeEnc(const ImageView *view, const char *filename, uint32_t offset, int length, const char *password);
+
+// The view has to outlive the reader. Returns 0 if it can't be used.
+StegoReader *OpenStegoReader(const ImageView *view, const char *password);
 
 #endif
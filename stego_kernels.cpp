@@ -0,0 +1,1419 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: stego_kernels.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+template <typename Layout> inline static void SetStegoByte(Layout layout, uint32_t *pixels, uint8_t data)
+template <typename Layout> inline static uint8_t GetStegoByte(Layout layout, const uint32_t *pixels)
+static int GetStegoLaneBits(Image *image, uint8_t *lane_bits)
+static int EncodeStegoBytesSSE(Image *image, const char *buffer, int count, uint32_t pixel, const uint8_t *lane_bits)
+static int EncodeStegoBytesAVX2(Image *image, const char *buffer, int count, uint32_t pixel, const uint8_t *lane_bits)
+static void GetStegoGather(const uint8_t *lane_bits, uint8_t *gather)
+static int DecodeStegoBytesSSE(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+static int DecodeStegoBytesAVX2(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+static int DecodeStegoBytesBMI2(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+void SetStegoKernel(StegoKernel kernel)
+StegoKernel GetStegoKernel()
+template <typename Layout> static void EncodeStegoBytesLayout(Layout layout, Image *image, const char *buffer, int count, uint32_t pixel)
+void EncodeStegoBytesScalar(Image *image, const char *buffer, int count, uint32_t pixel)
+void EncodeStegoBytes(Image *image, const char *buffer, int count, uint32_t pixel)
+template <typename Layout> static void DecodeStegoBytesLayout(Layout layout, Image *image, uint32_t pixel, char *buffer, int count)
+void DecodeStegoBytesScalar(Image *image, uint32_t pixel, char *buffer, int count)
+void DecodeStegoBytes(Image *image, uint32_t pixel, char *buffer, int count)
+template <int Depth, typename Layout> static void EncodeStegoGroups(Layout layout, Image *image, const char *buffer, int count, uint32_t pixel)
+template <int Depth, typename Layout> static void DecodeStegoGroups(Layout layout, Image *image, uint32_t pixel, char *buffer, int count)
+static void GetStegoRowImage(const Image *image, uint32_t row, Image *row_image)
+static uint32_t GetStegoSpanImage(const Image *image, uint32_t pixel, Image *span_image, uint32_t *pair, uint32_t *span_pixels)
+static void SetStegoPair(Image *image, uint32_t pixel, const uint32_t *pair)
+void EncodeStegoBytesDepth(Image *image, const char *buffer, int count, uint32_t pixel, int depth)
+void DecodeStegoBytesDepth(Image *image, uint32_t pixel, char *buffer, int count, int depth)
+static uint32_t MixStegoScatter(uint32_t value, uint32_t key)
+static uint32_t PermuteStegoRun(const StegoScatter *scatter, uint32_t run, int inverse)
+int StartStegoScatter(StegoScatter *scatter, const uint8_t *key, uint32_t base, uint32_t pixel_count)
+uint32_t GetStegoScatterPixel(const StegoScatter *scatter, uint32_t pixel, uint32_t *run_pixels)
+void EncodeStegoBytesScattered(Image *image, const char *buffer, int count, uint32_t pixel, int depth, const StegoScatter *scatter)
+void DecodeStegoBytesScattered(Image *image, uint32_t pixel, char *buffer, int count, int depth, const StegoScatter *scatter)
+   $
+   $Description: These are the kernels that move bytes in and out of the
+   pixels. At depth 1 every byte is stored in the least significant bit of
+   the RGBA values of two pixels. The scalar functions are the reference,
+   the SIMD kernels must produce the exact same pixels and bytes. The
+   deeper depths use more bits of every channel and have a template kernel
+   each. The scalar kernels are also templates on the channel layout, see
+   pixel_layout.h.
+
+   A scattered payload (the *Scattered functions) goes through the runs
+   of the image in a keyed order, see StegoScatter, and each run is
+   encoded with the same kernels. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "stego_kernels.h"
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "image.h"
+#include "pixel_layout.h"
+
+// The kernel that was asked for with SetStegoKernel.
+static StegoKernel requested_kernel = STEGO_KERNEL_AUTO;
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoByte
+   $Prototype: template <typename Layout> inline static void SetStegoByte(Layout layout, uint32_t *pixels, uint8_t data)
+   $Params:
+       layout: The channel layout of the pixels.
+       pixels: The two pixels to put the byte into.
+       data: The byte to put into the pixels.
+   $
+   $Description: This puts a single byte of data into two pixels. The high
+   nibble goes in the first pixel, with its highest bit in red and its
+   lowest in alpha. $
+   ======================================================================== */
+template <typename Layout>
+inline static void SetStegoByte(Layout layout, uint32_t *pixels, uint8_t data)
+{
+    // The least significant bit of every channel.
+    const uint32_t lsb = ((1u << layout.ShiftRed) | (1u << layout.ShiftGreen) |
+                          (1u << layout.ShiftBlue) | (1u << layout.ShiftAlpha));
+
+    for(int i = 0; i < 2; i++)
+    {
+        uint32_t nibble = (data >> (4 - (i * 4))) & 0xF;
+
+        pixels[i] = ((pixels[i] & ~lsb) |
+                     (((nibble >> 3) & 1) << layout.ShiftRed) |
+                     (((nibble >> 2) & 1) << layout.ShiftGreen) |
+                     (((nibble >> 1) & 1) << layout.ShiftBlue) |
+                     ((nibble & 1) << layout.ShiftAlpha));
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoByte
+   $Prototype: template <typename Layout> inline static uint8_t GetStegoByte(Layout layout, const uint32_t *pixels)
+   $Params:
+       layout: The channel layout of the pixels.
+       pixels: The two pixels to get the byte from.
+   $
+   $Description: This gets a single byte of data from two pixels. $
+   ======================================================================== */
+template <typename Layout>
+inline static uint8_t GetStegoByte(Layout layout, const uint32_t *pixels)
+{
+    uint32_t data = 0;
+
+    for(int i = 0; i < 2; i++)
+    {
+        data = ((data << 4) |
+                (((pixels[i] >> layout.ShiftRed) & 1) << 3) |
+                (((pixels[i] >> layout.ShiftGreen) & 1) << 2) |
+                (((pixels[i] >> layout.ShiftBlue) & 1) << 1) |
+                ((pixels[i] >> layout.ShiftAlpha) & 1));
+    }
+
+    return (uint8_t)data;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoLaneBits
+   $Prototype: static int GetStegoLaneBits(Image *image, uint8_t *lane_bits)
+   $Params:
+       image: The image to get the layout of.
+       lane_bits: 8 bytes that get filled with which bit of the data byte
+                  each byte of a pixel pair holds.
+   $
+   $Description: The SIMD kernels work on bytes instead of channels, so
+   they only work when every channel is a whole byte. Returns 1 if that is
+   the case, otherwise 0 and the scalar path has to be used. $
+   ======================================================================== */
+static int GetStegoLaneBits(Image *image, uint8_t *lane_bits)
+{
+    // Red holds the highest bit of each nibble, alpha the lowest.
+    uint32_t masks[4] = { image->MaskRed, image->MaskGreen, image->MaskBlue, image->MaskAlpha };
+    uint8_t shifts[4] = { image->ShiftRed, image->ShiftGreen, image->ShiftBlue, image->ShiftAlpha };
+    uint32_t covered = 0;
+
+    if (image->BitsPerPixel != 32)
+    {
+        return 0;
+    }
+
+    for(int channel = 0; channel < 4; channel++)
+    {
+        // Every channel has to be exactly one byte of the pixel.
+        if (shifts[channel] >= 32 || (shifts[channel] & 7) != 0 ||
+            masks[channel] != (0xFFu << shifts[channel]))
+        {
+            return 0;
+        }
+
+        covered |= masks[channel];
+
+        // The first pixel holds the high nibble, the second the low nibble.
+        lane_bits[(shifts[channel] / 8)] = 4 + (3 - channel);
+        lane_bits[(shifts[channel] / 8) + 4] = 3 - channel;
+    }
+
+    // Make sure that no two channels share a byte.
+    return covered == 0xFFFFFFFF;
+}
+
+#if STEGO_KERNELS_SIMD
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBytesSSE
+   $Prototype: static int EncodeStegoBytesSSE(Image *image, const char *buffer, int count, uint32_t pixel, const uint8_t *lane_bits)
+   $Params:
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at
+       lane_bits: The bit of the data byte each byte of a pixel pair holds.
+   $
+   $Description: Encodes 16 bytes into 32 pixels at a time. Each data byte
+   is spread across the 8 bytes of its pixel pair with a shuffle, then
+   the bit that belongs to each byte is tested and blended into its LSB.
+   Returns the amount of bytes that were encoded, the rest are left for
+   the scalar path. $
+   ======================================================================== */
+__attribute__((target("sse4.1")))
+static int EncodeStegoBytesSSE(Image *image, const char *buffer, int count, uint32_t pixel, const uint8_t *lane_bits)
+{
+    uint8_t mask_bytes[16];
+    uint8_t spread_bytes[8][16];
+    __m128i spread[8];
+    int i;
+
+    // Build the bit to test for each byte and the shuffles that copy
+    // data byte 2q into the first 8 bytes and 2q+1 into the last 8.
+    for(int j = 0; j < 16; j++)
+    {
+        mask_bytes[j] = 1 << lane_bits[j & 7];
+
+        for(int q = 0; q < 8; q++)
+        {
+            spread_bytes[q][j] = (2 * q) + (j / 8);
+        }
+    }
+
+    for(int q = 0; q < 8; q++)
+    {
+        spread[q] = _mm_loadu_si128((__m128i*)spread_bytes[q]);
+    }
+
+    __m128i bit_mask = _mm_loadu_si128((__m128i*)mask_bytes);
+    __m128i clear = _mm_set1_epi8((char)0xFE);
+    __m128i lsb = _mm_set1_epi8(0x01);
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        __m128i data = _mm_loadu_si128((const __m128i*)(buffer + i));
+        __m128i *pixels = (__m128i*)(image->Pixels + pixel + (i * 2));
+
+        for(int q = 0; q < 8; q++)
+        {
+            // Find out which bytes need their LSB set.
+            __m128i bits = _mm_and_si128(_mm_shuffle_epi8(data, spread[q]), bit_mask);
+            __m128i set = _mm_cmpeq_epi8(bits, bit_mask);
+
+            // Replace the LSB of every byte.
+            __m128i values = _mm_loadu_si128(pixels + q);
+            values = _mm_blendv_epi8(_mm_and_si128(values, clear), _mm_or_si128(values, lsb), set);
+
+            _mm_storeu_si128(pixels + q, values);
+        }
+    }
+
+    return i;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBytesAVX2
+   $Prototype: static int EncodeStegoBytesAVX2(Image *image, const char *buffer, int count, uint32_t pixel, const uint8_t *lane_bits)
+   $Params:
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at
+       lane_bits: The bit of the data byte each byte of a pixel pair holds.
+   $
+   $Description: The AVX2 version of EncodeStegoBytesSSE. Encodes 32 bytes
+   into 64 pixels at a time. Returns the amount of bytes that were encoded. $
+   ======================================================================== */
+__attribute__((target("avx2")))
+static int EncodeStegoBytesAVX2(Image *image, const char *buffer, int count, uint32_t pixel, const uint8_t *lane_bits)
+{
+    uint8_t mask_bytes[32];
+    uint8_t spread_bytes[4][32];
+    __m256i spread[4];
+    int i;
+
+    // The shuffles can't cross the 128 bit lanes, so each register
+    // gets its 4 data bytes from a 16 byte half broadcast to both lanes.
+    for(int j = 0; j < 32; j++)
+    {
+        mask_bytes[j] = 1 << lane_bits[j & 7];
+
+        for(int q = 0; q < 4; q++)
+        {
+            spread_bytes[q][j] = (4 * q) + (j / 8);
+        }
+    }
+
+    for(int q = 0; q < 4; q++)
+    {
+        spread[q] = _mm256_loadu_si256((__m256i*)spread_bytes[q]);
+    }
+
+    __m256i bit_mask = _mm256_loadu_si256((__m256i*)mask_bytes);
+    __m256i clear = _mm256_set1_epi8((char)0xFE);
+    __m256i lsb = _mm256_set1_epi8(0x01);
+
+    for(i = 0; i + 32 <= count; i += 32)
+    {
+        __m128i data_low = _mm_loadu_si128((const __m128i*)(buffer + i));
+        __m128i data_high = _mm_loadu_si128((const __m128i*)(buffer + i + 16));
+        __m256i halves[2] = { _mm256_broadcastsi128_si256(data_low),
+                              _mm256_broadcastsi128_si256(data_high) };
+        __m256i *pixels = (__m256i*)(image->Pixels + pixel + (i * 2));
+
+        for(int q = 0; q < 8; q++)
+        {
+            // Find out which bytes need their LSB set.
+            __m256i bits = _mm256_and_si256(_mm256_shuffle_epi8(halves[q / 4], spread[q & 3]), bit_mask);
+            __m256i set = _mm256_cmpeq_epi8(bits, bit_mask);
+
+            // Replace the LSB of every byte.
+            __m256i values = _mm256_loadu_si256(pixels + q);
+            values = _mm256_blendv_epi8(_mm256_and_si256(values, clear), _mm256_or_si256(values, lsb), set);
+
+            _mm256_storeu_si256(pixels + q, values);
+        }
+    }
+
+    return i;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoGather
+   $Prototype: static void GetStegoGather(const uint8_t *lane_bits, uint8_t *gather)
+   $Params:
+       lane_bits: The bit of the data byte each byte of a pixel pair holds.
+       gather: 8 bytes that get filled with the byte of the pixel pair
+               that holds each bit of the data byte.
+   $
+   $Description: Inverts the lane bits so the decode kernels can shuffle
+   the bytes of a pixel pair into bit order. $
+   ======================================================================== */
+static void GetStegoGather(const uint8_t *lane_bits, uint8_t *gather)
+{
+    for(int k = 0; k < 8; k++)
+    {
+        gather[lane_bits[k]] = k;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytesSSE
+   $Prototype: static int DecodeStegoBytesSSE(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+       lane_bits: The bit of the data byte each byte of a pixel pair holds.
+   $
+   $Description: Decodes 16 bytes from 32 pixels at a time. The bytes of
+   each pixel pair are shuffled into bit order, the LSBs are moved up to
+   the sign bit and a movemask gathers them into two data bytes. Returns
+   the amount of bytes that were decoded. $
+   ======================================================================== */
+__attribute__((target("sse4.1")))
+static int DecodeStegoBytesSSE(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+{
+    uint8_t gather[8];
+    uint8_t order_bytes[16];
+    int i;
+
+    GetStegoGather(lane_bits, gather);
+    for(int j = 0; j < 16; j++)
+    {
+        order_bytes[j] = (j & 8) + gather[j & 7];
+    }
+
+    __m128i order = _mm_loadu_si128((__m128i*)order_bytes);
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        const __m128i *pixels = (const __m128i*)(image->Pixels + pixel + (i * 2));
+        uint16_t *data = (uint16_t*)(buffer + i);
+
+        for(int q = 0; q < 8; q++)
+        {
+            __m128i values = _mm_shuffle_epi8(_mm_loadu_si128(pixels + q), order);
+            data[q] = (uint16_t)_mm_movemask_epi8(_mm_slli_epi16(values, 7));
+        }
+    }
+
+    return i;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytesAVX2
+   $Prototype: static int DecodeStegoBytesAVX2(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+       lane_bits: The bit of the data byte each byte of a pixel pair holds.
+   $
+   $Description: The AVX2 version of DecodeStegoBytesSSE. Each movemask
+   gathers 8 pixels into 4 data bytes. Returns the amount of bytes that
+   were decoded. $
+   ======================================================================== */
+__attribute__((target("avx2")))
+static int DecodeStegoBytesAVX2(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+{
+    uint8_t gather[8];
+    uint8_t order_bytes[32];
+    int i;
+
+    GetStegoGather(lane_bits, gather);
+    for(int j = 0; j < 32; j++)
+    {
+        order_bytes[j] = (j & 8) + gather[j & 7];
+    }
+
+    __m256i order = _mm256_loadu_si256((__m256i*)order_bytes);
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        const __m256i *pixels = (const __m256i*)(image->Pixels + pixel + (i * 2));
+        uint32_t *data = (uint32_t*)(buffer + i);
+
+        for(int q = 0; q < 4; q++)
+        {
+            __m256i values = _mm256_shuffle_epi8(_mm256_loadu_si256(pixels + q), order);
+            data[q] = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(values, 7));
+        }
+    }
+
+    return i;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytesBMI2
+   $Prototype: static int DecodeStegoBytesBMI2(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+       lane_bits: The bit of the data byte each byte of a pixel pair holds.
+   $
+   $Description: Decodes with PEXT. A pixel pair is read as one 64 bit
+   value, PEXT pulls out the 8 LSBs and a table puts them in bit order.
+   Returns the amount of bytes that were decoded. $
+   ======================================================================== */
+__attribute__((target("bmi2")))
+static int DecodeStegoBytesBMI2(Image *image, uint32_t pixel, char *buffer, int count, const uint8_t *lane_bits)
+{
+    uint8_t order[256];
+    const uint64_t *pixels = (const uint64_t*)(image->Pixels + pixel);
+    int i;
+
+    // Build the table that moves bit k of the PEXT result to its bit in the data byte.
+    for(int value = 0; value < 256; value++)
+    {
+        order[value] = 0;
+        for(int k = 0; k < 8; k++)
+        {
+            order[value] |= ((value >> k) & 1) << lane_bits[k];
+        }
+    }
+
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        uint64_t pair0, pair1, pair2, pair3;
+
+        memcpy(&pair0, pixels + i, sizeof(uint64_t));
+        memcpy(&pair1, pixels + i + 1, sizeof(uint64_t));
+        memcpy(&pair2, pixels + i + 2, sizeof(uint64_t));
+        memcpy(&pair3, pixels + i + 3, sizeof(uint64_t));
+
+        buffer[i] = order[_pext_u64(pair0, 0x0101010101010101ULL)];
+        buffer[i + 1] = order[_pext_u64(pair1, 0x0101010101010101ULL)];
+        buffer[i + 2] = order[_pext_u64(pair2, 0x0101010101010101ULL)];
+        buffer[i + 3] = order[_pext_u64(pair3, 0x0101010101010101ULL)];
+    }
+
+    return i;
+}
+#endif
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoKernel
+   $Prototype: void SetStegoKernel(StegoKernel kernel)
+   $Params:
+       kernel: The kernel to use from now on.
+   $
+   $Description: Forces the encode/decode functions to use a kernel. $
+   ======================================================================== */
+void SetStegoKernel(StegoKernel kernel)
+{
+    requested_kernel = kernel;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoKernel
+   $Prototype: StegoKernel GetStegoKernel()
+   $Params: $
+   $Description: Returns the kernel that will actually be used. AUTO and
+   kernels the CPU doesn't support are resolved here. $
+   ======================================================================== */
+StegoKernel GetStegoKernel()
+{
+#if STEGO_KERNELS_SIMD
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    int has_bmi2 = __builtin_cpu_supports("bmi2");
+    int has_sse = __builtin_cpu_supports("sse4.1");
+
+    switch (requested_kernel)
+    {
+        case STEGO_KERNEL_AUTO:
+        {
+            if (has_avx2)
+            {
+                return STEGO_KERNEL_AVX2;
+            }
+            if (has_bmi2)
+            {
+                return STEGO_KERNEL_BMI2;
+            }
+            if (has_sse)
+            {
+                return STEGO_KERNEL_SSE;
+            }
+        } break;
+
+        case STEGO_KERNEL_AVX2:
+        {
+            if (has_avx2)
+            {
+                return STEGO_KERNEL_AVX2;
+            }
+        } break;
+
+        case STEGO_KERNEL_BMI2:
+        {
+            if (has_bmi2)
+            {
+                return STEGO_KERNEL_BMI2;
+            }
+        } break;
+
+        case STEGO_KERNEL_SSE:
+        {
+            if (has_sse)
+            {
+                return STEGO_KERNEL_SSE;
+            }
+        } break;
+
+        default:
+            break;
+    }
+#endif
+
+    return STEGO_KERNEL_SCALAR;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBytesLayout
+   $Prototype: template <typename Layout> static void EncodeStegoBytesLayout(Layout layout, Image *image, const char *buffer, int count, uint32_t pixel)
+   $Params:
+       layout: The channel layout of the image
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at
+   $
+   $Description: Puts each byte into the two pixels after the previous
+   one. $
+   ======================================================================== */
+template <typename Layout>
+static void EncodeStegoBytesLayout(Layout layout, Image *image, const char *buffer, int count, uint32_t pixel)
+{
+    uint32_t *pixels = image->Pixels + pixel;
+
+    for(int i = 0; i < count; i++)
+    {
+        SetStegoByte(layout, pixels, (uint8_t)buffer[i]);
+        pixels += 2;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBytesScalar
+   $Prototype: void EncodeStegoBytesScalar(Image *image, const char *buffer, int count, uint32_t pixel)
+   $Params:
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at
+   $
+   $Description: Puts each byte into the two pixels after the previous
+   one. This is the reference that the SIMD kernels have to match. $
+   ======================================================================== */
+void EncodeStegoBytesScalar(Image *image, const char *buffer, int count, uint32_t pixel)
+{
+    DISPATCH_PIXEL_LAYOUT(image, EncodeStegoBytesLayout, image, buffer, count, pixel);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBytes
+   $Prototype: void EncodeStegoBytes(Image *image, const char *buffer, int count, uint32_t pixel)
+   $Params:
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at
+   $
+   $Description: Encodes the buffer with the fastest kernel that works
+   for the image. Whatever the SIMD kernel leaves over is done by the
+   scalar path. $
+   ======================================================================== */
+void EncodeStegoBytes(Image *image, const char *buffer, int count, uint32_t pixel)
+{
+    int done = 0;
+
+#if STEGO_KERNELS_SIMD
+    uint8_t lane_bits[8];
+
+    if (GetStegoLaneBits(image, lane_bits))
+    {
+        switch (GetStegoKernel())
+        {
+            case STEGO_KERNEL_AVX2:
+            {
+                done = EncodeStegoBytesAVX2(image, buffer, count, pixel, lane_bits);
+            } break;
+
+            // There is no PEXT encoder, PDEP would be slower than the shuffles.
+            case STEGO_KERNEL_BMI2:
+            case STEGO_KERNEL_SSE:
+            {
+                if (__builtin_cpu_supports("sse4.1"))
+                {
+                    done = EncodeStegoBytesSSE(image, buffer, count, pixel, lane_bits);
+                }
+            } break;
+
+            default:
+                break;
+        }
+    }
+#endif
+
+    EncodeStegoBytesScalar(image, buffer + done, count - done, pixel + (done * 2));
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytesLayout
+   $Prototype: template <typename Layout> static void DecodeStegoBytesLayout(Layout layout, Image *image, uint32_t pixel, char *buffer, int count)
+   $Params:
+       layout: The channel layout of the image
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+   $
+   $Description: Reads each byte from the two pixels after the previous
+   one. $
+   ======================================================================== */
+template <typename Layout>
+static void DecodeStegoBytesLayout(Layout layout, Image *image, uint32_t pixel, char *buffer, int count)
+{
+    const uint32_t *pixels = image->Pixels + pixel;
+
+    for(int i = 0; i < count; i++)
+    {
+        buffer[i] = (char)GetStegoByte(layout, pixels);
+        pixels += 2;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytesScalar
+   $Prototype: void DecodeStegoBytesScalar(Image *image, uint32_t pixel, char *buffer, int count)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+   $
+   $Description: Reads each byte from the two pixels after the previous
+   one. This is the reference that the SIMD kernels have to match. $
+   ======================================================================== */
+void DecodeStegoBytesScalar(Image *image, uint32_t pixel, char *buffer, int count)
+{
+    DISPATCH_PIXEL_LAYOUT(image, DecodeStegoBytesLayout, image, pixel, buffer, count);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytes
+   $Prototype: void DecodeStegoBytes(Image *image, uint32_t pixel, char *buffer, int count)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+   $
+   $Description: Decodes into the buffer with the fastest kernel that
+   works for the image. Whatever the SIMD kernel leaves over is done by
+   the scalar path. $
+   ======================================================================== */
+void DecodeStegoBytes(Image *image, uint32_t pixel, char *buffer, int count)
+{
+    int done = 0;
+
+#if STEGO_KERNELS_SIMD
+    uint8_t lane_bits[8];
+
+    if (GetStegoLaneBits(image, lane_bits))
+    {
+        switch (GetStegoKernel())
+        {
+            case STEGO_KERNEL_AVX2:
+            {
+                done = DecodeStegoBytesAVX2(image, pixel, buffer, count, lane_bits);
+            } break;
+
+            case STEGO_KERNEL_BMI2:
+            {
+                done = DecodeStegoBytesBMI2(image, pixel, buffer, count, lane_bits);
+            } break;
+
+            case STEGO_KERNEL_SSE:
+            {
+                done = DecodeStegoBytesSSE(image, pixel, buffer, count, lane_bits);
+            } break;
+
+            default:
+                break;
+        }
+    }
+#endif
+
+    DecodeStegoBytesScalar(image, pixel + (done * 2), buffer + done, count - done);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoGroups
+   $Prototype: template <int Depth, typename Layout> static void EncodeStegoGroups(Layout layout, Image *image, const char *buffer, int count, uint32_t pixel)
+   $Params:
+       layout: The channel layout of the image
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at
+   $
+   $Description: Puts the bytes into the lowest Depth bits of every
+   channel. The bytes are a stream of bits, most significant first, that
+   fills red, green, blue and then alpha of each pixel in turn, with the
+   first bit of a channel in its highest stored bit. A group is the
+   fewest whole bytes that fill whole pixels (1 byte in 2 pixels at depth
+   1, 1 in 1 at 2, 3 in 2 at 3 and 2 in 1 at 4). Depth is a template
+   parameter so every shift and loop is worked out at compile time, and
+   the bits of half a pixel are spread into place with a small table. $
+   ======================================================================== */
+template <int Depth, typename Layout>
+static void EncodeStegoGroups(Layout layout, Image *image, const char *buffer, int count, uint32_t pixel)
+{
+    const int group_bytes = (Depth == 3) ? 3 : ((Depth == 4) ? 2 : 1);
+    const int group_pixels = (group_bytes * 2) / Depth;
+    const int pixel_bits = 4 * Depth;
+    const int half_bits = 2 * Depth;
+    const uint32_t bits = (1 << Depth) - 1;
+    const uint32_t half_mask = (1 << half_bits) - 1;
+
+    const uint32_t shift_red = layout.ShiftRed;
+    const uint32_t shift_green = layout.ShiftGreen;
+    const uint32_t shift_blue = layout.ShiftBlue;
+    const uint32_t shift_alpha = layout.ShiftAlpha;
+    const uint32_t keep = ~((bits << shift_red) | (bits << shift_green) | (bits << shift_blue) | (bits << shift_alpha));
+
+    // Red and green come from the high half of a pixel's bits, blue and
+    // alpha from the low half.
+    uint32_t high[1 << half_bits];
+    uint32_t low[1 << half_bits];
+
+    for(uint32_t v = 0; v <= half_mask; v++)
+    {
+        high[v] = ((v >> Depth) << shift_red) | ((v & bits) << shift_green);
+        low[v] = ((v >> Depth) << shift_blue) | ((v & bits) << shift_alpha);
+    }
+
+    uint32_t *pixels = image->Pixels + pixel;
+    const uint8_t *bytes = (const uint8_t*)buffer;
+    int i = 0;
+
+    for(; i + group_bytes <= count; i += group_bytes)
+    {
+        uint32_t value = 0;
+
+        for(int b = 0; b < group_bytes; b++)
+        {
+            value = (value << 8) | bytes[i + b];
+        }
+
+        for(int p = 0; p < group_pixels; p++)
+        {
+            uint32_t v = value >> ((group_pixels - 1 - p) * pixel_bits);
+
+            pixels[p] = (pixels[p] & keep) | high[(v >> half_bits) & half_mask] | low[v & half_mask];
+        }
+
+        pixels += group_pixels;
+    }
+
+    // The last group can be short. The missing bytes are zero and only
+    // the pixels that hold a real byte are written.
+    if (i < count)
+    {
+        int byte_count = count - i;
+        int pixel_count = ((byte_count * 2) + Depth - 1) / Depth;
+        uint32_t value = 0;
+
+        for(int b = 0; b < group_bytes; b++)
+        {
+            value = (value << 8) | ((b < byte_count) ? bytes[i + b] : 0);
+        }
+
+        for(int p = 0; p < pixel_count; p++)
+        {
+            uint32_t v = value >> ((group_pixels - 1 - p) * pixel_bits);
+
+            pixels[p] = (pixels[p] & keep) | high[(v >> half_bits) & half_mask] | low[v & half_mask];
+        }
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoGroups
+   $Prototype: template <int Depth, typename Layout> static void DecodeStegoGroups(Layout layout, Image *image, uint32_t pixel, char *buffer, int count)
+   $Params:
+       layout: The channel layout of the image
+       image: The image to decode from
+       pixel: The pixel to start reading at
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+   $
+   $Description: Reads the bytes that EncodeStegoGroups stored. $
+   ======================================================================== */
+template <int Depth, typename Layout>
+static void DecodeStegoGroups(Layout layout, Image *image, uint32_t pixel, char *buffer, int count)
+{
+    const int group_bytes = (Depth == 3) ? 3 : ((Depth == 4) ? 2 : 1);
+    const int group_pixels = (group_bytes * 2) / Depth;
+    const int pixel_bits = 4 * Depth;
+    const uint32_t bits = (1 << Depth) - 1;
+
+    const uint32_t shift_red = layout.ShiftRed;
+    const uint32_t shift_green = layout.ShiftGreen;
+    const uint32_t shift_blue = layout.ShiftBlue;
+    const uint32_t shift_alpha = layout.ShiftAlpha;
+
+    // What each byte of a pixel adds to the pixel's bits, so a pixel is
+    // four lookups instead of shifting out every channel.
+    uint16_t lookup[4][256];
+
+    for(int k = 0; k < 4; k++)
+    {
+        for(uint32_t b = 0; b < 256; b++)
+        {
+            uint32_t input = b << (k * 8);
+
+            lookup[k][b] = (uint16_t)((((input >> shift_red) & bits) << (3 * Depth)) |
+                                      (((input >> shift_green) & bits) << (2 * Depth)) |
+                                      (((input >> shift_blue) & bits) << Depth) |
+                                      ((input >> shift_alpha) & bits));
+        }
+    }
+
+    const uint32_t *pixels = image->Pixels + pixel;
+    uint8_t *bytes = (uint8_t*)buffer;
+    int i = 0;
+
+    for(; i + group_bytes <= count; i += group_bytes)
+    {
+        uint32_t value = 0;
+
+        for(int p = 0; p < group_pixels; p++)
+        {
+            uint32_t input = pixels[p];
+
+            value = (value << pixel_bits) |
+                    lookup[0][input & 0xFF] | lookup[1][(input >> 8) & 0xFF] |
+                    lookup[2][(input >> 16) & 0xFF] | lookup[3][input >> 24];
+        }
+
+        for(int b = 0; b < group_bytes; b++)
+        {
+            bytes[i + b] = (uint8_t)(value >> ((group_bytes - 1 - b) * 8));
+        }
+
+        pixels += group_pixels;
+    }
+
+    // The last group can be short, never read past the pixels that hold
+    // the last byte.
+    if (i < count)
+    {
+        int byte_count = count - i;
+        int pixel_count = ((byte_count * 2) + Depth - 1) / Depth;
+        uint32_t value = 0;
+
+        for(int p = 0; p < group_pixels; p++)
+        {
+            uint32_t input = (p < pixel_count) ? pixels[p] : 0;
+
+            value = (value << pixel_bits) |
+                    lookup[0][input & 0xFF] | lookup[1][(input >> 8) & 0xFF] |
+                    lookup[2][(input >> 16) & 0xFF] | lookup[3][input >> 24];
+        }
+
+        for(int b = 0; b < byte_count; b++)
+        {
+            bytes[i + b] = (uint8_t)(value >> ((group_bytes - 1 - b) * 8));
+        }
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoRowImage
+   $Prototype: static void GetStegoRowImage(const Image *image, uint32_t row, Image *row_image)
+   $Params:
+       image: The 24 bit image
+       row: Which row of the image
+       row_image: Where to put the image of the row
+   $
+   $Description: Makes a 32 bit image out of one row of the image. The
+   row of a 24 bit image is its words, see GetStegoRowPixels. The words are
+   read in the same byte order as the file, so the channels are ABGR. A
+   row of a 32 bit image with gaps between its rows keeps its masks. The
+   pixels are not copied, rows are always 4 byte aligned. $
+   ======================================================================== */
+static void GetStegoRowImage(const Image *image, uint32_t row, Image *row_image)
+{
+    *row_image = *image;
+
+    row_image->Pixels = GetImageRow(image, row);
+    row_image->Width = GetStegoRowPixels(image);
+    row_image->Height = 1;
+    row_image->PixelCount = row_image->Width;
+    row_image->BitsPerPixel = 32;
+    row_image->Pitch = row_image->Width * sizeof(uint32_t);
+
+    if (image->BitsPerPixel != 24)
+    {
+        return;
+    }
+
+    row_image->MaskRed = AbgrLayout::MaskRed;
+    row_image->MaskGreen = AbgrLayout::MaskGreen;
+    row_image->MaskBlue = AbgrLayout::MaskBlue;
+    row_image->MaskAlpha = AbgrLayout::MaskAlpha;
+
+    row_image->ShiftRed = AbgrLayout::ShiftRed;
+    row_image->ShiftGreen = AbgrLayout::ShiftGreen;
+    row_image->ShiftBlue = AbgrLayout::ShiftBlue;
+    row_image->ShiftAlpha = AbgrLayout::ShiftAlpha;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoSpanImage
+   $Prototype: static uint32_t GetStegoSpanImage(const Image *image, uint32_t pixel, Image *span_image, uint32_t *pair, uint32_t *span_pixels)
+   $Params:
+       image: The 24 bit image, or the one with gaps between its rows
+       pixel: The pixel the span starts at
+       span_image: Where to put the image of the span
+       pair: Room for two pixels
+       span_pixels: Gets set to how many pixels the span has
+   $
+   $Description: Makes an image of the pixels from pixel to the end of its
+   row and returns where pixel is in it. The kernels can't split a group
+   of pixels across rows, so a span always has an even number of pixels
+   unless it is the end of the image. When a group would cross the end of
+   the row, the last pixel of the row and the first of the next one are
+   copied into pair and the span is the two of them. Encoding has to put
+   them back with SetStegoPair. $
+   ======================================================================== */
+static uint32_t GetStegoSpanImage(const Image *image, uint32_t pixel, Image *span_image, uint32_t *pair, uint32_t *span_pixels)
+{
+    uint32_t row_pixels = GetStegoRowPixels(image);
+    uint32_t row = pixel / row_pixels;
+    uint32_t column = pixel % row_pixels;
+    uint32_t left = row_pixels - column;
+    Image next_row;
+
+    GetStegoRowImage(image, row, span_image);
+
+    if ((left & 1) == 0 || row + 1 >= image->Height)
+    {
+        *span_pixels = left;
+        return column;
+    }
+
+    if (left > 1)
+    {
+        *span_pixels = left - 1;
+        return column;
+    }
+
+    GetStegoRowImage(image, row + 1, &next_row);
+    pair[0] = span_image->Pixels[column];
+    pair[1] = next_row.Pixels[0];
+
+    span_image->Pixels = pair;
+    span_image->Width = 2;
+    span_image->PixelCount = 2;
+    span_image->Pitch = 2 * sizeof(uint32_t);
+
+    *span_pixels = 2;
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SetStegoPair
+   $Prototype: static void SetStegoPair(Image *image, uint32_t pixel, const uint32_t *pair)
+   $Params:
+       image: The image the pair came from
+       pixel: The last pixel of the row the pair starts in
+       pair: The two pixels from GetStegoSpanImage
+   $
+   $Description: Puts a pair of pixels that were encoded back into the end
+   of one row and the start of the next. $
+   ======================================================================== */
+static void SetStegoPair(Image *image, uint32_t pixel, const uint32_t *pair)
+{
+    uint32_t row_pixels = GetStegoRowPixels(image);
+    uint32_t row = pixel / row_pixels;
+
+    GetImageRow(image, row)[pixel % row_pixels] = pair[0];
+    GetImageRow(image, row + 1)[0] = pair[1];
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBytesDepth
+   $Prototype: void EncodeStegoBytesDepth(Image *image, const char *buffer, int count, uint32_t pixel, int depth)
+   $Params:
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel to start writing at. It has to be the start of a
+              group, so the bytes before it have to be whole groups.
+       depth: How many bits of each channel to use, 1 to 4.
+   $
+   $Description: Encodes the buffer at a depth. Depth 1 is the same as
+   EncodeStegoBytes and uses the SIMD kernels. A 24 bit image, or one with
+   gaps between its rows, is encoded a row at a time. $
+   ======================================================================== */
+void EncodeStegoBytesDepth(Image *image, const char *buffer, int count, uint32_t pixel, int depth)
+{
+    if (!IsImageContiguous(image))
+    {
+        Image span_image;
+        uint32_t pair[2];
+
+        while (count > 0 && GetStegoRowPixels(image) > 0)
+        {
+            uint32_t span_pixels;
+            uint32_t start = GetStegoSpanImage(image, pixel, &span_image, pair, &span_pixels);
+            int span_count = (int)GetStegoByteCount(span_pixels, depth);
+
+            if (span_count > count)
+            {
+                span_count = count;
+            }
+
+            if (span_count == 0)
+            {
+                break;
+            }
+
+            EncodeStegoBytesDepth(&span_image, buffer, span_count, start, depth);
+
+            if (span_image.Pixels == pair)
+            {
+                SetStegoPair(image, pixel, pair);
+            }
+
+            buffer += span_count;
+            count -= span_count;
+            pixel += span_pixels;
+        }
+        return;
+    }
+
+    switch (depth)
+    {
+        case 2: DISPATCH_PIXEL_LAYOUT(image, EncodeStegoGroups<2>, image, buffer, count, pixel); break;
+        case 3: DISPATCH_PIXEL_LAYOUT(image, EncodeStegoGroups<3>, image, buffer, count, pixel); break;
+        case 4: DISPATCH_PIXEL_LAYOUT(image, EncodeStegoGroups<4>, image, buffer, count, pixel); break;
+        default: EncodeStegoBytes(image, buffer, count, pixel); break;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytesDepth
+   $Prototype: void DecodeStegoBytesDepth(Image *image, uint32_t pixel, char *buffer, int count, int depth)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel to start reading at. It has to be the start of a group.
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+       depth: How many bits of each channel were used, 1 to 4.
+   $
+   $Description: Decodes into the buffer at a depth. A 24 bit image, or one
+   with gaps between its rows, is decoded a row at a time. $
+   ======================================================================== */
+void DecodeStegoBytesDepth(Image *image, uint32_t pixel, char *buffer, int count, int depth)
+{
+    if (!IsImageContiguous(image))
+    {
+        Image span_image;
+        uint32_t pair[2];
+
+        while (count > 0 && GetStegoRowPixels(image) > 0)
+        {
+            uint32_t span_pixels;
+            uint32_t start = GetStegoSpanImage(image, pixel, &span_image, pair, &span_pixels);
+            int span_count = (int)GetStegoByteCount(span_pixels, depth);
+
+            if (span_count > count)
+            {
+                span_count = count;
+            }
+
+            if (span_count == 0)
+            {
+                break;
+            }
+
+            DecodeStegoBytesDepth(&span_image, start, buffer, span_count, depth);
+
+            buffer += span_count;
+            count -= span_count;
+            pixel += span_pixels;
+        }
+        return;
+    }
+
+    switch (depth)
+    {
+        case 2: DISPATCH_PIXEL_LAYOUT(image, DecodeStegoGroups<2>, image, pixel, buffer, count); break;
+        case 3: DISPATCH_PIXEL_LAYOUT(image, DecodeStegoGroups<3>, image, pixel, buffer, count); break;
+        case 4: DISPATCH_PIXEL_LAYOUT(image, DecodeStegoGroups<4>, image, pixel, buffer, count); break;
+        default: DecodeStegoBytes(image, pixel, buffer, count); break;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: MixStegoScatter
+   $Prototype: static uint32_t MixStegoScatter(uint32_t value, uint32_t key)
+   $Params:
+       value: The number to mix
+       key: A word of the scatter key
+   $
+   $Description: Mixes a number with a key word so every bit of the
+   result depends on every bit of both (the murmur3 finaliser). It is the
+   round function of the run permutation. $
+   ======================================================================== */
+static uint32_t MixStegoScatter(uint32_t value, uint32_t key)
+{
+    value ^= key;
+    value ^= value >> 16;
+    value *= 0x85EBCA6B;
+    value ^= value >> 13;
+    value *= 0xC2B2AE35;
+    value ^= value >> 16;
+
+    return value;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: PermuteStegoRun
+   $Prototype: static uint32_t PermuteStegoRun(const StegoScatter *scatter, uint32_t run, int inverse)
+   $Params:
+       scatter: The scatter of the payload
+       run: Which run, less than RunCount
+       inverse: 0 to go from a run of the payload to the run of the image
+                it is stored in, 1 to go back.
+   $
+   $Description: A four round Feistel network is a permutation of the
+   RunBits numbers, and the ones past RunCount are put through again
+   until one isn't, so the result is always a run of the image and no two
+   runs get the same one. The inverse runs the rounds backwards. $
+   ======================================================================== */
+static uint32_t PermuteStegoRun(const StegoScatter *scatter, uint32_t run, int inverse)
+{
+    uint32_t half = scatter->RunBits / 2;
+    uint32_t mask = (1u << half) - 1;
+
+    do
+    {
+        uint32_t left = run >> half;
+        uint32_t right = run & mask;
+
+        for(int i = 0; i < 4; i++)
+        {
+            if (inverse)
+            {
+                uint32_t previous = right ^ (MixStegoScatter(left, scatter->Keys[3 - i]) & mask);
+
+                right = left;
+                left = previous;
+            }
+            else
+            {
+                uint32_t next = left ^ (MixStegoScatter(right, scatter->Keys[i]) & mask);
+
+                left = right;
+                right = next;
+            }
+        }
+
+        run = (left << half) | right;
+    } while (run >= scatter->RunCount);
+
+    return run;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: StartStegoScatter
+   $Prototype: int StartStegoScatter(StegoScatter *scatter, const uint8_t *key, uint32_t base, uint32_t pixel_count)
+   $Params:
+       scatter: The scatter to set up
+       key: STEGO_SCATTER_KEY_BYTES of key
+       base: The first pixel that is scattered. The ones before it are
+             left in order.
+       pixel_count: How many pixels the kernels can use in the image, see
+                    GetStegoImagePixels.
+   $
+   $Description: Sets up the scatter of a payload over an image, sizing
+   the runs from how many pixels there are. The short run at the end is
+   an even number of pixels, so every run holds whole groups at every
+   depth. The same key and image size always give the same scatter.
+   Returns 0 on success and -1 if there would be fewer than 2 runs. $
+   ======================================================================== */
+int StartStegoScatter(StegoScatter *scatter, const uint8_t *key, uint32_t base, uint32_t pixel_count)
+{
+    uint32_t pixels = (pixel_count > base) ? (pixel_count - base) : 0;
+    uint32_t whole_runs;
+
+    scatter->Base = base;
+    scatter->RunPixels = STEGO_SCATTER_RUN_PIXELS;
+
+    while (scatter->RunPixels > STEGO_SCATTER_MIN_RUN_PIXELS &&
+           (pixels / scatter->RunPixels) < STEGO_SCATTER_MIN_RUNS)
+    {
+        scatter->RunPixels /= 2;
+    }
+
+    whole_runs = pixels / scatter->RunPixels;
+    scatter->ShortPixels = (pixels - (whole_runs * scatter->RunPixels)) & ~1u;
+    scatter->RunCount = whole_runs + ((scatter->ShortPixels > 0) ? 1 : 0);
+
+    if (scatter->RunCount < 2)
+    {
+        return -1;
+    }
+
+    scatter->RunBits = 2;
+
+    while (scatter->RunBits < 32 && (1u << scatter->RunBits) < scatter->RunCount)
+    {
+        scatter->RunBits += 2;
+    }
+
+    for(int i = 0; i < STEGO_SCATTER_KEY_BYTES / 4; i++)
+    {
+        scatter->Keys[i] = (((uint32_t)key[(i * 4)] << 24) | ((uint32_t)key[(i * 4) + 1] << 16) |
+                            ((uint32_t)key[(i * 4) + 2] << 8) | (uint32_t)key[(i * 4) + 3]);
+    }
+
+    // The short run is the last run of the image, whichever run of the
+    // payload goes there is short too.
+    scatter->ShortRun = scatter->ShortPixels ? PermuteStegoRun(scatter, scatter->RunCount - 1, 1) : scatter->RunCount;
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStegoScatterPixel
+   $Prototype: uint32_t GetStegoScatterPixel(const StegoScatter *scatter, uint32_t pixel, uint32_t *run_pixels)
+   $Params:
+       scatter: The scatter of the payload
+       pixel: The pixel of the payload, as if it went through the image
+              in order.
+       run_pixels: Gets set to how many pixels from pixel on are stored
+                   one after the other.
+   $
+   $Description: Returns the pixel of the image that a pixel of the
+   payload is stored in. The runs of the payload before ShortRun are
+   whole, then it has ShortPixels and the rest are whole again. $
+   ======================================================================== */
+uint32_t GetStegoScatterPixel(const StegoScatter *scatter, uint32_t pixel, uint32_t *run_pixels)
+{
+    if (pixel < scatter->Base)
+    {
+        *run_pixels = scatter->Base - pixel;
+        return pixel;
+    }
+
+    uint32_t offset = pixel - scatter->Base;
+    uint32_t short_start = scatter->ShortRun * scatter->RunPixels;
+    uint32_t run;
+    uint32_t column;
+    uint32_t length;
+
+    if (offset >= ((scatter->RunCount - 1) * scatter->RunPixels) + (scatter->ShortPixels ? scatter->ShortPixels : scatter->RunPixels))
+    {
+        *run_pixels = 0xFFFFFFFF - pixel;
+        return pixel;
+    }
+
+    if (offset < short_start)
+    {
+        run = offset / scatter->RunPixels;
+        column = offset % scatter->RunPixels;
+        length = scatter->RunPixels;
+    }
+    else if (offset < short_start + scatter->ShortPixels)
+    {
+        run = scatter->ShortRun;
+        column = offset - short_start;
+        length = scatter->ShortPixels;
+    }
+    else
+    {
+        run = ((offset - scatter->ShortPixels) / scatter->RunPixels) + 1;
+        column = (offset - scatter->ShortPixels) % scatter->RunPixels;
+        length = scatter->RunPixels;
+    }
+
+    *run_pixels = length - column;
+
+    return scatter->Base + (PermuteStegoRun(scatter, run, 0) * scatter->RunPixels) + column;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoBytesScattered
+   $Prototype: void EncodeStegoBytesScattered(Image *image, const char *buffer, int count, uint32_t pixel, int depth, const StegoScatter *scatter)
+   $Params:
+       image: The image to encode into
+       buffer: The bytes to put into the image
+       count: The amount of bytes in the buffer
+       pixel: The pixel of the payload to start writing at. It has to be
+              the start of a group.
+       depth: How many bits of each channel to use, 1 to 4.
+       scatter: The scatter of the payload, 0 if it isn't scattered.
+   $
+   $Description: Encodes the buffer a run at a time, with the same kernels
+   as EncodeStegoBytesDepth. Every run is whole groups at every depth. $
+   ======================================================================== */
+void EncodeStegoBytesScattered(Image *image, const char *buffer, int count, uint32_t pixel, int depth, const StegoScatter *scatter)
+{
+    if (!scatter)
+    {
+        EncodeStegoBytesDepth(image, buffer, count, pixel, depth);
+        return;
+    }
+
+    while (count > 0)
+    {
+        uint32_t run_pixels;
+        uint32_t stored = GetStegoScatterPixel(scatter, pixel, &run_pixels);
+        uint32_t run_bytes = GetStegoByteCount(run_pixels, depth);
+        int bytes = (run_bytes < (uint32_t)count) ? (int)run_bytes : count;
+
+        EncodeStegoBytesDepth(image, buffer, bytes, stored, depth);
+
+        buffer += bytes;
+        count -= bytes;
+        pixel += run_pixels;
+    }
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoBytesScattered
+   $Prototype: void DecodeStegoBytesScattered(Image *image, uint32_t pixel, char *buffer, int count, int depth, const StegoScatter *scatter)
+   $Params:
+       image: The image to decode from
+       pixel: The pixel of the payload to start reading at. It has to be
+              the start of a group.
+       buffer: The buffer to write the bytes into
+       count: The amount of bytes to read
+       depth: How many bits of each channel were used, 1 to 4.
+       scatter: The scatter of the payload, 0 if it isn't scattered.
+   $
+   $Description: Decodes into the buffer a run at a time. $
+   ======================================================================== */
+void DecodeStegoBytesScattered(Image *image, uint32_t pixel, char *buffer, int count, int depth, const StegoScatter *scatter)
+{
+    if (!scatter)
+    {
+        DecodeStegoBytesDepth(image, pixel, buffer, count, depth);
+        return;
+    }
+
+    while (count > 0)
+    {
+        uint32_t run_pixels;
+        uint32_t stored = GetStegoScatterPixel(scatter, pixel, &run_pixels);
+        uint32_t run_bytes = GetStegoByteCount(run_pixels, depth);
+        int bytes = (run_bytes < (uint32_t)count) ? (int)run_bytes : count;
+
+        DecodeStegoBytesDepth(image, stored, buffer, bytes, depth);
+
+        buffer += bytes;
+        count -= bytes;
+        pixel += run_pixels;
+    }
+}
@@ -0,0 +1,132 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: stego_kernels.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: The low level routines that move payload bytes in and
+                 out of the pixel data. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(STEGO_KERNELS_H)
+#define STEGO_KERNELS_H
+
+#include <stdint.h>
+
+#include "image.h"
+
+// Set this to 0 to compile out the SIMD kernels and only use the
+// scalar reference path.
+#define STEGO_KERNELS_SIMD 1
+
+// Which kernel the Encode/Decode functions use. AUTO picks the best
+// one the CPU supports, the others force a kernel (mainly for testing
+// and benchmarking). A forced kernel the CPU doesn't support falls
+// back to the scalar path.
+enum StegoKernel
+{
+    STEGO_KERNEL_AUTO,
+    STEGO_KERNEL_SCALAR,
+    STEGO_KERNEL_SSE,
+    STEGO_KERNEL_BMI2,
+    STEGO_KERNEL_AVX2,
+};
+
+// The payload can use the lowest 1 to 4 bits of every channel. The
+// deeper it goes the more fits and the more the image changes.
+#define STEGO_MIN_DEPTH 1
+#define STEGO_MAX_DEPTH 4
+
+// Returns how many pixels count bytes take up at a depth.
+inline uint32_t GetStegoPixelCount(uint32_t count, int depth)
+{
+    return (uint32_t)((((uint64_t)count * 2) + depth - 1) / depth);
+}
+
+// Returns how many whole bytes fit in pixel_count pixels at a depth.
+inline uint32_t GetStegoByteCount(uint32_t pixel_count, int depth)
+{
+    return (uint32_t)(((uint64_t)pixel_count * depth) / 2);
+}
+
+// 24 bit images are packed 3 bytes to a pixel, so the kernels see each
+// row as 4 byte words of channel bytes instead. There are an even number
+// of words per row so every depth ends a row on a whole group, and the
+// bytes after the last word and the row padding are never touched. The
+// rows of a 32 bit image with gaps between them are its pixels, numbered
+// the same as if the rows were packed.
+inline uint32_t GetStegoRowPixels(const Image *image)
+{
+    if (image->BitsPerPixel == 24)
+    {
+        return ((image->Width * 3) / 4) & ~1u;
+    }
+
+    return image->Width;
+}
+
+// Returns how many pixels (or words, for 24 bit images) the kernels can
+// use in the image.
+inline uint32_t GetStegoImagePixels(const Image *image)
+{
+    if (image->BitsPerPixel == 24)
+    {
+        return GetStegoRowPixels(image) * image->Height;
+    }
+
+    return image->PixelCount;
+}
+
+// A payload can be scattered over the image instead of going through
+// the pixels in order. The pixels from Base on are split into runs that
+// are shuffled with a keyed permutation. A run is still encoded in order,
+// so the kernels stay fast. Runs are STEGO_SCATTER_RUN_PIXELS, halved
+// down to STEGO_SCATTER_MIN_RUN_PIXELS until the image has at least
+// STEGO_SCATTER_MIN_RUNS of them, and the pixels left over after the last
+// whole run are a shorter run that is shuffled with the others. Only a
+// last odd pixel isn't moved.
+#define STEGO_SCATTER_RUN_PIXELS 4096
+#define STEGO_SCATTER_MIN_RUN_PIXELS 16
+#define STEGO_SCATTER_MIN_RUNS 64
+#define STEGO_SCATTER_KEY_BYTES 32
+
+struct StegoScatter
+{
+    uint32_t Base;
+    uint32_t RunPixels;
+
+    // How many runs there are, counting the short one at the end if
+    // ShortPixels isn't 0. ShortRun is which run of the payload is
+    // stored in it, RunCount if there isn't one.
+    uint32_t RunCount;
+    uint32_t ShortPixels;
+    uint32_t ShortRun;
+
+    // The runs are permuted with a Feistel network on RunBits bits,
+    // skipping the numbers past RunCount.
+    uint32_t RunBits;
+    uint32_t Keys[STEGO_SCATTER_KEY_BYTES / 4];
+};
+
+void SetStegoKernel(StegoKernel kernel);
+StegoKernel GetStegoKernel();
+
+void EncodeStegoBytesScalar(Image *image, const char *buffer, int count, uint32_t pixel);
+void EncodeStegoBytes(Image *image, const char *buffer, int count, uint32_t pixel);
+
+void DecodeStegoBytesScalar(Image *image, uint32_t pixel, char *buffer, int count);
+void DecodeStegoBytes(Image *image, uint32_t pixel, char *buffer, int count);
+
+void EncodeStegoBytesDepth(Image *image, const char *buffer, int count, uint32_t pixel, int depth);
+void DecodeStegoBytesDepth(Image *image, uint32_t pixel, char *buffer, int count, int depth);
+
+// Returns -1 if the image is too small to have 2 runs.
+int StartStegoScatter(StegoScatter *scatter, const uint8_t *key, uint32_t base, uint32_t pixel_count);
+uint32_t GetStegoScatterPixel(const StegoScatter *scatter, uint32_t pixel, uint32_t *run_pixels);
+
+// The scatter is 0 if the bytes go through the pixels in order.
+void EncodeStegoBytesScattered(Image *image, const char *buffer, int count, uint32_t pixel, int depth, const StegoScatter *scatter);
+void DecodeStegoBytesScattered(Image *image, uint32_t pixel, char *buffer, int count, int depth, const StegoScatter *scatter);
+
+#endif
@@ -0,0 +1,662 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: stripe.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static int GetStripePayloadId(uint64_t *payload_id)
+static char *GetStripeOutput(const char *output, int index)
+static void EncodeStripeJob(void *data, int index)
+static void DecodeStripeJob(void *data, int index)
+static void RunStripeJob(void *data, int index)
+static void RunStripeJobs(StripeWork *work, int carrier_count, ParallelFunction function)
+static void SplitStripes(StripeJob *jobs, int carrier_count, uint32_t data_length)
+int EncodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *output, AESType aes, const char *password)
+static int CheckStripes(StripeJob *jobs, int carrier_count, StripeJob **ordered)
+static int WriteStripes(StripeJob **ordered, int carrier_count, const char *filename)
+int DecodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *password)
+   $
+   $Description: A file that is too big for one image is split into a
+   stripe for each of the carrier images, sized by how much each of them
+   can hold so they all fill up at the same rate. Each image gets a
+   payload of its own with a stripe header saying which stripe it is, how
+   many there are, the ID they share and where its part of the data goes
+   (see steganography.cpp). Each carrier is loaded, encoded and saved or
+   loaded and decoded on a thread of its own, so the work is spread over
+   the processors and the disks the images are on. The carriers can be
+   decoded in any order. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "stripe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "image.h"
+#include "steganography.h"
+#include "threads.h"
+#include "profiler.h"
+
+// The stripe index and count are a byte each in the header.
+#define STRIPE_MAX_CARRIERS 255
+
+// One carrier image and its stripe.
+struct StripeJob
+{
+    const char *Carrier;
+
+    // Where the encoded image is saved, while encoding.
+    char *Output;
+
+    StegoStripe Stripe;
+
+    // The stripe's part of the data. While encoding it points into the
+    // whole of the data, while decoding it is allocated by the job.
+    char *Data;
+
+    // 0 if the job worked, otherwise -1.
+    int Result;
+};
+
+// What all of the jobs share.
+struct StripeWork
+{
+    StripeJob *Jobs;
+
+    // Only used to encode, decoding finds out which AES from the image.
+    AESType Aes;
+    const char *Password;
+
+    // EncodeStripeJob or DecodeStripeJob, which RunStripeJob runs.
+    ParallelFunction Function;
+};
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStripePayloadId
+   $Prototype: static int GetStripePayloadId(uint64_t *payload_id)
+   $Params:
+       payload_id: Gets set to a random ID.
+   $
+   $Description: Makes the ID the stripes of a payload share, so stripes
+   of different payloads can't be decoded together. Returns 0 on success
+   and -1 if there isn't any random data. $
+   ======================================================================== */
+static int GetStripePayloadId(uint64_t *payload_id)
+{
+    FILE *fp;
+    size_t bytes_read;
+
+    if ((fp = fopen("/dev/urandom", "r")) == 0)
+    {
+        printf("Error: unable to read random data for the payload ID.\n");
+        return -1;
+    }
+
+    bytes_read = fread(payload_id, 1, sizeof(uint64_t), fp);
+    fclose(fp);
+
+    if (bytes_read != sizeof(uint64_t))
+    {
+        printf("Error: unable to read random data for the payload ID.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetStripeOutput
+   $Prototype: static char *GetStripeOutput(const char *output, int index)
+   $Params:
+       output: The output filename the user gave
+       index: Which stripe it is
+   $
+   $Description: Returns the filename stripe index is saved as, which is
+   output with _<index> in front of its .bmp, or on the end if it doesn't
+   have one. It needs to be freed. $
+   ======================================================================== */
+static char *GetStripeOutput(const char *output, int index)
+{
+    int length = strlen(output);
+    char *filename = (char*)malloc(length + 16);
+
+    if (length > 4 && strcmp(output + length - 4, ".bmp") == 0)
+    {
+        sprintf(filename, "%.*s_%d.bmp", length - 4, output, index);
+    }
+    else
+    {
+        sprintf(filename, "%s_%d.bmp", output, index);
+    }
+
+    return filename;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStripeJob
+   $Prototype: static void EncodeStripeJob(void *data, int index)
+   $Params:
+       data: The StripeWork
+       index: The carrier to encode
+   $
+   $Description: Loads a carrier copy on write, encodes its stripe
+   straight into it and saves it. $
+   ======================================================================== */
+static void EncodeStripeJob(void *data, int index)
+{
+    TIMED_BLOCK();
+
+    StripeWork *work = (StripeWork*)data;
+    StripeJob *job = &work->Jobs[index];
+    Image *image;
+
+    job->Result = -1;
+
+    if ((image = LoadImageMapped(job->Carrier, IMAGE_MAP_PRIVATE)) == 0)
+    {
+        printf("The image %s failed to load.\n", job->Carrier);
+        return;
+    }
+
+    if (work->Password)
+    {
+        job->Result = EncodeStegoStripeInPlaceEnc(image, job->Data, job->Stripe.Length, &job->Stripe, work->Aes, work->Password);
+    }
+    else
+    {
+        job->Result = EncodeStegoStripeInPlace(image, job->Data, job->Stripe.Length, &job->Stripe);
+    }
+
+    if (job->Result == 0 && SaveBitmap(job->Output, image) != 0)
+    {
+        job->Result = -1;
+    }
+
+    FreeImage(image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStripeJob
+   $Prototype: static void DecodeStripeJob(void *data, int index)
+   $Params:
+       data: The StripeWork
+       index: The carrier to decode
+   $
+   $Description: Loads a carrier, finds out which stripe it has and
+   decodes its part of the data. $
+   ======================================================================== */
+static void DecodeStripeJob(void *data, int index)
+{
+    TIMED_BLOCK();
+
+    StripeWork *work = (StripeWork*)data;
+    StripeJob *job = &work->Jobs[index];
+    Image *image;
+    int length;
+
+    job->Result = -1;
+
+    if ((image = LoadImageMapped(job->Carrier, IMAGE_MAP_READ)) == 0)
+    {
+        printf("The image %s failed to load.\n", job->Carrier);
+        return;
+    }
+
+    if (ReadStegoStripe(image, &job->Stripe) == 0)
+    {
+        job->Data = (char*)AllocateMemory(MEMORY_PAYLOAD, job->Stripe.Length);
+
+        if (work->Password)
+        {
+            length = DecodeStegoStripeEnc(image, job->Data, job->Stripe.Length, work->Password);
+        }
+        else
+        {
+            length = DecodeStegoStripe(image, job->Data, job->Stripe.Length);
+        }
+
+        job->Result = (length == (int)job->Stripe.Length) ? 0 : -1;
+    }
+
+    FreeImage(image);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunStripeJob
+   $Prototype: static void RunStripeJob(void *data, int index)
+   $Params:
+       data: The StripeWork
+       index: The carrier
+   $
+   $Description: Runs the job of one carrier single threaded, like the
+   jobs of a batch, which only changes the thread it runs on. $
+   ======================================================================== */
+static void RunStripeJob(void *data, int index)
+{
+    StripeWork *work = (StripeWork*)data;
+    int stego_threads = SetStegoJobThreads(1);
+    int image_threads = SetImageJobThreads(1);
+
+    work->Function(data, index);
+
+    SetStegoJobThreads(stego_threads);
+    SetImageJobThreads(image_threads);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: RunStripeJobs
+   $Prototype: static void RunStripeJobs(StripeWork *work, int carrier_count, ParallelFunction function)
+   $Params:
+       work: The jobs to run
+       carrier_count: How many carriers there are
+       function: EncodeStripeJob or DecodeStripeJob
+   $
+   $Description: Runs a job for each carrier on a thread of its own with
+   RunStripeJob. $
+   ======================================================================== */
+static void RunStripeJobs(StripeWork *work, int carrier_count, ParallelFunction function)
+{
+    work->Function = function;
+    ParallelFor(carrier_count, carrier_count, RunStripeJob, work);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: SplitStripes
+   $Prototype: static void SplitStripes(StripeJob *jobs, int carrier_count, uint32_t data_length)
+   $Params:
+       jobs: The carriers, with the length of the data that fits in each
+             of them in Stripe.Length.
+       carrier_count: How many carriers there are
+       data_length: How long the data is. It has to fit in them all.
+   $
+   $Description: Gives each carrier a share of the data by how much it
+   can hold, so every carrier ends up just as full, then hands out what
+   was rounded off to the ones with room left. Sets the offset and length
+   of every stripe. $
+   ======================================================================== */
+static void SplitStripes(StripeJob *jobs, int carrier_count, uint32_t data_length)
+{
+    uint64_t capacity = 0;
+    uint32_t given = 0;
+    uint32_t offset = 0;
+    uint32_t *room = (uint32_t*)malloc(sizeof(uint32_t) * carrier_count);
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        room[i] = jobs[i].Stripe.Length;
+        capacity += room[i];
+    }
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        jobs[i].Stripe.Length = (uint32_t)(((uint64_t)data_length * room[i]) / capacity);
+        given += jobs[i].Stripe.Length;
+    }
+
+    for(int i = 0; i < carrier_count && given < data_length; i++)
+    {
+        uint32_t extra = room[i] - jobs[i].Stripe.Length;
+
+        if (extra > data_length - given)
+        {
+            extra = data_length - given;
+        }
+
+        jobs[i].Stripe.Length += extra;
+        given += extra;
+    }
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        jobs[i].Stripe.Offset = offset;
+        offset += jobs[i].Stripe.Length;
+    }
+
+    free(room);
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: EncodeStegoFileStriped
+   $Prototype: int EncodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *output, AESType aes, const char *password)
+   $Params:
+       carriers: The images to stripe the file across
+       carrier_count: How many there are, at most 255.
+       filename: The file to encode
+       output: What the encoded images are called. Stripe i is saved with
+               _i in front of the .bmp.
+       aes: Which AES to encrypt with
+       password: The password to derive the keys from, 0 to not encrypt.
+   $
+   $Description: Stripes a file across the carriers. Only the headers of
+   the carriers are read to work out how much each of them holds before
+   they are encoded at the same time. Returns 0 on success and -1 if the
+   file doesn't fit in all of them or any of them fails. $
+   ======================================================================== */
+int EncodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *output, AESType aes, const char *password)
+{
+    TIMED_BLOCK();
+
+    StripeWork work;
+    StripeJob *jobs;
+    uint64_t payload_id;
+    uint64_t capacity = 0;
+    int buffer_length;
+    char *buffer;
+    int result = 0;
+
+    if (carrier_count < 1 || carrier_count > STRIPE_MAX_CARRIERS)
+    {
+        printf("Error: a file can be striped across 1 to %d images.\n", STRIPE_MAX_CARRIERS);
+        return -1;
+    }
+
+    if (GetStripePayloadId(&payload_id) != 0)
+    {
+        return -1;
+    }
+
+    jobs = (StripeJob*)calloc(carrier_count, sizeof(StripeJob));
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        StegoProbe probe;
+
+        if (ProbeStegoImage(carriers[i], &probe) != 0)
+        {
+            printf("The image %s failed to load.\n", carriers[i]);
+            free(jobs);
+            return -1;
+        }
+
+        jobs[i].Carrier = carriers[i];
+        jobs[i].Stripe.Length = StegoStripeMaxBytes(probe.Capacity, password != 0);
+        capacity += jobs[i].Stripe.Length;
+    }
+
+    if ((buffer = ReadStegoFile(filename, &buffer_length)) == 0)
+    {
+        free(jobs);
+        return -1;
+    }
+
+    if ((uint64_t)buffer_length > capacity)
+    {
+        printf("Error: buffer is too long to store.\n");
+        FreeMemory(buffer);
+        free(jobs);
+        return -1;
+    }
+
+    SplitStripes(jobs, carrier_count, buffer_length);
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        jobs[i].Output = GetStripeOutput(output, i);
+        jobs[i].Data = buffer + jobs[i].Stripe.Offset;
+        jobs[i].Stripe.PayloadId = payload_id;
+        jobs[i].Stripe.DataLength = buffer_length;
+        jobs[i].Stripe.Index = i;
+        jobs[i].Stripe.Count = carrier_count;
+    }
+
+    work.Jobs = jobs;
+    work.Aes = aes;
+    work.Password = password;
+
+    RunStripeJobs(&work, carrier_count, EncodeStripeJob);
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        if (jobs[i].Result != 0)
+        {
+            printf("Stripe %d in %s failed.\n", i + 1, jobs[i].Carrier);
+            result = -1;
+        }
+
+        free(jobs[i].Output);
+    }
+
+    FreeMemory(buffer);
+    free(jobs);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: CheckStripes
+   $Prototype: static int CheckStripes(StripeJob *jobs, int carrier_count, StripeJob **ordered)
+   $Params:
+       jobs: The decoded carriers, in the order they were given.
+       carrier_count: How many carriers there are
+       ordered: Gets the carriers in stripe order.
+   $
+   $Description: Checks that the carriers are every stripe of the same
+   payload once, and that the stripes fit together end to end. Returns 0
+   on success and -1 if they don't. $
+   ======================================================================== */
+static int CheckStripes(StripeJob *jobs, int carrier_count, StripeJob **ordered)
+{
+    uint32_t offset = 0;
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        const StegoStripe *stripe = &jobs[i].Stripe;
+
+        if (stripe->Count != carrier_count)
+        {
+            printf("Cannot decode images. The payload in %s has %d stripes, %d images were given.\n",
+                   jobs[i].Carrier, stripe->Count, carrier_count);
+            return -1;
+        }
+
+        if (stripe->PayloadId != jobs[0].Stripe.PayloadId || stripe->DataLength != jobs[0].Stripe.DataLength)
+        {
+            printf("Cannot decode images. %s has a stripe of a different payload.\n", jobs[i].Carrier);
+            return -1;
+        }
+
+        if (ordered[stripe->Index] != 0)
+        {
+            printf("Cannot decode images. %s and %s have the same stripe.\n", ordered[stripe->Index]->Carrier, jobs[i].Carrier);
+            return -1;
+        }
+
+        ordered[stripe->Index] = &jobs[i];
+    }
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        if (ordered[i]->Stripe.Offset != offset)
+        {
+            printf("Cannot decode images. The stripes don't fit together.\n");
+            return -1;
+        }
+
+        offset += ordered[i]->Stripe.Length;
+    }
+
+    if (offset != jobs[0].Stripe.DataLength)
+    {
+        printf("Cannot decode images. The stripes don't fit together.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: WriteStripes
+   $Prototype: static int WriteStripes(StripeJob **ordered, int carrier_count, const char *filename)
+   $Params:
+       ordered: The decoded carriers in stripe order.
+       carrier_count: How many carriers there are
+       filename: The file to write to, 0 to use the stored filename.
+   $
+   $Description: Writes the stripes out one after the other. The NUL
+   terminated filename at the start of the data can run across more than
+   one stripe. Returns how many bytes the file has, or -1. $
+   ======================================================================== */
+static int WriteStripes(StripeJob **ordered, int carrier_count, const char *filename)
+{
+    char *name = 0;
+    uint32_t name_length = 0;
+    FILE *fp = 0;
+    int result = -1;
+    int written = 0;
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        const char *data = ordered[i]->Data;
+        uint32_t count = ordered[i]->Stripe.Length;
+        uint32_t bytes_written = 0;
+
+        // Collect the filename until its NUL.
+        if (!fp)
+        {
+            const char *name_end = (const char*)memchr(data, 0, count);
+            uint32_t part = name_end ? (name_end - data + 1) : count;
+
+            name = (char*)realloc(name, name_length + part);
+            memcpy(name + name_length, data, part);
+            name_length += part;
+            data += part;
+            count -= part;
+
+            if (!name_end)
+            {
+                continue;
+            }
+
+            if (name_length == 1)
+            {
+                printf("Cannot decode images. The data is an archive of files, it has to be extracted.\n");
+                break;
+            }
+
+            if ((fp = fopen(filename ? filename : name, "w")) == 0)
+            {
+                printf("Error writing file: %s\n", filename ? filename : name);
+                break;
+            }
+        }
+
+        while (bytes_written < count)
+        {
+            uint32_t n = fwrite(data + bytes_written, 1, count - bytes_written, fp);
+
+            if (n == 0)
+            {
+                printf("Error writing file: %s\n", filename ? filename : name);
+                break;
+            }
+
+            bytes_written += n;
+        }
+
+        if (bytes_written < count)
+        {
+            break;
+        }
+
+        written += count;
+
+        if (i == carrier_count - 1)
+        {
+            result = written;
+        }
+    }
+
+    if (fp)
+    {
+        fclose(fp);
+    }
+    else if (name_length > 0 && name[name_length - 1] != 0)
+    {
+        printf("Cannot decode images. The filename is not terminated.\n");
+    }
+
+    free(name);
+
+    return result;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: DecodeStegoFileStriped
+   $Prototype: int DecodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *password)
+   $Params:
+       carriers: The images with the stripes, in any order.
+       carrier_count: How many there are. It has to be all of them.
+       filename: The file to write to, 0 to use the stored filename.
+       password: The password it was encrypted with, 0 if it isn't.
+   $
+   $Description: Decodes the stripes of a file from all of the carriers
+   at the same time, puts them in order and writes the file out. Returns
+   how many bytes the file has, or -1. $
+   ======================================================================== */
+int DecodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *password)
+{
+    TIMED_BLOCK();
+
+    StripeWork work;
+    StripeJob *jobs;
+    StripeJob **ordered;
+    int result = 0;
+
+    if (carrier_count < 1 || carrier_count > STRIPE_MAX_CARRIERS)
+    {
+        printf("Error: a file can be striped across 1 to %d images.\n", STRIPE_MAX_CARRIERS);
+        return -1;
+    }
+
+    jobs = (StripeJob*)calloc(carrier_count, sizeof(StripeJob));
+    ordered = (StripeJob**)calloc(carrier_count, sizeof(StripeJob*));
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        jobs[i].Carrier = carriers[i];
+    }
+
+    work.Jobs = jobs;
+    work.Password = password;
+
+    RunStripeJobs(&work, carrier_count, DecodeStripeJob);
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        if (jobs[i].Result != 0)
+        {
+            printf("The stripe in %s couldn't be decoded.\n", jobs[i].Carrier);
+            result = -1;
+        }
+    }
+
+    if (result == 0 && (result = CheckStripes(jobs, carrier_count, ordered)) == 0)
+    {
+        result = WriteStripes(ordered, carrier_count, filename);
+    }
+
+    for(int i = 0; i < carrier_count; i++)
+    {
+        FreeMemory(jobs[i].Data);
+    }
+
+    free(ordered);
+    free(jobs);
+
+    return result;
+}
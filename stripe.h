@@ -0,0 +1,22 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: stripe.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: Stripes a file that doesn't fit in one image across
+                 several of them, a thread for each. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(STRIPE_H)
+#define STRIPE_H
+
+#include "encryption.h"
+
+// The password is 0 if the file isn't encrypted. Stripe i is saved as
+// output with _i in front of its .bmp.
+int EncodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *output, AESType aes, const char *password);
+int DecodeStegoFileStriped(char **carriers, int carrier_count, const char *filename, const char *password);
+
+#endif
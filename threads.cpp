@@ -0,0 +1,129 @@
+/* ========================================================================
+   $SOURCE FILE
+   $File: threads.cpp $
+   $Program: steganography $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Functions:
+static void *ParallelWorker(void *arg)
+int GetProcessorCount()
+void ParallelFor(int thread_count, int job_count, ParallelFunction function, void *data)
+   $
+   $Description: This file runs jobs on a group of pthreads. $
+   $Revisions: $
+   ======================================================================== */
+
+#include "threads.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// What all of the workers of one ParallelFor share.
+struct ParallelWork
+{
+    ParallelFunction Function;
+    void *Data;
+
+    int JobCount;
+    int NextJob;
+};
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ParallelWorker
+   $Prototype: static void *ParallelWorker(void *arg)
+   $Params:
+       arg: The ParallelWork to do.
+   $
+   $Description: Keeps taking the next job until there are none left. $
+   ======================================================================== */
+static void *ParallelWorker(void *arg)
+{
+    ParallelWork *work = (ParallelWork*)arg;
+    int job;
+
+    while ((job = __atomic_fetch_add(&work->NextJob, 1, __ATOMIC_RELAXED)) < work->JobCount)
+    {
+        work->Function(work->Data, job);
+    }
+
+    return 0;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: GetProcessorCount
+   $Prototype: int GetProcessorCount()
+   $Params: $
+   $Description: Returns how many processors are online. $
+   ======================================================================== */
+int GetProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (int)count : 1;
+}
+
+/* ========================================================================
+   $FUNCTION
+   $Name: ParallelFor
+   $Prototype: void ParallelFor(int thread_count, int job_count, ParallelFunction function, void *data)
+   $Params:
+       thread_count: How many threads to use, 0 uses one per processor.
+       job_count: How many jobs there are.
+       function: The function to call for every job.
+       data: The pointer passed to the function.
+   $
+   $Description: Calls the function once for every job, spread across
+   the threads. The calling thread does jobs as well and this returns
+   once all of the jobs are finished. If a thread can't be created the
+   remaining threads pick up its jobs. $
+   ======================================================================== */
+void ParallelFor(int thread_count, int job_count, ParallelFunction function, void *data)
+{
+    ParallelWork work;
+    pthread_t *threads;
+    int started = 0;
+
+    if (thread_count <= 0)
+    {
+        thread_count = GetProcessorCount();
+    }
+
+    if (thread_count > job_count)
+    {
+        thread_count = job_count;
+    }
+
+    work.Function = function;
+    work.Data = data;
+    work.JobCount = job_count;
+    work.NextJob = 0;
+
+    // No point in creating threads for a single worker.
+    if (thread_count <= 1)
+    {
+        ParallelWorker(&work);
+        return;
+    }
+
+    threads = (pthread_t*)malloc(sizeof(pthread_t) * (thread_count - 1));
+
+    for(int i = 0; i < thread_count - 1; i++)
+    {
+        if (pthread_create(&threads[started], 0, ParallelWorker, &work) == 0)
+        {
+            started++;
+        }
+    }
+
+    ParallelWorker(&work);
+
+    for(int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], 0);
+    }
+
+    free(threads);
+}
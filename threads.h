@@ -0,0 +1,21 @@
+/* ========================================================================
+   $HEADER FILE
+   $File: threads.h $
+   $Program: $
+   $Developer: Jordan Marling $
+   $Created On: 2026/10/17 $
+   $Description: A small helper for splitting work across threads. $
+   $Revisions: $
+   ======================================================================== */
+
+#if !defined(THREADS_H)
+#define THREADS_H
+
+// The function that gets called for every job. Data is the pointer that
+// was given to ParallelFor and index is the job number.
+typedef void (*ParallelFunction)(void *data, int index);
+
+int GetProcessorCount();
+void ParallelFor(int thread_count, int job_count, ParallelFunction function, void *data);
+
+#endif